@@ -0,0 +1,369 @@
+#ifndef AQI_ENGINE_H
+#define AQI_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "PacketSchema.h"
+#include "AQIResult.h"
+
+// ===== AQI STANDARDS =====
+enum AQIStandard : uint8_t {
+  AQI_STANDARD_EPA = 0,   // US EPA scale 0-500, as computed by the Node-RED flow
+  AQI_STANDARD_CAQI,      // EU Common Air Quality Index (hourly grid), 0-100, above 100 = very high
+  AQI_STANDARD_UBA,       // Umweltbundesamt Luftqualitätsindex, class 1 (sehr gut) to 5 (sehr schlecht)
+  AQI_STANDARD_COUNT
+};
+
+static const char* const AQI_STANDARD_NAMES[AQI_STANDARD_COUNT] = {"EPA", "CAQI", "UBA"};
+
+// In the order the flow's "AQI Calculator" sums them up
+enum AQIPollutant : uint8_t {
+  AQI_POLLUTANT_PM1_0 = 0,
+  AQI_POLLUTANT_PM2_5,
+  AQI_POLLUTANT_PM10,
+  AQI_POLLUTANT_CO2,
+  AQI_POLLUTANT_VOC,
+  AQI_POLLUTANT_GAS,
+  AQI_POLLUTANT_IAQ,
+  AQI_POLLUTANT_COUNT
+};
+
+static const char* const AQI_POLLUTANT_NAMES[AQI_POLLUTANT_COUNT] = {
+  "PM1.0", "PM2.5", "PM10", "CO2", "VOC", "Gas", "IAQ"
+};
+
+// ===== BREAKPOINT TABLES =====
+// A band runs from one concentration to the next in the direction of worse
+// air; the index is interpolated linearly between its two ends. A value is
+// in the first band whose end it has not passed, the last band extrapolates.
+// Bands with equal indices are steps (UBA classes, the flow's CO2 floor).
+//
+// Concentrations are integers in the packet field's wire unit (IAQ in
+// tenths, breath VOC in 1/100 mg/m³, see PACKET_SCHEMA) times the scale's
+// unitsPerWire, so a sub-index is integer math on the packet as it is sent.
+struct AQIBreakpoint {
+  int32_t from;
+  int32_t to;
+  int16_t indexFrom;
+  int16_t indexTo;
+};
+
+struct AQIScale {
+  const AQIBreakpoint* bands;   // nullptr = the standard has no scale for the pollutant
+  uint8_t count;
+  uint8_t unitsPerWire;         // 10 where a breakpoint is finer than the wire unit (EPA PM2.5: 12.1)
+  bool falling;                 // Worse air = lower value (gas resistance)
+  int16_t maxIndex;             // Cap after rounding, 0 = none
+};
+
+template <size_t N>
+constexpr AQIScale aqiScale(const AQIBreakpoint (&bands)[N], uint8_t unitsPerWire = 1, bool falling = false,
+                            int16_t maxIndex = 0) {
+  return {bands, (uint8_t)N, unitsPerWire, falling, maxIndex};
+}
+
+// EPA: the breakpoints of the flow's function nodes. PM2.5/PM10 are the US
+// EPA (2012) tables with the index continuous at the band edges (50, 100,
+// ...); PM1.0, CO2, VOC, gas and IAQ are the flow's own and only PM2.5,
+// PM10, CO2 and IAQ count as EPA sub-indices.
+static constexpr AQIBreakpoint AQI_EPA_PM1_0[] = {
+  {0, 8, 0, 50}, {8, 25, 50, 100}, {25, 40, 100, 150}, {40, 60, 150, 200}, {60, 100, 200, 300},
+  {100, 200, 300, 500}
+};
+static constexpr AQIBreakpoint AQI_EPA_PM2_5[] = {   // 0.1 µg/m³
+  {0, 120, 0, 50}, {121, 354, 50, 100}, {355, 554, 100, 150}, {555, 1504, 150, 200},
+  {1505, 2504, 200, 300}, {2505, 5004, 300, 500}
+};
+static constexpr AQIBreakpoint AQI_EPA_PM10[] = {
+  {0, 54, 0, 50}, {55, 154, 50, 100}, {155, 254, 100, 150}, {255, 354, 150, 200}, {355, 424, 200, 300},
+  {425, 604, 300, 500}
+};
+static constexpr AQIBreakpoint AQI_EPA_CO2[] = {
+  {0, 400, 25, 25}, {400, 600, 25, 50}, {600, 800, 50, 100}, {800, 1000, 100, 150}, {1000, 1500, 150, 200},
+  {1500, 2000, 200, 300}, {2000, 5000, 300, 500}
+};
+static constexpr AQIBreakpoint AQI_EPA_VOC[] = {     // 0.01 mg/m³
+  {0, 30, 25, 25}, {30, 50, 25, 50}, {50, 100, 50, 100}, {100, 200, 100, 150}, {200, 300, 150, 200},
+  {300, 500, 200, 300}, {500, 2500, 300, 500}
+};
+static constexpr AQIBreakpoint AQI_EPA_GAS[] = {
+  {1000000, 500000, 25, 25}, {500000, 200000, 25, 50}, {200000, 100000, 50, 100}, {100000, 50000, 100, 150},
+  {50000, 20000, 150, 200}, {20000, 10000, 200, 300}, {10000, 1000, 300, 500}
+};
+static constexpr AQIBreakpoint AQI_EPA_IAQ[] = {     // 0.1 IAQ
+  {0, 500, 0, 50}, {500, 1000, 50, 100}, {1000, 1500, 100, 150}, {1500, 2000, 150, 200}, {2000, 3000, 200, 300},
+  {3000, 5000, 300, 500}
+};
+
+// CAQI: hourly background grid (µg/m³). CO2 and IAQ are not part of CAQI;
+// their bands put the flow's 800/1000 ppm and the BSEC IAQ classes on the
+// same 25-point steps so an indoor worst index can be formed.
+static constexpr AQIBreakpoint AQI_CAQI_PM2_5[] = {
+  {0, 15, 0, 25}, {15, 30, 25, 50}, {30, 55, 50, 75}, {55, 110, 75, 100}
+};
+static constexpr AQIBreakpoint AQI_CAQI_PM10[] = {
+  {0, 25, 0, 25}, {25, 50, 25, 50}, {50, 90, 50, 75}, {90, 180, 75, 100}
+};
+static constexpr AQIBreakpoint AQI_CAQI_CO2[] = {
+  {0, 600, 0, 25}, {600, 800, 25, 50}, {800, 1000, 50, 75}, {1000, 2000, 75, 100}
+};
+static constexpr AQIBreakpoint AQI_CAQI_IAQ[] = {    // 0.1 IAQ
+  {0, 500, 0, 25}, {500, 1000, 25, 50}, {1000, 1500, 50, 75}, {1500, 2000, 75, 100}
+};
+
+// UBA: classes of the Luftqualitätsindex (PM hourly means, µg/m³). CO2
+// follows the UBA indoor guide values (up to 1000 ppm harmless, 2000 ppm
+// conspicuous, above unacceptable), IAQ the BSEC classes.
+static constexpr AQIBreakpoint AQI_UBA_PM2_5[] = {
+  {0, 10, 1, 1}, {10, 20, 2, 2}, {20, 25, 3, 3}, {25, 50, 4, 4}, {50, 1000, 5, 5}
+};
+static constexpr AQIBreakpoint AQI_UBA_PM10[] = {
+  {0, 20, 1, 1}, {20, 35, 2, 2}, {35, 50, 3, 3}, {50, 100, 4, 4}, {100, 1000, 5, 5}
+};
+static constexpr AQIBreakpoint AQI_UBA_CO2[] = {
+  {0, 1000, 1, 1}, {1000, 2000, 3, 3}, {2000, 100000, 5, 5}
+};
+static constexpr AQIBreakpoint AQI_UBA_IAQ[] = {     // 0.1 IAQ
+  {0, 500, 1, 1}, {500, 1000, 2, 2}, {1000, 1500, 3, 3}, {1500, 2000, 4, 4}, {2000, 10000, 5, 5}
+};
+
+static constexpr AQIScale AQI_NO_SCALE = {nullptr, 0, 1, false, 0};
+
+// The flow's scales for the combined index - all seven values
+static constexpr AQIScale AQI_FLOW_SCALES[AQI_POLLUTANT_COUNT] = {
+  aqiScale(AQI_EPA_PM1_0, 1, false, 500), aqiScale(AQI_EPA_PM2_5, 10), aqiScale(AQI_EPA_PM10),
+  aqiScale(AQI_EPA_CO2, 1, false, 500), aqiScale(AQI_EPA_VOC, 1, false, 500), aqiScale(AQI_EPA_GAS, 1, true, 500),
+  aqiScale(AQI_EPA_IAQ)
+};
+
+// The standards: PM2.5, PM10, CO2 and IAQ
+static constexpr AQIScale AQI_SCALES[AQI_STANDARD_COUNT][AQI_POLLUTANT_COUNT] = {
+  {AQI_NO_SCALE, aqiScale(AQI_EPA_PM2_5, 10), aqiScale(AQI_EPA_PM10), aqiScale(AQI_EPA_CO2, 1, false, 500),
+   AQI_NO_SCALE, AQI_NO_SCALE, aqiScale(AQI_EPA_IAQ)},
+  {AQI_NO_SCALE, aqiScale(AQI_CAQI_PM2_5), aqiScale(AQI_CAQI_PM10), aqiScale(AQI_CAQI_CO2),
+   AQI_NO_SCALE, AQI_NO_SCALE, aqiScale(AQI_CAQI_IAQ)},
+  {AQI_NO_SCALE, aqiScale(AQI_UBA_PM2_5), aqiScale(AQI_UBA_PM10), aqiScale(AQI_UBA_CO2),
+   AQI_NO_SCALE, AQI_NO_SCALE, aqiScale(AQI_UBA_IAQ)}
+};
+
+// Weights of the flow's "AQI Calculator" in tenths, by BSEC accuracy below / at least 2
+static constexpr uint8_t AQI_FLOW_WEIGHTS[AQI_POLLUTANT_COUNT][2] = {
+  {9, 9}, {10, 10}, {8, 8}, {6, 9}, {5, 8}, {6, 6}, {7, 10}
+};
+
+// ===== SUB-INDICES =====
+struct AQISubIndices {
+  int16_t index[AQI_POLLUTANT_COUNT];   // -1 = no scale in this standard or sensor absent
+  int16_t worst;                        // The standard's overall index: the highest sub-index, -1 if none
+  AQIPollutant dominant;
+};
+
+// ===== AQI ENGINE =====
+// Local AQI from a packet, no network: the sub-indices of each standard and
+// the combined index of the flow's "AQI Calculator" (weighted mean of all
+// sub-indices, level and color from getAQILevel()), i.e. the aqi_index the
+// flow stores for the same packet.
+//
+// Integer math: the wire values against integer breakpoints, rounded half
+// up like Math.round by integer division. The flow's double arithmetic only
+// differs from the exact result next to a .5; no sub-index of a value a
+// packet can hold gets there (tools/aqi_engine_bench checks every one), only
+// weighted means that are exactly on a tie, which flowTieRound() settles the
+// way the flow's double sum does.
+class AQIEngine {
+public:
+  // Sub-index of a wire value of the pollutant's packet field, -1 if the standard has no scale for it
+  static int16_t subIndex(AQIStandard standard, AQIPollutant pollutant, uint32_t raw);
+
+  // Sub-index on the flow's scale, as weighted into the combined index
+  static int16_t flowSubIndex(AQIPollutant pollutant, uint32_t raw);
+
+  // All sub-indices of the sensors present in the packet
+  static void evaluate(AQIStandard standard, const SensorDataPacket& packet, AQISubIndices& out);
+
+  // Node-RED "AQI Calculator" with getAQILevel()
+  static AQIResult combined(const SensorDataPacket& packet);
+
+  // getAQILevel(): level and color gradient of a combined index
+  static AQILevel level(int32_t aqi, uint32_t& color);
+
+private:
+  static int16_t interpolate(const AQIScale& scale, uint32_t raw);
+  static uint32_t rawValue(const SensorDataPacket& packet, AQIPollutant pollutant);
+  static bool present(const SensorDataPacket& packet, AQIPollutant pollutant);
+
+  // Math.round(num / den) for den > 0, and its mirror image for the
+  // gradients that count down (Math.round(n - x) = n - round half down of x)
+  static int32_t roundHalfUp(int32_t num, int32_t den);
+  static int32_t roundHalfDown(int32_t num, int32_t den);
+  static int32_t flowTieRound(const int16_t* index, const uint8_t* weight);
+};
+
+// ===== IMPLEMENTATION =====
+int32_t AQIEngine::roundHalfUp(int32_t num, int32_t den) {
+  int32_t twice = 2 * num + den;
+  int32_t q = twice / (2 * den);
+  return twice < 0 && q * 2 * den != twice ? q - 1 : q;  // Floor, not truncation
+}
+
+int32_t AQIEngine::roundHalfDown(int32_t num, int32_t den) {
+  return -roundHalfUp(-num, den);
+}
+
+// The products stay below 2^31: at most 200 index points per band times a
+// distance of at most 655350 table units (a 16-bit field in tenths) - the
+// 32-bit gas resistance only reaches steps (the 25 at and above 500 kOhm)
+// with a large distance.
+int16_t AQIEngine::interpolate(const AQIScale& scale, uint32_t raw) {
+  int32_t x = (int32_t)(raw > 0x7FFFFFFF / scale.unitsPerWire ? 0x7FFFFFFF / scale.unitsPerWire : raw) *
+              scale.unitsPerWire;
+  uint8_t i = 0;
+  if (scale.falling) {
+    while (i + 1 < scale.count && x < scale.bands[i].to) {
+      i++;
+    }
+  } else {
+    while (i + 1 < scale.count && x > scale.bands[i].to) {
+      i++;
+    }
+  }
+  const AQIBreakpoint& band = scale.bands[i];
+  if (band.indexFrom == band.indexTo) {
+    return band.indexFrom;
+  }
+  int32_t num = (int32_t)(band.indexTo - band.indexFrom) * (x - band.from);
+  int32_t den = band.to - band.from;
+  if (den < 0) {
+    num = -num;
+    den = -den;
+  }
+  int32_t index = band.indexFrom + roundHalfUp(num, den);
+  return (int16_t)(scale.maxIndex > 0 && index > scale.maxIndex ? scale.maxIndex : index);
+}
+
+// Weighted mean exactly on a .5: the flow's sum of index * 0.9 + ... in
+// double lands just above or below it, depending on the values and their
+// order, and Math.round follows. Repeats that sum - the only floating point
+// of the engine, on about one packet in 600.
+int32_t AQIEngine::flowTieRound(const int16_t* index, const uint8_t* weight) {
+  double total = 0;
+  double weights = 0;
+  for (uint8_t p = 0; p < AQI_POLLUTANT_COUNT; p++) {
+    if (weight[p] > 0) {
+      double w = weight[p] / 10.0;  // Correctly rounded: the same double as the literal 0.9 in the flow
+      total += index[p] * w;
+      weights += w;
+    }
+  }
+  double mean = total / weights;
+  int32_t down = (int32_t)mean;   // Positive: truncation is floor
+  return mean - down >= 0.5 ? down + 1 : down;
+}
+
+int16_t AQIEngine::subIndex(AQIStandard standard, AQIPollutant pollutant, uint32_t raw) {
+  if (standard >= AQI_STANDARD_COUNT || pollutant >= AQI_POLLUTANT_COUNT) {
+    return -1;
+  }
+  const AQIScale& scale = AQI_SCALES[standard][pollutant];
+  return scale.bands != nullptr ? interpolate(scale, raw) : -1;
+}
+
+int16_t AQIEngine::flowSubIndex(AQIPollutant pollutant, uint32_t raw) {
+  return pollutant < AQI_POLLUTANT_COUNT ? interpolate(AQI_FLOW_SCALES[pollutant], raw) : -1;
+}
+
+uint32_t AQIEngine::rawValue(const SensorDataPacket& packet, AQIPollutant pollutant) {
+  switch (pollutant) {
+    case AQI_POLLUTANT_PM1_0: return packet.pm1_0;
+    case AQI_POLLUTANT_PM2_5: return packet.pm2_5;
+    case AQI_POLLUTANT_PM10:  return packet.pm10;
+    case AQI_POLLUTANT_CO2:   return packet.co2_equivalent;
+    case AQI_POLLUTANT_VOC:   return packet.breath_voc;
+    case AQI_POLLUTANT_GAS:   return packet.gas_resistance;
+    case AQI_POLLUTANT_IAQ:   return packet.iaq;
+    default:                  return 0;
+  }
+}
+
+bool AQIEngine::present(const SensorDataPacket& packet, AQIPollutant pollutant) {
+  return pollutant <= AQI_POLLUTANT_PM10 ? (packet.pms_flags & 1) != 0 : (packet.bme_flags & 1) != 0;
+}
+
+void AQIEngine::evaluate(AQIStandard standard, const SensorDataPacket& packet, AQISubIndices& out) {
+  out.worst = -1;
+  out.dominant = AQI_POLLUTANT_PM2_5;
+  for (uint8_t p = 0; p < AQI_POLLUTANT_COUNT; p++) {
+    AQIPollutant pollutant = (AQIPollutant)p;
+    out.index[p] = present(packet, pollutant) ? subIndex(standard, pollutant, rawValue(packet, pollutant)) : -1;
+    if (out.index[p] > out.worst) {
+      out.worst = out.index[p];
+      out.dominant = pollutant;
+    }
+  }
+}
+
+AQIResult AQIEngine::combined(const SensorDataPacket& packet) {
+  // The flow takes every value it finds in the decoded packet: PM (0 if the
+  // section was not sent) always, the BME68X values when above zero
+  const uint8_t accuracy[AQI_POLLUTANT_COUNT] = {
+    3, 3, 3, packet.co2_accuracy, packet.voc_accuracy, 3, packet.iaq_accuracy
+  };
+  int16_t index[AQI_POLLUTANT_COUNT];
+  uint8_t weight[AQI_POLLUTANT_COUNT];
+  int32_t total = 0;
+  int32_t weights = 0;
+  for (uint8_t p = 0; p < AQI_POLLUTANT_COUNT; p++) {
+    uint32_t raw = rawValue(packet, (AQIPollutant)p);
+    weight[p] = p > AQI_POLLUTANT_PM10 && raw == 0 ? 0 : AQI_FLOW_WEIGHTS[p][accuracy[p] >= 2 ? 1 : 0];
+    index[p] = weight[p] > 0 ? interpolate(AQI_FLOW_SCALES[p], raw) : 0;
+    total += index[p] * weight[p];
+    weights += weight[p];
+  }
+
+  // PM always counts, weights > 0
+  int32_t aqi = (2 * total) % (2 * weights) == weights ? flowTieRound(index, weight) : roundHalfUp(total, weights);
+  if (aqi < 25) {
+    aqi = 25;
+  }
+
+  AQIResult result;
+  result.success = true;
+  result.aqi = (float)aqi;
+  result.level = level(aqi, result.colorCode);
+  return result;
+}
+
+AQILevel AQIEngine::level(int32_t aqi, uint32_t& color) {
+  int32_t r, g, b = 0;
+  AQILevel id;
+  if (aqi <= 50) {
+    r = roundHalfUp(aqi * 128, 50);
+    g = 255;
+    id = aqi <= 25 ? AQI_LEVEL_VERY_GOOD : AQI_LEVEL_GOOD;
+  } else if (aqi <= 100) {
+    r = 128 + roundHalfUp((aqi - 50) * 127, 50);
+    g = 255;
+    id = aqi <= 75 ? AQI_LEVEL_STILL_GOOD : AQI_LEVEL_MODERATE;
+  } else if (aqi <= 150) {
+    r = 255;
+    g = 255 - roundHalfDown((aqi - 100) * 129, 50);
+    id = aqi <= 125 ? AQI_LEVEL_UNHEALTHY : AQI_LEVEL_UNHEALTHY_SENSITIVE;
+  } else if (aqi <= 200) {
+    r = 255;
+    g = 126 - roundHalfDown((aqi - 150) * 126, 50);
+    id = aqi <= 175 ? AQI_LEVEL_SLIGHTLY_UNHEALTHY : AQI_LEVEL_UNHEALTHY_HIGH;
+  } else if (aqi <= 300) {
+    r = 255 - roundHalfDown((aqi - 200) * 112, 100);
+    g = 0;
+    b = roundHalfUp((aqi - 200) * 151, 100);
+    id = aqi <= 250 ? AQI_LEVEL_VERY_UNHEALTHY : AQI_LEVEL_EXTREMELY_UNHEALTHY;
+  } else {
+    r = 0x80;
+    g = 0;
+    id = AQI_LEVEL_HAZARDOUS;
+  }
+  color = ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+  return id;
+}
+
+#endif
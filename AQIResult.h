@@ -0,0 +1,341 @@
+#ifndef AQI_RESULT_H
+#define AQI_RESULT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "PacketSchema.h"
+
+// ===== AQI LEVELS =====
+// Level ids as sent by the Node-RED flow - order must match the
+// AQI_LEVELS table in the "AQI Response Generator" function
+enum AQILevel : uint8_t {
+  AQI_LEVEL_UNKNOWN = 0,
+  AQI_LEVEL_VERY_GOOD,
+  AQI_LEVEL_GOOD,
+  AQI_LEVEL_STILL_GOOD,
+  AQI_LEVEL_MODERATE,
+  AQI_LEVEL_UNHEALTHY,
+  AQI_LEVEL_UNHEALTHY_SENSITIVE,
+  AQI_LEVEL_SLIGHTLY_UNHEALTHY,
+  AQI_LEVEL_UNHEALTHY_HIGH,
+  AQI_LEVEL_VERY_UNHEALTHY,
+  AQI_LEVEL_EXTREMELY_UNHEALTHY,
+  AQI_LEVEL_HAZARDOUS,
+  AQI_LEVEL_COUNT
+};
+
+static const char* const AQI_LEVEL_NAMES[AQI_LEVEL_COUNT] = {
+  "No Data",
+  "Sehr gut",
+  "Gut",
+  "Still good",
+  "Moderate",
+  "Unhealthy",
+  "Unhealthy for sensitive groups",
+  "Leicht ungesund",
+  "Ungesund",
+  "Sehr ungesund",
+  "Extrem ungesund",
+  "Hazardous"
+};
+
+// At most 15 characters - the overview line of the display
+static const char* const AQI_LEVEL_SHORT_NAMES[AQI_LEVEL_COUNT] = {
+  "No Data",
+  "Sehr gut",
+  "Gut",
+  "Still good",
+  "Moderate",
+  "Unhealthy",
+  "Unhlthy Sens",
+  "Leicht ungesund",
+  "Ungesund",
+  "Sehr ungesund",
+  "Extrem ungesund",
+  "Hazardous!"
+};
+
+// ===== AQI RESULT STRUCTURE =====
+// No heap members: copied by value between tasks and every loop() cycle
+struct AQIResult {
+  bool success = false;
+  float aqi = 50.0;
+  AQILevel level = AQI_LEVEL_GOOD;
+  uint32_t colorCode = 0x00FF00;
+
+  const char* levelName() const { return AQI_LEVEL_NAMES[level < AQI_LEVEL_COUNT ? level : AQI_LEVEL_UNKNOWN]; }
+  const char* shortLevelName() const {
+    return AQI_LEVEL_SHORT_NAMES[level < AQI_LEVEL_COUNT ? level : AQI_LEVEL_UNKNOWN];
+  }
+};
+
+// ===== AQI JSON CODEC =====
+// JSON request and response of /calculate-aqi without heap: the request is
+// formatted from the packet's integer fields into a caller buffer (no float
+// printf, which allocates in newlib), the response is scanned in place - the
+// level name and color are compared and converted straight from the buffer.
+// Only the members of the "aqi" object the device uses are read; all other
+// values are skipped, so new fields in the flow do not break it.
+// tools/aqi_heap_bench runs both directions on the host with malloc counted
+// (the HTTP exchange around them is not heap-free).
+class AQIJson {
+public:
+  static const size_t MAX_REQUEST_LENGTH = 96;    // {"pm2_5":65535,...} with all fields at maximum
+  static const size_t MAX_RESPONSE_LENGTH = 512;  // Node-RED answers with ~250 bytes
+
+  // Length written (without terminator), 0 if out is too small
+  static size_t writeRequest(char* out, size_t size, const SensorDataPacket& packet);
+
+  // json must hold length bytes; false if the "aqi" object or its
+  // "combined" value is missing. level and color are optional.
+  static bool parseResponse(const char* json, size_t length, AQIResult& result);
+
+  // Name as sent by the flow, AQI_LEVEL_UNKNOWN if not in the table
+  static AQILevel levelFromName(const char* name, size_t length);
+
+  // "#RRGGBB" - false for anything else
+  static bool parseColor(const char* text, size_t length, uint32_t& color);
+
+private:
+  struct Cursor {
+    const char* pos;
+    const char* end;
+  };
+
+  static void skipSpace(Cursor& c);
+  static bool expect(Cursor& c, char ch);
+  static bool readString(Cursor& c, const char*& text, size_t& length);
+  static bool readNumber(Cursor& c, float& value);
+  static bool skipValue(Cursor& c);
+  static bool keyIs(const char* key, size_t length, const char* name);
+};
+
+// ===== IMPLEMENTATION =====
+size_t AQIJson::writeRequest(char* out, size_t size, const SensorDataPacket& packet) {
+  int length = snprintf(out, size, "{\"pm2_5\":%u,\"pm10\":%u,\"iaq\":%u.%u,\"co2\":%u,\"calibrated\":%s}",
+                        (unsigned)packet.pm2_5, (unsigned)packet.pm10,
+                        (unsigned)(packet.iaq / 10), (unsigned)(packet.iaq % 10),
+                        (unsigned)packet.co2_equivalent, (packet.bme_flags & 2) != 0 ? "true" : "false");
+  return length > 0 && (size_t)length < size ? (size_t)length : 0;
+}
+
+bool AQIJson::parseResponse(const char* json, size_t length, AQIResult& result) {
+  Cursor c = {json, json + length};
+
+  // Top level: find "aqi", skip everything else
+  if (!expect(c, '{')) {
+    return false;
+  }
+  for (;;) {
+    const char* key;
+    size_t keyLength;
+    if (!readString(c, key, keyLength) || !expect(c, ':')) {
+      return false;
+    }
+    if (keyIs(key, keyLength, "aqi")) {
+      break;
+    }
+    if (!skipValue(c)) {
+      return false;
+    }
+    if (!expect(c, ',')) {
+      return false;  // End of object without "aqi"
+    }
+  }
+
+  // The "aqi" object
+  if (!expect(c, '{')) {
+    return false;
+  }
+  bool haveCombined = false;
+  AQIResult parsed = result;
+  parsed.level = AQI_LEVEL_UNKNOWN;
+  skipSpace(c);
+  if (c.pos < c.end && *c.pos == '}') {
+    return false;
+  }
+  for (;;) {
+    const char* key;
+    size_t keyLength;
+    if (!readString(c, key, keyLength) || !expect(c, ':')) {
+      return false;
+    }
+    if (keyIs(key, keyLength, "combined")) {
+      if (!readNumber(c, parsed.aqi)) {
+        return false;
+      }
+      haveCombined = true;
+    } else if (keyIs(key, keyLength, "level")) {
+      const char* text;
+      size_t textLength;
+      if (!readString(c, text, textLength)) {
+        return false;
+      }
+      parsed.level = levelFromName(text, textLength);
+    } else if (keyIs(key, keyLength, "color")) {
+      const char* text;
+      size_t textLength;
+      if (!readString(c, text, textLength)) {
+        return false;
+      }
+      parseColor(text, textLength, parsed.colorCode);  // Keeps the previous color if malformed
+    } else if (!skipValue(c)) {
+      return false;
+    }
+    skipSpace(c);
+    if (c.pos < c.end && *c.pos == '}') {
+      break;
+    }
+    if (!expect(c, ',')) {
+      return false;
+    }
+  }
+
+  if (!haveCombined) {
+    return false;
+  }
+  parsed.success = true;
+  result = parsed;
+  return true;
+}
+
+AQILevel AQIJson::levelFromName(const char* name, size_t length) {
+  for (uint8_t i = 0; i < AQI_LEVEL_COUNT; i++) {
+    if (keyIs(name, length, AQI_LEVEL_NAMES[i])) {
+      return (AQILevel)i;
+    }
+  }
+  return AQI_LEVEL_UNKNOWN;
+}
+
+bool AQIJson::parseColor(const char* text, size_t length, uint32_t& color) {
+  if (length != 7 || text[0] != '#') {
+    return false;
+  }
+  uint32_t value = 0;
+  for (size_t i = 1; i < 7; i++) {
+    char ch = text[i];
+    uint32_t digit;
+    if (ch >= '0' && ch <= '9') {
+      digit = ch - '0';
+    } else if (ch >= 'a' && ch <= 'f') {
+      digit = ch - 'a' + 10;
+    } else if (ch >= 'A' && ch <= 'F') {
+      digit = ch - 'A' + 10;
+    } else {
+      return false;
+    }
+    value = (value << 4) | digit;
+  }
+  color = value;
+  return true;
+}
+
+void AQIJson::skipSpace(Cursor& c) {
+  while (c.pos < c.end && (*c.pos == ' ' || *c.pos == '\t' || *c.pos == '\r' || *c.pos == '\n')) {
+    c.pos++;
+  }
+}
+
+bool AQIJson::expect(Cursor& c, char ch) {
+  skipSpace(c);
+  if (c.pos >= c.end || *c.pos != ch) {
+    return false;
+  }
+  c.pos++;
+  return true;
+}
+
+// Raw text between the quotes - escapes are skipped over, not decoded
+// (level names and colors contain none)
+bool AQIJson::readString(Cursor& c, const char*& text, size_t& length) {
+  if (!expect(c, '"')) {
+    return false;
+  }
+  text = c.pos;
+  while (c.pos < c.end && *c.pos != '"') {
+    c.pos += *c.pos == '\\' ? 2 : 1;
+  }
+  if (c.pos >= c.end) {
+    return false;
+  }
+  length = c.pos - text;
+  c.pos++;
+  return true;
+}
+
+// Sign, digits, fraction - no exponent, the flow sends rounded values
+bool AQIJson::readNumber(Cursor& c, float& value) {
+  skipSpace(c);
+  bool negative = c.pos < c.end && *c.pos == '-';
+  if (negative) {
+    c.pos++;
+  }
+  const char* start = c.pos;
+  float number = 0;
+  while (c.pos < c.end && *c.pos >= '0' && *c.pos <= '9') {
+    number = number * 10 + (*c.pos++ - '0');
+  }
+  if (c.pos < c.end && *c.pos == '.') {
+    c.pos++;
+    float scale = 0.1f;
+    while (c.pos < c.end && *c.pos >= '0' && *c.pos <= '9') {
+      number += (*c.pos++ - '0') * scale;
+      scale *= 0.1f;
+    }
+  }
+  if (c.pos == start || (c.pos < c.end && (*c.pos == 'e' || *c.pos == 'E'))) {
+    return false;
+  }
+  value = negative ? -number : number;
+  return true;
+}
+
+// Any value; objects and arrays by bracket depth, strings with escapes
+bool AQIJson::skipValue(Cursor& c) {
+  skipSpace(c);
+  if (c.pos >= c.end) {
+    return false;
+  }
+  if (*c.pos == '"') {
+    const char* text;
+    size_t length;
+    return readString(c, text, length);
+  }
+  if (*c.pos != '{' && *c.pos != '[') {
+    // Number, true, false, null
+    const char* start = c.pos;
+    while (c.pos < c.end && *c.pos != ',' && *c.pos != '}' && *c.pos != ']' &&
+           *c.pos != ' ' && *c.pos != '\r' && *c.pos != '\n' && *c.pos != '\t') {
+      c.pos++;
+    }
+    return c.pos > start;
+  }
+  int depth = 0;
+  while (c.pos < c.end) {
+    char ch = *c.pos;
+    if (ch == '"') {
+      const char* text;
+      size_t length;
+      if (!readString(c, text, length)) {
+        return false;
+      }
+      continue;
+    }
+    c.pos++;
+    if (ch == '{' || ch == '[') {
+      depth++;
+    } else if ((ch == '}' || ch == ']') && --depth == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AQIJson::keyIs(const char* key, size_t length, const char* name) {
+  return strlen(name) == length && memcmp(key, name, length) == 0;
+}
+
+#endif
@@ -14,7 +14,6 @@
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include <Adafruit_NeoPixel.h>
-#include <ArduinoJson.h>
 #include <EEPROM.h>
 
 // Project includes
@@ -25,6 +24,9 @@
 #include "ButtonHandler.h"
 #include "LEDManager.h"
 #include "ByteTransmission.h"
+#include "BootTimeline.h"
+#include "AQIEngine.h"
+#include "Scheduler.h"
 
 // ===== HARDWARE OBJECTS =====
 Adafruit_NeoPixel strip = Adafruit_NeoPixel(NUM_LEDS, LED_PIN, NEO_GRB + NEO_KHZ800);
@@ -33,7 +35,8 @@ PMS pms(Serial1);
 U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE, DISPLAY_SCL, DISPLAY_SDA);
 
 // ===== SYSTEM OBJECTS =====
-SensorManager sensorManager(iaqSensor, pms);
+Scheduler scheduler;
+SensorManager sensorManager(iaqSensor, pms, Serial1);
 DisplayManager displayManager(u8g2, strip);
 ButtonHandler buttonHandler(displayManager);
 LEDManager ledManager(strip, displayManager);
@@ -42,176 +45,274 @@ ByteTransmissionManager byteManager;
 // ===== GLOBAL VARIABLES =====
 bool wifiConnected = false;
 bool nodeRedResponding = false;  // Node-RED response status
-float calculatedAQI = 50.0;
-String aqiLevel = "Good";
-uint32_t aqiColorCode = 0x00FF00; // Green
+AQIResult displayedAQI;            // Local engine (AQI_LOCAL) or Node-RED result (no heap)
+bool sendDue = true;               // Set by the send task; the next sample is queued (the first at once)
+SchedulerTask wifiTask = SCHEDULER_NO_TASK;
+SchedulerTask sendTask = SCHEDULER_NO_TASK;
+SchedulerTask bootTraceTask = SCHEDULER_NO_TASK;
+SchedulerTask sampleTask = SCHEDULER_NO_TASK;
 
-AQIResult calculateLocalAQI(const SensorData& data) {
-  AQIResult result;
-
-  // Validate sensor availability
-  if (!data.pms5003Available) {
-    DEBUG_WARN("PMS5003 not available for AQI calculation");
+// Flow's "AQI Calculator" on the device (AQIEngine.h) - same packet, same number
+AQIResult calculateLocalAQI(const SensorDataPacket& sample) {
+  if ((sample.pms_flags & 1) == 0 && (sample.bme_flags & 1) == 0) {
+    AQIResult result;
     result.success = false;
     result.aqi = 0;
-    result.level = F("No Data");
+    result.level = AQI_LEVEL_UNKNOWN;
     result.colorCode = 0x808080;  // Gray
     return result;
   }
+  return AQIEngine::combined(sample);
+}
 
-  int pm25 = data.pm2_5;
-  float aqi = 0;
-
-  if (pm25 <= 12) {
-    aqi = pm25 * 50.0 / 12.0;
-    result.level = F("Good");
-    result.colorCode = 0x00FF00;
-  } else if (pm25 <= 35) {
-    aqi = (pm25 - 12.1) * (100.0 - 51.0) / (35.4 - 12.1) + 51.0;
-    result.level = F("Moderate");
-    result.colorCode = 0xFFFF00;
-  } else if (pm25 <= 55) {
-    aqi = (pm25 - 35.5) * (150.0 - 101.0) / (55.4 - 35.5) + 101.0;
-    result.level = F("Poor");
-    result.colorCode = 0xFFA500;
-  } else if (pm25 <= 150) {
-    aqi = (pm25 - 55.5) * (200.0 - 151.0) / (150.4 - 55.5) + 151.0;
-    result.level = F("Unhealthy");
-    result.colorCode = 0xFF0000;
-  } else if (pm25 <= 250) {
-    aqi = (pm25 - 150.5) * (300.0 - 201.0) / (250.4 - 150.5) + 201.0;
-    result.level = F("Very poor");
-    result.colorCode = 0x800080;
-  } else {
-    aqi = (pm25 - 250.5) * (500.0 - 301.0) / (500.4 - 250.5) + 301.0;
-    result.level = F("Hazardous");
-    result.colorCode = 0x7E0023;
+// Combined index and the worst sub-index of each standard
+void logLocalAQI(const SensorDataPacket& sample, const AQIResult& local, unsigned long elapsedUs) {
+  AQISubIndices sub[AQI_STANDARD_COUNT];
+  for (uint8_t s = 0; s < AQI_STANDARD_COUNT; s++) {
+    AQIEngine::evaluate((AQIStandard)s, sample, sub[s]);
+  }
+  DEBUG_INFO("Local AQI: %.0f (%s) in %lu us - EPA %d (%s), CAQI %d (%s), UBA class %d (%s)",
+             local.aqi, local.levelName(), elapsedUs,
+             sub[AQI_STANDARD_EPA].worst, AQI_POLLUTANT_NAMES[sub[AQI_STANDARD_EPA].dominant],
+             sub[AQI_STANDARD_CAQI].worst, AQI_POLLUTANT_NAMES[sub[AQI_STANDARD_CAQI].dominant],
+             sub[AQI_STANDARD_UBA].worst, AQI_POLLUTANT_NAMES[sub[AQI_STANDARD_UBA].dominant]);
+}
+
+#if CYCLE_BENCH
+// CPU cycles per call of the sample path, over a spread of synthetic readings
+void runCycleBench() {
+  const uint32_t RUNS = 1000;
+  SensorData data;
+  data.bme68xAvailable = true;
+  data.ds18b20Available = true;
+  data.pms5003Available = true;
+  uint32_t packCycles = 0;
+  uint32_t aqiCycles = 0;
+  uint32_t checksum = 0;
+  for (uint32_t i = 0; i < RUNS; i++) {
+    data.temperature = 18.0f + (i % 100) * 0.07f;
+    data.humidity = 35.0f + (i % 50) * 0.5f;
+    data.pressure = 1013.25f - (i % 40) * 0.3f;
+    data.gasResistance = 50000.0f + i * 731.0f;
+    data.iaq = 20.0f + (i % 300) * 0.7f;
+    data.staticIaq = data.iaq;
+    data.co2Equivalent = 420.0f + (i % 200) * 13.0f;
+    data.breathVocEquivalent = 0.4f + (i % 100) * 0.03f;
+    data.iaqAccuracy = data.co2Accuracy = data.breathVocAccuracy = (uint8_t)(i & 3);
+    data.externalTemp = data.temperature - 0.5f;
+    data.pm1_0 = (uint16_t)(i % 80);
+    data.pm2_5 = (uint16_t)(i % 150);
+    data.pm10 = (uint16_t)(i % 220);
+
+    SensorDataPacket sample = {};
+    uint32_t start = ESP.getCycleCount();
+    packSensorData(data, sample);
+    uint32_t packed = ESP.getCycleCount();
+    AQIResult result = calculateLocalAQI(sample);
+    uint32_t done = ESP.getCycleCount();
+    packCycles += packed - start;
+    aqiCycles += done - packed;
+    checksum += result.colorCode;
+  }
+  DEBUG_INFO("Cycle bench: packSensorData %lu, calculateLocalAQI %lu cycles/call at %lu MHz (checksum %lu)",
+             (unsigned long)(packCycles / RUNS), (unsigned long)(aqiCycles / RUNS),
+             (unsigned long)ESP.getCpuFreqMHz(), (unsigned long)checksum);
+}
+#endif
+
+// ===== SCHEDULER TASKS =====
+// WiFi state machine - never blocks; the IP is shown once after boot
+void onWiFi(void*) {
+  static bool ipShown = false;
+  wifiConnected = byteManager.updateWiFi();
+  if (wifiConnected && !ipShown) {
+    IPAddress ip = WiFi.localIP();
+    char message[24];
+    snprintf(message, sizeof(message), "IP: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    displayManager.showMessage(message, 2000);
+    ipShown = true;
   }
+  scheduler.in(wifiTask, WIFI_POLL_INTERVAL);
+}
+
+// DATA_SEND_INTERVAL passed - the next sample goes to the network task
+void onSendDue(void*) {
+  sendDue = true;
+}
 
-  result.aqi = aqi;
-  result.success = true;
-  return result;
+void onBootTrace(void*) {
+  if (!BootTimeline::update()) {
+    scheduler.in(bootTraceTask, 1000);
+  }
 }
 
+void onSample(void*);  // With the sample handling below
+
 void setup() {
   Serial.begin(115200);
-  delay(1000);
-  
+  BootTimeline::mark(BOOT_SETUP);
+
   DEBUG_INFO("=== Air Quality Monitor starting ===");
- 
-  // Initialize hardware
+
+  // Initialize hardware - no settling delays, nothing below waits
   Wire.begin(DISPLAY_SDA, DISPLAY_SCL);
   Wire.setClock(100000);
-  delay(100);
-  
   Serial1.begin(9600, SERIAL_8N1, PMS_RX_PIN, PMS_TX_PIN);
-  delay(100);
 
-  // Initialize components
-  displayManager.init();
+  // Initialize components - each registers its scheduler tasks
+  scheduler.begin();
+  displayManager.init(scheduler);
   ledManager.init();
-  buttonHandler.init();
-  
-  // Show startup messages
-  displayManager.showMessage("System starting...");
+  buttonHandler.init(scheduler);
+  BootTimeline::mark(BOOT_DISPLAY);
+  displayManager.showMessage("Initializing sensors...", 0);
 
-  // Initialize sensors
-  displayManager.showMessage("Initializing sensors...");
+  // Sensors first: BSEC samples as soon as its task runs, the PMS5003
+  // warms up in its state machine. New snapshots wake loop() (onSample).
   bool sensorsOK = sensorManager.init();
-  
+  sampleTask = scheduler.add("sample", onSample, nullptr);
+  sensorManager.setUpdateTask(scheduler, sampleTask);
+  if (!sensorManager.begin()) {
+    sensorsOK = false;
+  }
+  BootTimeline::mark(BOOT_SENSORS);
+
+  // WiFi associates in the background while loop() is already sampling
+  wifiTask = scheduler.add("wifi", onWiFi, nullptr);
+  byteManager.startWiFi(scheduler, wifiTask);
+  scheduler.in(wifiTask, WIFI_POLL_INTERVAL);
+  displayManager.setWiFiStats(&byteManager.getWiFiStats());
+
+  sendTask = scheduler.add("send", onSendDue, nullptr);
+  bootTraceTask = scheduler.add("boot trace", onBootTrace, nullptr);
+  scheduler.in(bootTraceTask, 1000);
+
+  // Uploads run in their own task from here on
+  if (!byteManager.begin()) {
+    DEBUG_ERROR("Network task not started - no uploads");
+  }
+
+  // Shown while loop() runs - updateDisplay() takes over when it expires
   if (sensorsOK) {
     displayManager.showMessage("Sensors OK!", 1000);
   } else {
     displayManager.showMessage("Sensor warning!", 5000);
   }
 
-  // Connect to WiFi
-  displayManager.showMessage("Connecting WiFi...");
-  wifiConnected = byteManager.connectWiFi();
+#if CYCLE_BENCH
+  runCycleBench();
+#endif
 
-  if (wifiConnected) {
-    displayManager.showMessage("WiFi connected!", 1000);
-    String ip = WiFi.localIP().toString();
-    displayManager.showMessage("IP: " + ip, 2000);
-    DEBUG_INFO("WiFi connected successfully");
-  } else {
-    displayManager.showMessage("Offline mode", 5000);
-    DEBUG_WARN("WiFi connection failed - offline mode");
-  }
-
-  displayManager.showMessage("System ready!", 1000);
+  BootTimeline::mark(BOOT_READY);
   DEBUG_INFO("Setup completed");
 }
 
-void loop() {
+// ===== SAMPLE =====
+// The sensor task published a new snapshot
+void handleSample(const SensorData& data) {
   static unsigned long lastDebugTime = 0;
   static uint8_t loopDebugCount = 0;
 
-  // Update system components
-  buttonHandler.update();
-
-  // Read sensors
-  if (sensorManager.update()) {
-    SensorData data = sensorManager.getData();
-
-    // Enhanced debug output for sensor data
-    if (loopDebugCount < 10 || (millis() - lastDebugTime > 30000)) {
-      DEBUG_INFO("=== Sensor Data Update ===");
-      if (data.bme68xAvailable) {
-        DEBUG_INFO("BME68X - Temp: %.1f°C, Hum: %.1f%%, Press: %.1f hPa, Gas: %.0f Ohm",
-                   data.temperature, data.humidity, data.pressure, data.gasResistance);
-        DEBUG_INFO("BSEC - IAQ: %.0f (acc:%d), CO2: %.0f ppm (acc:%d), VOC: %.1f mg/m3 (acc:%d)",
-                   data.iaq, data.iaqAccuracy,
-                   data.co2Equivalent, data.co2Accuracy,
-                   data.breathVocEquivalent, data.breathVocAccuracy);
-      } else {
-        DEBUG_WARN("BME68X not available!");
-      }
-      if (data.pms5003Available) {
-        DEBUG_INFO("PMS5003 - PM1.0: %d, PM2.5: %d, PM10: %d µg/m³",
-                   data.pm1_0, data.pm2_5, data.pm10);
-      }
-      lastDebugTime = millis();
-      loopDebugCount++;
+  BootTimeline::mark(BOOT_FIRST_SAMPLE);
+
+  // One conversion to wire units per sample - AQI, send filter and upload all use it
+  SensorDataPacket sample = {};
+  packSensorData(data, sample);
+
+  unsigned long aqiStart = micros();
+  AQIResult local = calculateLocalAQI(sample);
+  unsigned long aqiMicros = micros() - aqiStart;
+
+  // Enhanced debug output for sensor data
+  if (loopDebugCount < 10 || (millis() - lastDebugTime > 30000)) {
+    DEBUG_INFO("=== Sensor Data Update ===");
+    if (data.bme68xAvailable) {
+      DEBUG_INFO("BME68X - Temp: %.1f°C, Hum: %.1f%%, Press: %.1f hPa, Gas: %.0f Ohm",
+                 data.temperature, data.humidity, data.pressure, data.gasResistance);
+      DEBUG_INFO("BSEC - IAQ: %.0f (acc:%d), CO2: %.0f ppm (acc:%d), VOC: %.1f mg/m3 (acc:%d)",
+                 data.iaq, data.iaqAccuracy,
+                 data.co2Equivalent, data.co2Accuracy,
+                 data.breathVocEquivalent, data.breathVocAccuracy);
+    } else {
+      DEBUG_WARN("BME68X not available!");
     }
+    if (data.pms5003Available) {
+      DEBUG_INFO("PMS5003 - PM1.0: %d, PM2.5: %d, PM10: %d µg/m³",
+                 data.pm1_0, data.pm2_5, data.pm10);
+      DEBUG_INFO("PMS5003 - CF=1: %u/%u/%u µg/m³", data.pm1_0Cf1, data.pm2_5Cf1, data.pm10Cf1);
+      DEBUG_INFO("PMS5003 - per 0.1 L >0.3: %u, >0.5: %u, >1.0: %u, >2.5: %u, >5: %u, >10 µm: %u",
+                 data.particles[PMS_BIN_0_3], data.particles[PMS_BIN_0_5], data.particles[PMS_BIN_1_0],
+                 data.particles[PMS_BIN_2_5], data.particles[PMS_BIN_5_0], data.particles[PMS_BIN_10]);
+    }
+    logLocalAQI(sample, local, aqiMicros);
+    const SchedulerStats& stats = scheduler.getStats();
+    DEBUG_INFO("Scheduler: %lu wakeups, %lu runs, idle %lu%%, next: %s",
+               (unsigned long)stats.wakeups, (unsigned long)stats.runs,
+               (unsigned long)stats.idlePercent(esp_timer_get_time()), scheduler.nextTaskName());
+    BsecTiming timing = sensorManager.getBsecTiming();
+    DEBUG_INFO("BSEC timing: %lu calls, late %lu us (mean %lu, max %lu), %lu violations",
+               (unsigned long)timing.calls, (unsigned long)timing.lastLateUs, (unsigned long)timing.meanLateUs(),
+               (unsigned long)timing.maxLateUs, (unsigned long)timing.violations);
+    lastDebugTime = millis();
+    loopDebugCount++;
+  }
 
-    AQIResult local = calculateLocalAQI(data);
-
-    if (wifiConnected) {
-      if (byteManager.isTimeToSend()) {
-        AQIResult net = byteManager.sendDataAndGetAQI(data);
-        if (net.success) {
-          calculatedAQI = net.aqi;
-          aqiLevel = net.level;
-          aqiColorCode = net.colorCode;
-          nodeRedResponding = true;
-          DEBUG_INFO("Received AQI from Node-RED: %.1f (%s)", calculatedAQI, aqiLevel.c_str());
-        } else {
-          nodeRedResponding = false;
-          calculatedAQI = local.aqi;
-          aqiLevel = local.level;
-          aqiColorCode = local.colorCode;
-          DEBUG_WARN("Node-RED timeout or error");
-        }
-      } else if (!nodeRedResponding) {
-        calculatedAQI = local.aqi;
-        aqiLevel = local.level;
-        aqiColorCode = local.colorCode;
+  // Hand the sample to the network task - never blocks.
+  // Offline samples are queued too and go to the backlog.
+  // The level stands for the AQI class (the color is a gradient).
+  if (sendDue) {
+    sendDue = false;
+    scheduler.in(sendTask, DATA_SEND_INTERVAL);
+    AQILevel aqiClass = AQI_LOCAL ? local.level : displayedAQI.level;
+    if (!byteManager.queueData(sample, aqiClass)) {
+      DEBUG_WARN("Network queue full - sample dropped (%lu total)",
+                 (unsigned long)byteManager.getDroppedPackets());
+    }
+  }
+
+  // Pick up the latest result published by the network task
+  AQIResult net;
+  if (byteManager.getLatestAQI(net)) {
+    nodeRedResponding = net.success;
+    if (net.success) {
+#if !AQI_LOCAL
+      displayedAQI = net;
+#endif
+      if (net.level != AQI_LEVEL_UNKNOWN) {
+        DEBUG_INFO("Received AQI from Node-RED: %.1f (%s)", net.aqi, net.levelName());
       }
     } else {
-      nodeRedResponding = false;
-      calculatedAQI = local.aqi;
-      aqiLevel = local.level;
-      aqiColorCode = local.colorCode;
+      DEBUG_WARN("Node-RED timeout or error");
     }
+  }
 
-    displayManager.updateDisplay(data, calculatedAQI, aqiLevel, wifiConnected, nodeRedResponding);
-    ledManager.updateLEDs(aqiColorCode);
+  if (!wifiConnected) {
+    nodeRedResponding = false;
   }
 
-  // Check WiFi connection
-  if (wifiConnected && WiFi.status() != WL_CONNECTED) {
-    DEBUG_WARN("WiFi lost - attempting reconnection");
-    wifiConnected = byteManager.connectWiFi();
+#if AQI_LOCAL
+  displayedAQI = local;
+#else
+  if (!nodeRedResponding) {
+    displayedAQI = local;
   }
-}
\ No newline at end of file
+#endif
+
+  displayManager.updateDisplay(data, displayedAQI, wifiConnected, nodeRedResponding);
+  ledManager.updateLEDs(displayedAQI.colorCode);
+}
+
+// Triggered by the sensor task; several snapshots in a row are taken as one
+void onSample(void*) {
+  static uint32_t sequence = 0;
+  SensorData data;
+  if (sensorManager.readData(data, sequence)) {
+    handleSample(data);
+  }
+}
+
+// Runs what is due, then sleeps until the nearest deadline or a trigger
+// (button ISR, WiFi event, sensor snapshot) - no polling in between
+void loop() {
+  scheduler.sleep(scheduler.runDue());
+}
@@ -0,0 +1,99 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+// ===== BOOT MILESTONES =====
+enum BootMilestone : uint8_t {
+  BOOT_SETUP = 0,         // setup() entered
+  BOOT_DISPLAY,           // Display initialized
+  BOOT_BSEC,              // BSEC initialized, first run() in the next loop()
+  BOOT_SENSORS,           // All sensors initialized
+  BOOT_READY,             // setup() done
+  BOOT_FIRST_SAMPLE,      // First sensor reading in loop()
+  BOOT_WIFI,              // Got an IP address
+  BOOT_TIME_SYNC,         // First SNTP sync
+  BOOT_FIRST_UPLOAD,      // First live packet accepted by the server
+  BOOT_MILESTONE_COUNT
+};
+
+// ===== BOOT TIMELINE =====
+// Time since boot (esp_timer, so the time before setup() counts too) at
+// which each milestone was first reached. mark() is lock-free and may be
+// called from any task; the trace is printed once from loop()'s task, when
+// the first upload is in or BOOT_TRACE_TIMEOUT has passed.
+class BootTimeline {
+public:
+  static void mark(BootMilestone milestone);
+
+  // Prints the trace when it is complete; true once it is out
+  static bool update();
+
+private:
+  static std::atomic<uint32_t> reachedMs[BOOT_MILESTONE_COUNT];  // 0 = not reached
+  static bool printed;
+  static const char* const NAMES[BOOT_MILESTONE_COUNT];
+
+  static uint32_t nowMs();
+  static void print();
+};
+
+// ===== IMPLEMENTATION =====
+std::atomic<uint32_t> BootTimeline::reachedMs[BOOT_MILESTONE_COUNT];  // Zero-initialized (static)
+bool BootTimeline::printed = false;
+const char* const BootTimeline::NAMES[BOOT_MILESTONE_COUNT] = {
+  "setup", "display", "bsec", "sensors", "ready", "first sample", "wifi", "time sync", "first upload"
+};
+
+uint32_t BootTimeline::nowMs() {
+  uint32_t ms = (uint32_t)(esp_timer_get_time() / 1000);
+  return ms > 0 ? ms : 1;
+}
+
+void BootTimeline::mark(BootMilestone milestone) {
+  uint32_t unset = 0;
+  reachedMs[milestone].compare_exchange_strong(unset, nowMs());
+}
+
+bool BootTimeline::update() {
+  if (!printed && (reachedMs[BOOT_FIRST_UPLOAD].load() != 0 || nowMs() >= BOOT_TRACE_TIMEOUT)) {
+    printed = true;
+    print();
+  }
+  return printed;
+}
+
+// In the order reached - after setup() WiFi, sensors and uploads race each other
+void BootTimeline::print() {
+  uint8_t order[BOOT_MILESTONE_COUNT];
+  uint32_t ms[BOOT_MILESTONE_COUNT];
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+    ms[i] = reachedMs[i].load();
+    if (ms[i] == 0) {
+      continue;
+    }
+    uint8_t j = count++;
+    for (; j > 0 && ms[order[j - 1]] > ms[i]; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  DEBUG_INFO("=== Boot timeline (ms since boot) ===");
+  uint32_t previous = 0;
+  for (uint8_t k = 0; k < count; k++) {
+    uint8_t i = order[k];
+    DEBUG_INFO("  %-13s %6lu  +%lu", NAMES[i], (unsigned long)ms[i], (unsigned long)(ms[i] - previous));
+    previous = ms[i];
+  }
+  for (uint8_t i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+    if (ms[i] == 0) {
+      DEBUG_INFO("  %-13s not reached", NAMES[i]);
+    }
+  }
+}
+
+#endif
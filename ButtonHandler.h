@@ -4,8 +4,11 @@
 #include <Arduino.h>
 #include "config.h"
 #include "DisplayManager.h"
+#include "Scheduler.h"
 
 // ===== BUTTON HANDLER CLASS =====
+// A scheduler task: the ISR triggers it on a press, then it checks for the
+// release every BUTTON_POLL_INTERVAL until the button is up again.
 class ButtonHandler {
 private:
   DisplayManager& displayManager;
@@ -13,6 +16,8 @@ private:
   static volatile bool selectFlag;
   static volatile unsigned long lastInterruptTime;
   static portMUX_TYPE selectMux;
+  static Scheduler* scheduler;
+  static SchedulerTask task;
   static void IRAM_ATTR selectISR();
 
   unsigned long selectPressTime = 0;
@@ -20,10 +25,11 @@ private:
 
 public:
   ButtonHandler(DisplayManager& display);
-  void init();
-  void update();
+  void init(Scheduler& taskScheduler);
 
 private:
+  void update();
+  static void onButton(void* self) { static_cast<ButtonHandler*>(self)->update(); }
   void handleSelectButtonShort();
   void handleSelectButtonLong();
 };
@@ -32,22 +38,30 @@ private:
 volatile bool ButtonHandler::selectFlag = false;
 volatile unsigned long ButtonHandler::lastInterruptTime = 0;
 portMUX_TYPE ButtonHandler::selectMux = portMUX_INITIALIZER_UNLOCKED;
+Scheduler* ButtonHandler::scheduler = nullptr;
+SchedulerTask ButtonHandler::task = SCHEDULER_NO_TASK;
 
 // ===== ISR DEFINITION =====
 void IRAM_ATTR ButtonHandler::selectISR() {
   portENTER_CRITICAL_ISR(&selectMux);
   unsigned long interruptTime = millis();
-  if (interruptTime - lastInterruptTime > BUTTON_DEBOUNCE_MS) {
+  bool pressed = interruptTime - lastInterruptTime > BUTTON_DEBOUNCE_MS;
+  if (pressed) {
     selectFlag = true;
     lastInterruptTime = interruptTime;
   }
   portEXIT_CRITICAL_ISR(&selectMux);
+  if (pressed && scheduler != nullptr) {
+    scheduler->triggerFromISR(task);
+  }
 }
 
 // ===== IMPLEMENTATION =====
 ButtonHandler::ButtonHandler(DisplayManager& display) : displayManager(display) {}
 
-void ButtonHandler::init() {
+void ButtonHandler::init(Scheduler& taskScheduler) {
+  task = taskScheduler.add("button", onButton, this);
+  scheduler = &taskScheduler;
   pinMode(BUTTON_SELECT_PIN, INPUT_PULLUP);
   attachInterrupt(digitalPinToInterrupt(BUTTON_SELECT_PIN), selectISR, FALLING);
   
@@ -75,6 +89,10 @@ void ButtonHandler::update() {
       handleSelectButtonShort();
     }
   }
+
+  if (selectWaitingRelease) {
+    scheduler->in(task, BUTTON_POLL_INTERVAL);
+  }
 }
 
 void ButtonHandler::handleSelectButtonShort() {
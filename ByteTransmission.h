@@ -4,305 +4,867 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
-#include <ArduinoJson.h>
 #include "config.h"
 #include "secrets.h"
 #include "SensorManager.h"
 #include "TimeUtils.h"
+#include "HttpConnection.h"
+#include "CoapConnection.h"
+#include "MqttUplink.h"
+#include "Mailbox.h"
+#include "PacketStore.h"
+#include "PacketSchema.h"
+#include "SendFilter.h"
+#include "WallClock.h"
+#include "LineProtocol.h"
+#include "Gzip.h"
+#include <Preferences.h>
+#include "WiFiConnection.h"
+#include "AQIResult.h"
+#include "BootTimeline.h"
+
+#if INFLUX_DIRECT && TRANSPORT_MODE != TRANSPORT_HTTP
+#error "INFLUX_DIRECT needs TRANSPORT_MODE TRANSPORT_HTTP"
+#endif
 
 // ===== BYTE TRANSMISSION PROTOCOL =====
-// Compact binary format for minimal data transfer
+// Compact binary format for minimal data transfer - sensor packet layout and
+// encoders are generated from the field table in PacketSchema.h
+#define PACKET_NVS_NAMESPACE "packet"
 
 #pragma pack(push, 1)  // No padding bytes
 
-struct SensorDataPacket {
-  // Header (4 bytes)
-  uint32_t timestamp;           // Unix timestamp
-  
-  // BME68X Data (22 bytes)
-  int16_t bme_temperature;      // °C * 100 (e.g., 2350 = 23.50°C)
-  uint16_t bme_humidity;        // % * 100 (e.g., 4520 = 45.20%)
-  uint16_t bme_pressure;        // hPa * 10 (e.g., 10132 = 1013.2 hPa)
-  uint32_t gas_resistance;      // Ohm
-  uint16_t iaq;                 // IAQ * 10
-  uint16_t static_iaq;          // Static IAQ * 10
-  uint16_t co2_equivalent;      // ppm
-  uint16_t breath_voc;          // mg/m³ * 100
-  uint8_t iaq_accuracy;         // 0-3
-  uint8_t co2_accuracy;         // 0-3
-  uint8_t voc_accuracy;         // 0-3
-  uint8_t bme_flags;            // Bit 0: available, Bit 1: calibrated
-  
-  // DS18B20 Data (3 bytes)
-  int16_t ds_temperature;       // °C * 100
-  uint8_t ds_flags;             // Bit 0: available
-  
-  // PMS5003 Data (7 bytes)
-  uint16_t pm1_0;               // µg/m³
-  uint16_t pm2_5;               // µg/m³
-  uint16_t pm10;                // µg/m³
-  uint8_t pms_flags;            // Bit 0: available
-  
-  // System data (5 bytes)
-  uint32_t uptime_seconds;      // Seconds since start (4 bytes)
-  int8_t wifi_rssi;             // dBm (1 byte)
-  
-  // Checksum (1 byte)
+// Binary AQI result returned in the /sensor-data response body (combined mode)
+#define AQI_RESPONSE_MAGIC 0xA1
+
+struct AQIResponsePacket {
+  uint8_t magic;                // AQI_RESPONSE_MAGIC
+  uint16_t aqi;                 // AQI * 10
+  uint8_t level_id;             // AQILevel
+  uint8_t color_r;              // LED color
+  uint8_t color_g;
+  uint8_t color_b;
   uint8_t checksum;             // XOR of all bytes
 };
-// TOTAL: 4+22+3+7+5+1 = 42 bytes
+// TOTAL: 1+2+1+3+1 = 8 bytes
 
 #pragma pack(pop)
 
-// ===== AQI RESULT STRUCTURE =====
-struct AQIResult {
-  bool success = false;
-  float aqi = 50.0;
-  String level = "Good";
-  uint32_t colorCode = 0x00FF00;
-};
-
 // ===== BYTE TRANSMISSION MANAGER =====
 class ByteTransmissionManager {
 private:
-  unsigned long lastSendTime = 0;
-  
+
+  // Keep-alive sessions, one per Node-RED endpoint
+  HttpConnection sendConnection;
+  HttpConnection aqiConnection;
+#if TRANSPORT_MODE == TRANSPORT_COAP
+  CoapConnection coapConnection;  // Live packets; backlog stays on sendConnection
+#endif
+
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+  // Persistent broker session: publishes pipelined, AQI pushed on a retained topic
+  MqttUplink mqtt;
+#endif
+
+  // Network task: packets in via bounded queue, latest AQI out via mailbox
+  QueueHandle_t packetQueue = nullptr;
+  TaskHandle_t networkTask = nullptr;
+  Mailbox<AQIResult> aqiMailbox;   // AQIResult is trivially copyable
+  uint32_t aqiSequence = 0;       // Last mailbox sequence seen by loop()
+  uint32_t droppedPackets = 0;
+  char aqiResponse[AQIJson::MAX_RESPONSE_LENGTH + 1];  // Network task: /calculate-aqi body, parsed in place
+  SendFilter sendFilter;          // loop() side: skips unchanged samples (SEND_ON_CHANGE)
+  WallClock wallClock;            // SNTP time for the packets, read from both tasks
+  WiFiConnection wifi;            // loop() side: background connect + reconnect; isConnected() any task
+
+  // Packet identity: (bootCount, sequence) grows strictly per device
+  uint8_t deviceId[6] = {0};
+  uint16_t bootCount = 0;
+  uint32_t nextSequence = 0;
+  char bootCountHeader[8] = "0";
+
+#if BACKLOG_ENABLED
+  // Store-and-forward: packets that could not be sent, uploaded after reconnect
+  PacketStore backlog;
+  SensorDataPacket backlogBatch[BACKLOG_BATCH_SIZE];
+  unsigned long lastDrainTime = 0;
+#if BACKLOG_BATCH_FRAMES
+  static_assert(BACKLOG_BATCH_SIZE <= 255, "Batch frame count is one byte");
+  uint8_t backlogBody[BatchFrameEncoder::maxFrameSize(BACKLOG_BATCH_SIZE)];
+#else
+  uint8_t backlogBody[BACKLOG_BATCH_SIZE * PACKET_WIRE_MAX_SIZE];
+#endif
+#endif
+
+#if INFLUX_DIRECT
+  // Line protocol batch, gzipped into influxBody when INFLUX_BATCH_SAMPLES are collected
+  static_assert(sizeof(INFLUX_LOCATION) - 1 <= LineProtocolEncoder::MAX_LOCATION_LENGTH, "INFLUX_LOCATION too long");
+  static_assert(INFLUX_BATCH_SAMPLES * LineProtocolEncoder::MAX_LINE_LENGTH <= GzipEncoder::MAX_INPUT_LENGTH,
+                "INFLUX_BATCH_SAMPLES lines exceed one gzip buffer");
+  HttpConnection influxConnection;
+  char influxLines[INFLUX_BATCH_SAMPLES * LineProtocolEncoder::MAX_LINE_LENGTH];
+  size_t influxLength = 0;
+  size_t influxCount = 0;
+  uint8_t influxBody[GzipEncoder::maxEncodedSize(sizeof(influxLines))];
+  uint16_t influxHashTable[GzipEncoder::HASH_SIZE];
+#endif
+
 public:
   ByteTransmissionManager();
 
-  bool connectWiFi();
-  bool isTimeToSend();
-  AQIResult sendDataAndGetAQI(const SensorData& data);
-  bool isConnected() { return WiFi.status() == WL_CONNECTED; }
+  bool begin();
+  void startWiFi(Scheduler& scheduler, SchedulerTask task);  // WiFi events trigger task
+  bool updateWiFi();              // Call from loop() (the task); true while connected
+  bool queueData(const SensorDataPacket& sample, uint32_t aqiClass);  // Sensor sections (packSensorData)
+  bool getLatestAQI(AQIResult& result);
+  // No traffic on a cached lease before its gateway check passed
+  bool isConnected() { return wifi.isConnected() && WiFi.status() == WL_CONNECTED; }
+  uint32_t getDroppedPackets() const { return droppedPackets; }
+  uint32_t getSentPackets() const { return sendFilter.getSent(); }
+  uint32_t getSuppressedPackets() const { return sendFilter.getSuppressed(); }
+
+  const WiFiConnectionStats& getWiFiStats() const { return wifi.getStats(); }
+
+  // Per-endpoint request timing counters
+  const HttpConnectionStats& getSendStats() const { return sendConnection.getStats(); }
+  const HttpConnectionStats& getAQIStats() const { return aqiConnection.getStats(); }
+#if TRANSPORT_MODE == TRANSPORT_COAP
+  const CoapConnectionStats& getCoapStats() const { return coapConnection.getStats(); }
+#endif
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+  const MqttConnectionStats& getMqttStats() const { return mqtt.getStats(); }
+#endif
+#if INFLUX_DIRECT
+  const HttpConnectionStats& getInfluxStats() const { return influxConnection.getStats(); }
+#endif
   
 private:
-  SensorDataPacket createPacket(const SensorData& data);
-  uint8_t calculateChecksum(const SensorDataPacket& packet);
-  bool sendBinaryData(const SensorDataPacket& packet);
-  AQIResult getCalculatedAQI(const SensorData& data);
-  uint32_t parseColorCode(const String& colorStr);
+  void loadIdentity();
+  static void networkTaskEntry(void* param);
+  void runNetworkTask();
+  void handleLivePacket(const SensorDataPacket& packet);
+  void publishAQI(const AQIResult& result);
+  bool transmitPacket(const SensorDataPacket& packet, AQIResult& result);
+  void storePacket(const SensorDataPacket& packet);
+  void drainBacklog();
+  static uint32_t deviceUptimeSeconds();
+
+#if INFLUX_DIRECT
+  bool writeInflux(const SensorDataPacket& packet);
+  bool appendInfluxLine(const SensorDataPacket& packet);
+  bool flushInflux();
+  void writeInfluxBacklog();
+  bool packetTimeMs(const SensorDataPacket& packet, uint64_t& timeMs);
+#endif
+
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+  static void mqttAqiEntry(void* context, const uint8_t* payload, size_t length);
+  void onMqttAqi(const uint8_t* payload, size_t length);
+#endif
+
+  SensorDataPacket createPacket(const SensorDataPacket& sample);
+  uint8_t calculateChecksum(const uint8_t* bytes, size_t length);
+  bool sendBinaryData(const SensorDataPacket& packet, AQIResult* aqiResult = nullptr);
+  bool sendCoapData(const SensorDataPacket& packet, AQIResult& aqiResult);
+  AQIResult parseAQIResponse(HTTPClient& http);
+  AQIResult decodeAQIResponse(const AQIResponsePacket& response);
+  AQIResult getCalculatedAQI(const SensorDataPacket& packet);
+  static AQIResult uploadAccepted();
+  void logRequestStats(const char* name, const HttpConnection& connection);
+  void logCoapStats(const CoapConnectionStats& stats);
 };
 
 // ===== IMPLEMENTATION =====
-ByteTransmissionManager::ByteTransmissionManager() {
+ByteTransmissionManager::ByteTransmissionManager()
+  : sendConnection(NODERED_SEND_URL), aqiConnection(NODERED_AQI_URL)
+#if TRANSPORT_MODE == TRANSPORT_COAP
+  , coapConnection(NODERED_COAP_URL)
+#endif
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+  , mqtt(MQTT_BROKER_URL, MQTT_USERNAME, MQTT_PASSWORD)
+#endif
+#if BACKLOG_ENABLED
+  , backlog(sizeof(SensorDataPacket))
+#endif
+#if INFLUX_DIRECT
+  , influxConnection(INFLUX_WRITE_URL)
+#endif
+{
 }
 
-bool ByteTransmissionManager::connectWiFi() {
-  DEBUG_INFO("Connecting to WiFi...");
+bool ByteTransmissionManager::begin() {
+  loadIdentity();
+
+  packetQueue = xQueueCreate(NET_QUEUE_LENGTH, sizeof(SensorDataPacket));
+  if (packetQueue == nullptr) {
+    DEBUG_ERROR("Network queue allocation failed");
+    return false;
+  }
 
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+#if BACKLOG_ENABLED
+  mqtt.begin(deviceId, &backlog, mqttAqiEntry, this);
+#else
+  mqtt.begin(deviceId, nullptr, mqttAqiEntry, this);
+#endif
+#endif
 
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED &&
-         (millis() - startTime) < WIFI_CONNECT_TIMEOUT) {
-    delay(500);
+  // Pinned to the core loop() does not run on - HTTP never stalls sensors/button
+  if (xTaskCreatePinnedToCore(networkTaskEntry, "network", NET_TASK_STACK_SIZE, this,
+                              NET_TASK_PRIORITY, &networkTask, NET_TASK_CORE) != pdPASS) {
+    DEBUG_ERROR("Network task creation failed");
+    return false;
   }
 
-  if (WiFi.status() == WL_CONNECTED) {
-    DEBUG_INFO("WiFi connected: %s", WiFi.localIP().toString().c_str());
-    DEBUG_INFO("RSSI: %d dBm", WiFi.RSSI());
-    return true;
+  DEBUG_INFO("Network task started on core %d", NET_TASK_CORE);
+  return true;
+}
+
+void ByteTransmissionManager::loadIdentity() {
+  // eFuse MAC, first byte first - same order as printed by the ESP32
+  uint64_t mac = ESP.getEfuseMac();
+  for (size_t i = 0; i < sizeof(deviceId); i++) {
+    deviceId[i] = (uint8_t)(mac >> (8 * i));
+  }
+
+  // Sequence numbers restart at 0, the boot count tells the runs apart.
+  // NVS instead of EEPROM - resetBsecCalibration() clears the whole EEPROM.
+  Preferences prefs;
+  if (prefs.begin(PACKET_NVS_NAMESPACE, false)) {
+    bootCount = prefs.getUShort("boot", 0) + 1;
+    prefs.putUShort("boot", bootCount);
+    prefs.end();
   } else {
-    DEBUG_ERROR("WiFi connection failed");
-    return false;
+    DEBUG_ERROR("NVS not available - boot count stays 0");
   }
+  snprintf(bootCountHeader, sizeof(bootCountHeader), "%u", bootCount);
+
+  DEBUG_INFO("Device %02X%02X%02X%02X%02X%02X, boot %u",
+             deviceId[0], deviceId[1], deviceId[2], deviceId[3], deviceId[4], deviceId[5], bootCount);
 }
 
-bool ByteTransmissionManager::isTimeToSend() {
-  return (millis() - lastSendTime >= DATA_SEND_INTERVAL);
+void ByteTransmissionManager::networkTaskEntry(void* param) {
+  static_cast<ByteTransmissionManager*>(param)->runNetworkTask();
+}
+
+void ByteTransmissionManager::runNetworkTask() {
+  SensorDataPacket packet;
+
+#if BACKLOG_ENABLED
+  // Mount and recover here - the flash scan does not delay setup()
+  backlog.begin();
+#endif
+
+  for (;;) {
+    // Sleep until the next live packet - with a backlog wake up to drain it
+    TickType_t wait = portMAX_DELAY;
+#if BACKLOG_ENABLED
+    if (backlog.pending() > 0) {
+      wait = pdMS_TO_TICKS(BACKLOG_DRAIN_INTERVAL);
+    }
+#endif
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+    // PUBACKs, pushed AQI results and keep-alive need the socket serviced
+    if (wait > pdMS_TO_TICKS(MQTT_POLL_INTERVAL)) {
+      wait = pdMS_TO_TICKS(MQTT_POLL_INTERVAL);
+    }
+#endif
+
+    if (xQueueReceive(packetQueue, &packet, wait) == pdTRUE) {
+      handleLivePacket(packet);
+    }
+
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+    mqtt.poll(isConnected());
+#endif
+
+#if BACKLOG_ENABLED
+    // Live samples first: drain only while none is waiting, rate limited
+    if (uxQueueMessagesWaiting(packetQueue) == 0 && isConnected() &&
+        backlog.pending() > 0 && millis() - lastDrainTime >= BACKLOG_DRAIN_INTERVAL) {
+#if INFLUX_DIRECT
+      writeInfluxBacklog();
+#else
+      drainBacklog();
+#endif
+    }
+#endif
+  }
 }
 
-AQIResult ByteTransmissionManager::sendDataAndGetAQI(const SensorData& data) {
+void ByteTransmissionManager::handleLivePacket(const SensorDataPacket& packet) {
+  if (!isConnected()) {
+    storePacket(packet);  // Offline - keep it for later
+    return;
+  }
+
+#if INFLUX_DIRECT
+  // Lines go to InfluxDB in batches; without AQI_LOCAL the AQI still comes
+  // from Node-RED if configured
+  bool written = writeInflux(packet);
+  if (!written) {
+    storePacket(packet);
+  }
+#if AQI_LOCAL
+  publishAQI(written ? uploadAccepted() : AQIResult());
+#else
+  publishAQI(NODERED_AQI_URL[0] != '\0' ? getCalculatedAQI(packet) : AQIResult());
+#endif
+#elif TRANSPORT_MODE == TRANSPORT_MQTT
+  // PUBACK and AQI arrive later through mqtt.poll()
+  if (!mqtt.publish(packet, isConnected())) {
+    storePacket(packet);
+    publishAQI(AQIResult());
+  }
+#else
   AQIResult result;
-  
-  // Send binary sensor data to Node-RED
-  SensorDataPacket packet = createPacket(data);
-  if (sendBinaryData(packet)) {
-    // Retrieve AQI from Node-RED (JSON)
-    result = getCalculatedAQI(data);
-    lastSendTime = millis();
+  if (transmitPacket(packet, result)) {
+    BootTimeline::mark(BOOT_FIRST_UPLOAD);
+  } else {
+    storePacket(packet);
   }
-  
-  return result;
+  publishAQI(result);
+#endif
 }
 
-SensorDataPacket ByteTransmissionManager::createPacket(const SensorData& data) {
-  SensorDataPacket packet = {0};
-  
-  // Header
-  packet.timestamp = (uint32_t)(getUptimeMillis() / 1000);  // Unix-like since start
-
-  // BME68X data
-  if (data.bme68xAvailable) {
-    packet.bme_temperature = (int16_t)(data.temperature * 100);
-    packet.bme_humidity = (uint16_t)(data.humidity * 100);
-    packet.bme_pressure = (uint16_t)(data.pressure * 10);
-    packet.gas_resistance = (uint32_t)data.gasResistance;
-    packet.iaq = (uint16_t)(data.iaq * 10);
-    packet.static_iaq = (uint16_t)(data.staticIaq * 10);
-    packet.co2_equivalent = (uint16_t)data.co2Equivalent;
-    packet.breath_voc = (uint16_t)(data.breathVocEquivalent * 100);
-    packet.iaq_accuracy = data.iaqAccuracy;
-    packet.co2_accuracy = data.co2Accuracy;
-    packet.voc_accuracy = data.breathVocAccuracy;
-    packet.bme_flags = (data.bme68xAvailable ? 1 : 0) | (data.bsecCalibrated ? 2 : 0);
+void ByteTransmissionManager::publishAQI(const AQIResult& result) {
+  aqiMailbox.publish(result);
+}
+
+void ByteTransmissionManager::storePacket(const SensorDataPacket& packet) {
+#if BACKLOG_ENABLED
+  if (backlog.push((const uint8_t*)&packet)) {
+    DEBUG_INFO("Packet stored in backlog (%u pending)", (unsigned)backlog.pending());
+  } else {
+    DEBUG_ERROR("Backlog store failed - sample lost");
   }
-  
-  // DS18B20 data
-  if (data.ds18b20Available) {
-    packet.ds_temperature = (int16_t)(data.externalTemp * 100);
-    packet.ds_flags = 1;  // Available
+#endif
+}
+
+void ByteTransmissionManager::drainBacklog() {
+#if BACKLOG_ENABLED
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+  if (!mqtt.canPublishBacklog()) {
+    return;  // Previous batch not acknowledged yet, or no broker session
   }
-  
-  // PMS5003 data
-  if (data.pms5003Available) {
-    packet.pm1_0 = data.pm1_0;
-    packet.pm2_5 = data.pm2_5;
-    packet.pm10 = data.pm10;
-    packet.pms_flags = 1;  // Available
+#endif
+  lastDrainTime = millis();
+
+  size_t count = backlog.read((uint8_t*)backlogBatch, BACKLOG_BATCH_SIZE);
+  if (count == 0) {
+    backlog.acknowledge();  // Only corrupt records were skipped
+    return;
+  }
+
+  // Samples of this boot from before the first sync get their time now; for
+  // older ones X-Device-Uptime and X-Boot-Count let the flow restore it
+  for (size_t i = 0; i < count; i++) {
+    wallClock.stampLate(backlogBatch[i], bootCount);
   }
+
+  // Oldest first
+  char batchCount[8];
+  char uptime[12];
+  snprintf(batchCount, sizeof(batchCount), "%u", (unsigned)count);
+  snprintf(uptime, sizeof(uptime), "%lu", (unsigned long)deviceUptimeSeconds());
+
+  size_t length = 0;
+  const char* format = "raw";
+
+#if BACKLOG_BATCH_FRAMES
+  unsigned long encodeStart = micros();
+  length = BatchFrameEncoder::encode(backlogBatch, count, backlogBody, sizeof(backlogBody));
+  unsigned long encodeTime = micros() - encodeStart;
+  if (length > 0) {
+    format = "batch";
+    DEBUG_INFO("Batch frame: %u samples in %u bytes (%.1f bytes/sample, raw %u), encoded in %lu us",
+               (unsigned)count, (unsigned)length, (float)length / count,
+               (unsigned)sizeof(SensorDataPacket), encodeTime);
+  } else {
+    DEBUG_WARN("Batch frame not possible - sending single packets");
+  }
+#endif
+
+  // Wire packets back to back - each one carries its own length via the bitmap
+  if (length == 0) {
+    for (size_t i = 0; i < count; i++) {
+      length += PacketEncoder::encode(backlogBatch[i], backlogBody + length);
+    }
+  }
+
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+  // Acknowledged in the store once the PUBACK comes in, until then the next batch waits
+  mqtt.publishBacklog(format, bootCountHeader, uptime, backlogBody, length, count);
+#else
+  HttpHeader headers[] = {
+    {"X-Packet-Format", format},
+    {"X-Backlog", batchCount},
+    {"X-Device-Uptime", uptime},
+    {"X-Boot-Count", bootCountHeader}
+  };
+
+  int httpResponseCode = sendConnection.post("application/octet-stream", headers, 4, backlogBody, length, 5000);
+  sendConnection.finish();
+
+  if (httpResponseCode >= 200 && httpResponseCode < 300) {
+    backlog.acknowledge();
+    DEBUG_INFO("Backlog: %u packets uploaded, %u pending", (unsigned)count, (unsigned)backlog.pending());
+  } else {
+    DEBUG_WARN("Backlog upload failed, HTTP: %d", httpResponseCode);
+  }
+#endif
+#endif
+}
+
+uint32_t ByteTransmissionManager::deviceUptimeSeconds() {
+  // esp_timer is safe from any task (getUptimeMillis() belongs to loop())
+  return (uint32_t)(esp_timer_get_time() / 1000000ULL);
+}
+
+#if INFLUX_DIRECT
+bool ByteTransmissionManager::writeInflux(const SensorDataPacket& packet) {
+  // A full batch that could not be written is retried first - until then new packets go to the backlog
+  if (influxCount >= INFLUX_BATCH_SAMPLES && !flushInflux()) {
+    return false;
+  }
+  if (!appendInfluxLine(packet)) {
+    DEBUG_WARN("No wall-clock time yet - packet goes to the backlog");
+    return false;
+  }
+  if (influxCount >= INFLUX_BATCH_SAMPLES) {
+    flushInflux();  // Failed: stays in RAM, retried with the next packet
+  }
+  return true;
+}
+
+bool ByteTransmissionManager::appendInfluxLine(const SensorDataPacket& packet) {
+  uint64_t timeMs;
+  if (!packetTimeMs(packet, timeMs)) {
+    return false;
+  }
+  // Always fits: the buffer holds INFLUX_BATCH_SAMPLES lines of MAX_LINE_LENGTH
+  influxLength += LineProtocolEncoder::encode(packet, INFLUX_LOCATION, timeMs, influxLines + influxLength,
+                                              sizeof(influxLines) - influxLength);
+  influxCount++;
+  return true;
+}
+
+bool ByteTransmissionManager::flushInflux() {
+  unsigned long encodeStart = micros();
+  size_t length = GzipEncoder::encode((const uint8_t*)influxLines, influxLength, influxBody, sizeof(influxBody),
+                                      influxHashTable);
+  unsigned long encodeTime = micros() - encodeStart;
+
+  HttpHeader headers[] = {
+    {"Content-Encoding", "gzip"},
+    {"Authorization", "Token " INFLUX_TOKEN}
+  };
+  size_t headerCount = INFLUX_TOKEN[0] != '\0' ? 2 : 1;
+  int httpResponseCode = influxConnection.post("text/plain; charset=utf-8", headers, headerCount,
+                                               influxBody, length, 5000);
+  influxConnection.finish();
+  logRequestStats("influx-write", influxConnection);
+
+  if (httpResponseCode >= 200 && httpResponseCode < 300) {
+    BootTimeline::mark(BOOT_FIRST_UPLOAD);
+    DEBUG_INFO("InfluxDB: %u lines, %u bytes gzipped to %u (%.1fx) in %lu us",
+               (unsigned)influxCount, (unsigned)influxLength, (unsigned)length,
+               (float)influxLength / length, encodeTime);
+  } else if (httpResponseCode == 400 || httpResponseCode == 413) {
+    // Rejected content never succeeds - retrying would block every later batch
+    DEBUG_ERROR("InfluxDB rejected %u lines, HTTP: %d - batch dropped", (unsigned)influxCount, httpResponseCode);
+  } else {
+    DEBUG_WARN("InfluxDB write failed, HTTP: %d", httpResponseCode);
+    return false;
+  }
+  influxLength = 0;
+  influxCount = 0;
+  return true;
+}
+
+void ByteTransmissionManager::writeInfluxBacklog() {
+#if BACKLOG_ENABLED
+  // Line timestamps need the clock; the live batch is written early so the
+  // buffer is free for the backlog
+  if (!wallClock.isSynced() || (influxCount > 0 && !flushInflux())) {
+    return;
+  }
+  lastDrainTime = millis();
+
+  size_t count = backlog.read((uint8_t*)backlogBatch, BACKLOG_BATCH_SIZE < INFLUX_BATCH_SAMPLES ?
+                                                      BACKLOG_BATCH_SIZE : INFLUX_BATCH_SAMPLES);
+  size_t skipped = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!appendInfluxLine(backlogBatch[i])) {
+      skipped++;  // Taken before the first sync of an earlier boot: no time reference
+    }
+  }
+  if (skipped > 0) {
+    DEBUG_WARN("Backlog: %u packets of an earlier boot dropped (no time reference)", (unsigned)skipped);
+  }
+
+  if (influxCount == 0 || flushInflux()) {
+    backlog.acknowledge();
+    DEBUG_INFO("Backlog: %u packets written, %u pending", (unsigned)count, (unsigned)backlog.pending());
+  } else {
+    influxLength = 0;  // Not acknowledged - the same packets are read again
+    influxCount = 0;
+  }
+#endif
+}
+
+// Unix ms from the packet's time section - packets of this boot taken before
+// the first sync are stamped late. False until SNTP has synced, and for
+// unstamped packets of an earlier boot.
+bool ByteTransmissionManager::packetTimeMs(const SensorDataPacket& packet, uint64_t& timeMs) {
+  SensorDataPacket stamped = packet;
+  if (!wallClock.stampLate(stamped, bootCount)) {
+    return false;
+  }
+  timeMs = (uint64_t)stamped.timestamp * 1000 + stamped.time_ms;
+  return true;
+}
+#endif
+
+#if TRANSPORT_MODE == TRANSPORT_MQTT
+void ByteTransmissionManager::mqttAqiEntry(void* context, const uint8_t* payload, size_t length) {
+  static_cast<ByteTransmissionManager*>(context)->onMqttAqi(payload, length);
+}
+
+void ByteTransmissionManager::onMqttAqi(const uint8_t* payload, size_t length) {
+  if (payload == nullptr) {
+    publishAQI(AQIResult());  // Session lost
+    return;
+  }
+
+  AQIResponsePacket response;
+  if (length != sizeof(response)) {
+    DEBUG_WARN("Unexpected AQI message (%u bytes)", (unsigned)length);
+    return;
+  }
+  memcpy(&response, payload, sizeof(response));
+  publishAQI(decodeAQIResponse(response));
+}
+#endif
+
+void ByteTransmissionManager::startWiFi(Scheduler& scheduler, SchedulerTask task) {
+  wifi.setEventTask(scheduler, task);
+  wifi.setWallClock(wallClock);
+  wifi.begin(WIFI_SSID, WIFI_PASSWORD);
+}
+
+bool ByteTransmissionManager::updateWiFi() {
+  if (wifi.update()) {
+    wallClock.begin();
+  }
+  return wifi.isConnected();
+}
+
+// False only if the sample was dropped - a sample skipped by SEND_ON_CHANGE is not lost
+bool ByteTransmissionManager::queueData(const SensorDataPacket& sample, uint32_t aqiClass) {
+#if SEND_ON_CHANGE
+  // Checked before a sequence number is used, so skipped samples leave no gap
+  uint32_t now = millis();
+  if (!sendFilter.shouldSend(sample, aqiClass, now)) {
+    return true;
+  }
+#endif
+
+  // Never blocks - a full queue means the network is behind, drop the sample
+  SensorDataPacket packet = createPacket(sample);
+  if (packetQueue == nullptr || xQueueSend(packetQueue, &packet, 0) != pdTRUE) {
+    droppedPackets++;
+    return false;  // Filter reference unchanged - the next similar sample still goes out
+  }
+
+#if SEND_ON_CHANGE
+  sendFilter.markSent(sample, aqiClass, now);
+  DEBUG_INFO("Send-on-change: %s (%lu sent, %lu suppressed)", sendFilter.getReason(),
+             (unsigned long)sendFilter.getSent(), (unsigned long)sendFilter.getSuppressed());
+#endif
+  return true;
+}
+
+bool ByteTransmissionManager::getLatestAQI(AQIResult& result) {
+  AQIResult latest;
+  if (!aqiMailbox.read(latest, aqiSequence)) {
+    return false;  // No new result since last call
+  }
+  result = latest;
+  return true;
+}
+
+bool ByteTransmissionManager::transmitPacket(const SensorDataPacket& packet, AQIResult& result) {
+  // Send binary sensor data to Node-RED
+#if TRANSPORT_MODE == TRANSPORT_COAP
+  // One datagram each way: AQI comes back in the piggybacked ACK
+  if (!sendCoapData(packet, result)) {
+    return false;
+  }
+  if (!result.success) {
+    result = AQI_LOCAL ? uploadAccepted() : getCalculatedAQI(packet);
+  }
+#elif AQI_COMBINED_RESPONSE
+  // Single round trip: AQI comes back in the /sensor-data response
+  if (!sendBinaryData(packet, &result)) {
+    return false;
+  }
+  if (!result.success) {
+    // Flow did not answer with an AQI body - use the JSON request instead
+    result = AQI_LOCAL ? uploadAccepted() : getCalculatedAQI(packet);
+  }
+#else
+  if (!sendBinaryData(packet)) {
+    return false;
+  }
+#if AQI_LOCAL
+  result = uploadAccepted();
+#else
+  // Retrieve AQI from Node-RED (JSON)
+  result = getCalculatedAQI(packet);
+#endif
+#endif
   
-  // System data
-  packet.uptime_seconds = (uint32_t)(getUptimeMillis() / 1000);  // Seconds since start
+  return true;
+}
+
+// Sensor sections as packed in loop(), no second float conversion
+SensorDataPacket ByteTransmissionManager::createPacket(const SensorDataPacket& sample) {
+  SensorDataPacket packet = sample;
+
+  // Header
+  packet.magic_version = PACKET_MAGIC_V3;
+  memcpy(packet.device_id, deviceId, sizeof(packet.device_id));
+  packet.boot_count = bootCount;
+  packet.sequence = nextSequence++;  // Also counted when the queue drops it - shows up as a gap
+
+  // System data - esp_timer like X-Device-Uptime and the wall clock mapping
+  int64_t uptimeUs = esp_timer_get_time();
+  packet.uptime_seconds = (uint32_t)(uptimeUs / 1000000);  // Seconds since boot
   packet.wifi_rssi = (int8_t)WiFi.RSSI();
 
-  // Calculate checksum
-  packet.checksum = calculateChecksum(packet);
-  
+  // UTC with ms and quality once SNTP has synced, the uptime until then
+  packet.timestamp = packet.uptime_seconds;
+  wallClock.stamp(packet, uptimeUs);
+
   return packet;
 }
 
-uint8_t ByteTransmissionManager::calculateChecksum(const SensorDataPacket& packet) {
+uint8_t ByteTransmissionManager::calculateChecksum(const uint8_t* bytes, size_t length) {
   uint8_t checksum = 0;
-  const uint8_t* bytes = (const uint8_t*)&packet;
   
-  // XOR all bytes except checksum
-  for (size_t i = 0; i < sizeof(SensorDataPacket) - 1; i++) {
+  // XOR all bytes
+  for (size_t i = 0; i < length; i++) {
     checksum ^= bytes[i];
   }
   
   return checksum;
 }
 
-bool ByteTransmissionManager::sendBinaryData(const SensorDataPacket& packet) {
+bool ByteTransmissionManager::sendBinaryData(const SensorDataPacket& packet, AQIResult* aqiResult) {
   if (!isConnected()) {
     DEBUG_ERROR("WiFi not connected - cannot send data");
     return false;
   }
 
-  HTTPClient http;
-  if (!http.begin(NODERED_SEND_URL)) {
-    DEBUG_ERROR("HTTP begin failed - invalid URL?");
-    return false;
-  }
+  uint8_t wire[PACKET_WIRE_MAX_SIZE];
+  size_t length = PacketEncoder::encode(packet, wire);
 
-  http.addHeader("Content-Type", "application/octet-stream");
-  http.addHeader("X-Packet-Size", String(sizeof(SensorDataPacket)));
-  http.setTimeout(5000);
+  char packetSize[8];
+  char uptime[12];
+  snprintf(packetSize, sizeof(packetSize), "%u", (unsigned)length);
+  snprintf(uptime, sizeof(uptime), "%lu", (unsigned long)deviceUptimeSeconds());
+  HttpHeader headers[] = {
+    {"X-Packet-Size", packetSize},
+    {"X-Device-Uptime", uptime},
+    {"X-Boot-Count", bootCountHeader},
+    {"X-AQI-Response", "binary"}  // Ask the flow to answer with an AQIResponsePacket
+  };
+  size_t headerCount = aqiResult != nullptr ? 4 : 3;
 
-  DEBUG_INFO("Sending binary packet (%d bytes)", sizeof(SensorDataPacket));
+  DEBUG_INFO("Sending binary packet (%u bytes)", (unsigned)length);
 
-  // Send binary data
-  int httpResponseCode = http.POST((uint8_t*)&packet, sizeof(SensorDataPacket));
+  // Send binary data over the keep-alive session
+  int httpResponseCode = sendConnection.post("application/octet-stream", headers, headerCount,
+                                             wire, length, 5000);
+  HTTPClient& http = sendConnection.response();
 
   bool success = false;
   if (httpResponseCode >= 200 && httpResponseCode < 300) {
     DEBUG_INFO("Binary data sent successfully, HTTP: %d", httpResponseCode);
     success = true;
+
+    if (aqiResult != nullptr) {
+      *aqiResult = parseAQIResponse(http);
+    }
   } else if (httpResponseCode > 0) {
     DEBUG_ERROR("HTTP POST failed with code: %d", httpResponseCode);
   } else {
     DEBUG_ERROR("HTTP POST failed - connection error: %d", httpResponseCode);
   }
 
-  http.end();
+  sendConnection.finish();
+  logRequestStats("sensor-data", sendConnection);
+  return success;
+}
+
+bool ByteTransmissionManager::sendCoapData(const SensorDataPacket& packet, AQIResult& aqiResult) {
+#if TRANSPORT_MODE == TRANSPORT_COAP
+  if (!isConnected()) {
+    DEBUG_ERROR("WiFi not connected - cannot send data");
+    return false;
+  }
+
+  uint8_t wire[PACKET_WIRE_MAX_SIZE];
+  size_t length = PacketEncoder::encode(packet, wire);
+
+  DEBUG_INFO("Sending CoAP packet (%u bytes)", (unsigned)length);
+
+  AQIResponsePacket response;
+  size_t responseLength = 0;
+  int code = coapConnection.post(wire, length, (uint8_t*)&response, sizeof(response), responseLength);
+
+  bool success = false;
+  if (code >= COAP_CODE(2, 0) && code < COAP_CODE(3, 0)) {
+    DEBUG_INFO("Binary data sent successfully, CoAP: %d.%02d", code >> 5, code & 0x1F);
+    success = true;
+
+    if (responseLength == sizeof(response)) {
+      aqiResult = decodeAQIResponse(response);
+    } else {
+      DEBUG_WARN("No binary AQI in CoAP response (%u bytes)", (unsigned)responseLength);
+    }
+  } else if (code >= 0) {
+    DEBUG_ERROR("CoAP POST failed with code: %d.%02d", code >> 5, code & 0x1F);
+  } else {
+    DEBUG_ERROR("CoAP POST failed - %s", code == COAP_ERROR_TIMEOUT ? "no ACK" : "transport error");
+  }
+
+  logCoapStats(coapConnection.getStats());
   return success;
+#else
+  return false;
+#endif
 }
 
-AQIResult ByteTransmissionManager::getCalculatedAQI(const SensorData& data) {
+AQIResult ByteTransmissionManager::parseAQIResponse(HTTPClient& http) {
   AQIResult result;
 
-  if (!isConnected()) {
-    DEBUG_ERROR("WiFi not connected - cannot get AQI");
+  int size = http.getSize();
+  if (size != sizeof(AQIResponsePacket)) {
+    DEBUG_WARN("No binary AQI in response (%d bytes)", size);
     return result;
   }
 
-  HTTPClient http;
-  if (!http.begin(NODERED_AQI_URL)) {
-    DEBUG_ERROR("HTTP begin failed for AQI - invalid URL?");
+  AQIResponsePacket response;
+  WiFiClient* stream = http.getStreamPtr();
+  if (stream == nullptr ||
+      stream->readBytes((uint8_t*)&response, sizeof(response)) != sizeof(response)) {
+    DEBUG_ERROR("AQI response read failed");
     return result;
   }
 
-  http.addHeader("Content-Type", "application/json");
-  http.setTimeout(3000);
-  http.setReuse(false);
-  const char* headerKeys[] = {"Content-Length"};
-  http.collectHeaders(headerKeys, 1);
+  return decodeAQIResponse(response);
+}
 
+AQIResult ByteTransmissionManager::decodeAQIResponse(const AQIResponsePacket& response) {
+  AQIResult result;
 
-  // Build JSON request safely
-  StaticJsonDocument<256> doc;
-  doc["pm2_5"] = data.pm2_5;
-  doc["pm10"] = data.pm10;
-  doc["iaq"] = data.iaq;
-  doc["co2"] = data.co2Equivalent;
-  doc["calibrated"] = data.bsecCalibrated;
+  if (response.magic != AQI_RESPONSE_MAGIC ||
+      response.checksum != calculateChecksum((const uint8_t*)&response, sizeof(response) - 1)) {
+    DEBUG_ERROR("Invalid AQI response (magic 0x%02X)", response.magic);
+    return result;
+  }
 
-  String request;
-  serializeJson(doc, request);
+  uint8_t levelId = response.level_id < AQI_LEVEL_COUNT ? response.level_id : (uint8_t)AQI_LEVEL_UNKNOWN;
+  result.aqi = response.aqi / 10.0f;
+  result.level = (AQILevel)levelId;
+  result.colorCode = ((uint32_t)response.color_r << 16) |
+                     ((uint32_t)response.color_g << 8) |
+                     response.color_b;
+  result.success = true;
+  DEBUG_INFO("Binary AQI: %.1f (%s)", result.aqi, result.levelName());
 
-  int httpResponseCode = http.POST(request);
+  return result;
+}
 
-  if (httpResponseCode >= 200 && httpResponseCode < 300) {
-    if (http.getSize() > 1024) {
-      DEBUG_ERROR("Response too large: %d bytes", http.getSize());
-      http.end();
-      return result;
-    }
+// Upload accepted (flow or InfluxDB), no AQI asked for: with AQI_LOCAL the
+// display shows the device's own result, so /calculate-aqi is not requested
+AQIResult ByteTransmissionManager::uploadAccepted() {
+  AQIResult result;
+  result.success = true;
+  result.aqi = 0;
+  result.level = AQI_LEVEL_UNKNOWN;
+  return result;
+}
 
-    String response = http.getString();
-    DEBUG_INFO("Full AQI response: %s", response.c_str());
-
-    StaticJsonDocument<256> doc;
-    DeserializationError error = deserializeJson(doc, response);
-
-    if (!error) {
-      JsonObject aqi = doc["aqi"];
-      if (!aqi.isNull()) {
-        result.aqi = aqi["combined"].as<float>();
-        if (aqi.containsKey("level")) {
-          result.level = String((const char*)aqi["level"]);
-        }
-        if (aqi.containsKey("color")) {
-          result.colorCode = parseColorCode(String((const char*)aqi["color"]));
-        }
-        result.success = true;
-        DEBUG_INFO("Final parsed AQI: %.1f (%s)", result.aqi, result.level.c_str());
-      }
+AQIResult ByteTransmissionManager::getCalculatedAQI(const SensorDataPacket& packet) {
+  AQIResult result;
+
+  if (!isConnected()) {
+    DEBUG_ERROR("WiFi not connected - cannot get AQI");
+    return result;
+  }
+
+  // Request on the stack, response scanned in place in aqiResponse - the
+  // codec needs no heap (HTTPClient still builds its header Strings)
+  char request[AQIJson::MAX_REQUEST_LENGTH];
+  size_t requestLength = AQIJson::writeRequest(request, sizeof(request), packet);
+
+  int httpResponseCode = aqiConnection.post("application/json", nullptr, 0,
+                                            (const uint8_t*)request, requestLength, 3000);
+  HTTPClient& http = aqiConnection.response();
+
+  if (httpResponseCode >= 200 && httpResponseCode < 300) {
+    // Content-Length is needed to read the body in one piece (Node-RED sends it)
+    int size = http.getSize();
+    WiFiClient* stream = http.getStreamPtr();
+    if (size <= 0 || (size_t)size > AQIJson::MAX_RESPONSE_LENGTH) {
+      DEBUG_ERROR("Unexpected AQI response size: %d bytes", size);
+    } else if (stream == nullptr || stream->readBytes((uint8_t*)aqiResponse, size) != (size_t)size) {
+      DEBUG_ERROR("AQI response read failed");
     } else {
-      DEBUG_ERROR("JSON parse failed: %s", error.c_str());
+      aqiResponse[size] = '\0';
+      DEBUG_INFO("Full AQI response: %s", aqiResponse);
+      if (AQIJson::parseResponse(aqiResponse, size, result)) {
+        DEBUG_INFO("Final parsed AQI: %.1f (%s)", result.aqi, result.levelName());
+      } else {
+        DEBUG_ERROR("JSON parse failed");
+      }
     }
   } else {
     DEBUG_ERROR("AQI request failed, HTTP: %d", httpResponseCode);
   }
 
-  http.end();
+  aqiConnection.finish();
+  logRequestStats("calculate-aqi", aqiConnection);
   return result;
 }
 
-uint32_t ByteTransmissionManager::parseColorCode(const String& colorStr) {
-  if (colorStr.startsWith("#") && colorStr.length() == 7) {
-    long color = strtol(colorStr.substring(1).c_str(), NULL, 16);
-    return (uint32_t)color;
+
+void ByteTransmissionManager::logRequestStats(const char* name, const HttpConnection& connection) {
+  const HttpConnectionStats& stats = connection.getStats();
+  DEBUG_INFO("%s %s: %lu ms (avg %lu, max %lu) - %lu requests, %lu connects, %lu failures",
+             connection.isSecure() ? "HTTPS" : "HTTP", name,
+             (unsigned long)stats.lastRequestMs, (unsigned long)stats.averageRequestMs(),
+             (unsigned long)stats.maxRequestMs, (unsigned long)stats.requests,
+             (unsigned long)stats.connects, (unsigned long)stats.failures);
+
+  if (connection.isSecure()) {
+    const TlsClientStats& tls = connection.getTlsStats();
+    DEBUG_INFO("TLS %s: %lu full handshakes (avg %lu ms), %lu resumed (avg %lu ms), %lu failed",
+               name, (unsigned long)tls.fullHandshakes, (unsigned long)tls.averageFullMs(),
+               (unsigned long)tls.resumedHandshakes, (unsigned long)tls.averageResumedMs(),
+               (unsigned long)tls.failures);
   }
-  
-  // Fallback colors
-  if (colorStr.indexOf("Good") >= 0) return 0x00FF00;
-  if (colorStr.indexOf("Moderate") >= 0) return 0xFFFF00;
-  if (colorStr.indexOf("Unhealthy") >= 0) return 0xFF0000;
+}
 
-  return 0x00FF00; // Default green
+void ByteTransmissionManager::logCoapStats(const CoapConnectionStats& stats) {
+  DEBUG_INFO("CoAP sensor-data: %lu ms (avg %lu, max %lu) - %lu requests, %lu retransmits, %lu failures, %lu/%lu bytes",
+             (unsigned long)stats.lastRequestMs, (unsigned long)stats.averageRequestMs(),
+             (unsigned long)stats.maxRequestMs, (unsigned long)stats.requests,
+             (unsigned long)stats.retransmits, (unsigned long)stats.failures,
+             (unsigned long)stats.bytesSent, (unsigned long)stats.bytesReceived);
 }
 
 #endif
@@ -0,0 +1,151 @@
+#ifndef CLOCK_MAPPING_H
+#define CLOCK_MAPPING_H
+
+#include <stdint.h>
+
+// ===== CLOCK MAPPING =====
+// Maps the monotonic uptime clock (esp_timer, µs) to UTC from SNTP sync
+// points. Between syncs the uptime is scaled by the crystal drift: the
+// median of the last DRIFT_SAMPLES rates measured between raw sync points,
+// so a single server step or delayed reply does not skew it. The error
+// found at a sync is slewed in at up to MAX_SLEW_PPM instead of jumping, so
+// mapped times never run backwards; only the first sync and errors beyond
+// STEP_THRESHOLD_US step the clock. tools/ntp_server --selftest drives it
+// through simulated days of drift and server steps.
+enum TimeQuality : uint8_t {
+  TIME_QUALITY_NONE = 0,          // Never synced - packet has no time section
+  TIME_QUALITY_ESTIMATED,         // Last sync older than the stale limit, or stamped after the fact
+  TIME_QUALITY_SYNCED,            // Synced, drift not measured yet
+  TIME_QUALITY_DRIFT_CORRECTED    // Synced and drift-corrected
+};
+
+class ClockMapping {
+public:
+  static const int64_t STEP_THRESHOLD_US = 1000000;         // Larger errors step the clock
+  static const int64_t MAX_SLEW_PPM = 500;                  // Slew rate for smaller errors
+  static const int64_t MIN_DRIFT_INTERVAL_US = 900000000;   // 15 min: shorter spans are mostly SNTP jitter
+  static const int64_t MAX_DRIFT_PPM = 500;                 // Crystal tolerance with margin; beyond = bad sample
+
+  // Sync point: SNTP reported utcUs at uptime uptimeUs
+  void addSync(int64_t uptimeUs, int64_t utcUs);
+
+  bool isSynced() const { return syncs > 0; }
+
+  // UTC in µs at uptimeUs, 0 before the first sync. Continuous and
+  // monotonic except for steps.
+  int64_t toUtc(int64_t uptimeUs) const;
+
+  // ESTIMATED once the last sync is older than staleUs
+  TimeQuality quality(int64_t uptimeUs, int64_t staleUs) const;
+
+  double getDriftPpm() const { return driftPpm; }         // > 0: uptime clock runs slow
+  int64_t getLastErrorUs() const { return lastErrorUs; }  // UTC minus mapping at the last sync
+  uint32_t getSyncs() const { return syncs; }
+  uint32_t getSteps() const { return steps; }
+
+private:
+  static const uint8_t DRIFT_SAMPLES = 5;
+
+  // utc(u) = anchorUtcUs + d * (1 + drift) + slewUs * min(d / slewDurationUs, 1), d = u - anchorUptimeUs
+  int64_t anchorUptimeUs = 0;
+  int64_t anchorUtcUs = 0;
+  int64_t slewUs = 0;
+  int64_t slewDurationUs = 0;
+  double driftPpm = 0;
+  float driftSamples[DRIFT_SAMPLES] = {};   // Ring, ppm
+  uint8_t driftCount = 0;
+  uint8_t driftNext = 0;
+
+  int64_t baseUptimeUs = 0;     // Raw sync point the next drift sample is measured from
+  int64_t baseUtcUs = 0;
+  int64_t lastSyncUptimeUs = 0;
+  int64_t lastErrorUs = 0;
+  uint32_t syncs = 0;
+  uint32_t steps = 0;
+
+  double medianDrift() const;
+};
+
+// ===== IMPLEMENTATION =====
+void ClockMapping::addSync(int64_t uptimeUs, int64_t utcUs) {
+  if (syncs++ == 0) {
+    anchorUptimeUs = baseUptimeUs = lastSyncUptimeUs = uptimeUs;
+    anchorUtcUs = baseUtcUs = utcUs;
+    return;
+  }
+
+  // Error against the mapping the packets were stamped with so far
+  int64_t mapped = toUtc(uptimeUs);
+  lastErrorUs = utcUs - mapped;
+  lastSyncUptimeUs = uptimeUs;
+
+  // Drift from the raw sync points - independent of slewing. The base only
+  // moves on once a span was long enough, so frequent syncs still add up.
+  int64_t elapsed = uptimeUs - baseUptimeUs;
+  if (elapsed >= MIN_DRIFT_INTERVAL_US) {
+    double measured = (double)(utcUs - baseUtcUs - elapsed) * 1e6 / (double)elapsed;
+    if (measured > -MAX_DRIFT_PPM && measured < MAX_DRIFT_PPM) {
+      driftSamples[driftNext] = (float)measured;
+      driftNext = (uint8_t)((driftNext + 1) % DRIFT_SAMPLES);
+      driftCount += driftCount < DRIFT_SAMPLES;
+      driftPpm = medianDrift();
+    }
+    baseUptimeUs = uptimeUs;
+    baseUtcUs = utcUs;
+  }
+
+  // New segment starts where the old one is now - no jump for small errors
+  anchorUptimeUs = uptimeUs;
+  if (lastErrorUs > STEP_THRESHOLD_US || lastErrorUs < -STEP_THRESHOLD_US) {
+    anchorUtcUs = utcUs;
+    slewUs = 0;
+    slewDurationUs = 0;
+    baseUptimeUs = uptimeUs;   // A step (server change, first real sync) is no drift
+    baseUtcUs = utcUs;
+    steps++;
+  } else {
+    anchorUtcUs = mapped;
+    slewUs = lastErrorUs;
+    slewDurationUs = (slewUs < 0 ? -slewUs : slewUs) * 1000000 / MAX_SLEW_PPM;
+  }
+}
+
+int64_t ClockMapping::toUtc(int64_t uptimeUs) const {
+  if (syncs == 0) {
+    return 0;
+  }
+  // Rounded once: the correction changes by less than 1 µs per µs, so the
+  // sum stays monotonic
+  int64_t elapsed = uptimeUs - anchorUptimeUs;
+  double correction = (double)elapsed * driftPpm * 1e-6;
+  if (elapsed > 0 && slewUs != 0) {
+    correction += elapsed >= slewDurationUs ? (double)slewUs : (double)slewUs * elapsed / slewDurationUs;
+  }
+  return anchorUtcUs + elapsed + (int64_t)(correction < 0 ? correction - 0.5 : correction + 0.5);
+}
+
+// Even count: mean of the middle two
+double ClockMapping::medianDrift() const {
+  float sorted[DRIFT_SAMPLES];
+  for (uint8_t i = 0; i < driftCount; i++) {
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > driftSamples[i]; j--) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = driftSamples[i];
+  }
+  uint8_t middle = driftCount / 2;
+  return driftCount % 2 == 1 ? sorted[middle] : ((double)sorted[middle - 1] + sorted[middle]) / 2;
+}
+
+TimeQuality ClockMapping::quality(int64_t uptimeUs, int64_t staleUs) const {
+  if (syncs == 0) {
+    return TIME_QUALITY_NONE;
+  }
+  if (uptimeUs - lastSyncUptimeUs > staleUs) {
+    return TIME_QUALITY_ESTIMATED;
+  }
+  return driftCount > 0 ? TIME_QUALITY_DRIFT_CORRECTED : TIME_QUALITY_SYNCED;
+}
+
+#endif
@@ -0,0 +1,403 @@
+#ifndef COAP_CONNECTION_H
+#define COAP_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "config.h"
+
+// ===== COAP PROTOCOL (RFC 7252) =====
+#define COAP_VERSION 1
+#define COAP_TYPE_CON 0
+#define COAP_TYPE_NON 1
+#define COAP_TYPE_ACK 2
+#define COAP_TYPE_RST 3
+
+#define COAP_CODE(c, d) (((c) << 5) | (d))   // e.g. COAP_CODE(2, 4) = 2.04 Changed
+#define COAP_CODE_EMPTY 0x00
+#define COAP_METHOD_POST COAP_CODE(0, 2)
+
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_CONTENT_FORMAT 12
+#define COAP_OPTION_ACCEPT 17
+#define COAP_FORMAT_OCTET_STREAM 42
+#define COAP_PAYLOAD_MARKER 0xFF
+#define COAP_TOKEN_LENGTH 4
+
+// post() results below 0
+#define COAP_ERROR_TIMEOUT -1         // No answer after all retransmissions
+#define COAP_ERROR_RESET -2           // Server rejected the message (RST)
+#define COAP_ERROR_SEND -3            // Socket, DNS or message size problem
+#define COAP_ERROR_INVALID_URL -4
+
+// ===== COAP CONNECTION STATISTICS =====
+struct CoapConnectionStats {
+  uint32_t requests = 0;         // Confirmable requests (one per post())
+  uint32_t failures = 0;         // Timeouts, resets and non-2.xx answers
+  uint32_t retransmits = 0;      // Repeated datagrams after an ACK timeout
+  uint32_t dnsLookups = 0;       // Host name resolutions
+  uint32_t bytesSent = 0;        // CoAP bytes incl. retransmissions (+28 per datagram on air)
+  uint32_t bytesReceived = 0;
+  uint32_t lastRequestMs = 0;    // Duration of the last exchange
+  uint32_t maxRequestMs = 0;     // Slowest exchange so far
+  uint64_t totalRequestMs = 0;   // Sum of all exchange durations
+
+  uint32_t averageRequestMs() const {
+    return requests > 0 ? (uint32_t)(totalRequestMs / requests) : 0;
+  }
+};
+
+// ===== COAP CONNECTION CLASS =====
+// Confirmable CoAP POSTs over UDP to one endpoint. The URL is parsed and the
+// Uri-Path options encoded once, the host is resolved once. The answer is
+// expected piggybacked in the ACK; an empty ACK followed by a separate
+// response is accepted as well. Retransmission follows RFC 7252 4.2: random
+// initial timeout of ACK_TIMEOUT..ACK_TIMEOUT*1.5, doubled per retry.
+class CoapConnection {
+private:
+  const char* url;
+  String host;
+  uint16_t port = 5683;
+  bool urlValid = false;
+
+  // Uri-Path options, ready to copy into every request
+  uint8_t pathOptions[64];
+  size_t pathOptionsLength = 0;
+
+  IPAddress address;
+  bool addressResolved = false;
+
+  WiFiUDP udp;
+  bool socketOpen = false;
+  uint16_t nextMessageId = 0;
+  uint8_t message[COAP_MAX_MESSAGE_SIZE];   // Request, then received datagrams
+  CoapConnectionStats stats;
+
+public:
+  CoapConnection(const char* endpointUrl);
+
+  // Sends a confirmable POST with an application/octet-stream body. Returns
+  // the response code (COAP_CODE(2, 4) etc.) or COAP_ERROR_* (< 0). Up to
+  // responseSize bytes of the response payload are copied to responseBody.
+  int post(const uint8_t* body, size_t length,
+           uint8_t* responseBody, size_t responseSize, size_t& responseLength);
+
+  const char* getUrl() const { return url; }
+  const CoapConnectionStats& getStats() const { return stats; }
+
+private:
+  bool parseUrl();
+  bool ensureSocket();
+  size_t buildRequest(uint16_t messageId, const uint8_t* token, const uint8_t* body, size_t length);
+  bool sendDatagram(size_t length);
+  int waitForResponse(uint16_t messageId, const uint8_t* token, uint32_t timeoutMs, bool& acknowledged,
+                      uint8_t* responseBody, size_t responseSize, size_t& responseLength);
+  void sendEmptyAck(uint16_t messageId);
+  static size_t writeOption(uint8_t* out, uint16_t delta, const uint8_t* value, size_t length);
+  static uint8_t writeExtended(uint16_t value, uint8_t*& out);
+  static bool findPayload(const uint8_t* data, size_t length, size_t offset, size_t& payloadOffset);
+};
+
+// ===== IMPLEMENTATION =====
+CoapConnection::CoapConnection(const char* endpointUrl) : url(endpointUrl) {
+  urlValid = parseUrl();
+}
+
+bool CoapConnection::parseUrl() {
+  // Expected format: coap://host[:port]/path
+  String u(url);
+  if (!u.startsWith("coap://")) {
+    return false;
+  }
+
+  String rest = u.substring(7);
+  int slash = rest.indexOf("/");
+  String hostPort = slash >= 0 ? rest.substring(0, slash) : rest;
+  String path = slash >= 0 ? rest.substring(slash + 1) : String("");
+
+  int colon = hostPort.indexOf(":");
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = (uint16_t)atoi(hostPort.substring(colon + 1).c_str());
+  } else {
+    host = hostPort;
+    port = 5683;
+  }
+
+  // One Uri-Path option per segment, only the first carries a delta
+  uint16_t delta = COAP_OPTION_URI_PATH;
+  size_t start = 0;
+  while (start < path.length()) {
+    int end = path.substring(start).indexOf("/");
+    size_t segmentLength = end >= 0 ? (size_t)end : path.length() - start;
+    if (segmentLength > 0) {
+      if (pathOptionsLength + 3 + segmentLength > sizeof(pathOptions)) {
+        return false;
+      }
+      pathOptionsLength += writeOption(pathOptions + pathOptionsLength, delta,
+                                       (const uint8_t*)path.c_str() + start, segmentLength);
+      delta = 0;
+    }
+    start += segmentLength + 1;
+  }
+
+  return host.length() > 0 && port != 0;
+}
+
+bool CoapConnection::ensureSocket() {
+  // Resolve once, reuse the address for every request
+  if (!addressResolved) {
+    stats.dnsLookups++;
+    if (!WiFi.hostByName(host.c_str(), address)) {
+      DEBUG_ERROR("DNS lookup failed for %s", host.c_str());
+      return false;
+    }
+    addressResolved = true;
+  }
+
+  if (!socketOpen) {
+    if (!udp.begin(0)) {  // Any local port
+      DEBUG_ERROR("UDP socket could not be opened");
+      return false;
+    }
+    socketOpen = true;
+    nextMessageId = (uint16_t)esp_random();  // RFC 7252 4.4: randomized start
+  }
+  return true;
+}
+
+uint8_t CoapConnection::writeExtended(uint16_t value, uint8_t*& out) {
+  // Option delta/length nibble: 0..12 inline, 13 + 1 byte, 14 + 2 bytes
+  if (value < 13) {
+    return (uint8_t)value;
+  }
+  if (value < 269) {
+    *out++ = (uint8_t)(value - 13);
+    return 13;
+  }
+  *out++ = (uint8_t)((value - 269) >> 8);
+  *out++ = (uint8_t)(value - 269);
+  return 14;
+}
+
+size_t CoapConnection::writeOption(uint8_t* out, uint16_t delta, const uint8_t* value, size_t length) {
+  uint8_t* cursor = out + 1;
+  uint8_t deltaNibble = writeExtended(delta, cursor);
+  uint8_t lengthNibble = writeExtended((uint16_t)length, cursor);
+  out[0] = (uint8_t)((deltaNibble << 4) | lengthNibble);
+  memcpy(cursor, value, length);
+  return (size_t)(cursor - out) + length;
+}
+
+size_t CoapConnection::buildRequest(uint16_t messageId, const uint8_t* token,
+                                    const uint8_t* body, size_t length) {
+  // Header (4) + token + Uri-Path + Content-Format (2) + Accept (2) + marker (1) + body
+  size_t total = 4 + COAP_TOKEN_LENGTH + pathOptionsLength + 2 + 2 + 1 + length;
+  if (total > sizeof(message)) {
+    return 0;
+  }
+
+  const uint8_t format = COAP_FORMAT_OCTET_STREAM;
+  size_t offset = 0;
+  message[offset++] = (COAP_VERSION << 6) | (COAP_TYPE_CON << 4) | COAP_TOKEN_LENGTH;
+  message[offset++] = COAP_METHOD_POST;
+  message[offset++] = (uint8_t)(messageId >> 8);
+  message[offset++] = (uint8_t)messageId;
+  memcpy(message + offset, token, COAP_TOKEN_LENGTH);
+  offset += COAP_TOKEN_LENGTH;
+
+  // Options in ascending order: Uri-Path (11), Content-Format (12), Accept (17)
+  memcpy(message + offset, pathOptions, pathOptionsLength);
+  offset += pathOptionsLength;
+  uint16_t lastOption = pathOptionsLength > 0 ? COAP_OPTION_URI_PATH : 0;
+  offset += writeOption(message + offset, COAP_OPTION_CONTENT_FORMAT - lastOption, &format, 1);
+  offset += writeOption(message + offset, COAP_OPTION_ACCEPT - COAP_OPTION_CONTENT_FORMAT, &format, 1);
+
+  message[offset++] = COAP_PAYLOAD_MARKER;
+  memcpy(message + offset, body, length);
+  return offset + length;
+}
+
+bool CoapConnection::sendDatagram(size_t length) {
+  if (!udp.beginPacket(address, port)) {
+    return false;
+  }
+  udp.write(message, length);
+  if (!udp.endPacket()) {
+    return false;
+  }
+  stats.bytesSent += length;
+  return true;
+}
+
+void CoapConnection::sendEmptyAck(uint16_t messageId) {
+  // Acknowledges a confirmable separate response
+  uint8_t ack[4] = {(COAP_VERSION << 6) | (COAP_TYPE_ACK << 4), COAP_CODE_EMPTY,
+                    (uint8_t)(messageId >> 8), (uint8_t)messageId};
+  if (udp.beginPacket(address, port)) {
+    udp.write(ack, sizeof(ack));
+    udp.endPacket();
+    stats.bytesSent += sizeof(ack);
+  }
+}
+
+bool CoapConnection::findPayload(const uint8_t* data, size_t length, size_t offset, size_t& payloadOffset) {
+  // Skips all options; payloadOffset == length means no payload
+  while (offset < length) {
+    uint8_t byte = data[offset++];
+    if (byte == COAP_PAYLOAD_MARKER) {
+      payloadOffset = offset;
+      return offset < length;  // Marker without payload is a format error
+    }
+
+    uint16_t fields[2] = {(uint16_t)(byte >> 4), (uint16_t)(byte & 0x0F)};
+    for (uint16_t& field : fields) {
+      if (field == 13 && offset + 1 <= length) {
+        field = 13 + data[offset];
+        offset += 1;
+      } else if (field == 14 && offset + 2 <= length) {
+        field = 269 + ((data[offset] << 8) | data[offset + 1]);
+        offset += 2;
+      } else if (field >= 13) {
+        return false;
+      }
+    }
+    offset += fields[1];
+  }
+
+  payloadOffset = length;
+  return offset == length;
+}
+
+int CoapConnection::waitForResponse(uint16_t messageId, const uint8_t* token, uint32_t timeoutMs,
+                                    bool& acknowledged, uint8_t* responseBody, size_t responseSize,
+                                    size_t& responseLength) {
+  unsigned long waitStart = millis();
+
+  while (millis() - waitStart < timeoutMs) {
+    int size = udp.parsePacket();
+    if (size <= 0) {
+      vTaskDelay(1);  // Network task only - loop() is never blocked here
+      continue;
+    }
+
+    size_t length = (size_t)udp.read(message, sizeof(message));
+    stats.bytesReceived += length;
+    if (length < 4 || (message[0] >> 6) != COAP_VERSION || udp.remoteIP() != address) {
+      continue;  // Not CoAP or not from our server
+    }
+
+    uint8_t type = (message[0] >> 4) & 0x03;
+    uint8_t tokenLength = message[0] & 0x0F;
+    uint8_t code = message[1];
+    uint16_t id = (uint16_t)((message[2] << 8) | message[3]);
+
+    // Empty ACK/RST: matched by message id
+    if (code == COAP_CODE_EMPTY) {
+      if (id != messageId) {
+        continue;
+      }
+      if (type == COAP_TYPE_RST) {
+        return COAP_ERROR_RESET;
+      }
+      if (type == COAP_TYPE_ACK) {
+        acknowledged = true;  // Separate response follows - stop retransmitting
+      }
+      continue;
+    }
+
+    // Responses: piggybacked ACK or separate CON/NON, matched by token
+    bool piggybacked = type == COAP_TYPE_ACK && id == messageId;
+    bool separate = type == COAP_TYPE_CON || type == COAP_TYPE_NON;
+    if ((!piggybacked && !separate) || tokenLength != COAP_TOKEN_LENGTH ||
+        length < 4u + tokenLength || memcmp(message + 4, token, COAP_TOKEN_LENGTH) != 0) {
+      continue;  // Late answer to an earlier exchange
+    }
+    if (type == COAP_TYPE_CON) {
+      sendEmptyAck(id);
+    }
+
+    size_t payloadOffset = 0;
+    if (!findPayload(message, length, 4 + tokenLength, payloadOffset)) {
+      DEBUG_WARN("Malformed CoAP response ignored");
+      continue;
+    }
+    responseLength = length - payloadOffset;
+    if (responseLength > responseSize) {
+      responseLength = responseSize;
+    }
+    memcpy(responseBody, message + payloadOffset, responseLength);
+    return code;
+  }
+
+  return COAP_ERROR_TIMEOUT;
+}
+
+int CoapConnection::post(const uint8_t* body, size_t length,
+                         uint8_t* responseBody, size_t responseSize, size_t& responseLength) {
+  responseLength = 0;
+  if (!urlValid) {
+    DEBUG_ERROR("CoAP request failed - invalid URL: %s", url);
+    return COAP_ERROR_INVALID_URL;
+  }
+
+  unsigned long requestStart = millis();
+  stats.requests++;
+
+  int code = COAP_ERROR_SEND;
+  if (ensureSocket()) {
+    uint16_t messageId = nextMessageId++;
+    uint8_t token[COAP_TOKEN_LENGTH];
+    uint32_t random = esp_random();
+    memcpy(token, &random, sizeof(token));
+
+    size_t requestLength = buildRequest(messageId, token, body, length);
+    if (requestLength == 0) {
+      DEBUG_ERROR("CoAP request too large (%u bytes payload)", (unsigned)length);
+    } else {
+      // Initial timeout random in [ACK_TIMEOUT, ACK_TIMEOUT * 1.5]
+      uint32_t timeout = COAP_ACK_TIMEOUT + esp_random() % (COAP_ACK_TIMEOUT / 2 + 1);
+      bool acknowledged = false;
+
+      for (uint8_t attempt = 0; attempt <= COAP_MAX_RETRANSMIT; attempt++) {
+        // buildRequest() output is overwritten by received datagrams - rebuild for retries
+        if (!acknowledged) {
+          if (attempt > 0) {
+            stats.retransmits++;
+            requestLength = buildRequest(messageId, token, body, length);
+            DEBUG_WARN("CoAP retransmission %u/%u (MID %u)", attempt, COAP_MAX_RETRANSMIT, messageId);
+          }
+          if (!sendDatagram(requestLength)) {
+            DEBUG_ERROR("CoAP send to %s:%u failed", host.c_str(), port);
+            code = COAP_ERROR_SEND;
+            break;
+          }
+        }
+
+        code = waitForResponse(messageId, token, timeout, acknowledged,
+                               responseBody, responseSize, responseLength);
+        if (code != COAP_ERROR_TIMEOUT) {
+          break;
+        }
+        timeout *= 2;
+      }
+    }
+  }
+
+  uint32_t duration = millis() - requestStart;
+  stats.lastRequestMs = duration;
+  stats.totalRequestMs += duration;
+  if (duration > stats.maxRequestMs) {
+    stats.maxRequestMs = duration;
+  }
+  if (code < COAP_CODE(2, 0) || code >= COAP_CODE(3, 0)) {
+    stats.failures++;
+  }
+  if (code == COAP_ERROR_TIMEOUT || code == COAP_ERROR_SEND) {
+    addressResolved = false;  // Address may have changed - resolve again next time
+  }
+
+  return code;
+}
+
+#endif
@@ -8,6 +8,9 @@
 #include "config.h"
 #include "SensorManager.h"
 #include "TimeUtils.h"
+#include "WiFiConnection.h"
+#include "AQIResult.h"
+#include "Scheduler.h"
 
 // ===== DISPLAY MANAGER CLASS =====
 class DisplayManager {
@@ -19,14 +22,20 @@ private:
   StealthMode stealthMode = STEALTH_OFF;
   bool displayEnabled = true;
   unsigned long stealthTempStartTime = 0;
+  const WiFiConnectionStats* wifiStats = nullptr;  // Shown on the SYSTEM view
+  unsigned long messageStart = 0;
+  unsigned long messageDuration = 0;               // showMessage() text stays up this long
+  Scheduler* scheduler = nullptr;
+  SchedulerTask stealthTask = SCHEDULER_NO_TASK;   // End of STEALTH_TEMP_ON
   
 public:
   DisplayManager(U8G2_SH1106_128X64_NONAME_F_HW_I2C& disp, Adafruit_NeoPixel& strip);
 
-  void init();
-  void updateDisplay(const SensorData& data, float aqi, const String& aqiLevel,
+  void init(Scheduler& taskScheduler);
+  void updateDisplay(const SensorData& data, const AQIResult& aqi,
                      bool wifiConnected, bool nodeRedResponding = true);
-  void showMessage(const String& message, int duration = 1000);
+  void showMessage(const char* message, int duration = 1000);  // Returns at once, text held for duration
+  void setWiFiStats(const WiFiConnectionStats* stats) { wifiStats = stats; }
   
   // View control
   void nextView();
@@ -41,7 +50,7 @@ public:
   void resetActivity() { /* no longer used */ }
   
 private:
-    void drawOverview(const SensorData& data, float aqi, const String& aqiLevel, bool wifiConnected, bool nodeRedResponding);
+    void drawOverview(const SensorData& data, const AQIResult& aqi, bool wifiConnected, bool nodeRedResponding);
     void drawEnvironment(const SensorData& data, bool wifiConnected);
     void drawParticles(const SensorData& data, float aqi, bool wifiConnected);
     void drawGas(const SensorData& data, bool wifiConnected);
@@ -49,9 +58,9 @@ private:
     void drawWiFiIcon(int x, int y, bool connected);
     void drawNodeRedIcon(int x, int y, bool connected);
     void drawConnectionBar(int x, int y, bool wifiConnected, bool nodeRedResponding);
-    String getShortLevelName(const String& level);
   void updateStealthMode();
   void updateDisplayBrightness();
+  static void onStealthTimeout(void* self) { static_cast<DisplayManager*>(self)->updateStealthMode(); }
 };
 
 // ===== IMPLEMENTATION =====
@@ -59,8 +68,10 @@ DisplayManager::DisplayManager(U8G2_SH1106_128X64_NONAME_F_HW_I2C& disp, Adafrui
   : display(disp), leds(strip) {
 }
 
-void DisplayManager::init() {
+void DisplayManager::init(Scheduler& taskScheduler) {
   DEBUG_INFO("Initializing display...");
+  scheduler = &taskScheduler;
+  stealthTask = scheduler->add("stealth", onStealthTimeout, this);
   
   // Check if display is available
   Wire.beginTransmission(0x3C);
@@ -81,10 +92,18 @@ void DisplayManager::init() {
   DEBUG_INFO("Display initialized successfully");
 }
 
-void DisplayManager::updateDisplay(const SensorData& data, float aqi, const String& aqiLevel, bool wifiConnected, bool nodeRedResponding) {
+void DisplayManager::updateDisplay(const SensorData& data, const AQIResult& aqi, bool wifiConnected, bool nodeRedResponding) {
   if (!displayEnabled) {
     return;
   }
+
+  // A message from showMessage() is still up
+  if (messageDuration > 0) {
+    if (millis() - messageStart < messageDuration) {
+      return;
+    }
+    messageDuration = 0;
+  }
   
   updateStealthMode();
   
@@ -99,13 +118,13 @@ void DisplayManager::updateDisplay(const SensorData& data, float aqi, const Stri
   
     switch (currentView) {
       case VIEW_OVERVIEW:
-        drawOverview(data, aqi, aqiLevel, wifiConnected, nodeRedResponding);
+        drawOverview(data, aqi, wifiConnected, nodeRedResponding);
         break;
       case VIEW_ENVIRONMENT:
         drawEnvironment(data, wifiConnected);
         break;
       case VIEW_PARTICLES:
-        drawParticles(data, aqi, wifiConnected);
+        drawParticles(data, aqi.aqi, wifiConnected);
         break;
       case VIEW_GAS:
         drawGas(data, wifiConnected);
@@ -120,7 +139,7 @@ void DisplayManager::updateDisplay(const SensorData& data, float aqi, const Stri
   display.sendBuffer();
 }
 
-void DisplayManager::drawOverview(const SensorData& data, float aqi, const String& aqiLevel, bool wifiConnected, bool nodeRedResponding) {
+void DisplayManager::drawOverview(const SensorData& data, const AQIResult& aqi, bool wifiConnected, bool nodeRedResponding) {
   // Status indicators
   display.setFont(u8g2_font_ncenB08_tr);
   drawConnectionBar(122, 0, wifiConnected, nodeRedResponding);
@@ -131,18 +150,17 @@ void DisplayManager::drawOverview(const SensorData& data, float aqi, const Strin
   // AQI - large value
   display.setFont(u8g2_font_ncenB14_tr);
   display.setCursor(0, 24);
-  if (aqi > 999) {
+  if (aqi.aqi > 999) {
     display.setFont(u8g2_font_ncenB10_tr);
-    display.printf("AQI:%.0f", aqi);
+    display.printf("AQI:%.0f", aqi.aqi);
   } else {
-    display.printf("AQI: %.0f", aqi);
+    display.printf("AQI: %.0f", aqi.aqi);
   }
 
   // AQI Level from Node-RED
   display.setFont(u8g2_font_ncenB08_tr);
   display.setCursor(0, 34);
-  String shortLevel = getShortLevelName(aqiLevel);
-  display.print(shortLevel.c_str());
+  display.print(aqi.shortLevelName());
 
   // Main values - DS18B20 as primary temperature
   display.setFont(u8g2_font_ncenB08_tr);
@@ -296,23 +314,37 @@ void DisplayManager::drawSystem(const SensorData& data, bool wifiConnected) {
   } else {
     display.printf("Up: %lum", minutes);
   }
+
+  // Sensor count right-aligned on the uptime row: ncenB08 needs 10 px per
+  // line, so the 64 px panel has room for the title and four rows below it
+  char sensors[12];
+  snprintf(sensors, sizeof(sensors), "Sens: %d/3",
+    (data.bme68xAvailable ? 1 : 0) + (data.ds18b20Available ? 1 : 0) + (data.pms5003Available ? 1 : 0));
+  display.drawStr(128 - display.getStrWidth(sensors), 25, sensors);
   
-  // WiFi Status
+  // WiFi Status with the time of the last connect
   display.setCursor(0, 35);
-  display.printf("WiFi: %s", wifiConnected ? "OK" : "Error");
+  if (wifiConnected && wifiStats != nullptr) {
+    display.printf("WiFi: OK %lums", (unsigned long)wifiStats->lastConnectMs);
+  } else {
+    display.printf("WiFi: %s", wifiConnected ? "OK" : "Error");
+  }
   
   // IP-Adresse oder Offline
   display.setCursor(0, 45);
   if (wifiConnected) {
-    display.print(WiFi.localIP().toString().c_str());
+    IPAddress ip = WiFi.localIP();
+    display.printf("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
   } else {
     display.print("Offline");
   }
 
-  // Sensor Count
-  display.setCursor(0, 62);
-  display.printf("Sens: %d/3",
-    (data.bme68xAvailable ? 1 : 0) + (data.ds18b20Available ? 1 : 0) + (data.pms5003Available ? 1 : 0));
+  // Average connect times: cached AP / scan + DHCP
+  if (wifiStats != nullptr) {
+    display.setCursor(0, 55);
+    display.printf("Fast %lums Full %lums",
+                   (unsigned long)wifiStats->averageFastMs(), (unsigned long)wifiStats->averageFullMs());
+  }
 }
 
 void DisplayManager::drawWiFiIcon(int x, int y, bool connected) {
@@ -361,31 +393,22 @@ void DisplayManager::drawConnectionBar(int x, int y, bool wifiConnected, bool no
   }
 }
 
-String DisplayManager::getShortLevelName(const String& level) {
-  if (level == "Unhealthy for sensitive groups") return "Unhlthy Sens";
-  if (level == "Very unhealthy") return "Very Unhlthy";
-  if (level == "Extremely unhealthy") return "Extr. Unhlthy";
-  if (level == "Hazardous") return "Hazardous!";
-  if (level.length() > 15) return level.substring(0, 14);
-  return level;
-}
-
-void DisplayManager::showMessage(const String& message, int duration) {
+void DisplayManager::showMessage(const char* message, int duration) {
   if (!displayEnabled) return;
   
   display.clearBuffer();
   display.setFont(u8g2_font_ncenB08_tr);
   
   // Center text
-  int textWidth = display.getUTF8Width(message.c_str());
+  int textWidth = display.getUTF8Width(message);
   int x = (SCREEN_WIDTH - textWidth) / 2;
   
-  display.drawStr(x, 32, message.c_str());
+  display.drawStr(x, 32, message);
   display.sendBuffer();
-  
-  if (duration > 0) {
-    delay(duration);
-  }
+
+  // No delay: updateDisplay() leaves the message alone until it expires
+  messageStart = millis();
+  messageDuration = duration > 0 ? duration : 0;
 }
 
 void DisplayManager::nextView() {
@@ -418,6 +441,7 @@ void DisplayManager::activateStealthTemp() {
   if (stealthMode == STEALTH_ON) {
     stealthMode = STEALTH_TEMP_ON;
     stealthTempStartTime = millis();
+    scheduler->in(stealthTask, STEALTH_TEMP_ON_MS);
     updateDisplayBrightness();
     DEBUG_INFO("Stealth temporarily activated for 20s");
   }
@@ -426,7 +450,7 @@ void DisplayManager::activateStealthTemp() {
 void DisplayManager::updateStealthMode() {
   // Temporary stealth mode timeout
   if (stealthMode == STEALTH_TEMP_ON) {
-    if (millis() - stealthTempStartTime > STEALTH_TEMP_ON_MS) {
+    if (millis() - stealthTempStartTime >= STEALTH_TEMP_ON_MS) {
       stealthMode = STEALTH_ON;
       updateDisplayBrightness();
       DEBUG_INFO("Stealth temporary mode ended - back to stealth");
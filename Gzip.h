@@ -0,0 +1,182 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Crc32.h"
+
+// ===== GZIP ENCODER =====
+// Single-pass gzip (RFC 1952) of a buffer up to 64 KB: one deflate block
+// with the fixed Huffman code (RFC 1951 3.2.6), greedy LZ77 matches found
+// through a hash table of 3-byte prefixes (one candidate per prefix). No
+// dynamic Huffman tables - line protocol repeats long field names, which
+// the matches already cover. Memory: the caller's hash table and output
+// buffer only; the checksum comes from Crc32.h. tools/influx_server
+// --selftest inflates its output with zlib.
+class GzipEncoder {
+public:
+  static const size_t HASH_BITS = 12;
+  static const size_t HASH_SIZE = 1 << HASH_BITS;   // Entries of the caller's table (uint16_t)
+  static const size_t MAX_INPUT_LENGTH = 65535;
+
+  // Header + 9 bits per literal (worst case, a match is never longer) +
+  // block header and end code + trailer
+  static constexpr size_t maxEncodedSize(size_t length) {
+    return 10 + (9 * length + 10 + 7) / 8 + 8;
+  }
+
+  // Returns the gzip length, 0 if length exceeds MAX_INPUT_LENGTH or capacity
+  // is below maxEncodedSize(length)
+  static size_t encode(const uint8_t* in, size_t length, uint8_t* out, size_t capacity, uint16_t* hashTable);
+
+private:
+  static const size_t MIN_MATCH = 3;
+  static const size_t MAX_MATCH = 258;
+  static const size_t WINDOW = 32768;
+
+  struct BitWriter {
+    uint8_t* out;
+    size_t length;
+    uint32_t bits;
+    uint8_t count;
+
+    // Values go LSB first; Huffman codes are stored bit-reversed for that
+    void put(uint32_t value, uint8_t width) {
+      bits |= value << count;
+      count += width;
+      while (count >= 8) {
+        out[length++] = (uint8_t)bits;
+        bits >>= 8;
+        count -= 8;
+      }
+    }
+    void flush() {
+      if (count > 0) {
+        out[length++] = (uint8_t)bits;
+      }
+      bits = 0;
+      count = 0;
+    }
+  };
+
+  static uint32_t reverse(uint32_t code, uint8_t width);
+  static void putSymbol(BitWriter& writer, uint16_t symbol);
+  static void putMatch(BitWriter& writer, size_t length, size_t distance);
+  static uint32_t hash(const uint8_t* p) {
+    return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+  }
+};
+
+// ===== IMPLEMENTATION =====
+uint32_t GzipEncoder::reverse(uint32_t code, uint8_t width) {
+  uint32_t reversed = 0;
+  for (uint8_t i = 0; i < width; i++) {
+    reversed = (reversed << 1) | ((code >> i) & 1);
+  }
+  return reversed;
+}
+
+// Fixed literal/length code: 0-143 8 bits, 144-255 9 bits, 256-279 7 bits, 280-287 8 bits
+void GzipEncoder::putSymbol(BitWriter& writer, uint16_t symbol) {
+  if (symbol < 144) {
+    writer.put(reverse(0x30 + symbol, 8), 8);
+  } else if (symbol < 256) {
+    writer.put(reverse(0x190 + symbol - 144, 9), 9);
+  } else if (symbol < 280) {
+    writer.put(reverse(symbol - 256, 7), 7);
+  } else {
+    writer.put(reverse(0xC0 + symbol - 280, 8), 8);
+  }
+}
+
+void GzipEncoder::putMatch(BitWriter& writer, size_t length, size_t distance) {
+  static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+  };
+  static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+  };
+  static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+  };
+  static const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+  };
+
+  size_t code = 28;
+  while (LENGTH_BASE[code] > length) {
+    code--;
+  }
+  putSymbol(writer, (uint16_t)(257 + code));
+  writer.put((uint32_t)(length - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+
+  code = 29;
+  while (DISTANCE_BASE[code] > distance) {
+    code--;
+  }
+  writer.put(reverse((uint32_t)code, 5), 5);
+  writer.put((uint32_t)(distance - DISTANCE_BASE[code]), DISTANCE_EXTRA[code]);
+}
+
+size_t GzipEncoder::encode(const uint8_t* in, size_t length, uint8_t* out, size_t capacity, uint16_t* hashTable) {
+  if (length > MAX_INPUT_LENGTH || capacity < maxEncodedSize(length)) {
+    return 0;
+  }
+
+  // Header: magic, deflate, no flags, no mtime, no extra flags, OS unknown
+  static const uint8_t HEADER[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+  memcpy(out, HEADER, sizeof(HEADER));
+  BitWriter writer = {out, sizeof(HEADER), 0, 0};
+  writer.put(1, 1);   // BFINAL
+  writer.put(1, 2);   // BTYPE 01: fixed Huffman
+
+  // Table entries are position + 1, 0 = empty
+  memset(hashTable, 0, HASH_SIZE * sizeof(uint16_t));
+  size_t i = 0;
+  while (i + MIN_MATCH <= length) {
+    uint32_t h = hash(in + i);
+    size_t candidate = hashTable[h];
+    hashTable[h] = (uint16_t)(i + 1);
+
+    size_t matched = 0;
+    if (candidate != 0 && i - (candidate - 1) <= WINDOW) {
+      const uint8_t* previous = in + candidate - 1;
+      size_t limit = length - i < MAX_MATCH ? length - i : MAX_MATCH;
+      while (matched < limit && previous[matched] == in[i + matched]) {
+        matched++;
+      }
+    }
+
+    if (matched < MIN_MATCH) {
+      putSymbol(writer, in[i++]);
+      continue;
+    }
+    putMatch(writer, matched, i - (candidate - 1));
+    // Positions inside the match become candidates as well
+    for (size_t j = i + 1; j < i + matched && j + MIN_MATCH <= length; j++) {
+      hashTable[hash(in + j)] = (uint16_t)(j + 1);
+    }
+    i += matched;
+  }
+  while (i < length) {
+    putSymbol(writer, in[i++]);
+  }
+  putSymbol(writer, 256);   // End of block
+  writer.flush();
+
+  // Trailer: CRC-32 and size of the input, little-endian
+  uint32_t crc = Crc32::update(0, in, length);
+  uint32_t size = (uint32_t)length;
+  for (size_t b = 0; b < 4; b++) {
+    out[writer.length++] = (uint8_t)(crc >> (8 * b));
+  }
+  for (size_t b = 0; b < 4; b++) {
+    out[writer.length++] = (uint8_t)(size >> (8 * b));
+  }
+  return writer.length;
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "config.h"
+#include "TlsClient.h"
+
+// ===== HTTP CONNECTION STATISTICS =====
+struct HttpConnectionStats {
+  uint32_t requests = 0;         // Requests sent
+  uint32_t failures = 0;         // Connection errors and non-2xx answers
+  uint32_t connects = 0;         // New TCP sessions (first connect + reconnects)
+  uint32_t dnsLookups = 0;       // Host name resolutions
+  uint32_t lastConnectMs = 0;    // Connect time of the last new session (incl. TLS handshake)
+  uint32_t lastRequestMs = 0;    // Duration of the last request (incl. connect)
+  uint32_t maxRequestMs = 0;     // Slowest request so far
+  uint64_t totalRequestMs = 0;   // Sum of all request durations
+
+  uint32_t averageRequestMs() const {
+    return requests > 0 ? (uint32_t)(totalRequestMs / requests) : 0;
+  }
+};
+
+// ===== HTTP HEADER =====
+struct HttpHeader {
+  const char* name;
+  const char* value;
+};
+
+// ===== HTTP CONNECTION CLASS =====
+// Long-lived keep-alive session to one endpoint. The URL is parsed and the
+// host resolved once, the TCP connection stays open between requests and is
+// re-established transparently when the server or WiFi dropped it. https://
+// URLs run over TlsClient, which resumes the TLS session on reconnects.
+class HttpConnection {
+private:
+  const char* url;
+  String host;
+  String path;
+  uint16_t port = 80;
+  bool secure = false;
+  bool urlValid = false;
+
+  IPAddress address;
+  bool addressResolved = false;
+
+  TlsClient client;
+  HTTPClient http;
+  HttpConnectionStats stats;
+
+public:
+  HttpConnection(const char* endpointUrl);
+
+  // Sends a POST; returns the HTTP code (< 0 on connection error).
+  // The response stays readable via response() until finish() is called.
+  int post(const char* contentType, const HttpHeader* headers, size_t headerCount,
+           const uint8_t* body, size_t length, uint16_t timeoutMs);
+  HTTPClient& response() { return http; }
+  void finish();
+
+  const char* getUrl() const { return url; }
+  bool isSecure() const { return secure; }
+  const HttpConnectionStats& getStats() const { return stats; }
+  const TlsClientStats& getTlsStats() const { return client.getStats(); }
+
+private:
+  bool parseUrl();
+  bool ensureConnected(uint16_t timeoutMs, bool& reused);
+  int sendRequest(const char* contentType, const HttpHeader* headers, size_t headerCount,
+                  const uint8_t* body, size_t length, uint16_t timeoutMs);
+};
+
+// ===== IMPLEMENTATION =====
+HttpConnection::HttpConnection(const char* endpointUrl) : url(endpointUrl) {
+  urlValid = parseUrl();
+  client.setSecure(secure);
+  client.setServerName(host.c_str());
+}
+
+bool HttpConnection::parseUrl() {
+  // Expected format: http[s]://host[:port]/path
+  String u(url);
+  secure = u.startsWith("https://");
+  if (!secure && !u.startsWith("http://")) {
+    return false;
+  }
+
+  String rest = u.substring(secure ? 8 : 7);
+  int slash = rest.indexOf("/");
+  String hostPort = slash >= 0 ? rest.substring(0, slash) : rest;
+  path = slash >= 0 ? rest.substring(slash) : String("/");
+
+  int colon = hostPort.indexOf(":");
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = (uint16_t)atoi(hostPort.substring(colon + 1).c_str());
+  } else {
+    host = hostPort;
+    port = secure ? 443 : 80;
+  }
+
+  return host.length() > 0 && port != 0;
+}
+
+bool HttpConnection::ensureConnected(uint16_t timeoutMs, bool& reused) {
+  reused = client.connected();
+  if (reused) {
+    return true;  // Open keep-alive session
+  }
+
+  // Resolve once, reuse the address for every reconnect
+  if (!addressResolved) {
+    stats.dnsLookups++;
+    if (!WiFi.hostByName(host.c_str(), address)) {
+      DEBUG_ERROR("DNS lookup failed for %s", host.c_str());
+      return false;
+    }
+    addressResolved = true;
+  }
+
+  unsigned long connectStart = millis();
+  client.stop();
+  if (!client.connect(address, port, timeoutMs)) {
+    DEBUG_ERROR("TCP connect to %s:%u failed", host.c_str(), port);
+    addressResolved = false;  // Address may have changed - resolve again next time
+    return false;
+  }
+  client.setNoDelay(true);
+
+  stats.connects++;
+  stats.lastConnectMs = millis() - connectStart;
+  DEBUG_INFO("%s session opened to %s:%u (%lu ms)", secure ? "HTTPS" : "HTTP", host.c_str(), port,
+             (unsigned long)stats.lastConnectMs);
+  return true;
+}
+
+int HttpConnection::sendRequest(const char* contentType, const HttpHeader* headers, size_t headerCount,
+                                const uint8_t* body, size_t length, uint16_t timeoutMs) {
+  // HTTPClient sees the connected client and reuses it
+  http.begin(client, host, port, path, secure);
+  http.setReuse(true);
+  http.setTimeout(timeoutMs);
+  http.addHeader("Content-Type", contentType);
+  for (size_t i = 0; i < headerCount; i++) {
+    http.addHeader(headers[i].name, headers[i].value);
+  }
+
+  return http.POST((uint8_t*)body, length);
+}
+
+int HttpConnection::post(const char* contentType, const HttpHeader* headers, size_t headerCount,
+                         const uint8_t* body, size_t length, uint16_t timeoutMs) {
+  if (!urlValid) {
+    DEBUG_ERROR("HTTP request failed - invalid URL: %s", url);
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+
+  unsigned long requestStart = millis();
+  stats.requests++;
+
+  bool reused = false;
+  int httpResponseCode = HTTPC_ERROR_CONNECTION_REFUSED;
+  if (ensureConnected(timeoutMs, reused)) {
+    httpResponseCode = sendRequest(contentType, headers, headerCount, body, length, timeoutMs);
+
+    // Server closed the idle session in the meantime - reconnect once and retry,
+    // but only if the request did not go out complete. Once it did, a lost
+    // connection or a read timeout does not tell whether the server processed
+    // it, and the flow stores a repeated packet again (it only reports the
+    // duplicate) - the caller keeps the packet in the backlog instead.
+    bool notSent = httpResponseCode == HTTPC_ERROR_SEND_HEADER_FAILED ||
+                   httpResponseCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    if (notSent && reused) {
+      DEBUG_WARN("Keep-alive session to %s lost - reconnecting", host.c_str());
+      http.end();
+      client.stop();
+      if (ensureConnected(timeoutMs, reused)) {
+        httpResponseCode = sendRequest(contentType, headers, headerCount, body, length, timeoutMs);
+      }
+    }
+  }
+
+  uint32_t duration = millis() - requestStart;
+  stats.lastRequestMs = duration;
+  stats.totalRequestMs += duration;
+  if (duration > stats.maxRequestMs) {
+    stats.maxRequestMs = duration;
+  }
+  if (httpResponseCode < 200 || httpResponseCode >= 300) {
+    stats.failures++;
+  }
+
+  return httpResponseCode;
+}
+
+void HttpConnection::finish() {
+  // Drains the response; keeps the socket open if the server allows reuse
+  http.end();
+}
+
+#endif
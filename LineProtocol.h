@@ -0,0 +1,220 @@
+#ifndef LINE_PROTOCOL_H
+#define LINE_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "PacketSchema.h"
+
+// ===== INFLUXDB LINE PROTOCOL =====
+// One line per sensor packet, written into a caller-provided buffer (no heap).
+// Measurement, tags and field names are those of the Node-RED "InfluxDB v2
+// Object Formatter", so dashboards work with either path; the values derived
+// in the flow (AQI, comfort, alerts) are not written. Fields of an absent
+// sensor section are left out instead of written as 0. Numbers are float
+// fields like the flow's, printed exactly from the scaled integers.
+// tools/influx_server --selftest runs this encoder on the host.
+#define LINE_PROTOCOL_MEASUREMENT "air_quality"
+
+struct LineProtocolField {
+  size_t field;                 // Index in PACKET_SCHEMA
+  const char* name;             // InfluxDB field key
+};
+
+static constexpr LineProtocolField LINE_PROTOCOL_FIELDS[] = {
+  {fieldIndex("bme_temperature"), "temperature_celsius"},
+  {fieldIndex("bme_humidity"),    "humidity_percent"},
+  {fieldIndex("bme_pressure"),    "pressure_hpa"},
+  {fieldIndex("ds_temperature"),  "ds_temperature_celsius"},
+  {fieldIndex("iaq"),             "iaq_index"},
+  {fieldIndex("static_iaq"),      "static_iaq"},
+  {fieldIndex("iaq_accuracy"),    "iaq_accuracy_level"},
+  {fieldIndex("gas_resistance"),  "gas_resistance_ohm"},
+  {fieldIndex("co2_equivalent"),  "co2_equivalent_ppm"},
+  {fieldIndex("co2_accuracy"),    "co2_accuracy_level"},
+  {fieldIndex("breath_voc"),      "tvoc_mgm3"},
+  {fieldIndex("voc_accuracy"),    "voc_accuracy_level"},
+  {fieldIndex("pm1_0"),           "pm1_0_ugm3"},
+  {fieldIndex("pm2_5"),           "pm2_5_ugm3"},
+  {fieldIndex("pm10"),            "pm10_ugm3"},
+  {fieldIndex("uptime_seconds"),  "uptime_seconds"},
+  {fieldIndex("wifi_rssi"),       "wifi_rssi_dbm"}
+};
+static constexpr size_t LINE_PROTOCOL_FIELD_COUNT = sizeof(LINE_PROTOCOL_FIELDS) / sizeof(LINE_PROTOCOL_FIELDS[0]);
+
+constexpr bool lineProtocolFieldsValid(size_t index = 0) {
+  return index >= LINE_PROTOCOL_FIELD_COUNT ||
+         (LINE_PROTOCOL_FIELDS[index].field < PACKET_FIELD_COUNT && lineProtocolFieldsValid(index + 1));
+}
+static_assert(lineProtocolFieldsValid(), "Line protocol field not in PACKET_SCHEMA");
+
+// Scaled values are printed as decimal fractions
+constexpr bool decimalScales(size_t index = 0) {
+  return index >= PACKET_FIELD_COUNT ||
+         ((PACKET_SCHEMA[index].scale == 1 || PACKET_SCHEMA[index].scale == 10 ||
+           PACKET_SCHEMA[index].scale == 100) && decimalScales(index + 1));
+}
+static_assert(decimalScales(), "Line protocol prints scales 1, 10 and 100 only");
+
+// Longest possible field part: separator, key, '=' and a value of up to
+// 11 characters ("-2147483648", "4294967295", "-327.68")
+constexpr size_t lineProtocolKeyLength(const char* key) {
+  return *key == '\0' ? 0 : 1 + lineProtocolKeyLength(key + 1);
+}
+constexpr size_t lineProtocolFieldsLength(size_t index = 0) {
+  return index >= LINE_PROTOCOL_FIELD_COUNT ? 0 :
+         1 + lineProtocolKeyLength(LINE_PROTOCOL_FIELDS[index].name) + 1 + 11 + lineProtocolFieldsLength(index + 1);
+}
+
+class LineProtocolEncoder {
+public:
+  static const size_t MAX_LOCATION_LENGTH = 32;
+
+  // Longest line: measurement and fixed tags, location fully escaped, every
+  // field, sensors_available_count, 20-digit timestamp and '\n'
+  static constexpr size_t MAX_LINE_LENGTH =
+      sizeof(LINE_PROTOCOL_MEASUREMENT ",data_type=environmental,device_id=") - 1 + 12 +
+      sizeof(",device_type=AirQualityMonitor,location=") - 1 + 2 * MAX_LOCATION_LENGTH +
+      lineProtocolFieldsLength() + sizeof(",sensors_available_count=3 ") - 1 + 20 + 1;
+
+  // Appends the line for packet at timeMs (Unix ms, precision=ms) including
+  // '\n'. Returns its length, 0 if it does not fit into capacity. Locations
+  // up to MAX_LOCATION_LENGTH always fit into MAX_LINE_LENGTH.
+  static size_t encode(const SensorDataPacket& packet, const char* location, uint64_t timeMs,
+                       char* out, size_t capacity);
+
+private:
+  struct Writer {
+    char* out;
+    size_t capacity;
+    size_t length;
+
+    void text(const char* value);
+    void tagValue(const char* value);
+    void unsignedNumber(uint64_t value);
+    void scaled(int64_t raw, uint16_t scale);
+    void character(char c) {
+      if (length < capacity) {
+        out[length] = c;
+      }
+      length++;
+    }
+  };
+
+  static int64_t readField(const uint8_t* packet, const PacketFieldSpec& field);
+};
+
+// ===== IMPLEMENTATION =====
+void LineProtocolEncoder::Writer::text(const char* value) {
+  while (*value != '\0') {
+    character(*value++);
+  }
+}
+
+// Tag values escape comma, equals sign and space
+void LineProtocolEncoder::Writer::tagValue(const char* value) {
+  for (; *value != '\0'; value++) {
+    if (*value == ',' || *value == '=' || *value == ' ') {
+      character('\\');
+    }
+    character(*value);
+  }
+}
+
+void LineProtocolEncoder::Writer::unsignedNumber(uint64_t value) {
+  char digits[20];
+  size_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0) {
+    character(digits[--count]);
+  }
+}
+
+// raw / scale without float rounding: 2150 / 100 -> "21.5", 600 -> "600"
+void LineProtocolEncoder::Writer::scaled(int64_t raw, uint16_t scale) {
+  uint64_t magnitude = raw < 0 ? (uint64_t)(-raw) : (uint64_t)raw;
+  if (raw < 0) {
+    character('-');
+  }
+  unsignedNumber(magnitude / scale);
+  uint64_t fraction = magnitude % scale;
+  if (fraction == 0) {
+    return;
+  }
+  character('.');
+  for (uint16_t digit = scale / 10; digit > 0 && fraction > 0; digit /= 10) {
+    character((char)('0' + fraction / digit));
+    fraction %= digit;
+  }
+}
+
+int64_t LineProtocolEncoder::readField(const uint8_t* packet, const PacketFieldSpec& field) {
+  const uint8_t* p = packet + field.offset;
+  switch (field.type) {
+    case FieldType::I8:
+      return (int8_t)p[0];
+    case FieldType::U16: {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    case FieldType::I16: {
+      int16_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    case FieldType::U32: {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    default:
+      return p[0];
+  }
+}
+
+size_t LineProtocolEncoder::encode(const SensorDataPacket& packet, const char* location, uint64_t timeMs,
+                                   char* out, size_t capacity) {
+  const uint8_t* raw = (const uint8_t*)&packet;
+  uint8_t present = PacketEncoder::sections(packet);
+  Writer writer = {out, capacity, 0};
+
+  // Tags sorted by key - the order InfluxDB stores them in
+  char deviceId[13];
+  for (size_t i = 0; i < sizeof(packet.device_id); i++) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    deviceId[2 * i] = HEX_DIGITS[packet.device_id[i] >> 4];
+    deviceId[2 * i + 1] = HEX_DIGITS[packet.device_id[i] & 0x0F];
+  }
+  deviceId[12] = '\0';
+  writer.text(LINE_PROTOCOL_MEASUREMENT ",data_type=environmental,device_id=");
+  writer.text(deviceId);
+  writer.text(",device_type=AirQualityMonitor,location=");
+  writer.tagValue(location);
+
+  char separator = ' ';
+  for (size_t i = 0; i < LINE_PROTOCOL_FIELD_COUNT; i++) {
+    const PacketFieldSpec& field = PACKET_SCHEMA[LINE_PROTOCOL_FIELDS[i].field];
+    if (!(present & (1 << field.section))) {
+      continue;
+    }
+    writer.character(separator);
+    writer.text(LINE_PROTOCOL_FIELDS[i].name);
+    writer.character('=');
+    writer.scaled(readField(raw, field), field.scale);
+    separator = ',';
+  }
+  writer.character(separator);
+  writer.text("sensors_available_count=");
+  writer.unsignedNumber((packet.bme_flags & 1) + (packet.ds_flags & 1) + (packet.pms_flags & 1));
+  writer.character(' ');
+  writer.unsignedNumber(timeMs);
+  writer.character('\n');
+
+  return writer.length <= capacity ? writer.length : 0;
+}
+
+#endif
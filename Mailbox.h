@@ -0,0 +1,55 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+// ===== MAILBOX =====
+// Lock-free single-writer mailbox (seqlock) holding the latest value.
+// The writer never waits; readers retry only while a write is in progress.
+// T must be trivially copyable (no String members).
+template <typename T>
+class Mailbox {
+  static_assert(std::is_trivially_copyable<T>::value, "Mailbox value must be trivially copyable");
+
+private:
+  T value;
+  std::atomic<uint32_t> sequence{0};  // Odd while a write is in progress
+
+public:
+  Mailbox() : value() {}
+
+  // Single writer only
+  void publish(const T& newValue) {
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    value = newValue;
+    std::atomic_thread_fence(std::memory_order_release);
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  // Copies the latest value; returns false if nothing new since lastSequence
+  bool read(T& out, uint32_t& lastSequence) const {
+    uint32_t before;
+    uint32_t after;
+    do {
+      before = sequence.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;  // Writer active
+      }
+      out = value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    if (before == lastSequence) {
+      return false;
+    }
+    lastSequence = before;
+    return true;
+  }
+};
+
+#endif
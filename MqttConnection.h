@@ -0,0 +1,603 @@
+#ifndef MQTT_CONNECTION_H
+#define MQTT_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "config.h"
+#include "TlsClient.h"
+
+// ===== MQTT PROTOCOL (3.1.1) =====
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82          // Incl. required flags 0010
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+#define MQTT_PUBLISH_QOS1 0x02
+#define MQTT_PUBLISH_RETAIN 0x01
+#define MQTT_TOPIC_MAX 80
+
+// ===== MQTT CONNECTION STATISTICS =====
+struct MqttConnectionStats {
+  uint32_t connects = 0;         // Accepted sessions (first connect + reconnects)
+  uint32_t sessionsResumed = 0;  // CONNACK with session present
+  uint32_t publishes = 0;        // QoS1 publishes sent
+  uint32_t acks = 0;             // PUBACKs received
+  uint32_t messages = 0;         // Messages received on subscriptions
+  uint32_t failures = 0;         // Failed connects and lost sessions
+  uint32_t maxInFlight = 0;      // Most unacknowledged publishes at once
+  uint32_t lastAckMs = 0;        // Publish -> PUBACK time of the last ack
+  uint32_t maxAckMs = 0;
+  uint64_t totalAckMs = 0;
+
+  uint32_t averageAckMs() const {
+    return acks > 0 ? (uint32_t)(totalAckMs / acks) : 0;
+  }
+};
+
+typedef void (*MqttMessageCallback)(void* context, const char* topic, const uint8_t* payload, size_t length);
+typedef void (*MqttAckCallback)(void* context, uint16_t packetId);
+
+// ===== MQTT CONNECTION CLASS =====
+// Persistent MQTT 3.1.1 session to one broker: clean session off, so the
+// broker keeps subscriptions and queued QoS1 messages across reconnects.
+// Publishes are QoS1 and pipelined - publish() returns right after writing,
+// up to MQTT_MAX_INFLIGHT packets wait for their PUBACK at the same time.
+// poll() reads PUBACKs and subscribed messages (delivered through the
+// callbacks) and keeps the session alive; call it regularly from one task.
+// mqtts:// URLs run over TlsClient, which resumes the TLS session on reconnects.
+class MqttConnection {
+private:
+  struct InFlight {
+    uint16_t packetId;
+    unsigned long sentTime;
+  };
+
+  enum ReceiveState : uint8_t { RX_HEADER, RX_LENGTH, RX_BODY };
+
+  const char* url;
+  String host;
+  uint16_t port = 1883;
+  bool secure = false;
+  bool urlValid = false;
+
+  IPAddress address;
+  bool addressResolved = false;
+
+  TlsClient client;
+  bool sessionOpen = false;
+  uint16_t keepAliveSeconds = 0;
+  unsigned long lastSendTime = 0;
+  unsigned long pingSentTime = 0;
+  bool pingPending = false;
+
+  uint16_t nextPacketId = 1;
+  InFlight inFlight[MQTT_MAX_INFLIGHT];
+  size_t inFlightCount = 0;
+
+  // Incoming packet, assembled across poll() calls. Bodies larger than the
+  // buffer are truncated: QoS1 messages are still acknowledged, not delivered.
+  ReceiveState rxState = RX_HEADER;
+  uint8_t rxHeader = 0;
+  uint32_t rxLength = 0;
+  uint32_t rxMultiplier = 1;
+  uint32_t rxReceived = 0;
+  uint8_t rxBuffer[MQTT_RX_BUFFER_SIZE];
+  uint8_t lastControlType = 0;    // For connect()/subscribe() waiting on an answer
+  uint8_t lastReturnCode = 0;
+  bool lastSessionPresent = false;
+
+  MqttMessageCallback messageCallback = nullptr;
+  MqttAckCallback ackCallback = nullptr;
+  void* callbackContext = nullptr;
+  MqttConnectionStats stats;
+
+public:
+  MqttConnection(const char* brokerUrl);
+
+  void setCallbacks(MqttMessageCallback onMessage, MqttAckCallback onAck, void* context);
+
+  // Opens TCP and the MQTT session; empty username/password are not sent
+  bool connect(const char* clientId, const char* username, const char* password,
+               uint16_t keepAlive, uint16_t timeoutMs);
+  bool subscribe(const char* topic, uint16_t timeoutMs);  // QoS1
+  // QoS1 publish; returns the packet id, 0 if the window is full or the write failed
+  uint16_t publish(const char* topic, const uint8_t* payload, size_t length, bool retain = false);
+  // Returns false when the session was lost (unacknowledged publishes are gone)
+  bool poll();
+  void disconnect();
+
+  bool connected() const { return sessionOpen; }
+  bool canPublish() const { return sessionOpen && inFlightCount < MQTT_MAX_INFLIGHT; }
+  size_t getInFlight() const { return inFlightCount; }
+  const char* getUrl() const { return url; }
+  const MqttConnectionStats& getStats() const { return stats; }
+  bool isSecure() const { return secure; }
+  const TlsClientStats& getTlsStats() const { return client.getStats(); }
+
+private:
+  bool parseUrl();
+  bool openSocket(uint16_t timeoutMs);
+  bool writePacket(const uint8_t* header, size_t headerLength, const uint8_t* payload, size_t payloadLength);
+  bool waitFor(uint8_t controlType, uint16_t timeoutMs);
+  void receive(uint8_t byte);
+  void handlePacket();
+  void handlePublish(size_t length);
+  void handlePuback(uint16_t packetId);
+  void closeSession(const char* reason);
+  static size_t writeRemainingLength(uint8_t* out, uint32_t length);
+  static size_t writeString(uint8_t* out, const char* text, size_t length);
+};
+
+// ===== IMPLEMENTATION =====
+MqttConnection::MqttConnection(const char* brokerUrl) : url(brokerUrl) {
+  urlValid = parseUrl();
+  client.setSecure(secure);
+  client.setServerName(host.c_str());
+}
+
+void MqttConnection::setCallbacks(MqttMessageCallback onMessage, MqttAckCallback onAck, void* context) {
+  messageCallback = onMessage;
+  ackCallback = onAck;
+  callbackContext = context;
+}
+
+bool MqttConnection::parseUrl() {
+  // Expected format: mqtt[s]://host[:port]
+  String u(url);
+  secure = u.startsWith("mqtts://");
+  if (!secure && !u.startsWith("mqtt://")) {
+    return false;
+  }
+
+  String hostPort = u.substring(secure ? 8 : 7);
+  int slash = hostPort.indexOf("/");
+  if (slash >= 0) {
+    hostPort = hostPort.substring(0, slash);
+  }
+
+  int colon = hostPort.indexOf(":");
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = (uint16_t)atoi(hostPort.substring(colon + 1).c_str());
+  } else {
+    host = hostPort;
+    port = secure ? 8883 : 1883;
+  }
+
+  return host.length() > 0 && port != 0;
+}
+
+bool MqttConnection::openSocket(uint16_t timeoutMs) {
+  // Resolve once, reuse the address for every reconnect
+  if (!addressResolved) {
+    if (!WiFi.hostByName(host.c_str(), address)) {
+      DEBUG_ERROR("DNS lookup failed for %s", host.c_str());
+      return false;
+    }
+    addressResolved = true;
+  }
+
+  client.stop();
+  if (!client.connect(address, port, timeoutMs)) {
+    DEBUG_ERROR("TCP connect to broker %s:%u failed", host.c_str(), port);
+    addressResolved = false;  // Address may have changed - resolve again next time
+    return false;
+  }
+  client.setNoDelay(true);
+  rxState = RX_HEADER;
+  return true;
+}
+
+size_t MqttConnection::writeRemainingLength(uint8_t* out, uint32_t length) {
+  size_t count = 0;
+  do {
+    uint8_t digit = length % 128;
+    length /= 128;
+    out[count++] = digit | (length > 0 ? 0x80 : 0);
+  } while (length > 0 && count < 4);
+  return count;
+}
+
+size_t MqttConnection::writeString(uint8_t* out, const char* text, size_t length) {
+  out[0] = (uint8_t)(length >> 8);
+  out[1] = (uint8_t)length;
+  memcpy(out + 2, text, length);
+  return 2 + length;
+}
+
+bool MqttConnection::writePacket(const uint8_t* header, size_t headerLength,
+                                 const uint8_t* payload, size_t payloadLength) {
+  // Small packets go out as one TCP segment, large payloads are written in place
+  uint8_t packet[160];
+  bool written;
+  if (payloadLength == 0) {
+    written = client.write(header, headerLength) == headerLength;
+  } else if (headerLength + payloadLength <= sizeof(packet)) {
+    memcpy(packet, header, headerLength);
+    memcpy(packet + headerLength, payload, payloadLength);
+    written = client.write(packet, headerLength + payloadLength) == headerLength + payloadLength;
+  } else {
+    written = client.write(header, headerLength) == headerLength &&
+              client.write(payload, payloadLength) == payloadLength;
+  }
+
+  if (written) {
+    lastSendTime = millis();
+  }
+  return written;
+}
+
+bool MqttConnection::connect(const char* clientId, const char* username, const char* password,
+                             uint16_t keepAlive, uint16_t timeoutMs) {
+  if (!urlValid) {
+    DEBUG_ERROR("MQTT connect failed - invalid URL: %s", url);
+    return false;
+  }
+  if (sessionOpen) {
+    return true;
+  }
+
+  size_t clientIdLength = strlen(clientId);
+  size_t usernameLength = username != nullptr ? strlen(username) : 0;
+  size_t passwordLength = password != nullptr ? strlen(password) : 0;
+
+  // Variable header: protocol "MQTT", level 4, flags, keep-alive
+  uint8_t flags = 0;  // Clean session off - persistent session
+  uint32_t remaining = 10 + 2 + clientIdLength;
+  if (usernameLength > 0) {
+    flags |= 0x80;
+    remaining += 2 + usernameLength;
+  }
+  if (passwordLength > 0) {
+    flags |= 0x40;
+    remaining += 2 + passwordLength;
+  }
+
+  uint8_t packet[160];
+  if (remaining + 5 > sizeof(packet)) {
+    DEBUG_ERROR("MQTT client id or credentials too long");
+    return false;
+  }
+
+  size_t length = 0;
+  packet[length++] = MQTT_CONNECT;
+  length += writeRemainingLength(packet + length, remaining);
+  length += writeString(packet + length, "MQTT", 4);
+  packet[length++] = 4;
+  packet[length++] = flags;
+  packet[length++] = (uint8_t)(keepAlive >> 8);
+  packet[length++] = (uint8_t)keepAlive;
+  length += writeString(packet + length, clientId, clientIdLength);
+  if (usernameLength > 0) {
+    length += writeString(packet + length, username, usernameLength);
+  }
+  if (passwordLength > 0) {
+    length += writeString(packet + length, password, passwordLength);
+  }
+
+  unsigned long connectStart = millis();
+  if (!openSocket(timeoutMs) || !writePacket(packet, length, nullptr, 0)) {
+    stats.failures++;
+    client.stop();
+    return false;
+  }
+
+  keepAliveSeconds = keepAlive;
+  pingPending = false;
+  inFlightCount = 0;
+  if (!waitFor(MQTT_CONNACK, timeoutMs) || lastReturnCode != 0) {
+    DEBUG_ERROR("MQTT broker refused session (return code %u)", lastReturnCode);
+    stats.failures++;
+    client.stop();
+    return false;
+  }
+
+  sessionOpen = true;
+  stats.connects++;
+  if (lastSessionPresent) {
+    stats.sessionsResumed++;
+  }
+  DEBUG_INFO("MQTT session to %s:%u %s (%lu ms)", host.c_str(), port,
+             lastSessionPresent ? "resumed" : "created", (unsigned long)(millis() - connectStart));
+  return true;
+}
+
+bool MqttConnection::subscribe(const char* topic, uint16_t timeoutMs) {
+  size_t topicLength = strlen(topic);
+  if (!sessionOpen || topicLength > MQTT_TOPIC_MAX) {
+    return false;
+  }
+
+  uint16_t packetId = nextPacketId++;
+  if (nextPacketId == 0) {
+    nextPacketId = 1;
+  }
+
+  uint8_t packet[MQTT_TOPIC_MAX + 12];
+  size_t length = 0;
+  packet[length++] = MQTT_SUBSCRIBE;
+  length += writeRemainingLength(packet + length, 2 + 2 + topicLength + 1);
+  packet[length++] = (uint8_t)(packetId >> 8);
+  packet[length++] = (uint8_t)packetId;
+  length += writeString(packet + length, topic, topicLength);
+  packet[length++] = 1;  // Requested QoS
+
+  if (!writePacket(packet, length, nullptr, 0)) {
+    closeSession("subscribe write failed");
+    return false;
+  }
+  if (!waitFor(MQTT_SUBACK, timeoutMs) || lastReturnCode == 0x80) {
+    DEBUG_ERROR("MQTT subscription to %s refused", topic);
+    return false;
+  }
+
+  DEBUG_INFO("MQTT subscribed to %s (QoS %u)", topic, lastReturnCode);
+  return true;
+}
+
+uint16_t MqttConnection::publish(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+  size_t topicLength = strlen(topic);
+  if (!canPublish() || topicLength > MQTT_TOPIC_MAX) {
+    return 0;
+  }
+
+  // Packet id 0 is invalid, ids still waiting for a PUBACK are skipped
+  uint16_t packetId = 0;
+  while (packetId == 0) {
+    packetId = nextPacketId++;
+    for (size_t i = 0; i < inFlightCount; i++) {
+      if (inFlight[i].packetId == packetId) {
+        packetId = 0;
+        break;
+      }
+    }
+  }
+
+  uint8_t header[5 + 2 + MQTT_TOPIC_MAX + 2];
+  size_t headerLength = 0;
+  header[headerLength++] = MQTT_PUBLISH | MQTT_PUBLISH_QOS1 | (retain ? MQTT_PUBLISH_RETAIN : 0);
+  headerLength += writeRemainingLength(header + headerLength, 2 + topicLength + 2 + length);
+  headerLength += writeString(header + headerLength, topic, topicLength);
+  header[headerLength++] = (uint8_t)(packetId >> 8);
+  header[headerLength++] = (uint8_t)packetId;
+
+  if (!writePacket(header, headerLength, payload, length)) {
+    closeSession("publish write failed");
+    return 0;
+  }
+
+  inFlight[inFlightCount].packetId = packetId;
+  inFlight[inFlightCount].sentTime = millis();
+  inFlightCount++;
+  stats.publishes++;
+  if (inFlightCount > stats.maxInFlight) {
+    stats.maxInFlight = inFlightCount;
+  }
+  return packetId;
+}
+
+bool MqttConnection::waitFor(uint8_t controlType, uint16_t timeoutMs) {
+  lastControlType = 0;
+  unsigned long waitStart = millis();
+  while (millis() - waitStart < timeoutMs) {
+    if (!client.connected()) {
+      return false;
+    }
+    // A retained message can follow the SUBACK in the same read
+    uint8_t chunk[64];
+    int count = client.read(chunk, sizeof(chunk));
+    bool seen = false;
+    for (int i = 0; i < count; i++) {
+      receive(chunk[i]);
+      seen = seen || lastControlType == controlType;
+    }
+    if (seen) {
+      return true;
+    }
+    if (count <= 0) {
+      vTaskDelay(1);
+    }
+  }
+  return false;
+}
+
+bool MqttConnection::poll() {
+  if (!sessionOpen) {
+    return false;
+  }
+
+  uint8_t chunk[64];
+  int count;
+  while ((count = client.read(chunk, sizeof(chunk))) > 0) {
+    for (int i = 0; i < count; i++) {
+      receive(chunk[i]);
+    }
+  }
+
+  if (!client.connected()) {
+    closeSession("broker closed the connection");
+    return false;
+  }
+
+  // A missing PUBACK would block its window slot forever - give up the
+  // session, the caller moves everything unacknowledged to the backlog
+  for (size_t i = 0; i < inFlightCount; i++) {
+    if (millis() - inFlight[i].sentTime > MQTT_ACK_TIMEOUT) {
+      closeSession("PUBACK timeout");
+      return false;
+    }
+  }
+
+  // Keep-alive: ping when idle, give up when the ping stays unanswered
+  unsigned long keepAliveMs = (unsigned long)keepAliveSeconds * 1000;
+  if (keepAliveMs > 0) {
+    if (pingPending && millis() - pingSentTime > keepAliveMs) {
+      closeSession("no PINGRESP");
+      return false;
+    }
+    if (!pingPending && millis() - lastSendTime >= keepAliveMs / 2) {
+      const uint8_t ping[2] = {MQTT_PINGREQ, 0};
+      if (!writePacket(ping, sizeof(ping), nullptr, 0)) {
+        closeSession("ping write failed");
+        return false;
+      }
+      pingPending = true;
+      pingSentTime = millis();
+    }
+  }
+
+  return sessionOpen;
+}
+
+void MqttConnection::receive(uint8_t byte) {
+  switch (rxState) {
+    case RX_HEADER:
+      rxHeader = byte;
+      rxLength = 0;
+      rxMultiplier = 1;
+      rxState = RX_LENGTH;
+      break;
+
+    case RX_LENGTH:
+      rxLength += (byte & 0x7F) * rxMultiplier;
+      rxMultiplier *= 128;
+      if ((byte & 0x80) == 0) {
+        rxReceived = 0;
+        if (rxLength == 0) {
+          handlePacket();
+          rxState = RX_HEADER;
+        } else {
+          rxState = RX_BODY;
+        }
+      } else if (rxMultiplier > 128UL * 128 * 128) {
+        closeSession("malformed remaining length");
+      }
+      break;
+
+    case RX_BODY:
+      if (rxReceived < sizeof(rxBuffer)) {
+        rxBuffer[rxReceived] = byte;
+      }
+      rxReceived++;
+      if (rxReceived == rxLength) {
+        handlePacket();
+        rxState = RX_HEADER;
+      }
+      break;
+  }
+}
+
+void MqttConnection::handlePacket() {
+  uint8_t type = rxHeader & 0xF0;
+  size_t length = rxLength < sizeof(rxBuffer) ? rxLength : sizeof(rxBuffer);
+
+  switch (type) {
+    case MQTT_CONNACK:
+      lastSessionPresent = length >= 1 && (rxBuffer[0] & 0x01) != 0;
+      lastReturnCode = length >= 2 ? rxBuffer[1] : 0xFF;
+      break;
+    case MQTT_SUBACK:
+      lastReturnCode = length >= 3 ? rxBuffer[2] : 0x80;
+      break;
+    case MQTT_PUBACK:
+      if (length >= 2) {
+        handlePuback((uint16_t)((rxBuffer[0] << 8) | rxBuffer[1]));
+      }
+      break;
+    case MQTT_PUBLISH:
+      handlePublish(length);
+      break;
+    case MQTT_PINGRESP:
+      pingPending = false;
+      break;
+    default:
+      break;
+  }
+  lastControlType = type;
+}
+
+void MqttConnection::handlePuback(uint16_t packetId) {
+  for (size_t i = 0; i < inFlightCount; i++) {
+    if (inFlight[i].packetId != packetId) {
+      continue;
+    }
+
+    uint32_t ackTime = millis() - inFlight[i].sentTime;
+    stats.acks++;
+    stats.lastAckMs = ackTime;
+    stats.totalAckMs += ackTime;
+    if (ackTime > stats.maxAckMs) {
+      stats.maxAckMs = ackTime;
+    }
+
+    inFlight[i] = inFlight[--inFlightCount];  // Order does not matter
+    if (ackCallback != nullptr) {
+      ackCallback(callbackContext, packetId);
+    }
+    return;
+  }
+}
+
+void MqttConnection::handlePublish(size_t length) {
+  uint8_t qos = (rxHeader >> 1) & 0x03;
+  if (length < 2) {
+    return;
+  }
+
+  size_t topicLength = (rxBuffer[0] << 8) | rxBuffer[1];
+  size_t offset = 2 + topicLength;
+  if (offset > length) {
+    return;  // Topic runs past the packet
+  }
+  if (qos > 0) {
+    if (offset + 2 > length) {
+      return;  // Not even the packet id fits - broker will redeliver
+    }
+    uint16_t packetId = (uint16_t)((rxBuffer[offset] << 8) | rxBuffer[offset + 1]);
+    offset += 2;
+
+    const uint8_t ack[4] = {MQTT_PUBACK, 2, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+    writePacket(ack, sizeof(ack), nullptr, 0);
+  }
+
+  stats.messages++;
+  if (rxLength > sizeof(rxBuffer) || topicLength > MQTT_TOPIC_MAX) {
+    DEBUG_WARN("MQTT message of %lu bytes ignored (buffer %u)",
+               (unsigned long)rxLength, (unsigned)sizeof(rxBuffer));
+    return;
+  }
+
+  if (messageCallback != nullptr) {
+    char topic[MQTT_TOPIC_MAX + 1];
+    memcpy(topic, rxBuffer + 2, topicLength);
+    topic[topicLength] = '\0';
+    messageCallback(callbackContext, topic, rxBuffer + offset, length - offset);
+  }
+}
+
+void MqttConnection::closeSession(const char* reason) {
+  if (sessionOpen) {
+    DEBUG_WARN("MQTT session lost: %s (%u publishes unacknowledged)", reason, (unsigned)inFlightCount);
+    stats.failures++;
+  }
+  sessionOpen = false;
+  inFlightCount = 0;
+  client.stop();
+}
+
+void MqttConnection::disconnect() {
+  if (sessionOpen) {
+    const uint8_t packet[2] = {MQTT_DISCONNECT, 0};
+    writePacket(packet, sizeof(packet), nullptr, 0);
+  }
+  sessionOpen = false;
+  inFlightCount = 0;
+  client.stop();
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef MQTT_UPLINK_H
+#define MQTT_UPLINK_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "MqttConnection.h"
+#include "PacketSchema.h"
+#include "PacketStore.h"
+#include "BootTimeline.h"
+
+// Message on the device's AQI topic; payload nullptr when the session was
+// lost (no AQI until the next one is pushed)
+typedef void (*MqttAqiCallback)(void* context, const uint8_t* payload, size_t length);
+
+// ===== MQTT UPLINK =====
+// TRANSPORT_MQTT side of the network task: one persistent broker session,
+// live packets as pipelined QoS1 publishes on <prefix>/<device>/data,
+// backlog batches on <prefix>/<device>/backlog/..., the AQI pushed back
+// retained on <prefix>/<device>/aqi. A live packet is kept until its
+// PUBACK; when the session is lost, the unacknowledged ones go to the
+// backlog and the batch in flight is read again. Apart from
+// ByteTransmissionManager so tools/mqtt_session_test can run it on the host.
+class MqttUplink {
+private:
+  struct PendingPublish {
+    uint16_t packetId;
+    SensorDataPacket packet;
+  };
+
+  MqttConnection mqtt;
+  const char* username;
+  const char* password;
+  PacketStore* backlog = nullptr;   // nullptr: unacknowledged packets are lost
+  bool sessionUp = false;
+  unsigned long connectTime = 0;
+  char deviceName[13] = "";
+  char clientId[20] = "";
+  char dataTopic[MQTT_TOPIC_MAX + 1] = "";
+  char aqiTopic[MQTT_TOPIC_MAX + 1] = "";
+  PendingPublish pendingPublishes[MQTT_MAX_INFLIGHT];  // Live packets until their PUBACK
+  size_t pendingCount = 0;
+  uint16_t backlogPacketId = 0;     // Batch waiting for its PUBACK (0 = none)
+  size_t backlogPublishedCount = 0;
+  MqttAqiCallback aqiCallback = nullptr;
+  void* callbackContext = nullptr;
+
+public:
+  MqttUplink(const char* brokerUrl, const char* brokerUsername, const char* brokerPassword);
+
+  // Topics and client id from the MAC; store takes the packets a lost session leaves behind
+  void begin(const uint8_t deviceId[6], PacketStore* store, MqttAqiCallback onAqi, void* context);
+
+  // networkUp: WiFi usable - no connect attempt otherwise.
+  // Live packet; false if it was not sent (the caller keeps it)
+  bool publish(const SensorDataPacket& packet, bool networkUp);
+  // PUBACKs, pushed AQI, keep-alive; reconnects (rate limited) after a loss
+  void poll(bool networkUp);
+  // One backlog batch at a time; acknowledged in the store on its PUBACK
+  bool canPublishBacklog() const { return backlogPacketId == 0 && mqtt.canPublish(); }
+  bool publishBacklog(const char* format, const char* bootCount, const char* uptime,
+                      const uint8_t* body, size_t length, size_t count);
+
+  bool connected() const { return mqtt.connected(); }
+  size_t getPending() const { return pendingCount; }
+  const MqttConnectionStats& getStats() const { return mqtt.getStats(); }
+
+private:
+  bool ensureSession(bool networkUp);
+  void handleLoss();
+  void keep(const SensorDataPacket& packet);
+  static void messageEntry(void* context, const char* topic, const uint8_t* payload, size_t length);
+  static void ackEntry(void* context, uint16_t packetId);
+  void onAck(uint16_t packetId);
+  void logStats(const MqttConnectionStats& stats);
+};
+
+// ===== IMPLEMENTATION =====
+MqttUplink::MqttUplink(const char* brokerUrl, const char* brokerUsername, const char* brokerPassword)
+  : mqtt(brokerUrl), username(brokerUsername), password(brokerPassword) {
+}
+
+void MqttUplink::begin(const uint8_t deviceId[6], PacketStore* store, MqttAqiCallback onAqi, void* context) {
+  backlog = store;
+  aqiCallback = onAqi;
+  callbackContext = context;
+  mqtt.setCallbacks(messageEntry, ackEntry, this);
+
+  snprintf(deviceName, sizeof(deviceName), "%02x%02x%02x%02x%02x%02x",
+           deviceId[0], deviceId[1], deviceId[2], deviceId[3], deviceId[4], deviceId[5]);
+  snprintf(clientId, sizeof(clientId), "aqm-%s", deviceName);
+  snprintf(dataTopic, sizeof(dataTopic), "%s/%s/data", MQTT_TOPIC_PREFIX, deviceName);
+  snprintf(aqiTopic, sizeof(aqiTopic), "%s/%s/aqi", MQTT_TOPIC_PREFIX, deviceName);
+}
+
+bool MqttUplink::ensureSession(bool networkUp) {
+  if (mqtt.connected()) {
+    return true;
+  }
+  if (!networkUp || (connectTime != 0 && millis() - connectTime < MQTT_RECONNECT_INTERVAL)) {
+    return false;
+  }
+
+  connectTime = millis();
+  if (!mqtt.connect(clientId, username, password, MQTT_KEEPALIVE, 5000)) {
+    return false;
+  }
+  sessionUp = true;
+
+  // Subscribing again also makes the broker resend the retained AQI
+  if (!mqtt.subscribe(aqiTopic, 5000)) {
+    DEBUG_WARN("No AQI subscription - pushed AQI updates will be missing");
+  }
+  return mqtt.connected();
+}
+
+void MqttUplink::poll(bool networkUp) {
+  if (mqtt.connected() && mqtt.poll()) {
+    return;
+  }
+
+  // Lost in poll() or in an earlier publish() - then reconnect, rate limited
+  handleLoss();
+  ensureSession(networkUp);
+}
+
+bool MqttUplink::publish(const SensorDataPacket& packet, bool networkUp) {
+  if (!ensureSession(networkUp)) {
+    return false;
+  }
+
+  // Window full: wait for PUBACKs instead of piling up unacknowledged packets
+  unsigned long waitStart = millis();
+  while (!mqtt.canPublish()) {
+    if (!mqtt.poll()) {
+      handleLoss();
+      return false;
+    }
+    if (millis() - waitStart >= MQTT_ACK_TIMEOUT) {
+      DEBUG_WARN("MQTT: %u publishes unacknowledged for %u ms - reconnecting",
+                 (unsigned)mqtt.getInFlight(), (unsigned)MQTT_ACK_TIMEOUT);
+      mqtt.disconnect();
+      handleLoss();
+      return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+
+  uint8_t wire[PACKET_WIRE_MAX_SIZE];
+  size_t length = PacketEncoder::encode(packet, wire);
+  uint16_t packetId = mqtt.publish(dataTopic, wire, length);
+  if (packetId == 0) {
+    handleLoss();
+    return false;
+  }
+
+  pendingPublishes[pendingCount].packetId = packetId;
+  pendingPublishes[pendingCount].packet = packet;
+  pendingCount++;
+  DEBUG_INFO("MQTT publish %u: %u bytes, %u in flight", packetId, (unsigned)length, (unsigned)mqtt.getInFlight());
+  return true;
+}
+
+bool MqttUplink::publishBacklog(const char* format, const char* bootCount, const char* uptime,
+                                const uint8_t* body, size_t length, size_t count) {
+  if (!canPublishBacklog()) {
+    return false;
+  }
+
+  // MQTT 3.1.1 has no headers - format, boot count and uptime go into the topic.
+  // Acknowledged in onAck(), until then the next batch waits.
+  char topic[MQTT_TOPIC_MAX + 1];
+  snprintf(topic, sizeof(topic), "%s/%s/backlog/%s/%s/%s", MQTT_TOPIC_PREFIX, deviceName, format, bootCount, uptime);
+  backlogPacketId = mqtt.publish(topic, body, length);
+  if (backlogPacketId == 0) {
+    DEBUG_WARN("Backlog publish failed");
+    handleLoss();
+    return false;
+  }
+  backlogPublishedCount = count;
+  return true;
+}
+
+void MqttUplink::handleLoss() {
+  if (!sessionUp) {
+    return;
+  }
+  sessionUp = false;
+
+  // Unacknowledged packets may or may not have reached the broker - keep
+  // them, the flow reports a resent one as duplicate by its sequence number
+  for (size_t i = 0; i < pendingCount; i++) {
+    keep(pendingPublishes[i].packet);
+  }
+  pendingCount = 0;
+  backlogPacketId = 0;  // Not acknowledged - the same batch is read again
+  if (aqiCallback != nullptr) {
+    aqiCallback(callbackContext, nullptr, 0);
+  }
+}
+
+void MqttUplink::keep(const SensorDataPacket& packet) {
+  if (backlog == nullptr) {
+    return;
+  }
+  if (backlog->push((const uint8_t*)&packet)) {
+    DEBUG_INFO("Packet stored in backlog (%u pending)", (unsigned)backlog->pending());
+  } else {
+    DEBUG_ERROR("Backlog store failed - sample lost");
+  }
+}
+
+void MqttUplink::messageEntry(void* context, const char* topic, const uint8_t* payload, size_t length) {
+  MqttUplink* uplink = static_cast<MqttUplink*>(context);
+  if (strcmp(topic, uplink->aqiTopic) == 0 && uplink->aqiCallback != nullptr) {
+    uplink->aqiCallback(uplink->callbackContext, payload, length);
+  }
+}
+
+void MqttUplink::ackEntry(void* context, uint16_t packetId) {
+  static_cast<MqttUplink*>(context)->onAck(packetId);
+}
+
+void MqttUplink::onAck(uint16_t packetId) {
+  for (size_t i = 0; i < pendingCount; i++) {
+    if (pendingPublishes[i].packetId == packetId) {
+      pendingPublishes[i] = pendingPublishes[--pendingCount];
+      BootTimeline::mark(BOOT_FIRST_UPLOAD);
+      logStats(mqtt.getStats());
+      return;
+    }
+  }
+
+  if (packetId == backlogPacketId) {
+    backlogPacketId = 0;
+    if (backlog != nullptr) {
+      backlog->acknowledge();
+      DEBUG_INFO("Backlog: %u packets uploaded, %u pending",
+                 (unsigned)backlogPublishedCount, (unsigned)backlog->pending());
+    }
+  }
+}
+
+void MqttUplink::logStats(const MqttConnectionStats& stats) {
+  DEBUG_INFO("MQTT data: PUBACK after %lu ms (avg %lu, max %lu) - %lu publishes, max %lu in flight, "
+             "%lu sessions (%lu resumed), %lu failures",
+             (unsigned long)stats.lastAckMs, (unsigned long)stats.averageAckMs(),
+             (unsigned long)stats.maxAckMs, (unsigned long)stats.publishes,
+             (unsigned long)stats.maxInFlight, (unsigned long)stats.connects,
+             (unsigned long)stats.sessionsResumed, (unsigned long)stats.failures);
+
+  if (mqtt.isSecure()) {
+    const TlsClientStats& tls = mqtt.getTlsStats();
+    DEBUG_INFO("TLS broker: %lu full handshakes (avg %lu ms), %lu resumed (avg %lu ms), %lu failed",
+               (unsigned long)tls.fullHandshakes, (unsigned long)tls.averageFullMs(),
+               (unsigned long)tls.resumedHandshakes, (unsigned long)tls.averageResumedMs(),
+               (unsigned long)tls.failures);
+  }
+}
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef PACKET_SCHEMA_H
+#define PACKET_SCHEMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Crc32.h"
+
+// ===== PACKET SCHEMA =====
+// Single source of the sensor packet layout. The list below generates the
+// packed SensorDataPacket struct and the constexpr field table that drives
+// the encoders in this file. tools/packet_codegen, a host program that
+// includes this header, emits the Node-RED decoder and the packet tables in
+// README.md / DATENPUNKTE.md from the same table - run it after changing a
+// field.
+//
+// Columns: name, type, scale (wire = value * scale), section,
+//          path in the decoded Node-RED object ("" = internal), unit
+#define PACKET_SCHEMA_FIELDS(X) \
+  X(magic_version,   MAGIC, 1,   HEADER,  "",                              "") \
+  X(device_id,       MAC,   1,   HEADER,  "device.id",                     "eFuse MAC") \
+  X(boot_count,      U16,   1,   HEADER,  "device.boot_count",             "") \
+  X(sequence,        U32,   1,   HEADER,  "device.sequence",               "") \
+  X(timestamp,       U32,   1,   HEADER,  "timestamp",                     "s (UTC if time section)") \
+  X(bme_temperature, I16,   100, BME68X,  "environment.main_temperature",  "°C") \
+  X(bme_humidity,    U16,   100, BME68X,  "environment.humidity",          "%") \
+  X(bme_pressure,    U16,   10,  BME68X,  "environment.pressure",          "hPa") \
+  X(gas_resistance,  U32,   1,   BME68X,  "air_quality.gas_resistance",    "Ohm") \
+  X(iaq,             U16,   10,  BME68X,  "air_quality.iaq",               "") \
+  X(static_iaq,      U16,   10,  BME68X,  "air_quality.static_iaq",        "") \
+  X(co2_equivalent,  U16,   1,   BME68X,  "air_quality.co2_equivalent",    "ppm") \
+  X(breath_voc,      U16,   100, BME68X,  "air_quality.breath_voc",        "mg/m³") \
+  X(iaq_accuracy,    U8,    1,   BME68X,  "air_quality.iaq_accuracy",      "0-3") \
+  X(co2_accuracy,    U8,    1,   BME68X,  "air_quality.co2_accuracy",      "0-3") \
+  X(voc_accuracy,    U8,    1,   BME68X,  "air_quality.voc_accuracy",      "0-3") \
+  X(bme_flags,       FLAGS, 1,   BME68X,  "",                              "Bit 0: available, bit 1: calibrated") \
+  X(ds_temperature,  I16,   100, DS18B20, "environment.ds_temperature",    "°C") \
+  X(ds_flags,        FLAGS, 1,   DS18B20, "",                              "Bit 0: available") \
+  X(pm1_0,           U16,   1,   PMS5003, "air_quality.pm1_0",             "µg/m³") \
+  X(pm2_5,           U16,   1,   PMS5003, "air_quality.pm2_5",             "µg/m³") \
+  X(pm10,            U16,   1,   PMS5003, "air_quality.pm10",              "µg/m³") \
+  X(pms_flags,       FLAGS, 1,   PMS5003, "",                              "Bit 0: available") \
+  X(uptime_seconds,  U32,   1,   SYSTEM,  "system.uptime_seconds",         "s") \
+  X(wifi_rssi,       I8,    1,   SYSTEM,  "system.wifi_rssi",              "dBm") \
+  X(time_ms,         U16,   1,   TIME,    "time.ms",                       "ms (fraction of timestamp)") \
+  X(time_quality,    FLAGS, 1,   TIME,    "time.quality",                  "1 estimated, 2 synced, 3 +drift")
+
+// MAGIC and MAC are the same in every packet of a device, a FLAGS field
+// decides whether its section is sent (0 = sensor absent, section skipped)
+enum class FieldType : uint8_t { U8, I8, U16, I16, U32, FLAGS, MAGIC, MAC };
+
+enum PacketSection : uint8_t {
+  SECTION_HEADER = 0,
+  SECTION_BME68X,
+  SECTION_DS18B20,
+  SECTION_PMS5003,
+  SECTION_SYSTEM,
+  SECTION_TIME,                 // Last: packets without it keep the layout of earlier firmware
+  SECTION_COUNT
+};
+
+static const char* const PACKET_SECTION_NAMES[SECTION_COUNT] = {
+  "header", "bme68x", "ds18b20", "pms5003", "system", "time"
+};
+
+template <FieldType T> struct FieldStorage;
+template <> struct FieldStorage<FieldType::U8>    { typedef uint8_t type; };
+template <> struct FieldStorage<FieldType::I8>    { typedef int8_t type; };
+template <> struct FieldStorage<FieldType::U16>   { typedef uint16_t type; };
+template <> struct FieldStorage<FieldType::I16>   { typedef int16_t type; };
+template <> struct FieldStorage<FieldType::U32>   { typedef uint32_t type; };
+template <> struct FieldStorage<FieldType::FLAGS> { typedef uint8_t type; };
+template <> struct FieldStorage<FieldType::MAGIC> { typedef uint8_t type; };
+template <> struct FieldStorage<FieldType::MAC>   { typedef uint8_t type[6]; };
+
+// ===== SENSOR DATA PACKET =====
+// In-memory form (network queue, backlog records); fixed size, all fields
+#pragma pack(push, 1)  // No padding bytes
+
+struct SensorDataPacket {
+#define PACKET_STRUCT_MEMBER(name, fieldType, scale, section, output, unit) \
+  FieldStorage<FieldType::fieldType>::type name;
+  PACKET_SCHEMA_FIELDS(PACKET_STRUCT_MEMBER)
+#undef PACKET_STRUCT_MEMBER
+};
+
+#pragma pack(pop)
+
+// ===== FIELD TABLE =====
+struct PacketFieldSpec {
+  const char* name;
+  FieldType type;
+  uint16_t scale;
+  PacketSection section;
+  const char* output;           // Path in the decoded object, "" = internal
+  const char* unit;
+  uint8_t offset;               // In SensorDataPacket
+  uint8_t size;
+};
+
+#define PACKET_FIELD_SPEC(name, fieldType, scale, section, output, unit) \
+  { #name, FieldType::fieldType, scale, SECTION_##section, output, unit, \
+    offsetof(SensorDataPacket, name), sizeof(SensorDataPacket::name) },
+
+static constexpr PacketFieldSpec PACKET_SCHEMA[] = {
+  PACKET_SCHEMA_FIELDS(PACKET_FIELD_SPEC)
+};
+#undef PACKET_FIELD_SPEC
+
+static constexpr size_t PACKET_FIELD_COUNT = sizeof(PACKET_SCHEMA) / sizeof(PACKET_SCHEMA[0]);
+
+constexpr bool isSignedField(FieldType type) {
+  return type == FieldType::I8 || type == FieldType::I16;
+}
+
+// Fields that repeat unchanged within one device's packets
+constexpr bool isConstantField(FieldType type) {
+  return type == FieldType::MAGIC || type == FieldType::MAC;
+}
+
+// Index of a field in PACKET_SCHEMA by name (compile time)
+constexpr bool sameFieldName(const char* a, const char* b) {
+  return *a == *b && (*a == '\0' || sameFieldName(a + 1, b + 1));
+}
+
+constexpr size_t fieldIndex(const char* name, size_t index = 0) {
+  return index >= PACKET_FIELD_COUNT || sameFieldName(PACKET_SCHEMA[index].name, name)
+           ? index : fieldIndex(name, index + 1);
+}
+
+// ===== WIRE FORMAT (v3) =====
+// Header section + section bitmap (1B) + present sections in table order
+// + CRC-32 (4B). Sections without a FLAGS field are always present; a
+// sensor section whose flags are 0 costs no bytes.
+#define PACKET_MAGIC_V3 0xD3    // High nibble magic 0xD, low nibble version 3
+
+static constexpr size_t PACKET_WIRE_MAX_SIZE = sizeof(SensorDataPacket) + 1 + 4;
+
+// Compile-time recursion over the field table - unrolls to straight-line
+// copies with constant offsets and sizes
+template <size_t I, size_t N = PACKET_FIELD_COUNT>
+struct PacketFieldCodec {
+  typedef PacketFieldCodec<I + 1, N> Next;
+
+  // Bit per section that has a non-zero FLAGS field
+  static uint8_t flaggedSections(const uint8_t* packet) {
+    return (PACKET_SCHEMA[I].type == FieldType::FLAGS && packet[PACKET_SCHEMA[I].offset] != 0
+              ? (uint8_t)(1 << PACKET_SCHEMA[I].section) : (uint8_t)0) |
+           Next::flaggedSections(packet);
+  }
+
+  // Bit per section without a FLAGS field
+  static constexpr uint8_t fixedSections(uint8_t optional = 0) {
+    return Next::fixedSections(optional | (PACKET_SCHEMA[I].type == FieldType::FLAGS
+                                             ? (uint8_t)(1 << PACKET_SCHEMA[I].section) : (uint8_t)0));
+  }
+
+  // Copies the fields of all sections in mask, in table order
+  static size_t encode(const uint8_t* packet, uint8_t mask, uint8_t* out) {
+    size_t length = 0;
+    if (mask & (1 << PACKET_SCHEMA[I].section)) {
+      memcpy(out, packet + PACKET_SCHEMA[I].offset, PACKET_SCHEMA[I].size);
+      length = PACKET_SCHEMA[I].size;
+    }
+    return length + Next::encode(packet, mask, out + length);
+  }
+
+  // Inverse of encode: fills the fields of all sections in mask from in
+  static size_t decode(const uint8_t* in, uint8_t mask, uint8_t* packet) {
+    size_t length = 0;
+    if (mask & (1 << PACKET_SCHEMA[I].section)) {
+      memcpy(packet + PACKET_SCHEMA[I].offset, in, PACKET_SCHEMA[I].size);
+      length = PACKET_SCHEMA[I].size;
+    }
+    return length + Next::decode(in + length, mask, packet);
+  }
+
+  // Bytes the fields of all sections in mask take on the wire
+  static constexpr size_t size(uint8_t mask) {
+    return ((mask & (1 << PACKET_SCHEMA[I].section)) ? PACKET_SCHEMA[I].size : 0) + Next::size(mask);
+  }
+};
+
+template <size_t N>
+struct PacketFieldCodec<N, N> {
+  static uint8_t flaggedSections(const uint8_t*) { return 0; }
+  static constexpr uint8_t fixedSections(uint8_t optional = 0) {
+    return (uint8_t)(((1 << SECTION_COUNT) - 1) & ~optional);
+  }
+  static size_t encode(const uint8_t*, uint8_t, uint8_t*) { return 0; }
+  static size_t decode(const uint8_t*, uint8_t, uint8_t*) { return 0; }
+  static constexpr size_t size(uint8_t) { return 0; }
+};
+
+class PacketEncoder {
+public:
+  // Sections present in this packet (bitmap as sent on the wire)
+  static uint8_t sections(const SensorDataPacket& packet);
+
+  // Writes the v3 wire packet, returns its length (<= PACKET_WIRE_MAX_SIZE)
+  static size_t encode(const SensorDataPacket& packet, uint8_t* out);
+};
+
+// ===== BATCH FRAME (v3) =====
+// N samples in one upload: the first one as v3 wire packet, every following
+// one as its section bitmap plus zigzag-varint deltas of the fields in its
+// present sections (absent sections count as 0). Slowly changing values
+// like pressure, humidity or uptime shrink to a single byte.
+//
+// Magic (1B) + Version (1B) + Count (1B) + First packet (v3)
+// + (Count-1) x (bitmap + deltas) + CRC-32 of the frame (4B)
+// Version 1 carried v1 packets and a XOR checksum, version 2 v2 packets.
+#define BATCH_FRAME_MAGIC 0xB5
+#define BATCH_FRAME_VERSION 3
+
+class BatchFrameEncoder {
+public:
+  // Worst case: every delta needs the full varint length
+  static constexpr size_t maxFrameSize(size_t count) {
+    return 3 + PACKET_WIRE_MAX_SIZE + (count > 0 ? count - 1 : 0) * (1 + maxDeltaSize()) + 4;
+  }
+
+  // Returns the frame length, 0 if count or capacity is invalid or the
+  // packets come from different devices
+  static size_t encode(const SensorDataPacket* packets, size_t count, uint8_t* frame, size_t capacity);
+
+  // Field value in wire units (sign-extended), 0 if its section is absent
+  static int64_t readField(const uint8_t* packet, uint8_t sections, const PacketFieldSpec& field);
+
+private:
+  // n-bit field: delta needs n+1 bits after zigzag, 7 bits per varint byte
+  static constexpr size_t maxVarintSize(size_t fieldSize) {
+    return (fieldSize * 8 + 1 + 6) / 7;
+  }
+  static constexpr size_t maxDeltaSize(size_t index = 0) {
+    return index < PACKET_FIELD_COUNT
+      ? (isConstantField(PACKET_SCHEMA[index].type) ? 0 : maxVarintSize(PACKET_SCHEMA[index].size)) +
+        maxDeltaSize(index + 1)
+      : 0;
+  }
+
+  static size_t writeVarint(uint64_t value, uint8_t* out);
+};
+
+// ===== IMPLEMENTATION =====
+uint8_t PacketEncoder::sections(const SensorDataPacket& packet) {
+  return PacketFieldCodec<0>::fixedSections() |
+         PacketFieldCodec<0>::flaggedSections((const uint8_t*)&packet);
+}
+
+size_t PacketEncoder::encode(const SensorDataPacket& packet, uint8_t* out) {
+  const uint8_t* raw = (const uint8_t*)&packet;
+  uint8_t present = sections(packet);
+
+  // Header first - the bitmap follows it so a decoder knows what comes next
+  size_t length = PacketFieldCodec<0>::encode(raw, 1 << SECTION_HEADER, out);
+  out[length++] = present;
+  length += PacketFieldCodec<0>::encode(raw, present & ~(1 << SECTION_HEADER), out + length);
+
+  uint32_t crc = Crc32::update(0, out, length);
+  memcpy(out + length, &crc, sizeof(crc));
+  return length + sizeof(crc);
+}
+
+size_t BatchFrameEncoder::encode(const SensorDataPacket* packets, size_t count, uint8_t* frame, size_t capacity) {
+  if (count == 0 || count > 255 || capacity < maxFrameSize(count)) {
+    return 0;
+  }
+
+  // Constant fields are taken from the first packet
+  for (size_t i = 1; i < count; i++) {
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      if (isConstantField(field.type) &&
+          memcmp((const uint8_t*)&packets[i] + field.offset,
+                 (const uint8_t*)&packets[0] + field.offset, field.size) != 0) {
+        return 0;
+      }
+    }
+  }
+
+  size_t length = 0;
+  frame[length++] = BATCH_FRAME_MAGIC;
+  frame[length++] = BATCH_FRAME_VERSION;
+  frame[length++] = (uint8_t)count;
+  length += PacketEncoder::encode(packets[0], frame + length);
+
+  uint8_t previousSections = PacketEncoder::sections(packets[0]);
+  for (size_t i = 1; i < count; i++) {
+    const uint8_t* previous = (const uint8_t*)&packets[i - 1];
+    const uint8_t* current = (const uint8_t*)&packets[i];
+    uint8_t currentSections = PacketEncoder::sections(packets[i]);
+    frame[length++] = currentSections;
+
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      if (isConstantField(field.type) || !(currentSections & (1 << field.section))) {
+        continue;
+      }
+      int64_t delta = readField(current, currentSections, field) -
+                      readField(previous, previousSections, field);
+      uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+      length += writeVarint(zigzag, frame + length);
+    }
+    previousSections = currentSections;
+  }
+
+  uint32_t crc = Crc32::update(0, frame, length);
+  memcpy(frame + length, &crc, sizeof(crc));
+  length += sizeof(crc);
+
+  return length;
+}
+
+int64_t BatchFrameEncoder::readField(const uint8_t* packet, uint8_t sections, const PacketFieldSpec& field) {
+  if (!(sections & (1 << field.section))) {
+    return 0;  // Absent on the wire - the decoder sees 0
+  }
+
+  // Little endian like the packet
+  const uint8_t* p = packet + field.offset;
+  bool isSigned = isSignedField(field.type);
+  switch (field.size) {
+    case 1: {
+      uint8_t v = p[0];
+      return isSigned ? (int64_t)(int8_t)v : (int64_t)v;
+    }
+    case 2: {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      return isSigned ? (int64_t)(int16_t)v : (int64_t)v;
+    }
+    default: {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return isSigned ? (int64_t)(int32_t)v : (int64_t)v;
+    }
+  }
+}
+
+size_t BatchFrameEncoder::writeVarint(uint64_t value, uint8_t* out) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+#endif
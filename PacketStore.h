@@ -0,0 +1,362 @@
+#ifndef PACKET_STORE_H
+#define PACKET_STORE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "config.h"
+
+// ===== PACKET STORE =====
+// Persistent FIFO of fixed-size records on LittleFS (store-and-forward backlog).
+//
+// Records are appended to segment files of BACKLOG_SEGMENT_RECORDS entries.
+// LittleFS appends are atomic and O(1), whereas rewriting the middle of a
+// large file copies everything behind it - so there is no single ring file.
+// Uploaded segments are deleted, the oldest one is dropped when the store is
+// full. The read position is kept in a small state file, so after a power cut
+// at most one batch is sent twice and a torn record fails its check byte.
+// The state file also records the record layout; it is written in begin()
+// before anything is appended, and segments it does not describe are dropped.
+#define PACKET_STORE_MAGIC 0x42514B31  // "BQK1"
+
+class PacketStore {
+private:
+  struct StoreState {
+    uint32_t magic;
+    uint16_t recordSize;
+    uint16_t segmentRecords;
+    uint32_t readSegment;
+    uint16_t readIndex;
+  };
+
+  const size_t recordSize;
+  bool ready = false;
+
+  // Segments on flash: firstSegment..lastSegment (empty if last < first)
+  uint32_t firstSegment = 1;
+  uint32_t lastSegment = 0;
+  uint16_t lastCount = 0;         // Records in the last segment
+  bool lastSealed = false;        // Torn append at its end - not appended to
+
+  // Oldest record not yet uploaded
+  uint32_t readSegment = 1;
+  uint16_t readIndex = 0;
+
+  // Position after the last read() - committed by acknowledge()
+  uint32_t peekSegment = 1;
+  uint16_t peekIndex = 0;
+
+  uint32_t droppedRecords = 0;    // Lost because the store was full
+  uint32_t corruptRecords = 0;    // Failed check byte (torn write)
+
+public:
+  PacketStore(size_t size);
+
+  bool begin();
+  bool isReady() const { return ready; }
+
+  bool push(const uint8_t* record);
+  size_t read(uint8_t* records, size_t maxRecords);
+  bool acknowledge();
+
+  size_t pending() const;         // A sealed segment counts as full once it is not the last one
+  uint32_t getDroppedRecords() const { return droppedRecords; }
+  uint32_t getCorruptRecords() const { return corruptRecords; }
+
+private:
+  void segmentPath(uint32_t segment, char* path, size_t length);
+  uint8_t recordCheck(const uint8_t* record);
+  void scanSegments();
+  void loadState();
+  bool saveState();
+  void removeSegment(uint32_t segment);
+  void removeAllSegments();
+};
+
+// ===== IMPLEMENTATION =====
+PacketStore::PacketStore(size_t size) : recordSize(size) {}
+
+bool PacketStore::begin() {
+  // Formats the partition on first use
+  if (!LittleFS.begin(true)) {
+    DEBUG_ERROR("LittleFS mount failed - backlog disabled");
+    return false;
+  }
+
+  if (!LittleFS.exists(BACKLOG_DIR)) {
+    LittleFS.mkdir(BACKLOG_DIR);
+  }
+
+  scanSegments();
+  loadState();
+
+  // Segments before the read position were uploaded but not yet deleted
+  while (firstSegment < readSegment && firstSegment <= lastSegment) {
+    removeSegment(firstSegment);
+    firstSegment++;
+  }
+
+  peekSegment = readSegment;
+  peekIndex = readIndex;
+  ready = true;
+
+  DEBUG_INFO("Backlog ready: %u packets pending (%lu segments)",
+             (unsigned)pending(), (unsigned long)(lastSegment >= firstSegment ? lastSegment - firstSegment + 1 : 0));
+  return true;
+}
+
+void PacketStore::segmentPath(uint32_t segment, char* path, size_t length) {
+  snprintf(path, length, "%s/%08lu.seg", BACKLOG_DIR, (unsigned long)segment);
+}
+
+uint8_t PacketStore::recordCheck(const uint8_t* record) {
+  // Seeded XOR - an all-zero torn record does not validate
+  uint8_t check = 0xA5;
+  for (size_t i = 0; i < recordSize; i++) {
+    check ^= record[i];
+  }
+  return check;
+}
+
+void PacketStore::scanSegments() {
+  File dir = LittleFS.open(BACKLOG_DIR);
+  if (!dir || !dir.isDirectory()) {
+    return;
+  }
+
+  uint32_t first = 0;
+  uint32_t last = 0;
+  size_t lastSize = 0;
+
+  File file = dir.openNextFile();
+  while (file) {
+    const char* name = strrchr(file.name(), '/');
+    name = name != nullptr ? name + 1 : file.name();
+
+    if (strstr(name, ".seg") != nullptr) {
+      uint32_t segment = strtoul(name, nullptr, 10);
+      if (segment > 0) {
+        if (first == 0 || segment < first) first = segment;
+        if (segment > last) {
+          last = segment;
+          lastSize = file.size();
+        }
+      }
+    }
+    file = dir.openNextFile();
+  }
+
+  if (last == 0) {
+    return;  // Empty store
+  }
+
+  firstSegment = first;
+  lastSegment = last;
+
+  size_t stride = recordSize + 1;
+  lastCount = lastSize / stride;
+  // Torn append - never write behind it, start a new segment instead
+  lastSealed = lastSize % stride != 0;
+}
+
+void PacketStore::loadState() {
+  readSegment = firstSegment;
+  readIndex = 0;
+
+  StoreState state;
+  size_t bytes = 0;
+  File file = LittleFS.open(BACKLOG_DIR "/state", "r");
+  if (file) {
+    bytes = file.read((uint8_t*)&state, sizeof(state));
+    file.close();
+  }
+
+  if (bytes != sizeof(state) || state.magic != PACKET_STORE_MAGIC) {
+    // The state is written before the first record, so segments without it
+    // have an unknown layout (older firmware, lost state file)
+    if (lastSegment >= firstSegment) {
+      DEBUG_WARN("Backlog without format record - discarding stored packets");
+      removeAllSegments();
+    }
+    saveState();
+    return;
+  }
+
+  if (state.recordSize != recordSize || state.segmentRecords != BACKLOG_SEGMENT_RECORDS) {
+    // Packet format changed - old records cannot be sent anymore
+    DEBUG_WARN("Backlog format changed - discarding stored packets");
+    removeAllSegments();
+    saveState();
+    return;
+  }
+
+  if (state.readSegment >= firstSegment) {
+    readSegment = state.readSegment;
+    readIndex = state.readIndex;
+  }
+}
+
+bool PacketStore::saveState() {
+  StoreState state = {PACKET_STORE_MAGIC, (uint16_t)recordSize, BACKLOG_SEGMENT_RECORDS,
+                      readSegment, readIndex};
+
+  // LittleFS commits the file on close - old or new state, never half of it
+  File file = LittleFS.open(BACKLOG_DIR "/state", "w");
+  if (!file) {
+    return false;
+  }
+  bool success = file.write((const uint8_t*)&state, sizeof(state)) == sizeof(state);
+  file.close();
+  return success;
+}
+
+void PacketStore::removeSegment(uint32_t segment) {
+  char path[32];
+  segmentPath(segment, path, sizeof(path));
+  LittleFS.remove(path);
+}
+
+void PacketStore::removeAllSegments() {
+  for (uint32_t segment = firstSegment; segment <= lastSegment; segment++) {
+    removeSegment(segment);
+  }
+  firstSegment = 1;
+  lastSegment = 0;
+  lastCount = 0;
+  lastSealed = false;
+  readSegment = 1;
+  readIndex = 0;
+}
+
+size_t PacketStore::pending() const {
+  if (lastSegment < firstSegment || readSegment > lastSegment) {
+    return 0;
+  }
+  if (readSegment == lastSegment) {
+    return lastCount > readIndex ? lastCount - readIndex : 0;
+  }
+  return (BACKLOG_SEGMENT_RECORDS - readIndex) +
+         (size_t)(lastSegment - readSegment - 1) * BACKLOG_SEGMENT_RECORDS +
+         lastCount;
+}
+
+bool PacketStore::push(const uint8_t* record) {
+  if (!ready) {
+    return false;
+  }
+
+  if (lastSegment < firstSegment || lastCount >= BACKLOG_SEGMENT_RECORDS || lastSealed) {
+    // Start a new segment
+    lastSegment++;
+    lastCount = 0;
+    lastSealed = false;
+    if (lastSegment < firstSegment) {
+      firstSegment = lastSegment;
+    }
+
+    // Full - drop the oldest segment
+    while (lastSegment - firstSegment + 1 > BACKLOG_MAX_SEGMENTS) {
+      if (readSegment == firstSegment) {
+        droppedRecords += BACKLOG_SEGMENT_RECORDS - readIndex;
+        readSegment++;
+        readIndex = 0;
+      }
+      removeSegment(firstSegment);
+      firstSegment++;
+      if (peekSegment < readSegment) {
+        peekSegment = readSegment;
+        peekIndex = readIndex;
+      }
+    }
+  }
+
+  char path[32];
+  segmentPath(lastSegment, path, sizeof(path));
+  File file = LittleFS.open(path, "a");
+  if (!file) {
+    DEBUG_ERROR("Backlog write failed: %s", path);
+    return false;
+  }
+
+  uint8_t check = recordCheck(record);
+  bool success = file.write(record, recordSize) == recordSize &&
+                 file.write(&check, 1) == 1;
+  file.close();
+
+  if (!success) {
+    // Partial append - continue in a fresh segment
+    lastSealed = true;
+    return false;
+  }
+
+  lastCount++;
+  return true;
+}
+
+size_t PacketStore::read(uint8_t* records, size_t maxRecords) {
+  size_t count = 0;
+  uint32_t segment = readSegment;
+  uint16_t index = readIndex;
+  size_t stride = recordSize + 1;
+
+  while (ready && count < maxRecords && segment <= lastSegment) {
+    uint16_t segmentCount = segment == lastSegment ? lastCount : BACKLOG_SEGMENT_RECORDS;
+    if (index >= segmentCount) {
+      if (segment == lastSegment) {
+        break;
+      }
+      segment++;
+      index = 0;
+      continue;
+    }
+
+    char path[32];
+    segmentPath(segment, path, sizeof(path));
+    File file = LittleFS.open(path, "r");
+    if (!file || !file.seek(index * stride)) {
+      // Segment lost - skip it
+      corruptRecords += segmentCount - index;
+      index = segmentCount;
+      continue;
+    }
+
+    while (index < segmentCount && count < maxRecords) {
+      uint8_t* record = records + count * recordSize;
+      uint8_t check = 0;
+      size_t bytes = file.read(record, recordSize);
+      if (bytes != recordSize || file.read(&check, 1) != 1) {
+        // Segment ends early: sealed after a torn append, which is the only
+        // record lost here
+        if (bytes > 0) {
+          corruptRecords++;
+        }
+        index = segmentCount;
+        break;
+      }
+      index++;
+
+      if (check == recordCheck(record)) {
+        count++;
+      } else {
+        corruptRecords++;
+      }
+    }
+    file.close();
+  }
+
+  peekSegment = segment;
+  peekIndex = index;
+  return count;
+}
+
+bool PacketStore::acknowledge() {
+  // Everything up to the last read() is uploaded
+  while (firstSegment < peekSegment && firstSegment <= lastSegment) {
+    removeSegment(firstSegment);
+    firstSegment++;
+  }
+  readSegment = peekSegment;
+  readIndex = peekIndex;
+  return saveState();
+}
+
+#endif
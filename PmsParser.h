@@ -0,0 +1,158 @@
+#ifndef PMS_PARSER_H
+#define PMS_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ===== PMS5003 FRAME =====
+// Plantower data frame as received: 0x42 0x4D, frame length (28), 13 data
+// words, checksum - all big endian, the checksum being the sum of the 30
+// bytes before it. The fields are read straight from the received bytes.
+#define PMS_FRAME_SIZE 32
+#define PMS_FRAME_LENGTH 28           // Length field: 13 data words + checksum
+#define PMS_HEADER_1 0x42
+#define PMS_HEADER_2 0x4D
+#define PMS_PARTICLE_BINS 6
+
+enum PmsParticleBin : uint8_t {
+  PMS_BIN_0_3 = 0,   // Particles > 0.3 µm per 0.1 L air
+  PMS_BIN_0_5,       // > 0.5 µm
+  PMS_BIN_1_0,       // > 1.0 µm
+  PMS_BIN_2_5,       // > 2.5 µm
+  PMS_BIN_5_0,       // > 5.0 µm
+  PMS_BIN_10         // > 10 µm
+};
+
+struct PmsFrame {
+  uint8_t bytes[PMS_FRAME_SIZE];
+
+  uint16_t word(size_t index) const { return (uint16_t)(bytes[4 + 2 * index] << 8 | bytes[5 + 2 * index]); }
+
+  // µg/m³, CF=1 (factory calibration particle)
+  uint16_t pm1_0Cf1() const { return word(0); }
+  uint16_t pm2_5Cf1() const { return word(1); }
+  uint16_t pm10Cf1() const { return word(2); }
+
+  // µg/m³, atmospheric environment - the values the device reports
+  uint16_t pm1_0() const { return word(3); }
+  uint16_t pm2_5() const { return word(4); }
+  uint16_t pm10() const { return word(5); }
+
+  uint16_t particles(PmsParticleBin bin) const { return word(6 + bin); }
+
+  uint8_t version() const { return bytes[28]; }
+  uint8_t errorCode() const { return bytes[29]; }
+};
+
+// ===== PARSER STATS =====
+struct PmsParserStats {
+  uint32_t frames = 0;          // Valid frames
+  uint32_t checksumErrors = 0;
+  uint32_t lengthErrors = 0;    // Header with another length: command replies (4) or noise
+  uint32_t skippedBytes = 0;    // Dropped while looking for a header
+};
+
+// ===== PMS5003 PARSER =====
+// Incremental: push() takes the bytes one by one as the UART delivers them,
+// split anywhere, and returns true when a frame is complete and its checksum
+// matches. A wrong length or checksum drops the first header byte only, so
+// a real frame that started inside the rejected bytes (noise with 0x42 0x4D
+// in it, a frame cut off by the sensor) is still found.
+//
+// The bytes are stored straight into one of two frame slots and the
+// consumer reads the fields from there - a frame is never copied. frame()
+// points at the last complete one; the next frame goes into the other
+// slot, so a frame stays valid until the one after it completes.
+class PmsParser {
+public:
+  // True if the byte completed a valid frame
+  bool push(uint8_t byte);
+
+  const PmsFrame* frame() const { return hasFrame ? &slots[ready] : nullptr; }
+
+  // Forgets a partial frame (not frame())
+  void reset() { received = 0; }
+
+  const PmsParserStats& getStats() const { return stats; }
+
+private:
+  PmsFrame slots[2];
+  uint8_t filling = 0;          // Slot being received into
+  uint8_t ready = 0;            // Slot of frame()
+  bool hasFrame = false;
+  size_t received = 0;          // Bytes of the frame in slots[filling]
+  PmsParserStats stats;
+
+  bool plausible() const;
+  bool checksumValid() const;
+  void resync();
+};
+
+// ===== IMPLEMENTATION =====
+inline bool PmsParser::push(uint8_t byte) {
+  uint8_t* bytes = slots[filling].bytes;
+  if (received == 0 && byte != PMS_HEADER_1) {
+    stats.skippedBytes++;
+    return false;
+  }
+  bytes[received++] = byte;
+
+  if (!plausible()) {
+    if (received == 4 && bytes[1] == PMS_HEADER_2) {
+      stats.lengthErrors++;
+    }
+    resync();
+    return false;
+  }
+  if (received < PMS_FRAME_SIZE) {
+    return false;
+  }
+
+  if (!checksumValid()) {
+    stats.checksumErrors++;
+    resync();
+    return false;
+  }
+  stats.frames++;
+  ready = filling;
+  filling ^= 1;
+  hasFrame = true;
+  received = 0;
+  return true;
+}
+
+// Header and length of what has been received so far
+inline bool PmsParser::plausible() const {
+  const uint8_t* bytes = slots[filling].bytes;
+  if (received >= 2 && bytes[1] != PMS_HEADER_2) {
+    return false;
+  }
+  return received < 4 || ((bytes[2] << 8) | bytes[3]) == PMS_FRAME_LENGTH;
+}
+
+inline bool PmsParser::checksumValid() const {
+  const uint8_t* bytes = slots[filling].bytes;
+  uint16_t sum = 0;
+  for (size_t i = 0; i < PMS_FRAME_SIZE - 2; i++) {
+    sum += bytes[i];
+  }
+  return sum == ((bytes[PMS_FRAME_SIZE - 2] << 8) | bytes[PMS_FRAME_SIZE - 1]);
+}
+
+// Drops the rejected header and everything up to the next 0x42 that can
+// still start a frame with the bytes after it
+inline void PmsParser::resync() {
+  uint8_t* bytes = slots[filling].bytes;
+  do {
+    size_t next = 1;
+    while (next < received && bytes[next] != PMS_HEADER_1) {
+      next++;
+    }
+    stats.skippedBytes += next;
+    memmove(bytes, bytes + next, received - next);
+    received -= next;
+  } while (received > 0 && !plausible());
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+typedef uint8_t SchedulerTask;
+typedef void (*SchedulerCallback)(void* context);
+
+#define SCHEDULER_NO_TASK 0xFF
+
+static_assert(SCHEDULER_MAX_TASKS <= 32, "One trigger bit per task");
+
+// ===== SCHEDULER STATS =====
+struct SchedulerStats {
+  uint32_t wakeups = 0;       // Returns from sleep() - deadlines and triggers
+  uint32_t runs = 0;          // Callbacks run
+  uint64_t sleptUs = 0;       // Time spent in sleep()
+  uint64_t sinceUs = 0;       // Start of the stats (esp_timer)
+
+  // Share of the time the driving task slept, in percent
+  uint32_t idlePercent(uint64_t nowUs) const {
+    uint64_t total = nowUs - sinceUs;
+    return total > 0 ? (uint32_t)(sleptUs * 100 / total) : 0;
+  }
+};
+
+// ===== SCHEDULER =====
+// Cooperative deadlines for one task: every component registers its tasks
+// once and then schedules them (at() / in()) for the next point in time it
+// has something to do - BSEC's next call, the end of a DS18B20 conversion,
+// a PMS5003 window, a timeout. runDue() runs the callbacks that are due,
+// in deadline order, and returns the time to the nearest deadline, which
+// sleep() waits for. A binary min-heap of at most SCHEDULER_MAX_TASKS
+// entries, one per task, so rescheduling a task moves it instead of adding
+// a second deadline. Deadlines are millis() values, compared wrap-safe.
+//
+// trigger() runs a task on the next pass from any other FreeRTOS task or
+// from an ISR (triggerFromISR) and wakes sleep() - button presses, WiFi
+// events. Each instance must be driven by exactly one task - loop() runs
+// the main one, the sensor task its own - and only that task touches the
+// heap.
+class Scheduler {
+public:
+  // Call from the task that drives this instance
+  void begin();
+
+  // Registers a task, not scheduled yet; SCHEDULER_NO_TASK if the table is full
+  SchedulerTask add(const char* name, SchedulerCallback callback, void* context);
+
+  void at(SchedulerTask task, uint32_t dueMs);
+  void in(SchedulerTask task, uint32_t delayMs) { at(task, millis() + delayMs); }
+  void cancel(SchedulerTask task);
+  bool isScheduled(SchedulerTask task) const { return task < taskCount && tasks[task].slot != NOT_QUEUED; }
+
+  void trigger(SchedulerTask task);
+  void IRAM_ATTR triggerFromISR(SchedulerTask task);
+
+  // Runs triggered and due tasks; ms until the next deadline, SCHEDULER_MAX_SLEEP if none
+  uint32_t runDue();
+
+  // Blocks the driving task for up to ms, or until a trigger
+  void sleep(uint32_t ms);
+
+  const SchedulerStats& getStats() const { return stats; }
+  const char* nextTaskName() const { return queued > 0 ? tasks[heap[0]].name : "-"; }
+
+private:
+  static const uint8_t NOT_QUEUED = 0xFF;
+
+  struct Task {
+    const char* name;
+    SchedulerCallback callback;
+    void* context;
+    uint32_t dueMs;
+    uint8_t slot;           // Index in heap, NOT_QUEUED if not scheduled
+  };
+
+  Task tasks[SCHEDULER_MAX_TASKS];
+  SchedulerTask heap[SCHEDULER_MAX_TASKS];
+  uint8_t taskCount = 0;
+  uint8_t queued = 0;
+  std::atomic<uint32_t> triggered{0};   // Bit per task
+  TaskHandle_t ownerTask = nullptr;
+  SchedulerStats stats;
+
+  bool earlier(SchedulerTask a, SchedulerTask b) const { return (int32_t)(tasks[a].dueMs - tasks[b].dueMs) < 0; }
+  void place(uint8_t slot, SchedulerTask task);
+  void siftUp(uint8_t slot);
+  void siftDown(uint8_t slot);
+  void remove(uint8_t slot);
+  void run(SchedulerTask task);
+};
+
+// ===== IMPLEMENTATION =====
+void Scheduler::begin() {
+  ownerTask = xTaskGetCurrentTaskHandle();
+  stats.sinceUs = esp_timer_get_time();
+}
+
+SchedulerTask Scheduler::add(const char* name, SchedulerCallback callback, void* context) {
+  if (taskCount >= SCHEDULER_MAX_TASKS) {
+    DEBUG_ERROR("Scheduler full - task %s not registered", name);
+    return SCHEDULER_NO_TASK;
+  }
+  Task& task = tasks[taskCount];
+  task.name = name;
+  task.callback = callback;
+  task.context = context;
+  task.dueMs = 0;
+  task.slot = NOT_QUEUED;
+  return taskCount++;
+}
+
+void Scheduler::at(SchedulerTask task, uint32_t dueMs) {
+  if (task >= taskCount) {
+    return;
+  }
+  uint8_t slot = tasks[task].slot;
+  tasks[task].dueMs = dueMs;
+  if (slot == NOT_QUEUED) {
+    place(queued++, task);
+    siftUp(queued - 1);
+  } else {
+    siftUp(slot);
+    siftDown(tasks[task].slot);
+  }
+}
+
+void Scheduler::cancel(SchedulerTask task) {
+  if (isScheduled(task)) {
+    remove(tasks[task].slot);
+  }
+}
+
+void Scheduler::trigger(SchedulerTask task) {
+  if (task >= SCHEDULER_MAX_TASKS) {
+    return;
+  }
+  triggered.fetch_or(1u << task);
+  if (ownerTask != nullptr) {
+    xTaskNotifyGive(ownerTask);
+  }
+}
+
+void IRAM_ATTR Scheduler::triggerFromISR(SchedulerTask task) {
+  if (task >= SCHEDULER_MAX_TASKS) {
+    return;
+  }
+  triggered.fetch_or(1u << task);
+  if (ownerTask != nullptr) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(ownerTask, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+uint32_t Scheduler::runDue() {
+  uint32_t pending = triggered.exchange(0);
+  for (SchedulerTask task = 0; pending != 0; task++, pending >>= 1) {
+    if (pending & 1) {
+      run(task);
+    }
+  }
+
+  // Each task at most twice per pass - a callback that keeps rescheduling
+  // itself for now cannot starve the others
+  uint32_t now = millis();
+  for (uint8_t budget = 2 * SCHEDULER_MAX_TASKS; queued > 0 && budget > 0; budget--) {
+    SchedulerTask task = heap[0];
+    if ((int32_t)(tasks[task].dueMs - now) > 0) {
+      return tasks[task].dueMs - now;
+    }
+    remove(0);
+    run(task);
+    now = millis();
+  }
+  return queued > 0 ? 0 : SCHEDULER_MAX_SLEEP;
+}
+
+void Scheduler::sleep(uint32_t ms) {
+  if (ms == 0) {
+    return;
+  }
+  if (ms > SCHEDULER_MAX_SLEEP) {
+    ms = SCHEDULER_MAX_SLEEP;
+  }
+  int64_t start = esp_timer_get_time();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));  // Idle task (and light sleep, if enabled) meanwhile
+  stats.sleptUs += esp_timer_get_time() - start;
+  stats.wakeups++;
+}
+
+void Scheduler::run(SchedulerTask task) {
+  if (task < taskCount) {
+    stats.runs++;
+    tasks[task].callback(tasks[task].context);
+  }
+}
+
+void Scheduler::place(uint8_t slot, SchedulerTask task) {
+  heap[slot] = task;
+  tasks[task].slot = slot;
+}
+
+void Scheduler::siftUp(uint8_t slot) {
+  SchedulerTask task = heap[slot];
+  while (slot > 0) {
+    uint8_t parent = (slot - 1) / 2;
+    if (!earlier(task, heap[parent])) {
+      break;
+    }
+    place(slot, heap[parent]);
+    slot = parent;
+  }
+  place(slot, task);
+}
+
+void Scheduler::siftDown(uint8_t slot) {
+  SchedulerTask task = heap[slot];
+  for (;;) {
+    uint8_t child = 2 * slot + 1;
+    if (child >= queued) {
+      break;
+    }
+    if (child + 1 < queued && earlier(heap[child + 1], heap[child])) {
+      child++;
+    }
+    if (!earlier(heap[child], task)) {
+      break;
+    }
+    place(slot, heap[child]);
+    slot = child;
+  }
+  place(slot, task);
+}
+
+void Scheduler::remove(uint8_t slot) {
+  SchedulerTask task = heap[slot];
+  tasks[task].slot = NOT_QUEUED;
+  queued--;
+  if (slot == queued) {
+    return;
+  }
+  SchedulerTask moved = heap[queued];
+  place(slot, moved);
+  siftUp(slot);
+  siftDown(tasks[moved].slot);
+}
+
+#endif
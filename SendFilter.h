@@ -0,0 +1,121 @@
+#ifndef SEND_FILTER_H
+#define SEND_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "PacketSchema.h"
+
+// ===== SEND-ON-CHANGE FILTER =====
+// Decides whether a sample is worth an upload. It is sent when a field moved
+// past its deadband since the last sent packet (not the last sample - slow
+// drifts still arrive once they add up), a sensor came or went, the AQI
+// class changed or SEND_HEARTBEAT_INTERVAL passed without a send. Fields
+// without a band (counters, uptime, gas resistance, RSSI) never trigger.
+// tools/fleet_sim runs one per simulated device.
+struct DeadbandSpec {
+  size_t field;                 // Index in PACKET_SCHEMA
+  uint32_t band;                // Wire units (value * scale); sent if the change exceeds it
+};
+
+constexpr DeadbandSpec deadband(const char* name, double band) {
+  return {fieldIndex(name), (uint32_t)(band * PACKET_SCHEMA[fieldIndex(name)].scale + 0.5)};
+}
+
+// Accuracy levels and flags (calibration bit): every change counts
+static constexpr DeadbandSpec SEND_DEADBANDS[] = {
+  deadband("bme_temperature", DEADBAND_TEMPERATURE),
+  deadband("bme_humidity",    DEADBAND_HUMIDITY),
+  deadband("bme_pressure",    DEADBAND_PRESSURE),
+  deadband("iaq",             DEADBAND_IAQ),
+  deadband("static_iaq",      DEADBAND_IAQ),
+  deadband("co2_equivalent",  DEADBAND_CO2),
+  deadband("breath_voc",      DEADBAND_VOC),
+  deadband("iaq_accuracy",    0),
+  deadband("co2_accuracy",    0),
+  deadband("voc_accuracy",    0),
+  deadband("bme_flags",       0),
+  deadband("ds_temperature",  DEADBAND_TEMPERATURE),
+  deadband("pm1_0",           DEADBAND_PM),
+  deadband("pm2_5",           DEADBAND_PM),
+  deadband("pm10",            DEADBAND_PM)
+};
+static constexpr size_t SEND_DEADBAND_COUNT = sizeof(SEND_DEADBANDS) / sizeof(SEND_DEADBANDS[0]);
+
+constexpr bool deadbandsValid(size_t index = 0) {
+  return index >= SEND_DEADBAND_COUNT ||
+         (SEND_DEADBANDS[index].field < PACKET_FIELD_COUNT && deadbandsValid(index + 1));
+}
+static_assert(deadbandsValid(), "Deadband field not in PACKET_SCHEMA");
+
+class SendFilter {
+public:
+  // True if packet is to be sent. aqiClass is any value that changes with
+  // the displayed AQI class. The reference stays until markSent().
+  bool shouldSend(const SensorDataPacket& packet, uint32_t aqiClass, uint32_t nowMs);
+  // The packet is on its way (queued) - it becomes the new reference. A
+  // sample dropped after shouldSend() is not, so the next one is compared
+  // against the last packet that actually went out.
+  void markSent(const SensorDataPacket& packet, uint32_t aqiClass, uint32_t nowMs);
+
+  // What triggered the last send: a field name, "sensors", "aqi class", "heartbeat" or "first"
+  const char* getReason() const { return reason; }
+  uint32_t getSent() const { return sent; }
+  uint32_t getSuppressed() const { return suppressed; }
+
+private:
+  SensorDataPacket reference;
+  uint8_t referenceSections = 0;
+  uint32_t referenceAqiClass = 0;
+  uint32_t referenceMs = 0;
+  bool hasReference = false;
+  const char* reason = "";
+  uint32_t sent = 0;
+  uint32_t suppressed = 0;
+
+  const char* changedField(const SensorDataPacket& packet, uint8_t sections) const;
+};
+
+// ===== IMPLEMENTATION =====
+bool SendFilter::shouldSend(const SensorDataPacket& packet, uint32_t aqiClass, uint32_t nowMs) {
+  uint8_t sections = PacketEncoder::sections(packet);
+
+  if (!hasReference) {
+    reason = "first";
+  } else if (sections != referenceSections) {
+    reason = "sensors";
+  } else if (aqiClass != referenceAqiClass) {
+    reason = "aqi class";
+  } else if ((reason = changedField(packet, sections)) != nullptr) {
+    // Field name set
+  } else if (nowMs - referenceMs >= SEND_HEARTBEAT_INTERVAL) {
+    reason = "heartbeat";
+  } else {
+    suppressed++;
+    return false;
+  }
+  return true;
+}
+
+void SendFilter::markSent(const SensorDataPacket& packet, uint32_t aqiClass, uint32_t nowMs) {
+  reference = packet;
+  referenceSections = PacketEncoder::sections(packet);
+  referenceAqiClass = aqiClass;
+  referenceMs = nowMs;
+  hasReference = true;
+  sent++;
+}
+
+const char* SendFilter::changedField(const SensorDataPacket& packet, uint8_t sections) const {
+  for (size_t i = 0; i < SEND_DEADBAND_COUNT; i++) {
+    const PacketFieldSpec& field = PACKET_SCHEMA[SEND_DEADBANDS[i].field];
+    int64_t delta = BatchFrameEncoder::readField((const uint8_t*)&packet, sections, field) -
+                    BatchFrameEncoder::readField((const uint8_t*)&reference, sections, field);
+    if ((uint64_t)(delta < 0 ? -delta : delta) > SEND_DEADBANDS[i].band) {
+      return field.name;
+    }
+  }
+  return nullptr;
+}
+
+#endif
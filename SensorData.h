@@ -0,0 +1,103 @@
+#ifndef SENSOR_DATA_H
+#define SENSOR_DATA_H
+
+#include <stdint.h>
+#include <cmath>
+#include <limits>
+#include "PacketSchema.h"
+#include "PmsParser.h"
+
+// ===== SENSOR DATA STRUCTURE =====
+// Latest readings of all sensors. tools/fleet_sim fills it from its sensor
+// model and packs it with packSensorData(), as loop() does.
+struct SensorData {
+  // BME68X/BSEC data
+  float temperature = 0.0;
+  float humidity = 0.0;
+  float pressure = 0.0;
+  float gasResistance = 0.0;
+  float iaq = 0.0;
+  float staticIaq = 0.0;
+  float co2Equivalent = 400.0;
+  float breathVocEquivalent = 0.0;
+  uint8_t iaqAccuracy = 0;
+  uint8_t staticIaqAccuracy = 0;
+  uint8_t co2Accuracy = 0;
+  uint8_t breathVocAccuracy = 0;
+  bool bsecCalibrated = false;
+  bool bme68xAvailable = false;
+  
+  // DS18B20 data
+  float externalTemp = 0.0;
+  bool ds18b20Available = false;
+  
+  // PMS5003 data
+  uint16_t pm1_0 = 0;
+  uint16_t pm2_5 = 0;
+  uint16_t pm10 = 0;
+  uint16_t pm1_0Cf1 = 0;                        // CF=1 (factory calibration) concentrations
+  uint16_t pm2_5Cf1 = 0;
+  uint16_t pm10Cf1 = 0;
+  uint16_t particles[PMS_PARTICLE_BINS] = {};   // Per 0.1 L above 0.3/0.5/1.0/2.5/5.0/10 µm (PmsParticleBin)
+  bool pms5003Available = false;
+};
+
+// ===== PACKET MAPPING =====
+// Reading to the wire unit of PACKET_SCHEMA field I: one single-precision
+// multiply by the schema scale, rounded to nearest and clamped to the
+// field's range. A plain cast truncates (an IAQ of 25.3f became 252) and is
+// undefined for out-of-range values such as a corrected humidity below 0.
+// The half is added with the sign of the value (std::copysign, no branch);
+// unsigned fields add +0.5 only, a negative value clamps to 0 either way.
+template <size_t I>
+inline typename FieldStorage<PACKET_SCHEMA[I].type>::type toWire(float value) {
+  typedef typename FieldStorage<PACKET_SCHEMA[I].type>::type T;
+  static_assert(I < PACKET_FIELD_COUNT, "Field not in PACKET_SCHEMA");
+  float scaled = value * (float)PACKET_SCHEMA[I].scale;
+  scaled += std::numeric_limits<T>::is_signed ? std::copysign(0.5f, scaled) : 0.5f;
+  if (!(scaled > (float)std::numeric_limits<T>::min())) {
+    return std::numeric_limits<T>::min();  // NaN too
+  }
+  if (scaled >= (float)std::numeric_limits<T>::max()) {
+    return std::numeric_limits<T>::max();
+  }
+  return (T)scaled;
+}
+
+// Sensor sections of a packet in the wire units of PACKET_SCHEMA - the one
+// float-to-integer step of a sample; the AQI, the send filter and the
+// uploads all work on its result. Fields of unavailable sensors stay
+// untouched (0 in a fresh packet).
+inline void packSensorData(const SensorData& data, SensorDataPacket& packet) {
+  // BME68X data
+  if (data.bme68xAvailable) {
+    packet.bme_temperature = toWire<fieldIndex("bme_temperature")>(data.temperature);
+    packet.bme_humidity = toWire<fieldIndex("bme_humidity")>(data.humidity);
+    packet.bme_pressure = toWire<fieldIndex("bme_pressure")>(data.pressure);
+    packet.gas_resistance = toWire<fieldIndex("gas_resistance")>(data.gasResistance);
+    packet.iaq = toWire<fieldIndex("iaq")>(data.iaq);
+    packet.static_iaq = toWire<fieldIndex("static_iaq")>(data.staticIaq);
+    packet.co2_equivalent = toWire<fieldIndex("co2_equivalent")>(data.co2Equivalent);
+    packet.breath_voc = toWire<fieldIndex("breath_voc")>(data.breathVocEquivalent);
+    packet.iaq_accuracy = data.iaqAccuracy;
+    packet.co2_accuracy = data.co2Accuracy;
+    packet.voc_accuracy = data.breathVocAccuracy;
+    packet.bme_flags = (data.bme68xAvailable ? 1 : 0) | (data.bsecCalibrated ? 2 : 0);
+  }
+
+  // DS18B20 data
+  if (data.ds18b20Available) {
+    packet.ds_temperature = toWire<fieldIndex("ds_temperature")>(data.externalTemp);
+    packet.ds_flags = 1;  // Available
+  }
+
+  // PMS5003 data
+  if (data.pms5003Available) {
+    packet.pm1_0 = data.pm1_0;
+    packet.pm2_5 = data.pm2_5;
+    packet.pm10 = data.pm10;
+    packet.pms_flags = 1;  // Available
+  }
+}
+
+#endif
@@ -9,63 +9,74 @@
 #include <DallasTemperature.h>
 #include <EEPROM.h>
 #include "config.h"
-
-// ===== SENSOR DATA STRUCTURE =====
-struct SensorData {
-  // BME68X/BSEC data
-  float temperature = 0.0;
-  float humidity = 0.0;
-  float pressure = 0.0;
-  float gasResistance = 0.0;
-  float iaq = 0.0;
-  float staticIaq = 0.0;
-  float co2Equivalent = 400.0;
-  float breathVocEquivalent = 0.0;
-  uint8_t iaqAccuracy = 0;
-  uint8_t staticIaqAccuracy = 0;
-  uint8_t co2Accuracy = 0;
-  uint8_t breathVocAccuracy = 0;
-  bool bsecCalibrated = false;
-  bool bme68xAvailable = false;
-  
-  // DS18B20 data
-  float externalTemp = 0.0;
-  bool ds18b20Available = false;
-  
-  // PMS5003 data
-  uint16_t pm1_0 = 0;
-  uint16_t pm2_5 = 0;
-  uint16_t pm10 = 0;
-  bool pms5003Available = false;
-};
+#include "SensorData.h"
+#include "BootTimeline.h"
+#include "Scheduler.h"
+#include "Mailbox.h"
+#include "PmsParser.h"
 
 // ===== SENSOR STATE MACHINES =====
 enum DS18B20State {
   DS18B20_IDLE,
-  DS18B20_REQUESTED,
-  DS18B20_READING
+  DS18B20_REQUESTED
 };
 
 enum PMS5003State {
   PMS5003_SLEEPING,
   PMS5003_WAKING,
-  PMS5003_READING,
-  PMS5003_RETRY
+  PMS5003_READING
+};
+
+// ===== BSEC TIMING =====
+// How late run() came against the time BSEC asked for (nextCall). BSEC
+// flags larger deviations as BSEC_W_SC_CALL_TIMING_VIOLATION.
+struct BsecTiming {
+  uint32_t calls = 0;         // Calls at a requested time
+  uint32_t lastLateUs = 0;
+  uint32_t maxLateUs = 0;
+  uint64_t totalLateUs = 0;
+  uint32_t violations = 0;    // Timing warnings from BSEC
+
+  uint32_t meanLateUs() const { return calls > 0 ? (uint32_t)(totalLateUs / calls) : 0; }
 };
 
 // ===== SENSOR MANAGER CLASS =====
+// Acquisition runs in its own FreeRTOS task (begin()) above loop()'s
+// priority, with its own Scheduler: each sensor is a task that runs when
+// its next step is due - BSEC at its next-call time, the DS18B20 at the end
+// of the conversion, the PMS5003 at the end of its wake-up and read timeout
+// and whenever its UART received bytes, the BSEC state save every BSEC_STATE_SAVE_INTERVAL. Display and
+// network work cannot delay BSEC; only an I2C transfer of the display in
+// progress is finished first (Wire serializes the bus).
+//
+// Readings are published as a snapshot (Mailbox, seqlock) that any task
+// reads without blocking the sensor task; the update task set with
+// setUpdateTask() is triggered on each new snapshot. After begin() only
+// the sensor task touches the sensors, currentData and the EEPROM.
 class SensorManager {
 private:
   Bsec& bme68x;
-  PMS& pms5003;
-  PMS::DATA pmsData;
+  PMS& pms5003;                           // Commands (wake-up, sleep, read request)
+  HardwareSerial& pmsSerial;              // Frames, parsed by pmsParser
+  PmsParser pmsParser;
 
   OneWire oneWire;
   DallasTemperature ds18b20;
 
-  SensorData currentData;
-  unsigned long lastSensorRead = 0;
-  unsigned long lastStateTime = 0;
+  SensorData currentData;                 // Sensor task only
+  Mailbox<SensorData> snapshot;           // Published copy for the other tasks
+  BsecTiming bsecTiming;
+  Mailbox<BsecTiming> bsecTimingBox;
+  int64_t bsecDueUs = 0;                  // Time BSEC asked for (esp_timer), 0 before the first call
+
+  Scheduler scheduler;                    // Runs in the sensor task
+  TaskHandle_t sensorTask = nullptr;
+  Scheduler* updateScheduler = nullptr;
+  SchedulerTask updateTask = SCHEDULER_NO_TASK;
+  SchedulerTask bsecTask = SCHEDULER_NO_TASK;
+  SchedulerTask ds18Task = SCHEDULER_NO_TASK;
+  SchedulerTask pmsTask = SCHEDULER_NO_TASK;
+  SchedulerTask stateSaveTask = SCHEDULER_NO_TASK;
 
   // Sensor corrections
   float tempCorrection = DEFAULT_TEMP_CORRECTION;
@@ -73,19 +84,26 @@ private:
 
   // Async state machines
   DS18B20State ds18State = DS18B20_IDLE;
-  unsigned long ds18RequestTime = 0;
-  unsigned long lastDS18B20Read = 0;
 
   PMS5003State pmsState = PMS5003_SLEEPING;
-  unsigned long pmsStateTime = 0;
   uint8_t pmsRetryCount = 0;
 
 public:
-  SensorManager(Bsec& bsec, PMS& pms);
+  SensorManager(Bsec& bsec, PMS& pms, HardwareSerial& pmsUart);
   
+  // Starts the sensors found and schedules their first steps
   bool init();
-  bool update();
-  SensorData getData() { return currentData; }
+  // Starts the sensor task; call after init()
+  bool begin();
+
+  // Triggered (from the sensor task) on every new snapshot
+  void setUpdateTask(Scheduler& taskScheduler, SchedulerTask task);
+
+  // Any task, never blocks the sensor task: copies the latest snapshot,
+  // false if none newer than sequence
+  bool readData(SensorData& data, uint32_t& sequence) const { return snapshot.read(data, sequence); }
+  SensorData getData() const;
+  BsecTiming getBsecTiming() const;
   
   void setTempCorrection(float correction) { tempCorrection = correction; }
   void setHumidityCorrection(float correction) { humidityCorrection = correction; }
@@ -100,6 +118,18 @@ private:
   bool readBME68X();
   bool readDS18B20();
   bool readPMS5003();
+  const PmsFrame* receivePMS5003();
+
+  void runBsec();
+  void publish();
+
+  static void sensorTaskEntry(void* self);
+
+  // Scheduler tasks
+  static void onBsec(void* self);
+  static void onDS18B20(void* self);
+  static void onPMS5003(void* self);
+  static void onStateSave(void* self);
 
   bool saveBsecState();
   bool loadBsecState();
@@ -108,11 +138,15 @@ private:
 };
 
 // ===== IMPLEMENTATION =====
-SensorManager::SensorManager(Bsec& bsec, PMS& pms) 
-  : bme68x(bsec), pms5003(pms), oneWire(DS18B20_PIN), ds18b20(&oneWire) {}
+SensorManager::SensorManager(Bsec& bsec, PMS& pms, HardwareSerial& pmsUart)
+  : bme68x(bsec), pms5003(pms), pmsSerial(pmsUart), oneWire(DS18B20_PIN), ds18b20(&oneWire) {}
 
 bool SensorManager::init() {
   DEBUG_INFO("Initializing sensors...");
+  bsecTask = scheduler.add("bsec", onBsec, this);
+  ds18Task = scheduler.add("ds18b20", onDS18B20, this);
+  pmsTask = scheduler.add("pms5003", onPMS5003, this);
+  stateSaveTask = scheduler.add("bsec state", onStateSave, this);
 
   // EEPROM for BSEC state (needs 221 bytes minimum)
   if (!EEPROM.begin(512)) {  // Use 512 bytes to be safe
@@ -133,6 +167,11 @@ bool SensorManager::init() {
 
   if (bmeAddress != 0) {
     success &= initBME68X(bmeAddress);
+    if (currentData.bme68xAvailable) {
+      BootTimeline::mark(BOOT_BSEC);
+      scheduler.in(bsecTask, 0);
+      scheduler.in(stateSaveTask, BSEC_STATE_SAVE_INTERVAL);
+    }
   } else {
     DEBUG_ERROR("BME68X not found");
     currentData.bme68xAvailable = false;
@@ -140,6 +179,9 @@ bool SensorManager::init() {
   
   // Initialize DS18B20
   success &= initDS18B20();
+  if (currentData.ds18b20Available) {
+    scheduler.in(ds18Task, 0);
+  }
   
   // Initialize PMS5003
   success &= initPMS5003();
@@ -148,66 +190,120 @@ bool SensorManager::init() {
   return success;
 }
 
-bool SensorManager::update() {
-  bool dataUpdated = false;
+bool SensorManager::begin() {
+  snapshot.publish(currentData);  // Availability flags before the first reading
+  if (xTaskCreatePinnedToCore(sensorTaskEntry, "sensors", SENSOR_TASK_STACK_SIZE, this,
+                              SENSOR_TASK_PRIORITY, &sensorTask, SENSOR_TASK_CORE) != pdPASS) {
+    DEBUG_ERROR("Sensor task creation failed");
+    return false;
+  }
+  DEBUG_INFO("Sensor task started on core %d", SENSOR_TASK_CORE);
+  return true;
+}
 
-  // Read BME68X - BSEC must be called continuously in every loop
-  if (currentData.bme68xAvailable) {
-    if (bme68x.run()) {
-      // New data available from BSEC
-      dataUpdated |= readBME68X();
-    } else {
-      // Check for errors
-      if (bme68x.bsecStatus != BSEC_OK) {
-        DEBUG_ERROR("BSEC error: %d", bme68x.bsecStatus);
-      }
-      if (bme68x.bme68xStatus != BME68X_OK) {
-        DEBUG_ERROR("BME68X sensor error: %d", bme68x.bme68xStatus);
-      }
-    }
+void SensorManager::setUpdateTask(Scheduler& taskScheduler, SchedulerTask task) {
+  updateScheduler = &taskScheduler;
+  updateTask = task;
+}
+
+SensorData SensorManager::getData() const {
+  SensorData data;
+  uint32_t sequence = 0;
+  snapshot.read(data, sequence);
+  return data;
+}
+
+BsecTiming SensorManager::getBsecTiming() const {
+  BsecTiming timing;
+  uint32_t sequence = 0;
+  bsecTimingBox.read(timing, sequence);
+  return timing;
+}
+
+void SensorManager::sensorTaskEntry(void* self) {
+  Scheduler& scheduler = static_cast<SensorManager*>(self)->scheduler;
+  scheduler.begin();
+  for (;;) {
+    scheduler.sleep(scheduler.runDue());
   }
+}
 
-  // Read DS18B20 asynchronously (every 10 seconds)
-  if (currentData.ds18b20Available) {
-    if (ds18State == DS18B20_IDLE && (millis() - lastDS18B20Read > 10000)) {
-      // Start new read cycle
-      readDS18B20();  // Starts the state machine
-    } else {
-      // Continue state machine
-      if (readDS18B20()) {
-        dataUpdated = true;
-        lastDS18B20Read = millis();
-      }
-    }
+void SensorManager::publish() {
+  snapshot.publish(currentData);
+  if (updateScheduler != nullptr) {
+    updateScheduler->trigger(updateTask);
   }
+}
 
-  // Read PMS5003 asynchronously (every SENSOR_READ_INTERVAL)
-  if (currentData.pms5003Available) {
-    if (pmsState == PMS5003_SLEEPING && (millis() - lastSensorRead >= SENSOR_READ_INTERVAL)) {
-      // Start new read cycle
-      readPMS5003();  // Starts the state machine
-    } else {
-      // Continue state machine
-      if (readPMS5003()) {
-        dataUpdated = true;
-      }
-    }
+void SensorManager::onBsec(void* self) {
+  static_cast<SensorManager*>(self)->runBsec();
+}
+
+void SensorManager::onDS18B20(void* self) {
+  SensorManager* manager = static_cast<SensorManager*>(self);
+  if (manager->readDS18B20()) {
+    manager->publish();
   }
+}
 
-  // Save BSEC state every 6h
-  if (currentData.bme68xAvailable && (millis() - lastStateTime > BSEC_STATE_SAVE_INTERVAL)) {
-    if (saveBsecState()) {
-      lastStateTime = millis();
-    } else {
-      DEBUG_WARN("BSEC state save failed - will retry in next interval");
+void SensorManager::onPMS5003(void* self) {
+  SensorManager* manager = static_cast<SensorManager*>(self);
+  if (manager->readPMS5003()) {
+    manager->publish();
+  }
+}
+
+void SensorManager::onStateSave(void* self) {
+  SensorManager* manager = static_cast<SensorManager*>(self);
+  if (manager->saveBsecState()) {
+    manager->scheduler.in(manager->stateSaveTask, BSEC_STATE_SAVE_INTERVAL);
+  } else {
+    DEBUG_WARN("BSEC state save failed - retry in %lu min", (unsigned long)(BSEC_STATE_RETRY_INTERVAL / 60000));
+    manager->scheduler.in(manager->stateSaveTask, BSEC_STATE_RETRY_INTERVAL);
+  }
+}
+
+// BSEC has to be called at the time it asks for (nextCall), not later
+void SensorManager::runBsec() {
+  if (bsecDueUs > 0) {
+    int64_t late = esp_timer_get_time() - bsecDueUs;
+    bsecTiming.lastLateUs = late > 0 ? (uint32_t)late : 0;
+    if (bsecTiming.lastLateUs > bsecTiming.maxLateUs) {
+      bsecTiming.maxLateUs = bsecTiming.lastLateUs;
     }
+    bsecTiming.totalLateUs += bsecTiming.lastLateUs;
+    bsecTiming.calls++;
   }
 
-  if (dataUpdated) {
-    lastSensorRead = millis();
+  bool newData = bme68x.run();
+  if (bme68x.bsecStatus == BSEC_W_SC_CALL_TIMING_VIOLATION) {
+    bsecTiming.violations++;  // A warning - run() goes on
+  }
+  if (newData) {
+    // New data available from BSEC
+    if (readBME68X()) {
+      publish();
+    }
+  } else {
+    // Check for errors
+    if (bme68x.bsecStatus != BSEC_OK && bme68x.bsecStatus != BSEC_W_SC_CALL_TIMING_VIOLATION) {
+      DEBUG_ERROR("BSEC error: %d", bme68x.bsecStatus);
+    }
+    if (bme68x.bme68xStatus != BME68X_OK) {
+      DEBUG_ERROR("BME68X sensor error: %d", bme68x.bme68xStatus);
+    }
   }
 
-  return dataUpdated;
+  // nextCall is on BSEC's 64-bit millis() clock; the low 32 bits are millis()
+  uint32_t next = (uint32_t)bme68x.nextCall;
+  if ((int32_t)(next - millis()) < BSEC_MIN_CALL_SPACING) {
+    next = millis() + BSEC_MIN_CALL_SPACING;  // After an error nextCall may not move on
+    bsecDueUs = 0;                            // Not a time BSEC asked for
+  } else {
+    bsecDueUs = bme68x.nextCall * 1000;       // millis() and esp_timer share their origin
+  }
+  scheduler.at(bsecTask, next);
+  bsecTimingBox.publish(bsecTiming);
 }
 
 bool SensorManager::scanI2CDevice(uint8_t address) {
@@ -318,6 +414,9 @@ bool SensorManager::initDS18B20() {
     }
     
     ds18b20.setResolution(12);
+    // requestTemperatures() returns at once; the conversion (750 ms at
+    // 12 bit) must not hold up BSEC in the sensor task
+    ds18b20.setWaitForConversion(false);
     currentData.ds18b20Available = true;
     DEBUG_INFO("DS18B20 found %d device(s)", deviceCount);
     return true;
@@ -333,10 +432,14 @@ bool SensorManager::initPMS5003() {
   DEBUG_INFO("Initializing PMS5003...");
   
   try {
+    // Fan spin-up runs in the state machine: first reading after the wake-up time
+    // Received bytes run the task at once (UART event task, not an ISR)
+    pmsSerial.onReceive([this]() { scheduler.trigger(pmsTask); });
     pms5003.passiveMode();
-    pms5003.wakeUp(); 
-    delay(1000);
-    
+    pms5003.wakeUp();
+    pmsState = PMS5003_WAKING;
+    scheduler.in(pmsTask, PMS_WAKE_TIME);
+
     currentData.pms5003Available = true;
     DEBUG_INFO("PMS5003 initialized successfully");
     return true;
@@ -355,7 +458,7 @@ bool SensorManager::readBME68X() {
   // Compensated values from BSEC
   currentData.temperature = bme68x.temperature + tempCorrection;
   currentData.humidity = bme68x.humidity + humidityCorrection;
-  currentData.pressure = bme68x.pressure / 100.0; // hPa
+  currentData.pressure = bme68x.pressure / 100.0f; // hPa
   currentData.gasResistance = bme68x.gasResistance;
 
   // BSEC gas algorithm outputs
@@ -382,27 +485,23 @@ bool SensorManager::readBME68X() {
   return true;
 }
 
+// Runs when due: starts a conversion, reads it DS18B20_CONVERSION_TIME later.
+// Needs the async mode set in initDS18B20() - with the library default,
+// requestTemperatures() itself waits for the conversion.
 bool SensorManager::readDS18B20() {
-  // Non-blocking state machine for DS18B20
   switch (ds18State) {
     case DS18B20_IDLE:
-      // Start temperature conversion
+      // Start temperature conversion, returns without waiting for it
       ds18b20.requestTemperatures();
-      ds18RequestTime = millis();
       ds18State = DS18B20_REQUESTED;
+      scheduler.in(ds18Task, DS18B20_CONVERSION_TIME);
       return false;
 
-    case DS18B20_REQUESTED:
-      // Wait for 750ms conversion time
-      if (millis() - ds18RequestTime >= 750) {
-        ds18State = DS18B20_READING;
-      }
-      return false;
-
-    case DS18B20_READING:
+    case DS18B20_REQUESTED: {
       // Read temperature
       float temp = ds18b20.getTempCByIndex(0);
       ds18State = DS18B20_IDLE;
+      scheduler.in(ds18Task, DS18B20_READ_INTERVAL);
 
       if (temp == DEVICE_DISCONNECTED_C) {
         DEBUG_WARN("DS18B20 read failed");
@@ -411,67 +510,100 @@ bool SensorManager::readDS18B20() {
 
       currentData.externalTemp = temp;
       return true;
+    }
   }
   return false;
 }
 
+// Runs at its deadlines (end of the wake-up, read timeout) and whenever the
+// UART received bytes: wake-up, read request, frame, sleep until the next cycle
 bool SensorManager::readPMS5003() {
-  // Non-blocking state machine for PMS5003
+  bool atDeadline = !scheduler.isScheduled(pmsTask);  // A UART trigger leaves the deadline queued
+  const PmsFrame* frame = receivePMS5003();
+
   switch (pmsState) {
     case PMS5003_SLEEPING:
+      if (!atDeadline) {
+        return false;  // Reply to the sleep command
+      }
       // Wake up sensor
       pms5003.wakeUp();
-      pmsStateTime = millis();
       pmsRetryCount = 0;
       pmsState = PMS5003_WAKING;
+      scheduler.in(pmsTask, PMS_WAKE_TIME);
       return false;
 
     case PMS5003_WAKING:
-      // Wait for 2000ms wake up time
-      if (millis() - pmsStateTime >= 2000) {
-        pms5003.requestRead();
-        pmsStateTime = millis();
-        pmsState = PMS5003_READING;
+      if (!atDeadline) {
+        return false;
       }
+      // Fan is up: ask for a frame
+      pmsParser.reset();
+      pms5003.requestRead();
+      pmsState = PMS5003_READING;
+      scheduler.in(pmsTask, PMS_READ_TIMEOUT);
       return false;
 
     case PMS5003_READING:
-      // Try to read data with 1000ms timeout
-      if (pms5003.readUntil(pmsData, 50)) {  // Non-blocking check
-        currentData.pm1_0 = pmsData.PM_AE_UG_1_0;
-        currentData.pm2_5 = pmsData.PM_AE_UG_2_5;
-        currentData.pm10 = pmsData.PM_AE_UG_10_0;
+      if (frame != nullptr) {
+        currentData.pm1_0 = frame->pm1_0();
+        currentData.pm2_5 = frame->pm2_5();
+        currentData.pm10 = frame->pm10();
+        currentData.pm1_0Cf1 = frame->pm1_0Cf1();
+        currentData.pm2_5Cf1 = frame->pm2_5Cf1();
+        currentData.pm10Cf1 = frame->pm10Cf1();
+        for (uint8_t bin = 0; bin < PMS_PARTICLE_BINS; bin++) {
+          currentData.particles[bin] = frame->particles((PmsParticleBin)bin);
+        }
         pms5003.sleep();
         pmsState = PMS5003_SLEEPING;
+        scheduler.in(pmsTask, SENSOR_READ_INTERVAL);
         return true;
       }
-
-      // Check timeout
-      if (millis() - pmsStateTime >= 1000) {
-        pmsRetryCount++;
-        if (pmsRetryCount >= 2) {
-          // Failed after 2 attempts
-          DEBUG_WARN("PMS5003 read failed after %d attempts", pmsRetryCount);
-          pms5003.sleep();
-          pmsState = PMS5003_SLEEPING;
-          return false;
-        } else {
-          // Retry
-          pms5003.requestRead();
-          pmsStateTime = millis();
-          pmsState = PMS5003_READING;
-        }
+      if (!atDeadline) {
+        return false;  // Rest of the frame still to come
       }
-      return false;
 
-    case PMS5003_RETRY:
-      // This state is not used anymore, merged into READING
-      pmsState = PMS5003_SLEEPING;
+      // Timeout
+      pmsRetryCount++;
+      if (pmsRetryCount >= 2) {
+        // Failed after 2 attempts
+        const PmsParserStats& stats = pmsParser.getStats();
+        DEBUG_WARN("PMS5003 read failed after %d attempts (%lu checksum errors, %lu bytes skipped)",
+                   pmsRetryCount, (unsigned long)stats.checksumErrors, (unsigned long)stats.skippedBytes);
+        pms5003.sleep();
+        pmsState = PMS5003_SLEEPING;
+        scheduler.in(pmsTask, SENSOR_READ_INTERVAL);
+        return false;
+      }
+      // Retry
+      pms5003.requestRead();
+      scheduler.in(pmsTask, PMS_READ_TIMEOUT);
       return false;
   }
   return false;
 }
 
+// Feeds what the UART received to the parser; the last frame completed by
+// it, read in place, or nullptr
+const PmsFrame* SensorManager::receivePMS5003() {
+  const PmsFrame* frame = nullptr;
+  uint8_t chunk[PMS_FRAME_SIZE];
+  int available;
+  while ((available = pmsSerial.available()) > 0) {
+    size_t length = pmsSerial.read(chunk, available < (int)sizeof(chunk) ? (size_t)available : sizeof(chunk));
+    if (length == 0) {
+      break;
+    }
+    for (size_t i = 0; i < length; i++) {
+      if (pmsParser.push(chunk[i])) {
+        frame = pmsParser.frame();
+      }
+    }
+  }
+  return frame;
+}
+
 bool SensorManager::saveBsecState() {
   if (!currentData.bme68xAvailable || !currentData.bsecCalibrated) {
     return false;
@@ -0,0 +1,418 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/net_sockets.h>
+#include "config.h"
+#include "secrets.h"
+
+// ===== TLS CLIENT STATISTICS =====
+struct TlsClientStats {
+  uint32_t fullHandshakes = 0;     // Certificate exchange + key agreement
+  uint32_t resumedHandshakes = 0;  // Abbreviated handshake from the cached session
+  uint32_t failures = 0;           // Failed handshakes
+  uint32_t lastHandshakeMs = 0;
+  uint64_t totalFullMs = 0;
+  uint64_t totalResumedMs = 0;
+
+  uint32_t averageFullMs() const {
+    return fullHandshakes > 0 ? (uint32_t)(totalFullMs / fullHandshakes) : 0;
+  }
+  uint32_t averageResumedMs() const {
+    return resumedHandshakes > 0 ? (uint32_t)(totalResumedMs / resumedHandshakes) : 0;
+  }
+};
+
+// ===== TLS CLIENT CLASS =====
+// WiFiClient with optional TLS (mbedtls) on top of its own TCP socket, so
+// HTTPClient and MqttConnection use it like a plain client. The session of
+// the last handshake (session ID or ticket, whatever the server offers) is
+// kept across stop()/connect(): a reconnect resumes it with one round trip
+// and without certificate verification or key agreement on the ESP32.
+// With setSecure(false) every call goes straight to WiFiClient.
+class TlsClient : public WiFiClient {
+private:
+  // RNG and trust anchor, shared by all connections
+  struct TlsContext {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt caCert;
+    mbedtls_ssl_config config;
+    bool ready = false;
+    bool verifyServer = false;
+  };
+
+  bool secure = false;
+  const char* serverName = "";
+
+  mbedtls_ssl_context ssl;
+  bool sslActive = false;
+  bool peerClosed = false;
+  uint16_t ioTimeoutMs = 5000;
+  int peeked = -1;
+
+  mbedtls_ssl_session session;
+  bool sessionCached = false;
+  bool certificateChecked = false;  // Set by the verify callback - full handshake only
+  TlsClientStats stats;
+
+public:
+  TlsClient();
+  ~TlsClient();
+
+  void setSecure(bool enabled) { secure = enabled; }
+  void setServerName(const char* name) { serverName = name; }  // SNI and certificate check
+  bool isSecure() const { return secure; }
+  void clearSession();
+  const TlsClientStats& getStats() const { return stats; }
+
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+private:
+  static TlsContext& context();
+  static bool initContext();
+  bool handshake(int32_t timeoutMs);
+  void closeSsl();
+  static int sendCallback(void* self, const unsigned char* buf, size_t length);
+  static int receiveCallback(void* self, unsigned char* buf, size_t length);
+  static int verifyCallback(void* self, mbedtls_x509_crt* crt, int depth, uint32_t* flags);
+};
+
+// ===== IMPLEMENTATION =====
+TlsClient::TlsClient() {
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_session_init(&session);
+}
+
+TlsClient::~TlsClient() {
+  closeSsl();
+  mbedtls_ssl_session_free(&session);
+}
+
+TlsClient::TlsContext& TlsClient::context() {
+  static TlsContext shared;
+  return shared;
+}
+
+bool TlsClient::initContext() {
+  TlsContext& ctx = context();
+  if (ctx.ready) {
+    return true;
+  }
+
+  mbedtls_entropy_init(&ctx.entropy);
+  mbedtls_ctr_drbg_init(&ctx.drbg);
+  mbedtls_x509_crt_init(&ctx.caCert);
+  mbedtls_ssl_config_init(&ctx.config);
+
+  int ret = mbedtls_ctr_drbg_seed(&ctx.drbg, mbedtls_entropy_func, &ctx.entropy, nullptr, 0);
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&ctx.config, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret != 0) {
+    DEBUG_ERROR("TLS setup failed (-0x%04X)", (unsigned)-ret);
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&ctx.config, mbedtls_ctr_drbg_random, &ctx.drbg);
+
+  // PEM length includes the terminating zero
+  const char* caPem = TLS_CA_CERT;
+  ctx.verifyServer = caPem[0] != '\0' &&
+                     mbedtls_x509_crt_parse(&ctx.caCert, (const unsigned char*)caPem, strlen(caPem) + 1) == 0;
+  if (ctx.verifyServer) {
+    mbedtls_ssl_conf_ca_chain(&ctx.config, &ctx.caCert, nullptr);
+    mbedtls_ssl_conf_authmode(&ctx.config, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else {
+    // Still encrypted, but any server certificate is accepted
+    DEBUG_WARN("TLS without CA certificate - server identity is not verified");
+    mbedtls_ssl_conf_authmode(&ctx.config, MBEDTLS_SSL_VERIFY_OPTIONAL);
+  }
+
+  ctx.ready = true;
+  return true;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  if (!secure) {
+    return WiFiClient::connect(ip, port, timeoutMs);
+  }
+
+  closeSsl();
+  if (!initContext() || !WiFiClient::connect(ip, port, timeoutMs)) {
+    return 0;
+  }
+  if (!handshake(timeoutMs)) {
+    closeSsl();
+    WiFiClient::stop();
+    return 0;
+  }
+  return 1;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, ioTimeoutMs);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return 0;
+  }
+  return connect(ip, port, ioTimeoutMs);
+}
+
+bool TlsClient::handshake(int32_t timeoutMs) {
+  TlsContext& ctx = context();
+  ioTimeoutMs = (uint16_t)timeoutMs;
+  peerClosed = false;
+  peeked = -1;
+
+  int ret = mbedtls_ssl_setup(&ssl, &ctx.config);
+  if (ret == 0 && serverName[0] != '\0') {
+    ret = mbedtls_ssl_set_hostname(&ssl, serverName);
+  }
+  if (ret != 0) {
+    DEBUG_ERROR("TLS session setup failed (-0x%04X)", (unsigned)-ret);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_init(&ssl);
+    return false;
+  }
+  sslActive = true;
+  mbedtls_ssl_set_verify(&ssl, verifyCallback, this);
+  mbedtls_ssl_set_bio(&ssl, this, sendCallback, receiveCallback, nullptr);
+
+  // The server decides: cached session accepted = abbreviated handshake
+  if (sessionCached && mbedtls_ssl_set_session(&ssl, &session) != 0) {
+    clearSession();
+  }
+
+  certificateChecked = false;
+  unsigned long handshakeStart = millis();
+  while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      break;
+    }
+    if (millis() - handshakeStart >= (unsigned long)timeoutMs) {
+      ret = MBEDTLS_ERR_SSL_TIMEOUT;
+      break;
+    }
+    vTaskDelay(1);
+  }
+  uint32_t duration = millis() - handshakeStart;
+
+  if (ret != 0) {
+    stats.failures++;
+    DEBUG_ERROR("TLS handshake with %s failed (-0x%04X, verify flags 0x%X)",
+                serverName, (unsigned)-ret, (unsigned)mbedtls_ssl_get_verify_result(&ssl));
+    clearSession();  // Never retry with a session the server choked on
+    return false;
+  }
+
+  // Only a full handshake sends the server certificate through verification
+  bool resumed = sessionCached && !certificateChecked;
+  stats.lastHandshakeMs = duration;
+  if (resumed) {
+    stats.resumedHandshakes++;
+    stats.totalResumedMs += duration;
+  } else {
+    stats.fullHandshakes++;
+    stats.totalFullMs += duration;
+  }
+  DEBUG_INFO("TLS %s with %s: %s, %s, %lu ms", resumed ? "session resumed" : "full handshake",
+             serverName, mbedtls_ssl_get_version(&ssl), mbedtls_ssl_get_ciphersuite(&ssl),
+             (unsigned long)duration);
+
+  // Keep the (possibly new) session or ticket for the next reconnect
+  mbedtls_ssl_session_free(&session);
+  mbedtls_ssl_session_init(&session);
+  sessionCached = mbedtls_ssl_get_session(&ssl, &session) == 0;
+  return true;
+}
+
+void TlsClient::clearSession() {
+  mbedtls_ssl_session_free(&session);
+  mbedtls_ssl_session_init(&session);
+  sessionCached = false;
+}
+
+void TlsClient::closeSsl() {
+  if (!sslActive) {
+    return;
+  }
+  // Frees the record buffers; the cached session stays
+  mbedtls_ssl_free(&ssl);
+  mbedtls_ssl_init(&ssl);
+  sslActive = false;
+  peeked = -1;
+}
+
+int TlsClient::sendCallback(void* self, const unsigned char* buf, size_t length) {
+  TlsClient* client = static_cast<TlsClient*>(self);
+  if (!client->WiFiClient::connected()) {
+    return MBEDTLS_ERR_NET_CONN_RESET;
+  }
+  size_t written = client->WiFiClient::write(buf, length);
+  return written > 0 ? (int)written : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int TlsClient::receiveCallback(void* self, unsigned char* buf, size_t length) {
+  TlsClient* client = static_cast<TlsClient*>(self);
+  if (client->WiFiClient::available() <= 0) {
+    return client->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+  }
+  int count = client->WiFiClient::read(buf, length);
+  return count > 0 ? count : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+int TlsClient::verifyCallback(void* self, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+  (void)crt;
+  (void)depth;
+  (void)flags;
+  static_cast<TlsClient*>(self)->certificateChecked = true;
+  return 0;  // Result stays in flags, the authmode decides
+}
+
+size_t TlsClient::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  if (!secure) {
+    return WiFiClient::write(buf, size);
+  }
+  if (!sslActive || peerClosed) {
+    return 0;
+  }
+
+  size_t sent = 0;
+  unsigned long writeStart = millis();
+  while (sent < size) {
+    int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+    if (ret > 0) {
+      sent += ret;
+    } else if (ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) {
+      DEBUG_WARN("TLS write failed (-0x%04X)", (unsigned)-ret);
+      peerClosed = true;
+      break;
+    } else if (millis() - writeStart >= ioTimeoutMs) {
+      break;
+    } else {
+      vTaskDelay(1);
+    }
+  }
+  return sent;
+}
+
+int TlsClient::available() {
+  if (!secure) {
+    return WiFiClient::available();
+  }
+  if (!sslActive) {
+    return 0;
+  }
+
+  int pending = (int)mbedtls_ssl_get_bytes_avail(&ssl);
+  if (pending == 0 && !peerClosed && WiFiClient::available() > 0) {
+    // Decrypt the next record without consuming application data
+    int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      peerClosed = true;  // close_notify or broken record
+    }
+    pending = (int)mbedtls_ssl_get_bytes_avail(&ssl);
+  }
+  return pending + (peeked >= 0 ? 1 : 0);
+}
+
+int TlsClient::read() {
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  if (!secure) {
+    return WiFiClient::read(buf, size);
+  }
+  if (!sslActive || size == 0) {
+    return -1;
+  }
+
+  size_t offset = 0;
+  if (peeked >= 0) {
+    buf[offset++] = (uint8_t)peeked;
+    peeked = -1;
+    if (offset == size) {
+      return 1;
+    }
+  }
+  if (peerClosed) {
+    return offset > 0 ? (int)offset : -1;
+  }
+
+  int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+  if (ret > 0) {
+    return (int)offset + ret;
+  }
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    peerClosed = true;  // 0 or PEER_CLOSE_NOTIFY: orderly close
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+int TlsClient::peek() {
+  if (!secure) {
+    return WiFiClient::peek();
+  }
+  if (peeked < 0) {
+    uint8_t data;
+    if (read(&data, 1) == 1) {
+      peeked = data;
+    }
+  }
+  return peeked;
+}
+
+void TlsClient::flush() {
+  if (!secure) {
+    WiFiClient::flush();
+  }
+  // Records are written immediately - nothing buffered on the TLS side
+}
+
+void TlsClient::stop() {
+  if (sslActive && !peerClosed && WiFiClient::connected()) {
+    mbedtls_ssl_close_notify(&ssl);  // Best effort; a lost alert does not invalidate the session
+  }
+  closeSsl();
+  WiFiClient::stop();
+}
+
+uint8_t TlsClient::connected() {
+  if (!secure) {
+    return WiFiClient::connected();
+  }
+  if (!sslActive) {
+    return 0;
+  }
+  // Decrypted data may still be waiting after the server closed
+  return (!peerClosed && WiFiClient::connected()) || available() > 0;
+}
+
+#endif
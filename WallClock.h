@@ -0,0 +1,119 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include "config.h"
+#include "Mailbox.h"
+#include "ClockMapping.h"
+#include "PacketSchema.h"
+#include "BootTimeline.h"
+
+// ===== WALL CLOCK =====
+// UTC timestamps for packets. The lwIP SNTP client polls TIME_NTP_SERVER
+// every TIME_SYNC_INTERVAL; each result becomes a sync point of the
+// ClockMapping (SNTP callback, tcpip task), which is published through a
+// Mailbox - stamping a packet from loop() or the network task is a seqlock
+// read, and the mapping runs on esp_timer, never on the settable system
+// clock. One instance (the callback has no context pointer).
+class WallClock {
+public:
+  // Starts SNTP - again after every WiFi connect, configTime() restarts the client
+  void begin();
+
+  // Time section from the uptime the sample was taken at; without a sync the
+  // packet keeps its uptime timestamp and no time section
+  void stamp(SensorDataPacket& packet, int64_t uptimeUs) const;
+
+  // Time section for a packet of boot bootCount taken before the first sync,
+  // from its uptime_seconds (quality ESTIMATED, +-0.5 s). True if the packet
+  // has a time section afterwards.
+  bool stampLate(SensorDataPacket& packet, uint16_t bootCount) const;
+
+  bool isSynced() const;
+
+  // Current UTC in whole seconds; 0 before the first sync
+  uint32_t utcSeconds() const;
+
+private:
+  static WallClock* instance;
+
+  ClockMapping mapping;               // SNTP callback only
+  Mailbox<ClockMapping> published;
+
+  ClockMapping current() const;
+  static void setTime(SensorDataPacket& packet, int64_t utcUs, TimeQuality quality);
+  static void onSync(struct timeval* tv);
+};
+
+// ===== IMPLEMENTATION =====
+WallClock* WallClock::instance = nullptr;
+
+void WallClock::begin() {
+  instance = this;
+  sntp_set_time_sync_notification_cb(onSync);
+  sntp_set_sync_interval(TIME_SYNC_INTERVAL);
+  configTime(0, 0, TIME_NTP_SERVER);  // UTC; SNTP syncs in the background
+}
+
+void WallClock::onSync(struct timeval* tv) {
+  // Reported right after the reply was applied - esp_timer now is the matching uptime
+  int64_t uptimeUs = esp_timer_get_time();
+  WallClock* clock = instance;
+  if (clock == nullptr) {
+    return;
+  }
+  clock->mapping.addSync(uptimeUs, (int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+  clock->published.publish(clock->mapping);
+  BootTimeline::mark(BOOT_TIME_SYNC);
+
+  // Integers only - this runs on the small tcpip task stack
+  DEBUG_INFO("SNTP sync %lu: error %ld ms, drift %ld ppb, %lu steps",
+             (unsigned long)clock->mapping.getSyncs(), (long)(clock->mapping.getLastErrorUs() / 1000),
+             (long)(clock->mapping.getDriftPpm() * 1000), (unsigned long)clock->mapping.getSteps());
+}
+
+ClockMapping WallClock::current() const {
+  ClockMapping value;
+  uint32_t unused = 0;
+  published.read(value, unused);
+  return value;
+}
+
+bool WallClock::isSynced() const {
+  return current().isSynced();
+}
+
+uint32_t WallClock::utcSeconds() const {
+  ClockMapping value = current();
+  return value.isSynced() ? (uint32_t)(value.toUtc(esp_timer_get_time()) / 1000000) : 0;
+}
+
+void WallClock::stamp(SensorDataPacket& packet, int64_t uptimeUs) const {
+  ClockMapping value = current();
+  if (value.isSynced()) {
+    setTime(packet, value.toUtc(uptimeUs), value.quality(uptimeUs, (int64_t)TIME_SYNC_STALE * 1000));
+  }
+}
+
+bool WallClock::stampLate(SensorDataPacket& packet, uint16_t bootCount) const {
+  if (packet.time_quality != TIME_QUALITY_NONE) {
+    return true;
+  }
+  ClockMapping value = current();
+  if (!value.isSynced() || packet.boot_count != bootCount) {
+    return false;  // Uptime of an earlier boot cannot be mapped
+  }
+  setTime(packet, value.toUtc((int64_t)packet.uptime_seconds * 1000000 + 500000), TIME_QUALITY_ESTIMATED);
+  return true;
+}
+
+void WallClock::setTime(SensorDataPacket& packet, int64_t utcUs, TimeQuality quality) {
+  int64_t utcMs = utcUs / 1000;
+  packet.timestamp = (uint32_t)(utcMs / 1000);
+  packet.time_ms = (uint16_t)(utcMs % 1000);
+  packet.time_quality = quality;
+}
+
+#endif
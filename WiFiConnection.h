@@ -0,0 +1,466 @@
+#ifndef WIFI_CONNECTION_H
+#define WIFI_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <atomic>
+#include <string.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/dhcp.h>
+#include <lwip/etharp.h>
+#include <lwip/tcpip.h>
+#include <lwip/timeouts.h>
+#include "config.h"
+#include "Crc32.h"
+#include "BootTimeline.h"
+#include "Scheduler.h"
+#include "WallClock.h"
+
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_REASON_ASSOC_LEAVE 8   // Our own disconnect() - not a failure
+#define WIFI_GATEWAY_POLL_MS 20     // ARP table look-ups during the gateway check
+#define WIFI_GATEWAY_REQUEST_EVERY 10  // Polls per ARP request for the gateway
+
+// ===== WIFI CONNECTION STATS =====
+struct WiFiConnectionStats {
+  uint32_t attempts = 0;
+  uint32_t fastConnects = 0;       // Cached BSSID/channel (and lease): no scan, no DHCP
+  uint32_t fullConnects = 0;       // Channel scan + DHCP
+  uint32_t failures = 0;           // Attempts that timed out or were rejected
+  uint32_t drops = 0;              // Link lost after it was up
+  uint32_t leaseRejects = 0;       // Fast connects whose gateway gave no ARP reply on the cached lease
+  uint32_t lastConnectMs = 0;      // begin() to IP of the last successful attempt
+  uint64_t totalFastMs = 0;
+  uint64_t totalFullMs = 0;
+
+  uint32_t averageFastMs() const {
+    return fastConnects > 0 ? (uint32_t)(totalFastMs / fastConnects) : 0;
+  }
+  uint32_t averageFullMs() const {
+    return fullConnects > 0 ? (uint32_t)(totalFullMs / fullConnects) : 0;
+  }
+};
+
+// ===== WIFI CONNECTION CLASS =====
+// Non-blocking station connect, driven by update() from loop(). The WiFi
+// event task only raises flags; state changes, NVS writes and logging all
+// happen in update(), so the stats can be read from loop() without locking.
+//
+// After a successful connect the BSSID, channel and DHCP lease are kept in
+// NVS. The next attempt (reconnect or reboot) joins that AP directly on its
+// channel with the lease as static config - no scan, no DHCP, typically well
+// under a second. If it fails, a full connect (scan + DHCP) follows at once;
+// full failures are retried with exponential backoff between
+// WIFI_RETRY_MIN and WIFI_RETRY_MAX. With WIFI_STATIC_IP the lease is never
+// used. One instance (the event callback has no context pointer).
+//
+// The lease is kept with the UTC time it was obtained and the lease time the
+// server granted. It is only reused within the first half of that time - a
+// DHCP client would renew it then - and only with a synced wall clock, so
+// the first connect after a reboot always asks DHCP. A connect on a reused
+// lease counts once the gateway answers ARP (WIFI_GATEWAY_CHECK_TIMEOUT);
+// otherwise the address is taken as gone and a full connect follows.
+//
+// update() is a scheduler task of loop(): every WIFI_POLL_INTERVAL for the
+// timeouts, and at once on an event (setEventTask()).
+class WiFiConnection {
+public:
+  // Loads the cache and starts the first attempt
+  void begin(const char* ssid, const char* password);
+
+  // Lease age is measured against this clock; without it the lease is not reused
+  void setWallClock(const WallClock& clock) { wallClock = &clock; }
+
+  // Got IP and disconnect events trigger this task
+  void setEventTask(Scheduler& scheduler, SchedulerTask task) {
+    eventScheduler = &scheduler;
+    eventTask = task;
+  }
+
+  // Runs the state machine; true on the call the link came up
+  bool update();
+
+  // Any task: true only once the attempt completed (lease gateway check
+  // included), until update() sees the link go
+  bool isConnected() const { return linkUp.load(); }
+  const WiFiConnectionStats& getStats() const { return stats; }
+
+private:
+  enum State : uint8_t {
+    STATE_IDLE = 0,
+    STATE_CONNECTING,
+    STATE_CHECKING,    // Up on the cached lease, waiting for the gateway's ARP reply
+    STATE_CONNECTED,
+    STATE_WAITING      // Backoff before the next attempt
+  };
+
+#pragma pack(push, 1)
+  struct Cache {
+    uint32_t ssidHash;   // CRC-32 of the SSID - a new SSID invalidates the cache
+    uint8_t bssid[6];
+    uint8_t channel;     // 0 = nothing cached
+    uint8_t leaseUses;   // Fast connects on this lease so far
+    uint32_t ip;         // 0 = no lease
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t leaseStart;    // UTC seconds the lease was obtained, 0 = not known (yet)
+    uint32_t leaseSeconds;  // Lease time granted by the DHCP server
+  };
+#pragma pack(pop)
+
+  static WiFiConnection* instance;
+
+  const char* ssid = nullptr;
+  const char* password = nullptr;
+  State state = STATE_IDLE;
+  std::atomic<bool> linkUp{false};  // state == STATE_CONNECTED, for other tasks
+  bool attemptFast = false;
+  bool attemptLease = false;      // Fast attempt on the cached lease
+  bool leaseStartPending = false; // DHCP lease obtained before the wall clock was synced
+  unsigned long attemptStart = 0;
+  unsigned long checkStart = 0;
+  unsigned long leaseObtainedMs = 0;
+  unsigned long waitStart = 0;
+  uint32_t backoffMs = 0;
+  Cache cache = {};
+  WiFiConnectionStats stats;
+  const WallClock* wallClock = nullptr;
+
+  Scheduler* eventScheduler = nullptr;
+  SchedulerTask eventTask = SCHEDULER_NO_TASK;
+
+  // Set by the event task, taken by update()
+  std::atomic<bool> gotIpEvent{false};
+  std::atomic<bool> disconnectEvent{false};
+  std::atomic<uint8_t> disconnectReason{0};
+
+  // Gateway check, polled on the tcpip task; a new probe number ends the old poll
+  std::atomic<uint32_t> gatewayProbe{0};
+  std::atomic<bool> gatewayReplied{false};
+  uint32_t gatewayPolls = 0;      // tcpip task only
+
+  void startAttempt(bool fast);
+  void attemptFailed(uint8_t reason);
+  void connected();
+  bool useLease() const;
+  uint32_t utcSeconds() const;
+  void stampLease();
+  void applyIpConfig(bool lease);
+  void startGatewayCheck();
+  void loadCache();
+  void saveCache();
+  static struct netif* stationNetif();
+  static void startGatewayPoll(void* arg);
+  static void pollGateway(void* arg);
+  static void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+};
+
+// ===== IMPLEMENTATION =====
+WiFiConnection* WiFiConnection::instance = nullptr;
+
+void WiFiConnection::begin(const char* networkSsid, const char* networkPassword) {
+  instance = this;
+  ssid = networkSsid;
+  password = networkPassword;
+  loadCache();
+
+  // Reconnects are ours; the core's own retry and flash writes stay off
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.onEvent(onEvent);
+  WiFi.mode(WIFI_STA);
+
+  startAttempt(cache.channel != 0);
+}
+
+bool WiFiConnection::update() {
+  bool up = gotIpEvent.exchange(false);
+  bool lost = disconnectEvent.exchange(false);
+  unsigned long now = millis();
+
+  switch (state) {
+    case STATE_CONNECTING: {
+      unsigned long timeout = attemptFast ? WIFI_FAST_CONNECT_TIMEOUT : WIFI_CONNECT_TIMEOUT;
+      if (up && WiFi.status() == WL_CONNECTED) {
+        if (attemptLease) {
+          startGatewayCheck();
+          break;
+        }
+        connected();
+        return true;
+      }
+      if (lost || now - attemptStart >= timeout) {
+        attemptFailed(lost ? disconnectReason.load() : 0);
+      }
+      break;
+    }
+    case STATE_CHECKING:
+      if (gatewayReplied.load() && !lost) {
+        gatewayProbe++;
+        connected();
+        return true;
+      }
+      if (lost || now - checkStart >= WIFI_GATEWAY_CHECK_TIMEOUT) {
+        gatewayProbe++;
+        if (!lost) {
+          stats.leaseRejects++;
+          DEBUG_WARN("Gateway gives no ARP reply on the cached lease");
+        }
+        attemptFailed(lost ? disconnectReason.load() : 0);
+      }
+      break;
+    case STATE_CONNECTED:
+      if (lost || WiFi.status() != WL_CONNECTED) {
+        stats.drops++;
+        DEBUG_WARN("WiFi lost (reason %u) - reconnecting", (unsigned)disconnectReason.load());
+        startAttempt(cache.channel != 0);
+      } else if (leaseStartPending) {
+        stampLease();
+      }
+      break;
+    case STATE_WAITING:
+      if (now - waitStart >= backoffMs) {
+        startAttempt(cache.channel != 0);
+      }
+      break;
+    default:
+      break;
+  }
+  return false;
+}
+
+void WiFiConnection::startAttempt(bool fast) {
+  attemptFast = fast;
+  attemptStart = millis();
+  state = STATE_CONNECTING;
+  linkUp.store(false);
+  stats.attempts++;
+
+  attemptLease = fast && useLease();
+  applyIpConfig(attemptLease);
+  if (fast) {
+    DEBUG_INFO("WiFi fast connect: channel %u%s", (unsigned)cache.channel, attemptLease ? ", cached lease" : "");
+    WiFi.begin(ssid, password, cache.channel, cache.bssid, true);
+  } else {
+    DEBUG_INFO("Connecting to WiFi...");
+    WiFi.begin(ssid, password);
+  }
+}
+
+void WiFiConnection::attemptFailed(uint8_t reason) {
+  stats.failures++;
+  WiFi.disconnect();
+
+  // The AP moved, changed channel or dropped the lease - scan right away
+  if (attemptFast) {
+    DEBUG_WARN("WiFi fast connect failed (reason %u) - full connect", (unsigned)reason);
+    cache.leaseUses = WIFI_LEASE_MAX_REUSE;  // Next lease comes from DHCP
+    startAttempt(false);
+    return;
+  }
+
+  backoffMs = backoffMs == 0 ? WIFI_RETRY_MIN : backoffMs * 2;
+  if (backoffMs > WIFI_RETRY_MAX) {
+    backoffMs = WIFI_RETRY_MAX;
+  }
+  waitStart = millis();
+  state = STATE_WAITING;
+  DEBUG_ERROR("WiFi connection failed (reason %u) - retry in %lu s",
+              (unsigned)reason, (unsigned long)(backoffMs / 1000));
+}
+
+void WiFiConnection::connected() {
+  uint32_t elapsed = millis() - attemptStart;
+  stats.lastConnectMs = elapsed;
+  if (attemptFast) {
+    stats.fastConnects++;
+    stats.totalFastMs += elapsed;
+  } else {
+    stats.fullConnects++;
+    stats.totalFullMs += elapsed;
+  }
+  state = STATE_CONNECTED;
+  linkUp.store(true);
+  backoffMs = 0;
+  BootTimeline::mark(BOOT_WIFI);
+
+  DEBUG_INFO("WiFi connected: %s (%s, %lu ms)", WiFi.localIP().toString().c_str(),
+             attemptFast ? "fast" : "full", (unsigned long)elapsed);
+  DEBUG_INFO("RSSI: %d dBm", WiFi.RSSI());
+
+  // Remember where we are; NVS is only written when something changed
+  Cache seen = cache;
+  seen.ssidHash = Crc32::update(0, (const uint8_t*)ssid, strlen(ssid));
+  memcpy(seen.bssid, WiFi.BSSID(), sizeof(seen.bssid));
+  seen.channel = (uint8_t)WiFi.channel();
+  leaseStartPending = false;
+  if (attemptLease) {
+    seen.leaseUses++;
+  } else {
+#ifndef WIFI_STATIC_IP
+    seen.ip = WiFi.localIP();
+    seen.gateway = WiFi.gatewayIP();
+    seen.subnet = WiFi.subnetMask();
+    seen.dns = WiFi.dnsIP(0);
+    seen.leaseUses = 0;
+
+    // Lease time the server just granted; read outside the tcpip task, a single word
+    struct netif* netif = stationNetif();
+    struct dhcp* dhcp = netif != nullptr ? netif_dhcp_data(netif) : nullptr;
+    seen.leaseSeconds = dhcp != nullptr && dhcp->offered_t0_lease != 0 ? dhcp->offered_t0_lease
+                                                                      : WIFI_LEASE_DEFAULT;
+    seen.leaseStart = utcSeconds();
+    leaseObtainedMs = millis();
+    leaseStartPending = seen.leaseStart == 0;
+#endif
+  }
+  if (memcmp(&seen, &cache, sizeof(cache)) != 0) {
+    cache = seen;
+    saveCache();
+  }
+}
+
+// Back-dates the lease start once the wall clock is synced
+void WiFiConnection::stampLease() {
+  uint32_t now = utcSeconds();
+  if (now == 0) {
+    return;
+  }
+  cache.leaseStart = now - (millis() - leaseObtainedMs) / 1000;
+  leaseStartPending = false;
+  saveCache();
+}
+
+uint32_t WiFiConnection::utcSeconds() const {
+  return wallClock != nullptr ? wallClock->utcSeconds() : 0;
+}
+
+bool WiFiConnection::useLease() const {
+#ifdef WIFI_STATIC_IP
+  return false;
+#else
+  if (!WIFI_REUSE_LEASE || cache.ip == 0 || cache.leaseUses >= WIFI_LEASE_MAX_REUSE || cache.leaseStart == 0) {
+    return false;
+  }
+  // A DHCP client would renew at half the lease time - reuse stays short of that
+  uint32_t now = utcSeconds();
+  return now >= cache.leaseStart && now - cache.leaseStart < cache.leaseSeconds / 2;
+#endif
+}
+
+void WiFiConnection::applyIpConfig(bool lease) {
+#ifdef WIFI_STATIC_IP
+  (void)lease;
+  IPAddress ip, gateway, subnet, dns;
+  ip.fromString(WIFI_STATIC_IP);
+  gateway.fromString(WIFI_STATIC_GATEWAY);
+  subnet.fromString(WIFI_STATIC_SUBNET);
+  dns.fromString(WIFI_STATIC_DNS);
+  WiFi.config(ip, gateway, subnet, dns);
+#else
+  if (lease) {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+  } else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // DHCP
+  }
+#endif
+}
+
+void WiFiConnection::startGatewayCheck() {
+  state = STATE_CHECKING;
+  checkStart = millis();
+  gatewayReplied.store(false);
+  uint32_t probe = ++gatewayProbe;
+  if (tcpip_callback(startGatewayPoll, (void*)(uintptr_t)probe) != ERR_OK) {
+    checkStart -= WIFI_GATEWAY_CHECK_TIMEOUT;  // Counts as no reply
+  }
+}
+
+struct netif* WiFiConnection::stationNetif() {
+  esp_netif_t* station = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  return station != nullptr ? (struct netif*)esp_netif_get_netif_impl(station) : nullptr;
+}
+
+void WiFiConnection::startGatewayPoll(void* arg) {
+  if (instance != nullptr) {
+    instance->gatewayPolls = 0;
+  }
+  pollGateway(arg);
+}
+
+// tcpip task: ARP request for the gateway, then its table entry is looked up
+// every WIFI_GATEWAY_POLL_MS until it answers or update() ends the check
+void WiFiConnection::pollGateway(void* arg) {
+  WiFiConnection* connection = instance;
+  uint32_t probe = (uint32_t)(uintptr_t)arg;
+  if (connection == nullptr || connection->gatewayProbe.load() != probe) {
+    return;
+  }
+  struct netif* netif = stationNetif();
+  if (netif == nullptr) {
+    return;  // Runs out into the timeout
+  }
+  ip4_addr_t gateway;
+  ip4_addr_set_u32(&gateway, connection->cache.gateway);
+  struct eth_addr* mac = nullptr;
+  const ip4_addr_t* entry = nullptr;
+  if (etharp_find_addr(netif, &gateway, &mac, &entry) >= 0) {
+    connection->gatewayReplied.store(true);
+    if (connection->eventScheduler != nullptr) {
+      connection->eventScheduler->trigger(connection->eventTask);
+    }
+    return;
+  }
+  if (connection->gatewayPolls++ % WIFI_GATEWAY_REQUEST_EVERY == 0) {
+    etharp_request(netif, &gateway);
+  }
+  sys_timeout(WIFI_GATEWAY_POLL_MS, pollGateway, arg);
+}
+
+void WiFiConnection::loadCache() {
+  Preferences prefs;
+  if (!prefs.begin(WIFI_NVS_NAMESPACE, true)) {
+    return;  // First boot - namespace does not exist yet
+  }
+  Cache stored = {};
+  bool valid = prefs.getBytes("cache", &stored, sizeof(stored)) == sizeof(stored) &&
+               stored.ssidHash == Crc32::update(0, (const uint8_t*)ssid, strlen(ssid));
+  prefs.end();
+  if (valid) {
+    cache = stored;
+  }
+}
+
+void WiFiConnection::saveCache() {
+  Preferences prefs;
+  if (prefs.begin(WIFI_NVS_NAMESPACE, false)) {
+    prefs.putBytes("cache", &cache, sizeof(cache));
+    prefs.end();
+  } else {
+    DEBUG_WARN("NVS not available - WiFi cache not saved");
+  }
+}
+
+void WiFiConnection::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  WiFiConnection* connection = instance;
+  if (connection == nullptr) {
+    return;
+  }
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    connection->gotIpEvent.store(true);
+  } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED &&
+             info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE) {
+    connection->disconnectReason.store(info.wifi_sta_disconnected.reason);
+    connection->disconnectEvent.store(true);
+  } else {
+    return;
+  }
+  if (connection->eventScheduler != nullptr) {
+    connection->eventScheduler->trigger(connection->eventTask);
+  }
+}
+
+#endif
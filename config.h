@@ -24,12 +24,135 @@
 #define BUTTON_SELECT_PIN 33
 #define BUTTON_DEBOUNCE_MS 50
 #define BUTTON_LONG_PRESS_MS 2000
+#define BUTTON_POLL_INTERVAL 20       // Release check while the button is held
 
 // ===== TIMING CONFIGURATION =====
 #define DATA_SEND_INTERVAL 10000      // 10 seconds
 #define SENSOR_READ_INTERVAL 3000     // 3 seconds (BSEC ULP mode compromise)
-#define WIFI_CONNECT_TIMEOUT 15000    // 15 seconds
+#define WIFI_CONNECT_TIMEOUT 15000    // 15 seconds per full connect attempt
 #define STEALTH_TEMP_ON_MS 20000      // 20 seconds temporary activation
+#define BOOT_TRACE_TIMEOUT 120000     // Boot timeline printed at the first upload, at the latest after 2 minutes
+
+// ===== SCHEDULER =====
+// loop() and the sensor task each sleep until their nearest deadline - a
+// sensor step, the button, WiFi or a timeout (Scheduler.h); ISRs, WiFi
+// events and new sensor snapshots wake loop() early.
+#define SCHEDULER_MAX_TASKS 12        // Registered tasks per scheduler (max. 32)
+#define SCHEDULER_MAX_SLEEP 1000      // Longest sleep without any deadline
+#define WIFI_POLL_INTERVAL 500        // Connect timeouts and backoff; events wake loop() at once
+#define DS18B20_READ_INTERVAL 10000   // DS18B20 conversion every 10 seconds...
+#define DS18B20_CONVERSION_TIME 750   // ...read 750 ms later (12 bit, async conversion)
+#define PMS_WAKE_TIME 2000            // PMS5003 fan spin-up before a read
+#define PMS_READ_TIMEOUT 1000         // Per read request, one retry; received bytes wake the task at once
+#define BSEC_MIN_CALL_SPACING 10      // If BSEC's next call is already due (after an error)
+
+// ===== WIFI CONNECTION =====
+// Connects in the background (WiFiConnection.h), loop() never waits for it.
+// BSSID, channel and DHCP lease of the last connect are cached in NVS, so a
+// reconnect or reboot joins the same AP without scan and DHCP. The lease is
+// reused only in the first half of its lease time and with a synced wall
+// clock - the first connect after a reboot always runs DHCP.
+#define WIFI_FAST_CONNECT_TIMEOUT 3000 // Cached AP; on failure a full connect follows at once
+#define WIFI_RETRY_MIN 2000           // Backoff after a failed full connect...
+#define WIFI_RETRY_MAX 300000         // ...doubles up to 5 minutes
+#define WIFI_REUSE_LEASE 1            // Fast connects reuse the cached DHCP lease (0 = DHCP every time)
+#define WIFI_LEASE_MAX_REUSE 10       // Then a full connect gets a fresh lease
+#define WIFI_LEASE_DEFAULT 3600       // Lease time (s) assumed if the DHCP client reports none
+#define WIFI_GATEWAY_CHECK_TIMEOUT 1000 // Cached lease: no ARP reply from the gateway by then = DHCP
+// Static IP instead of DHCP - all four are needed
+// #define WIFI_STATIC_IP "192.168.1.50"
+// #define WIFI_STATIC_GATEWAY "192.168.1.1"
+// #define WIFI_STATIC_SUBNET "255.255.255.0"
+// #define WIFI_STATIC_DNS "192.168.1.1"
+
+// ===== TRANSMISSION CONFIGURATION =====
+// Combined mode: /sensor-data answers with a binary AQI result, so no second
+// request to /calculate-aqi is needed. If the flow does not return an AQI body
+// (older Node-RED flow), the JSON request is used as fallback.
+#define AQI_COMBINED_RESPONSE 1
+
+// Display and LEDs show the AQI computed on the device (AQIEngine.h: the
+// flow's "AQI Calculator", same number as aqi_index in InfluxDB), so they
+// work without network; no /calculate-aqi request is made. 0 = show the
+// Node-RED result, local only as fallback.
+#define AQI_LOCAL 1
+#define CYCLE_BENCH 0                 // 1 = setup() logs the CPU cycles of packSensorData() and calculateLocalAQI()
+
+// Send-on-change: a sample is uploaded only when a field moved past its
+// deadband since the last upload, a sensor came or went, the AQI class
+// changed, or SEND_HEARTBEAT_INTERVAL passed (SendFilter.h). Samples are
+// still checked every DATA_SEND_INTERVAL. Off by default: with 1 the
+// server no longer gets one packet per interval, dashboards must hold values.
+#define SEND_ON_CHANGE 0              // 1 = skip unchanged samples, 0 = upload every sample
+#define SEND_HEARTBEAT_INTERVAL 300000 // 5 minutes max. between uploads
+#define DEADBAND_TEMPERATURE 0.2      // °C (BME68X and DS18B20)
+#define DEADBAND_HUMIDITY 1.0         // %
+#define DEADBAND_PRESSURE 0.5         // hPa
+#define DEADBAND_IAQ 5                // IAQ and static IAQ
+#define DEADBAND_CO2 25               // ppm
+#define DEADBAND_VOC 0.1              // mg/m³
+#define DEADBAND_PM 2                 // µg/m³ (PM1.0, PM2.5, PM10)
+
+// Transport for live packets. CoAP sends each packet as one confirmable UDP
+// datagram to NODERED_COAP_URL and gets the AQI back in the piggybacked ACK;
+// backlog uploads then still use HTTP (batch frames exceed one datagram).
+// MQTT publishes everything to MQTT_BROKER_URL and needs no HTTP endpoint.
+#define TRANSPORT_HTTP 0
+#define TRANSPORT_COAP 1
+#define TRANSPORT_MQTT 2
+#define TRANSPORT_MODE TRANSPORT_HTTP
+
+// CoAP retransmission (RFC 7252 4.8). MAX_RETRANSMIT is 4 in the RFC (up to
+// 93 s per packet); 2 keeps the worst case at ~21 s, below 4 queued packets.
+#define COAP_ACK_TIMEOUT 2000         // Initial ACK timeout, randomized up to 1.5x
+#define COAP_MAX_RETRANSMIT 2
+#define COAP_MAX_MESSAGE_SIZE 128     // Request/response datagram buffer
+
+// MQTT: packets to <prefix>/<device>/data, batch frames to
+// <prefix>/<device>/backlog/<format>/<boot>/<uptime>, AQI pushed (retained)
+// on <prefix>/<device>/aqi. <device> is the eFuse MAC in lowercase hex.
+#define MQTT_TOPIC_PREFIX "aqm"
+#define MQTT_KEEPALIVE 60             // Seconds
+#define MQTT_MAX_INFLIGHT 8           // Unacknowledged QoS1 publishes
+#define MQTT_ACK_TIMEOUT 10000        // PUBACK missing this long = broker stalled, reconnect
+#define MQTT_POLL_INTERVAL 50         // Network task services the socket this often (ms)
+#define MQTT_RECONNECT_INTERVAL 5000  // Min. time between connect attempts
+#define MQTT_RX_BUFFER_SIZE 128       // Largest received message (AQI result: 8 bytes)
+
+// InfluxDB direct write: packets become InfluxDB line protocol on the device,
+// INFLUX_BATCH_SAMPLES lines are gzipped and POSTed to INFLUX_WRITE_URL
+// (secrets.h) in one request - no Node-RED in the data path. The AQI still
+// comes from NODERED_AQI_URL if set. HTTP transport only.
+#define INFLUX_DIRECT 0
+#define INFLUX_BATCH_SAMPLES 20       // Lines per write (20 * 10 s = 200 s), ~37 KB RAM
+#define INFLUX_LOCATION "default_location"  // Value of the location tag
+
+// Wall-clock time: SNTP maps the uptime to UTC (WallClock.h) for the packet
+// timestamps - ms resolution, drift-corrected between syncs. Until the first
+// sync packets carry the uptime and no time section.
+#define TIME_NTP_SERVER "pool.ntp.org"  // UTC; packets of a fleet share one time base
+#define TIME_SYNC_INTERVAL 3600000    // SNTP poll interval (ms, min. 15000)
+#define TIME_SYNC_STALE 14400000      // Last sync older than this (ms): quality "estimated"
+
+// Network task - HTTP runs off the main loop so sensors and button never stall
+#define NET_TASK_CORE 0               // loop() runs on core 1
+#define NET_TASK_PRIORITY 1
+#define NET_TASK_STACK_SIZE 8192
+#define NET_QUEUE_LENGTH 4            // Packets waiting for upload
+
+// Sensor task - owns BSEC timing; preempts loop() (display, AQI) on its core
+#define SENSOR_TASK_CORE 1
+#define SENSOR_TASK_PRIORITY 3        // Above loop() (1) and the network task
+#define SENSOR_TASK_STACK_SIZE 6144   // saveBsecState() keeps the BSEC state and work buffer on the stack
+
+// Store-and-forward backlog on LittleFS for samples that could not be sent
+#define BACKLOG_ENABLED 1
+#define BACKLOG_DIR "/backlog"
+#define BACKLOG_SEGMENT_RECORDS 64    // Packets per segment file
+#define BACKLOG_MAX_SEGMENTS 135      // 135 * 64 = 8640 packets (24 h at 10 s)
+#define BACKLOG_BATCH_SIZE 32         // Packets per backlog upload
+#define BACKLOG_DRAIN_INTERVAL 2000   // Min. 2 seconds between backlog uploads
+#define BACKLOG_BATCH_FRAMES 1        // Delta-encoded batch frames (0 = raw packets back to back)
 
 // ===== SENSOR CONFIGURATION =====
 #define DEFAULT_TEMP_CORRECTION -3.5
@@ -37,6 +160,7 @@
 
 // BSEC configuration
 #define BSEC_STATE_SAVE_INTERVAL 21600000  // 6 hours in ms
+#define BSEC_STATE_RETRY_INTERVAL 600000   // 10 minutes while not calibrated or on a write error
 #define BSEC_BASELINE_EEPROM_ADDR 0
 
 // ===== DISPLAY VIEWS =====
@@ -12,7 +12,7 @@
 //    (no hardcoded credentials in code)
 // 2. Store credentials in EEPROM/SPIFFS with encryption
 // 3. Use WPA3 for WiFi if available
-// 4. Enable HTTPS for Node-RED communication (requires SSL certificates)
+// 4. Use https:// / mqtts:// URLs and set TLS_CA_CERT below
 // 5. Implement OTA password protection
 //
 // For production deployments, consider implementing a secure provisioning system.
@@ -27,8 +27,35 @@
 
 // ===== NODE-RED ENDPOINTS =====
 // Replace with your Node-RED server address
-// SECURITY: Use HTTPS in production: "https://YOUR_SERVER:1880/..."
+// SECURITY: Use HTTPS in production: "https://YOUR_SERVER:1880/..." (see TLS_CA_CERT)
 #define NODERED_SEND_URL "http://YOUR_SERVER:1880/sensor-data"
 #define NODERED_AQI_URL "http://YOUR_SERVER:1880/calculate-aqi"
+// Only used with TRANSPORT_MODE TRANSPORT_COAP (config.h)
+#define NODERED_COAP_URL "coap://YOUR_SERVER:5683/sensor-data"
+
+// ===== INFLUXDB =====
+// Only used with INFLUX_DIRECT 1 (config.h). InfluxDB v2 write API; keep precision=ms.
+// The token needs write access to the bucket.
+#define INFLUX_WRITE_URL "http://YOUR_SERVER:8086/api/v2/write?org=YOUR_ORG&bucket=EnvSensors&precision=ms"
+#define INFLUX_TOKEN ""
+
+// ===== MQTT BROKER =====
+// Only used with TRANSPORT_MODE TRANSPORT_MQTT (config.h); leave user/password empty if not needed.
+// "mqtts://YOUR_SERVER:8883" connects with TLS (see TLS_CA_CERT)
+#define MQTT_BROKER_URL "mqtt://YOUR_SERVER:1883"
+#define MQTT_USERNAME ""
+#define MQTT_PASSWORD ""
+
+// ===== TLS =====
+// CA certificate (PEM) that signed the server certificate of https:// and
+// mqtts:// endpoints - for a self-signed server certificate, the certificate
+// itself. Empty: the connection is encrypted, but the server is not verified.
+#define TLS_CA_CERT ""
+/* Example:
+#define TLS_CA_CERT \
+  "-----BEGIN CERTIFICATE-----\n" \
+  "MIIB...\n" \
+  "-----END CERTIFICATE-----\n"
+*/
 
 #endif
\ No newline at end of file
@@ -0,0 +1,290 @@
+// ===== LOCAL AQI ENGINE BENCHMARK =====
+// Checks AQIEngine.h against the flow port (flow_pipeline.h) and times it:
+//  - every wire value of each pollutant (PM 0-1000 µg/m³, CO2 0-65535 ppm,
+//    IAQ 0-6553.5, breath VOC 0-655.35 mg/m³, gas resistance on a log grid
+//    and every 7th Ohm to 1.1 MOhm) through the integer sub-index against
+//    the "AQI Response Generator" and "AQI Calculator" double formulas
+//  - level and color of every combined index 0-10000 against getAQILevel()
+//  - random packets (sensors present or not, any accuracy) through
+//    AQIEngine::combined() against the calculator's aqi_index and
+//    getAQILevel() level and color
+//  - ns per combined() and per evaluate() of each standard
+// Any difference fails the run (ties of the weighted mean included, see
+// AQIEngine::flowTieRound). A table of the three standards for some
+// typical readings is printed at the end.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/aqi_engine_bench.cpp -o aqi_engine_bench && ./aqi_engine_bench
+// Options: --packets N (1000000), --seed N (1).
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "SensorData.h"
+#include "AQIEngine.h"
+#include "tools/flow_pipeline.h"
+
+static uint64_t failures = 0;
+
+static void mismatch(const char* what, double value, double engine, double flow) {
+  if (failures++ < 10) {
+    fprintf(stderr, "%s at %.6g: engine %.17g, flow %.17g\n", what, value, engine, flow);
+  }
+}
+
+// ===== SUB-INDEX SWEEP =====
+// Response Generator: PM1.0, PM2.5, PM10, CO2, IAQ one at a time
+static double generatorAqi(AQIPollutant pollutant, double value) {
+  AqiRequest request;
+  switch (pollutant) {
+    case AQI_POLLUTANT_PM1_0: request.hasPm1 = true; request.pm1 = value; break;
+    case AQI_POLLUTANT_PM2_5: request.hasPm25 = true; request.pm25 = value; break;
+    case AQI_POLLUTANT_PM10:  request.hasPm10 = true; request.pm10 = value; break;
+    case AQI_POLLUTANT_CO2:   request.hasCo2 = true; request.co2 = value; break;
+    default:                  request.hasIaq = true; request.iaq = value; break;
+  }
+  AqiAnswer answer = FlowPipeline::answer(request);
+  switch (pollutant) {
+    case AQI_POLLUTANT_PM1_0: return answer.pm1Aqi;
+    case AQI_POLLUTANT_PM2_5: return answer.pm25Aqi;
+    case AQI_POLLUTANT_PM10:  return answer.pm10Aqi;
+    case AQI_POLLUTANT_CO2:   return answer.co2Aqi;
+    default:                  return answer.iaqAqi;
+  }
+}
+
+// Calculator with one BME68X value and no particles (weights 0.9+1.0+0.8 at accuracy 0):
+// VOC and gas resistance only show up in the weighted mean
+static void compareCalculator(const char* what, AQIPollutant pollutant, uint32_t raw) {
+  SensorDataPacket packet = {};
+  packet.bme_flags = 1;
+  if (pollutant == AQI_POLLUTANT_VOC) {
+    packet.breath_voc = (uint16_t)raw;
+  } else {
+    packet.gas_resistance = raw;
+  }
+  FlowSample sample;
+  FlowPipeline::toSample(packet, sample);
+  double pm25, pm10, iaq;
+  double flow = FlowPipeline::weightedAqi(sample, pm25, pm10, iaq);
+  double engine = AQIEngine::combined(packet).aqi;
+  if (engine != flow) {
+    mismatch(what, raw, engine, flow);
+  }
+}
+
+static uint64_t sweep() {
+  uint64_t checked = 0;
+  const struct {
+    AQIPollutant pollutant;
+    uint32_t maxRaw;
+    double scale;               // PACKET_SCHEMA scale of the field
+  } ranges[] = {
+    {AQI_POLLUTANT_PM1_0, 1000, 1}, {AQI_POLLUTANT_PM2_5, 1000, 1}, {AQI_POLLUTANT_PM10, 1000, 1},
+    {AQI_POLLUTANT_CO2, 65535, 1}, {AQI_POLLUTANT_IAQ, 65535, 10}
+  };
+  for (const auto& range : ranges) {
+    for (uint32_t raw = 0; raw <= range.maxRaw; raw++) {
+      if (range.pollutant == AQI_POLLUTANT_IAQ && raw == 0) {
+        continue;  // Not sent to the generator at 0
+      }
+      double engine = AQIEngine::flowSubIndex(range.pollutant, raw);
+      double flow = generatorAqi(range.pollutant, raw / range.scale);
+      if (range.pollutant == AQI_POLLUTANT_CO2 && raw == 0) {
+        flow = 25;  // Generator skips co2 = 0; the table floor is 25
+      }
+      if (engine != flow) {
+        mismatch(AQI_POLLUTANT_NAMES[range.pollutant], raw, engine, flow);
+      }
+      checked++;
+    }
+  }
+  for (uint32_t raw = 1; raw <= 65535; raw++) {
+    compareCalculator("VOC", AQI_POLLUTANT_VOC, raw);
+    checked++;
+  }
+  // Gas resistance: 1 Ohm to 4.2 GOhm, 64 steps per doubling plus the breakpoints
+  std::vector<uint32_t> gas = {1000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 0xFFFFFFFF};
+  for (double r = 1; r < 4.2e9; r *= std::pow(2.0, 1.0 / 64)) {
+    gas.push_back((uint32_t)r);
+  }
+  for (uint32_t r = 1; r <= 1100000; r++) {
+    if (r % 7 == 0 || (r > 990000 && r < 1010000)) {
+      gas.push_back(r);
+    }
+  }
+  for (uint32_t r : gas) {
+    compareCalculator("Gas", AQI_POLLUTANT_GAS, r);
+    checked++;
+  }
+
+  // getAQILevel() for every combined index up to 10000
+  for (int32_t aqi = 0; aqi <= 10000; aqi++) {
+    uint32_t color;
+    AQILevel level = AQIEngine::level(aqi, color);
+    uint8_t flowLevel;
+    uint32_t flowColor;
+    FlowPipeline::level(aqi, flowLevel, flowColor);
+    if (level != flowLevel || color != flowColor) {
+      mismatch("level", aqi, color, flowColor);
+    }
+    checked++;
+  }
+  return checked;
+}
+
+// ===== RANDOM PACKETS =====
+static void randomPacket(std::mt19937& rng, SensorDataPacket& packet) {
+  auto below = [&](uint32_t n) { return (uint32_t)(rng() % n); };
+  packet = {};
+  if (below(10) != 0) {
+    packet.bme_flags = 1 | (below(2) << 1);
+    packet.iaq = (uint16_t)(below(8) == 0 ? rng() : below(5000));
+    packet.co2_equivalent = (uint16_t)(below(8) == 0 ? rng() : 400 + below(4600));
+    packet.breath_voc = (uint16_t)(below(8) == 0 ? rng() : below(3000));
+    packet.gas_resistance = below(8) == 0 ? (uint32_t)rng() : 1000 + below(2000000);
+    packet.iaq_accuracy = (uint8_t)below(4);
+    packet.co2_accuracy = (uint8_t)below(4);
+    packet.voc_accuracy = (uint8_t)below(4);
+    if (below(20) == 0) {
+      packet.iaq = packet.co2_equivalent = packet.breath_voc = 0;  // BSEC not started yet
+    }
+  }
+  if (below(10) != 0) {
+    packet.pms_flags = 1;
+    uint32_t range = below(4) == 0 ? 1001 : 150;
+    packet.pm1_0 = (uint16_t)below(range);
+    packet.pm2_5 = (uint16_t)(packet.pm1_0 + below(range));
+    packet.pm10 = (uint16_t)(packet.pm2_5 + below(range));
+  }
+}
+
+static void comparePacket(const SensorDataPacket& packet) {
+  FlowSample sample;
+  FlowPipeline::toSample(packet, sample);
+  double pm25, pm10, iaq;
+  double flow = FlowPipeline::weightedAqi(sample, pm25, pm10, iaq);
+  uint8_t flowLevel;
+  uint32_t flowColor;
+  FlowPipeline::level(flow, flowLevel, flowColor);
+
+  AQIResult engine = AQIEngine::combined(packet);
+  if (engine.aqi != (float)flow || engine.level != flowLevel || engine.colorCode != flowColor) {
+    mismatch("combined", sample.pm25, engine.aqi, flow);
+  }
+}
+
+// ===== TIMING =====
+template <typename F>
+static double nsPerCall(const std::vector<SensorDataPacket>& packets, uint64_t& sink, F call) {
+  auto start = std::chrono::steady_clock::now();
+  for (const SensorDataPacket& packet : packets) {
+    sink += call(packet);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return seconds * 1e9 / packets.size();
+}
+
+static void printStandards() {
+  const struct {
+    const char* name;
+    uint16_t pm25, pm10, co2;
+    uint16_t iaq;               // Tenths, as in the packet
+    uint16_t voc;               // Hundredths
+  } readings[] = {
+    {"clean", 4, 8, 450, 250, 40},
+    {"urban", 14, 28, 700, 800, 90},
+    {"stuffy room", 9, 15, 1400, 1600, 180},
+    {"traffic", 32, 60, 600, 900, 100},
+    {"smoke", 120, 180, 900, 2600, 450},
+  };
+  printf("\n%-12s %6s %6s %6s %6s | %-13s | %-13s | %-13s | combined\n", "reading", "PM2.5", "PM10", "CO2", "IAQ",
+         "EPA worst", "CAQI worst", "UBA class");
+  for (const auto& r : readings) {
+    SensorDataPacket packet = {};
+    packet.pms_flags = 1;
+    packet.pm1_0 = (uint16_t)(r.pm25 * 2 / 3);
+    packet.pm2_5 = r.pm25;
+    packet.pm10 = r.pm10;
+    packet.bme_flags = 3;
+    packet.co2_equivalent = r.co2;
+    packet.iaq = r.iaq;
+    packet.breath_voc = r.voc;
+    packet.gas_resistance = 150000;
+    packet.iaq_accuracy = packet.co2_accuracy = packet.voc_accuracy = 3;
+    printf("%-12s %6u %6u %6u %6.1f", r.name, r.pm25, r.pm10, r.co2, r.iaq / 10.0);
+    for (uint8_t s = 0; s < AQI_STANDARD_COUNT; s++) {
+      AQISubIndices sub;
+      AQIEngine::evaluate((AQIStandard)s, packet, sub);
+      printf(" | %5d %-7s", sub.worst, AQI_POLLUTANT_NAMES[sub.dominant]);
+    }
+    AQIResult combined = AQIEngine::combined(packet);
+    printf(" | %3.0f %s\n", combined.aqi, combined.levelName());
+  }
+}
+
+int main(int argc, char** argv) {
+  uint64_t count = 1000000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--packets" && i + 1 < argc) {
+      count = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--packets N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (count == 0) {
+    fprintf(stderr, "--packets must be > 0\n");
+    return 2;
+  }
+
+  uint64_t swept = sweep();
+  printf("Sub-index sweep: %llu values, %llu differences\n", (unsigned long long)swept,
+         (unsigned long long)failures);
+
+  std::mt19937 rng(seed);
+  std::vector<SensorDataPacket> packets(count);
+  for (SensorDataPacket& packet : packets) {
+    randomPacket(rng, packet);
+  }
+  uint64_t before = failures;
+  for (const SensorDataPacket& packet : packets) {
+    comparePacket(packet);
+  }
+  printf("Combined AQI: %llu packets, %llu differences to the flow\n", (unsigned long long)count,
+         (unsigned long long)(failures - before));
+
+  uint64_t sink = 0;
+  double combinedNs = nsPerCall(packets, sink, [](const SensorDataPacket& packet) {
+    AQIResult result = AQIEngine::combined(packet);
+    return (uint64_t)result.aqi + result.colorCode;
+  });
+  printf("combined(): %.1f ns/packet\n", combinedNs);
+  for (uint8_t s = 0; s < AQI_STANDARD_COUNT; s++) {
+    double ns = nsPerCall(packets, sink, [s](const SensorDataPacket& packet) {
+      AQISubIndices sub;
+      AQIEngine::evaluate((AQIStandard)s, packet, sub);
+      return (uint64_t)sub.worst;
+    });
+    printf("evaluate(%s): %.1f ns/packet\n", AQI_STANDARD_NAMES[s], ns);
+  }
+  printf("(checksum %llu)\n", (unsigned long long)sink);
+
+  printStandards();
+
+  if (failures > 0) {
+    printf("FAIL: %llu differences\n", (unsigned long long)failures);
+    return 1;
+  }
+  printf("OK: engine matches the flow\n");
+  return 0;
+}
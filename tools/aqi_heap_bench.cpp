@@ -0,0 +1,231 @@
+// ===== AQI RESULT HEAP BENCHMARK =====
+// Runs the device's per-cycle AQI result path on the host - packet from
+// the sensor readings, JSON request into a stack buffer, Node-RED response
+// received into a fixed buffer and parsed in place (AQIResult.h), result
+// handed on by value, level name and AQI line formatted for the display -
+// with malloc/new counted, and fails unless the cycles allocate nothing.
+// The HTTP exchange between request and response is not part of it:
+// HttpConnection and HTTPClient build host, path and headers as Arduino
+// Strings per request, so a real cycle does allocate there.
+// A selftest of the response parser (pretty-printed, reordered, unknown and
+// malformed responses) runs first.
+//
+// Build and run from the repository root (Linux, glibc):
+//   g++ -std=c++17 -O2 -I. tools/aqi_heap_bench.cpp -o aqi_heap_bench && ./aqi_heap_bench
+// Options: --cycles N (1000000).
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "SensorData.h"
+#include "AQIResult.h"
+
+// ===== ALLOCATION COUNTER =====
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<uint64_t> allocatedBytes{0};
+
+extern "C" void* malloc(size_t size) {
+  allocations++;
+  allocatedBytes += size;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  allocations++;
+  allocatedBytes += count * size;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  allocations++;
+  allocatedBytes += size;
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+  __libc_free(ptr);
+}
+
+void* operator new(size_t size) {
+  void* ptr = malloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+// ===== SELFTEST =====
+struct ParseCase {
+  const char* name;
+  const char* json;
+  bool ok;
+  float aqi;
+  AQILevel level;
+  uint32_t color;
+};
+
+static const ParseCase PARSE_CASES[] = {
+  {"flow response",
+   "{\"success\":true,\"timestamp\":1767571200000,\"aqi\":{\"combined\":42,\"pm1_0_aqi\":30,\"pm2_5_aqi\":42,"
+   "\"pm10_aqi\":20,\"co2_aqi\":50,\"iaq_aqi\":66,\"level\":\"Gut\",\"color\":\"#6bff00\","
+   "\"dominant_pollutant\":\"VOC/Gas\"}}",
+   true, 42, AQI_LEVEL_GOOD, 0x6BFF00},
+  {"pretty printed, reordered",
+   "{\n  \"aqi\": {\n    \"color\": \"#FF0000\",\n    \"level\": \"Unhealthy for sensitive groups\",\n"
+   "    \"combined\": 137.5\n  },\n  \"success\": true\n}",
+   true, 137.5f, AQI_LEVEL_UNHEALTHY_SENSITIVE, 0xFF0000},
+  {"nested values skipped",
+   "{\"meta\":{\"a\":[1,{\"b\":\"}\"}],\"c\":\"x\\\"y\"},\"aqi\":{\"extra\":[{\"k\":[]}],\"combined\":7,"
+   "\"level\":\"Sehr gut\"}}",
+   true, 7, AQI_LEVEL_VERY_GOOD, 0x00FF00},
+  {"unknown level, bad color",
+   "{\"aqi\":{\"combined\":250,\"level\":\"Apocalyptic\",\"color\":\"red\"}}",
+   true, 250, AQI_LEVEL_UNKNOWN, 0x00FF00},
+  {"no aqi object", "{\"success\":false,\"error\":\"no data\"}", false, 0, AQI_LEVEL_UNKNOWN, 0},
+  {"no combined", "{\"aqi\":{\"level\":\"Gut\"}}", false, 0, AQI_LEVEL_UNKNOWN, 0},
+  {"empty aqi", "{\"aqi\":{}}", false, 0, AQI_LEVEL_UNKNOWN, 0},
+  {"truncated", "{\"aqi\":{\"combined\":42,\"level\":\"Gu", false, 0, AQI_LEVEL_UNKNOWN, 0},
+  {"exponent", "{\"aqi\":{\"combined\":4.2e1}}", false, 0, AQI_LEVEL_UNKNOWN, 0},
+  {"not json", "<html>502 Bad Gateway</html>", false, 0, AQI_LEVEL_UNKNOWN, 0},
+};
+
+static bool selftest() {
+  bool ok = true;
+  for (const ParseCase& test : PARSE_CASES) {
+    AQIResult result;
+    bool parsed = AQIJson::parseResponse(test.json, strlen(test.json), result);
+    bool pass = parsed == test.ok;
+    if (pass && parsed) {
+      pass = result.success && result.aqi == test.aqi && result.level == test.level && result.colorCode == test.color;
+    }
+    if (pass && !parsed) {
+      pass = !result.success && result.level == AQI_LEVEL_GOOD;  // Untouched on failure
+    }
+    if (!pass) {
+      fprintf(stderr, "selftest '%s' failed: parsed %d, aqi %.1f, level %u, color %06X\n", test.name, parsed,
+              result.aqi, (unsigned)result.level, (unsigned)result.colorCode);
+      ok = false;
+    }
+  }
+
+  SensorDataPacket packet = {};
+  packet.pm2_5 = 65535;
+  packet.pm10 = 65535;
+  packet.iaq = 65535;
+  packet.co2_equivalent = 65535;
+  packet.bme_flags = 3;
+  char request[AQIJson::MAX_REQUEST_LENGTH];
+  size_t length = AQIJson::writeRequest(request, sizeof(request), packet);
+  const char* expected = "{\"pm2_5\":65535,\"pm10\":65535,\"iaq\":6553.5,\"co2\":65535,\"calibrated\":true}";
+  if (length != strlen(expected) || strcmp(request, expected) != 0) {
+    fprintf(stderr, "selftest request failed: %s\n", request);
+    ok = false;
+  }
+  return ok;
+}
+
+// ===== CYCLE =====
+// What loop() and the network task do per sample for the AQI result
+static uint64_t runCycle(uint32_t i, char* received, AQIResult& displayed) {
+  // Sensor readings -> packet (loop)
+  SensorData data;
+  data.bme68xAvailable = true;
+  data.bsecCalibrated = (i & 1) != 0;
+  data.iaq = 20 + (i % 300) * 0.7f;
+  data.co2Equivalent = 400 + (i % 2000);
+  data.pms5003Available = true;
+  data.pm2_5 = (uint16_t)(i % 300);
+  data.pm10 = (uint16_t)(i % 420);
+  SensorDataPacket packet = {};
+  packSensorData(data, packet);
+
+  // Request (network task)
+  char request[AQIJson::MAX_REQUEST_LENGTH];
+  size_t requestLength = AQIJson::writeRequest(request, sizeof(request), packet);
+
+  // Node-RED answer as the AQI Response Generator sends it, read into the fixed buffer
+  unsigned combined = i % 500;
+  AQILevel level = (AQILevel)(1 + i % (AQI_LEVEL_COUNT - 1));
+  uint32_t color = (i * 2654435761u) & 0xFFFFFF;
+  int length = snprintf(received, AQIJson::MAX_RESPONSE_LENGTH + 1,
+                        "{\"success\":true,\"timestamp\":%u,\"aqi\":{\"combined\":%u,\"pm1_0_aqi\":%u,"
+                        "\"pm2_5_aqi\":%u,\"pm10_aqi\":%u,\"co2_aqi\":%u,\"iaq_aqi\":%u,\"level\":\"%s\","
+                        "\"color\":\"#%06x\",\"dominant_pollutant\":\"PM2.5\"}}",
+                        i, combined, combined / 2, combined, combined / 3, combined / 4, combined / 5,
+                        AQI_LEVEL_NAMES[level], (unsigned)color);
+
+  AQIResult result;
+  if (!AQIJson::parseResponse(received, (size_t)length, result) || result.aqi != (float)combined ||
+      result.level != level || result.colorCode != color) {
+    fprintf(stderr, "cycle %u: wrong result\n", i);
+    exit(1);
+  }
+
+  // Mailbox hand-off (a copy) and display (loop)
+  AQIResult latest = result;
+  displayed = latest;
+  char line[24];
+  int lineLength = snprintf(line, sizeof(line), "AQI: %u", (unsigned)displayed.aqi);
+  return requestLength + lineLength + strlen(displayed.shortLevelName()) + strlen(displayed.levelName());
+}
+
+int main(int argc, char** argv) {
+  uint64_t cycles = 1000000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--cycles" && i + 1 < argc) {
+      cycles = strtoull(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--cycles N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (cycles == 0) {
+    fprintf(stderr, "--cycles must be > 0\n");
+    return 2;
+  }
+
+  if (!selftest()) {
+    return 1;
+  }
+  printf("Parser selftest: %zu cases ok\n", sizeof(PARSE_CASES) / sizeof(PARSE_CASES[0]));
+
+  static char received[AQIJson::MAX_RESPONSE_LENGTH + 1];  // aqiResponse on the device
+  AQIResult displayed;
+  runCycle(0, received, displayed);  // Warm-up: lazy libc state, if any
+
+  uint64_t allocationsBefore = allocations.load();
+  uint64_t bytesBefore = allocatedBytes.load();
+  uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < cycles; i++) {
+    checksum += runCycle((uint32_t)i, received, displayed);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  uint64_t cycleAllocations = allocations.load() - allocationsBefore;
+  uint64_t cycleBytes = allocatedBytes.load() - bytesBefore;
+
+  printf("AQI codec and hand-off: %llu cycles, %llu allocations (%llu bytes), %.0f ns/cycle (checksum %llu)\n",
+         (unsigned long long)cycles, (unsigned long long)cycleAllocations, (unsigned long long)cycleBytes,
+         seconds * 1e9 / cycles, (unsigned long long)checksum);
+  if (cycleAllocations != 0) {
+    printf("FAIL: the per-cycle path allocates\n");
+    return 1;
+  }
+  printf("OK: zero heap allocations per cycle in the AQI codec and hand-off\n");
+  return 0;
+}
@@ -0,0 +1,254 @@
+// ===== BATCH FRAME BENCHMARK =====
+// Size and encode time of backlog uploads on three synthetic traces, cut
+// into batches of BACKLOG_BATCH_SIZE as drainBacklog() (ByteTransmission.h)
+// reads them from the store:
+//  - steady: indoor room, slow drift, all sensors present, time synced
+//  - noisy: the same room with large sensor noise, RSSI swings and sample
+//    times jittering within the second
+//  - dropouts: PMS5003, DS18B20 and BME68X missing for stretches, queue
+//    drops (sequence gaps), no time section before the first sync
+// Each batch is sent once as BatchFrameEncoder frame (PacketSchema.h) and
+// once as raw v3 packets back to back - the body drainBacklog() falls back
+// to. Every frame and every raw body is decoded again (packet_decoder.h)
+// and must give back the input packets; any difference fails the run.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/batch_bench.cpp -o batch_bench && ./batch_bench
+// Options: --samples N (100000 per trace), --batch N (BACKLOG_BATCH_SIZE), --seed N (1).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "ClockMapping.h"
+#include "SensorData.h"
+#include "packet_decoder.h"
+
+static const double PI = 3.14159265358979;
+static const uint32_t SAMPLE_INTERVAL_S = DATA_SEND_INTERVAL / 1000;
+static const uint32_t SYNC_TIME = 1760000000;   // UTC of uptime 0 in the traces
+
+enum class Trace { STEADY, NOISY, DROPOUTS };
+
+static const char* traceName(Trace trace) {
+  return trace == Trace::STEADY ? "steady" : trace == Trace::NOISY ? "noisy" : "dropouts";
+}
+
+// ===== TRACES =====
+class TraceModel {
+public:
+  // The first fifth of the dropout trace is from before the first sync
+  TraceModel(Trace trace, size_t samples, uint32_t seed)
+    : trace(trace), rng(seed), syncIndex(trace == Trace::DROPOUTS ? (uint32_t)(samples / 5) : 0) {}
+
+  SensorDataPacket next();
+
+private:
+  Trace trace;
+  std::mt19937 rng;
+  uint32_t syncIndex;           // First sample with a time section
+  uint32_t index = 0;
+  uint32_t sequence = 0;
+  double humidity = 45;
+  double pressure = 1013;
+  double gasResistance = 120000;
+  double pmBase = 6;
+  uint32_t pmsOutage = 0;       // Samples left without the sensor
+  uint32_t dsOutage = 0;
+  uint32_t bmeOutage = 0;
+
+  double uniform(double low, double high) { return std::uniform_real_distribution<double>(low, high)(rng); }
+  bool chance(double probability) { return uniform(0, 1) < probability; }
+  uint32_t outage(uint32_t& left, double probability, uint32_t shortest, uint32_t longest);
+};
+
+uint32_t TraceModel::outage(uint32_t& left, double probability, uint32_t shortest, uint32_t longest) {
+  if (left > 0) {
+    left--;
+  } else if (trace == Trace::DROPOUTS && chance(probability)) {
+    left = shortest + rng() % (longest - shortest + 1);
+  }
+  return left;
+}
+
+SensorDataPacket TraceModel::next() {
+  bool noisy = trace == Trace::NOISY;
+  uint32_t uptime = 600 + index * SAMPLE_INTERVAL_S;
+  double dayFraction = fmod(uptime / 86400.0, 1.0);
+  index++;
+
+  humidity = std::min(90.0, std::max(15.0, humidity + uniform(-0.05, 0.05)));
+  pressure = std::min(1050.0, std::max(960.0, pressure + uniform(-0.02, 0.02)));
+  gasResistance = std::min(400000.0, std::max(5000.0, gasResistance * (1 + uniform(-0.003, 0.003))));
+
+  SensorData data;
+  data.bme68xAvailable = outage(bmeOutage, 0.0005, 6, 60) == 0;
+  data.temperature = (float)(21 + 1.5 * sin(2 * PI * (dayFraction - 0.375)) + uniform(-0.02, 0.02) +
+                             (noisy ? uniform(-0.5, 0.5) : 0));
+  data.humidity = (float)(humidity + (noisy ? uniform(-2, 2) : 0));
+  data.pressure = (float)(pressure + (noisy ? uniform(-0.3, 0.3) : 0));
+  data.gasResistance = (float)(gasResistance * (noisy ? uniform(0.92, 1.08) : 1));
+  double iaq = std::min(500.0, std::max(0.0, 25 + 30 * log(250000 / data.gasResistance)));
+  data.iaq = (float)iaq;
+  data.staticIaq = (float)(iaq * 0.95);
+  data.co2Equivalent = (float)(450 + iaq * 6);
+  data.breathVocEquivalent = (float)(0.5 + iaq / 50);
+  data.iaqAccuracy = data.co2Accuracy = data.breathVocAccuracy = 3;
+  data.bsecCalibrated = true;
+
+  data.ds18b20Available = outage(dsOutage, 0.001, 1, 20) == 0;
+  data.externalTemp = data.temperature - 0.4f + (float)uniform(-0.05, 0.05);
+
+  data.pms5003Available = outage(pmsOutage, 0.002, 30, 300) == 0;
+  double pm25 = pmBase * (noisy ? uniform(0.5, 1.5) : uniform(0.95, 1.05));
+  data.pm1_0 = (uint16_t)(pm25 * 0.7);
+  data.pm2_5 = (uint16_t)pm25;
+  data.pm10 = (uint16_t)(pm25 * 1.4);
+
+  SensorDataPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packSensorData(data, packet);
+
+  // Header and system section as createPacket() fills them
+  static const uint8_t DEVICE_ID[] = {0x24, 0x6F, 0x28, 0xA1, 0xB2, 0xC3};
+  packet.magic_version = PACKET_MAGIC_V3;
+  memcpy(packet.device_id, DEVICE_ID, sizeof(packet.device_id));
+  packet.boot_count = 7;
+  if (trace == Trace::DROPOUTS && chance(0.01)) {
+    sequence += 1 + rng() % 5;  // Dropped from the full queue
+  }
+  packet.sequence = sequence++;
+  packet.uptime_seconds = uptime;
+  packet.wifi_rssi = (int8_t)(-60 + (noisy ? (int)(rng() % 17) - 8 : (int)(rng() % 3) - 1));
+
+  // Uptime until the first sync
+  packet.timestamp = uptime;
+  if (index > syncIndex) {
+    packet.timestamp = SYNC_TIME + uptime;
+    packet.time_ms = (uint16_t)(noisy ? rng() % 1000 : 250 + rng() % 5);
+    packet.time_quality = TIME_QUALITY_DRIFT_CORRECTED;
+  }
+  return packet;
+}
+
+// ===== BENCHMARK =====
+struct TraceResult {
+  size_t samples = 0;
+  size_t frames = 0;
+  size_t batchBytes = 0;
+  size_t rawBytes = 0;
+  double batchNs = 0;
+  double rawNs = 0;
+  size_t mismatches = 0;
+};
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool samePackets(const SensorDataPacket* a, const SensorDataPacket* b, size_t count) {
+  return memcmp(a, b, count * sizeof(SensorDataPacket)) == 0;
+}
+
+static TraceResult runTrace(Trace trace, size_t samples, size_t batchSize, uint32_t seed) {
+  TraceModel model(trace, samples, seed);
+  std::vector<SensorDataPacket> packets(samples);
+  for (SensorDataPacket& packet : packets) {
+    packet = model.next();
+  }
+
+  TraceResult result;
+  result.samples = samples;
+  std::vector<uint8_t> body(std::max(BatchFrameEncoder::maxFrameSize(batchSize), batchSize * PACKET_WIRE_MAX_SIZE));
+  std::vector<SensorDataPacket> decoded(batchSize);
+
+  for (size_t first = 0; first < samples; first += batchSize) {
+    size_t count = std::min(batchSize, samples - first);
+    const SensorDataPacket* batch = &packets[first];
+
+    auto start = std::chrono::steady_clock::now();
+    size_t length = BatchFrameEncoder::encode(batch, count, body.data(), body.size());
+    result.batchNs += elapsedNs(start);
+    result.batchBytes += length;
+    result.frames++;
+    if (length == 0 || BatchFrameDecoder::decode(body.data(), length, decoded.data(), count) != count ||
+        !samePackets(batch, decoded.data(), count)) {
+      result.mismatches++;
+    }
+
+    start = std::chrono::steady_clock::now();
+    length = 0;
+    for (size_t i = 0; i < count; i++) {
+      length += PacketEncoder::encode(batch[i], body.data() + length);
+    }
+    result.rawNs += elapsedNs(start);
+    result.rawBytes += length;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+      size_t packetLength = PacketDecoder::decode(body.data() + offset, length - offset, decoded[i]);
+      offset += packetLength;
+      if (packetLength == 0) {
+        break;
+      }
+    }
+    if (offset != length || !samePackets(batch, decoded.data(), count)) {
+      result.mismatches++;
+    }
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  size_t samples = 100000;
+  size_t batchSize = BACKLOG_BATCH_SIZE;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--samples" && i + 1 < argc) {
+      samples = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batchSize = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--samples N] [--batch N] [--seed N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (samples == 0 || batchSize == 0 || batchSize > 255) {
+    fprintf(stderr, "--samples must be > 0, --batch 1..255\n");
+    return 1;
+  }
+
+  printf("%zu samples per trace, batches of %zu, struct %zu bytes\n\n", samples, batchSize,
+         sizeof(SensorDataPacket));
+  printf("%-9s %12s %12s %7s %12s %12s\n", "trace", "raw B/smp", "batch B/smp", "ratio", "raw ns/smp",
+         "batch ns/smp");
+
+  size_t mismatches = 0;
+  for (Trace trace : {Trace::STEADY, Trace::NOISY, Trace::DROPOUTS}) {
+    TraceResult result = runTrace(trace, samples, batchSize, seed);
+    printf("%-9s %12.1f %12.1f %7.2f %12.1f %12.1f\n", traceName(trace),
+           (double)result.rawBytes / result.samples, (double)result.batchBytes / result.samples,
+           (double)result.batchBytes / result.rawBytes, result.rawNs / result.samples,
+           result.batchNs / result.samples);
+    if (result.mismatches > 0) {
+      fprintf(stderr, "FAIL: %s: %zu of %zu batches do not decode to their input\n", traceName(trace),
+              result.mismatches, result.frames);
+    }
+    mismatches += result.mismatches;
+  }
+
+  if (mismatches > 0) {
+    return 1;
+  }
+  printf("\nOK: every batch frame and raw body decodes to its input packets\n");
+  return 0;
+}
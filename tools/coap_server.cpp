@@ -0,0 +1,64 @@
+// ===== COAP STAND-IN SERVER =====
+// Minimal CoAP endpoint for testing TRANSPORT_MODE TRANSPORT_COAP without
+// Node-RED. Accepts confirmable POSTs to /sensor-data, checks the v3 packet
+// and answers with a piggybacked 2.04 ACK that carries an AQIResponsePacket
+// (PM2.5 AQI only). A retransmitted request gets the stored answer again
+// instead of being counted twice (RFC 7252 4.5). The endpoint itself is
+// tools/coap_stand_in.h, which tools/coap_session_test runs against
+// CoapConnection.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -I. tools/coap_server.cpp -o coap_server -lpthread && ./coap_server
+// Options: --port N (default 5683), --drop N (ignore every Nth new request to
+// exercise the device's retransmission), --lose N (handle every Nth new
+// request but lose the answer - the retransmission is answered from the
+// exchange cache), --separate N (answer every Nth new request with an empty
+// ACK and a separate confirmable response), --reset N (reject every Nth new
+// request with an RST), --delay MS (answer late).
+
+#include "coap_stand_in.h"
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv, CoapStandInOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--port") {
+      options.port = (uint16_t)atoi(argv[++i]);
+    } else if (arg == "--drop") {
+      options.drop = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--lose") {
+      options.lose = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--separate") {
+      options.separate = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--reset") {
+      options.reset = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--delay") {
+      options.delayMs = (unsigned)atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0;
+}
+
+int main(int argc, char** argv) {
+  CoapStandInOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--port N] [--drop N] [--lose N] [--separate N] [--reset N] [--delay MS]\n",
+            argv[0]);
+    return 2;
+  }
+
+  CoapStandIn server(options);
+  if (!server.open()) {
+    perror("bind");
+    return 1;
+  }
+  printf("CoAP stand-in listening on udp/%u (coap://<host>:%u/sensor-data)\n", server.port(), server.port());
+  fflush(stdout);
+  server.serve();
+  return 0;
+}
@@ -0,0 +1,426 @@
+// ===== COAP SESSION TEST =====
+// Runs CoapConnection.h unchanged against the coap_server stand-in
+// (tools/coap_stand_in.h) in a thread; the host shim in tools/host puts
+// WiFiUDP on a POSIX UDP socket. COAP_ACK_TIMEOUT is cut to 200 ms so the
+// backoff plays out in seconds. Cases, each against its own stand-in:
+//  - plain: every POST answered in the piggybacked ACK with its own AQI,
+//    no retransmission
+//  - drop (--drop 2): every second request ignored, the retransmission
+//    comes after the randomized initial timeout and is answered
+//  - lost ACK (--lose 2): the retransmission gets the stored answer, the
+//    packet is handled once
+//  - no answer (--drop 1): 1 + COAP_MAX_RETRANSMIT datagrams, the gaps
+//    doubling from [T, 1.5T], then COAP_ERROR_TIMEOUT and a new DNS lookup
+//  - separate response (--separate 1): empty ACK at once, the 2.04 follows
+//    later as a CON - no retransmission meanwhile, the CON is ACKed
+//  - reset (--reset 1): COAP_ERROR_RESET without a retransmission
+// Then the same packet is posted over CoAP, over HTTP on one keep-alive
+// session and over HTTP with a new session per request, and the loopback
+// latency and bytes per exchange are printed.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. -Itools/host tools/coap_session_test.cpp -o coap_session_test -lpthread && ./coap_session_test
+// Options: --requests N (200, latency comparison), --verbose (DEBUG output
+// of CoapConnection and the stand-in's log).
+
+#include <Arduino.h>
+#include "config.h"
+#undef COAP_ACK_TIMEOUT
+#define COAP_ACK_TIMEOUT 200
+
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tools/coap_stand_in.h"   // Before CoapConnection.h: its constants share names with the macros there
+#include "CoapConnection.h"
+#include "HttpConnection.h"
+#include "SensorData.h"
+
+static const uint32_t T = COAP_ACK_TIMEOUT;
+static const uint32_t SLACK_MS = 60;            // Scheduling on a loaded host
+static const unsigned SEPARATE_DELAY_MS = 350;  // After the first ACK timeout
+
+static int failures = 0;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", name);
+    failures++;
+  }
+}
+
+static bool within(long value, long low, long high) {
+  return value >= low && value <= high + (long)SLACK_MS;
+}
+
+static long msBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+  return (long)std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+}
+
+// ===== PACKETS =====
+static std::vector<uint8_t> wirePacket(uint32_t sequence, uint16_t pm25) {
+  SensorData data;
+  data.temperature = 21.4f;
+  data.humidity = 48.0f;
+  data.pressure = 1013.2f;
+  data.bme68xAvailable = true;
+  data.pm1_0 = pm25 / 2;
+  data.pm2_5 = pm25;
+  data.pm10 = pm25 + 4;
+  data.pms5003Available = true;
+
+  SensorDataPacket packet = {};
+  packSensorData(data, packet);
+  packet.magic_version = PACKET_MAGIC_V3;
+  memcpy(packet.device_id, "\xA4\xCF\x12\x34\x56\x78", sizeof(packet.device_id));
+  packet.boot_count = 7;
+  packet.sequence = sequence;
+  std::vector<uint8_t> wire(PACKET_WIRE_MAX_SIZE);
+  wire.resize(PacketEncoder::encode(packet, wire.data()));
+  return wire;
+}
+
+// The AQI answer the stand-in gives for a PM2.5 value
+static std::vector<uint8_t> expectedAnswer(uint16_t pm25) {
+  return aqiResponse(pm25Aqi(pm25));
+}
+
+// ===== COAP CASES =====
+static int coapPost(CoapConnection& connection, uint32_t sequence, uint16_t pm25, bool& answered) {
+  std::vector<uint8_t> wire = wirePacket(sequence, pm25);
+  uint8_t body[16];
+  size_t length = 0;
+  int code = connection.post(wire.data(), wire.size(), body, sizeof(body), length);
+  answered = std::vector<uint8_t>(body, body + length) == expectedAnswer(pm25);
+  return code;
+}
+
+// Stand-in with these options in a thread, one connection to it
+static void withStandIn(CoapStandInOptions options,
+                        const std::function<void(CoapStandIn&, CoapConnection&)>& run) {
+  options.port = 0;
+  options.quiet = Serial.quiet;
+  CoapStandIn server(options);
+  if (!server.open()) {
+    expect(false, "stand-in: UDP socket");
+    return;
+  }
+  std::thread serving([&server] { server.serve(); });
+  std::string url = "coap://127.0.0.1:" + std::to_string(server.port()) + "/sensor-data";
+  CoapConnection connection(url.c_str());
+  run(server, connection);
+  server.stop();
+  serving.join();
+}
+
+// Arrival times of the one message id that came more than once
+static std::vector<std::chrono::steady_clock::time_point> repeated(const CoapStandInStats& stats) {
+  for (const auto& entry : stats.arrivals) {
+    if (entry.second.size() > 1) {
+      return entry.second;
+    }
+  }
+  return {};
+}
+
+static void runCoapCases() {
+  withStandIn(CoapStandInOptions(), [](CoapStandIn& server, CoapConnection& connection) {
+    bool answered = true;
+    for (uint32_t i = 0; i < 5; i++) {
+      bool own;
+      answered = coapPost(connection, i, (uint16_t)(8 + 10 * i), own) == COAP_CODE(2, 4) && own && answered;
+    }
+    const CoapConnectionStats& stats = connection.getStats();
+    expect(answered, "plain: every POST gets its own AQI");
+    expect(stats.retransmits == 0 && stats.failures == 0, "plain: no retransmission");
+    expect(stats.dnsLookups == 1, "plain: one DNS lookup");
+    expect(server.stats().handled == 5 && server.stats().duplicates == 0, "plain: handled once each");
+  });
+
+  CoapStandInOptions drop;
+  drop.drop = 2;
+  withStandIn(drop, [](CoapStandIn& server, CoapConnection& connection) {
+    bool answered = true;
+    for (uint32_t i = 0; i < 3; i++) {
+      bool own;
+      answered = coapPost(connection, i, (uint16_t)(20 + i), own) == COAP_CODE(2, 4) && own && answered;
+    }
+    const CoapConnectionStats& stats = connection.getStats();
+    CoapStandInStats seen = server.stats();
+    expect(answered, "drop: all answered");
+    expect(stats.retransmits == 2 && seen.dropped == 2, "drop: one retransmission per dropped request");
+    expect(seen.handled == 3, "drop: every packet handled once");
+    std::vector<std::chrono::steady_clock::time_point> arrivals = repeated(seen);
+    expect(arrivals.size() == 2 && within(msBetween(arrivals[0], arrivals[1]), T, T * 3 / 2),
+           "drop: retransmission after the initial timeout [T, 1.5T]");
+  });
+
+  CoapStandInOptions lose;
+  lose.lose = 2;
+  withStandIn(lose, [](CoapStandIn& server, CoapConnection& connection) {
+    bool first, second;
+    int codes[2] = {coapPost(connection, 0, 30, first), coapPost(connection, 1, 31, second)};
+    CoapStandInStats seen = server.stats();
+    expect(codes[0] == COAP_CODE(2, 4) && codes[1] == COAP_CODE(2, 4) && first && second,
+           "lost ACK: answered from the exchange cache");
+    expect(seen.lost == 1 && seen.duplicates == 1 && seen.handled == 2, "lost ACK: handled once");
+    expect(connection.getStats().retransmits == 1, "lost ACK: one retransmission");
+  });
+
+  CoapStandInOptions silent;
+  silent.drop = 1;
+  withStandIn(silent, [](CoapStandIn& server, CoapConnection& connection) {
+    bool answered;
+    int code = coapPost(connection, 0, 40, answered);
+    const CoapConnectionStats& stats = connection.getStats();
+    std::vector<std::chrono::steady_clock::time_point> arrivals = repeated(server.stats());
+    expect(code == COAP_ERROR_TIMEOUT && stats.failures == 1, "no answer: timeout reported");
+    expect(arrivals.size() == 1 + COAP_MAX_RETRANSMIT && stats.retransmits == COAP_MAX_RETRANSMIT,
+           "no answer: COAP_MAX_RETRANSMIT retransmissions");
+    if (arrivals.size() == 3) {
+      long first = msBetween(arrivals[0], arrivals[1]);
+      long second = msBetween(arrivals[1], arrivals[2]);
+      expect(within(first, T, T * 3 / 2), "no answer: first gap in [T, 1.5T]");
+      expect(within(second, 2 * T, 3 * T) && within(second, 2 * first - (long)SLACK_MS, 2 * first),
+             "no answer: gap doubles");
+      expect(within((long)stats.lastRequestMs, 7 * first - (long)SLACK_MS, 7 * first),
+             "no answer: gives up after 7x the initial timeout");
+    }
+    coapPost(connection, 1, 41, answered);
+    expect(stats.dnsLookups == 2, "no answer: host resolved again");
+  });
+
+  CoapStandInOptions separate;
+  separate.separate = 1;
+  separate.delayMs = SEPARATE_DELAY_MS;
+  withStandIn(separate, [](CoapStandIn& server, CoapConnection& connection) {
+    bool answered;
+    int code = coapPost(connection, 0, 50, answered);
+    const CoapConnectionStats& stats = connection.getStats();
+    expect(code == COAP_CODE(2, 4) && answered, "separate: response after the empty ACK");
+    expect(stats.retransmits == 0, "separate: no retransmission after the empty ACK");
+    expect(stats.lastRequestMs >= SEPARATE_DELAY_MS, "separate: waited past the first timeout");
+    for (int i = 0; i < 50 && server.stats().separateAcks == 0; i++) {
+      delay(10);
+    }
+    CoapStandInStats seen = server.stats();
+    expect(seen.separates == 1 && seen.separateAcks == 1, "separate: CON response acknowledged");
+    expect(seen.handled == 1 && seen.duplicates == 0, "separate: handled once");
+  });
+
+  CoapStandInOptions reset;
+  reset.reset = 1;
+  withStandIn(reset, [](CoapStandIn& server, CoapConnection& connection) {
+    bool answered;
+    int code = coapPost(connection, 0, 60, answered);
+    const CoapConnectionStats& stats = connection.getStats();
+    expect(code == COAP_ERROR_RESET && stats.failures == 1, "reset: COAP_ERROR_RESET");
+    expect(stats.retransmits == 0 && stats.lastRequestMs < T, "reset: no retransmission");
+    expect(server.stats().resets == 1 && server.stats().handled == 0, "reset: not handled");
+  });
+}
+
+// ===== HTTP STAND-IN =====
+// Answers POST /sensor-data with the AQI like the flow (AQI_COMBINED_RESPONSE);
+// with closeEach, every session carries one request. Counts bytes both ways.
+class HttpStandIn {
+public:
+  uint16_t port = 0;
+  bool closeEach = false;
+
+  bool start() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 8) != 0 ||
+        getsockname(listenFd, (sockaddr*)&address, &length) != 0) {
+      return false;
+    }
+    port = ntohs(address.sin_port);
+    acceptor = std::thread([this] { acceptLoop(); });
+    return true;
+  }
+
+  void stop() {
+    shutdown(listenFd, SHUT_RDWR);
+    close(listenFd);
+    acceptor.join();
+    for (std::thread& connection : connections) {
+      connection.join();
+    }
+  }
+
+  void counts(uint64_t& in, uint64_t& out) {
+    std::lock_guard<std::mutex> guard(lock);
+    in = bytesIn;
+    out = bytesOut;
+    bytesIn = bytesOut = 0;
+  }
+
+private:
+  int listenFd = -1;
+  std::thread acceptor;
+  std::vector<std::thread> connections;
+  std::mutex lock;
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+
+  void acceptLoop() {
+    int fd;
+    while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+      std::lock_guard<std::mutex> guard(lock);
+      connections.emplace_back([this, fd] { serve(fd); });
+    }
+  }
+
+  void serve(int fd) {
+    std::string buffer;
+    for (;;) {
+      size_t headerEnd;
+      while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos ||
+             buffer.size() < headerEnd + 4 + bodyLength(buffer, headerEnd)) {
+        char data[512];
+        ssize_t count = recv(fd, data, sizeof(data), 0);
+        if (count <= 0) {
+          close(fd);
+          return;
+        }
+        buffer.append(data, count);
+      }
+      size_t length = bodyLength(buffer, headerEnd);
+      WirePacket packet;
+      bool valid = inspectPacket((const uint8_t*)buffer.data() + headerEnd + 4, length, packet);
+      std::vector<uint8_t> body = valid ? aqiResponse(pm25Aqi(packet.pm25)) : std::vector<uint8_t>();
+      std::string answer = std::string(valid ? "HTTP/1.1 200 OK" : "HTTP/1.1 400 Bad Request") +
+                           "\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+                           std::to_string(body.size()) + (closeEach ? "\r\nConnection: close" : "") + "\r\n\r\n" +
+                           std::string(body.begin(), body.end());
+      send(fd, answer.data(), answer.size(), MSG_NOSIGNAL);
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        bytesIn += headerEnd + 4 + length;
+        bytesOut += answer.size();
+      }
+      buffer.erase(0, headerEnd + 4 + length);
+      if (closeEach) {
+        close(fd);
+        return;
+      }
+    }
+  }
+
+  static size_t bodyLength(const std::string& buffer, size_t headerEnd) {
+    size_t field = buffer.find("Content-Length: ");
+    return field < headerEnd ? strtoul(buffer.c_str() + field + 16, nullptr, 10) : 0;
+  }
+};
+
+// ===== LATENCY: COAP VS HTTP =====
+struct Latency {
+  double averageUs = 0;
+  double maxUs = 0;
+  double bytesPerExchange = 0;
+  bool answered = true;
+};
+
+static void timed(Latency& latency, int requests, const std::function<bool(int)>& exchange) {
+  for (int i = 0; i < requests; i++) {
+    auto start = std::chrono::steady_clock::now();
+    latency.answered = exchange(i) && latency.answered;
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    latency.averageUs += us / requests;
+    latency.maxUs = std::max(latency.maxUs, us);
+  }
+}
+
+static bool httpPost(HttpConnection& connection, int sequence) {
+  uint16_t pm25 = (uint16_t)(5 + sequence % 60);
+  std::vector<uint8_t> wire = wirePacket((uint32_t)sequence, pm25);
+  int code = connection.post("application/octet-stream", nullptr, 0, wire.data(), wire.size(), 3000);
+  String answer = code == 200 ? connection.response().getString() : String();
+  connection.finish();
+  std::vector<uint8_t> expected = expectedAnswer(pm25);
+  return std::string(answer.c_str(), answer.length()) == std::string(expected.begin(), expected.end());
+}
+
+static void runLatencyComparison(int requests) {
+  Latency coap, keepAlive, perRequest;
+
+  withStandIn(CoapStandInOptions(), [&](CoapStandIn&, CoapConnection& connection) {
+    timed(coap, requests, [&](int i) {
+      bool own;
+      return coapPost(connection, (uint32_t)i, (uint16_t)(5 + i % 60), own) == COAP_CODE(2, 4) && own;
+    });
+    const CoapConnectionStats& stats = connection.getStats();
+    coap.bytesPerExchange = (double)(stats.bytesSent + stats.bytesReceived) / requests;
+  });
+
+  HttpStandIn server;
+  if (!server.start()) {
+    expect(false, "HTTP stand-in: listen on the loopback interface");
+    return;
+  }
+  std::string url = "http://127.0.0.1:" + std::to_string(server.port) + "/sensor-data";
+  uint64_t in, out;
+  {
+    HttpConnection connection(url.c_str());
+    timed(keepAlive, requests, [&](int i) { return httpPost(connection, i); });
+    expect(connection.getStats().connects == 1, "latency: HTTP keep-alive on one session");
+  }
+  server.counts(in, out);
+  keepAlive.bytesPerExchange = (double)(in + out) / requests;
+
+  server.closeEach = true;
+  timed(perRequest, requests, [&](int i) {
+    HttpConnection connection(url.c_str());  // Resolves and connects, as before keep-alive
+    return httpPost(connection, i);
+  });
+  server.counts(in, out);
+  perRequest.bytesPerExchange = (double)(in + out) / requests;
+  server.stop();
+
+  expect(coap.answered && keepAlive.answered && perRequest.answered, "latency: every request answered");
+  printf("Loopback, %d requests of %zu B packets (payload bytes, without UDP/TCP/IP headers and TCP handshakes):\n",
+         requests, wirePacket(0, 5).size());
+  printf("  CoAP CON + piggybacked ACK   %7.1f us avg %8.1f us max %6.1f B/exchange\n",
+         coap.averageUs, coap.maxUs, coap.bytesPerExchange);
+  printf("  HTTP keep-alive session      %7.1f us avg %8.1f us max %6.1f B/exchange\n",
+         keepAlive.averageUs, keepAlive.maxUs, keepAlive.bytesPerExchange);
+  printf("  HTTP new session per request %7.1f us avg %8.1f us max %6.1f B/exchange\n",
+         perRequest.averageUs, perRequest.maxUs, perRequest.bytesPerExchange);
+}
+
+int main(int argc, char** argv) {
+  Serial.quiet = true;
+  int requests = 200;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--requests" && i + 1 < argc) {
+      requests = atoi(argv[++i]);
+    } else if (arg == "--verbose") {
+      Serial.quiet = false;
+    } else {
+      fprintf(stderr, "Usage: %s [--requests N] [--verbose]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (requests < 1) {
+    fprintf(stderr, "--requests must be > 0\n");
+    return 1;
+  }
+
+  runCoapCases();
+  runLatencyComparison(requests);
+
+  if (failures > 0) {
+    printf("FAIL: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("OK: retransmission with backoff, lost ACK, timeout, separate response, reset\n");
+  return 0;
+}
@@ -0,0 +1,391 @@
+#ifndef COAP_STAND_IN_H
+#define COAP_STAND_IN_H
+
+// ===== COAP STAND-IN =====
+// The CoAP endpoint of coap_server, shared with coap_session_test. Accepts
+// confirmable POSTs to /sensor-data, checks the v3 packet and answers with
+// a 2.04 that carries an AQIResponsePacket (PM2.5 AQI only). A
+// retransmitted request gets the stored answer again instead of being
+// counted twice (RFC 7252 4.5). Every Nth new request can be treated
+// differently to exercise the device's side:
+//  - drop: ignored, no answer is stored - the retransmission counts as new
+//  - lose: handled and stored, but the answer is not sent - the
+//    retransmission gets the stored answer
+//  - separate: an empty ACK at once, the 2.04 follows delayMs later as a
+//    confirmable separate response, repeated until the device ACKs it
+//  - reset: rejected with an RST
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stand_in.h"
+
+// ===== PROTOCOL CONSTANTS =====
+// Same values as CoapConnection.h (Arduino header)
+static const uint8_t COAP_TYPE_CON = 0;
+static const uint8_t COAP_TYPE_ACK = 2;
+static const uint8_t COAP_TYPE_RST = 3;
+static const uint8_t COAP_POST = 0x02;
+static const uint8_t COAP_CHANGED = (2 << 5) | 4;       // 2.04
+static const uint8_t COAP_BAD_REQUEST = (4 << 5) | 0;   // 4.00
+static const uint8_t COAP_NOT_FOUND = (4 << 5) | 4;     // 4.04
+static const uint8_t COAP_NOT_ALLOWED = (4 << 5) | 5;   // 4.05
+static const uint16_t OPTION_URI_PATH = 11;
+static const uint8_t FORMAT_OCTET_STREAM = 42;
+static const int EXCHANGE_LIFETIME_S = 247;             // RFC 7252 4.8.2
+static const int SEPARATE_RETRY_MS = 1000;              // Separate response not ACKed
+static const int SEPARATE_MAX_RETRANSMIT = 2;
+
+struct CoapStandInOptions {
+  uint16_t port = 5683;    // 0 = any free port
+  unsigned drop = 0;
+  unsigned lose = 0;
+  unsigned separate = 0;
+  unsigned reset = 0;
+  unsigned delayMs = 0;    // Before every answer (separate: before the response)
+  bool quiet = false;      // No line per request
+};
+
+struct CoapStandInStats {
+  unsigned requests = 0;       // New requests (not retransmissions of a stored exchange)
+  unsigned handled = 0;        // Valid packets answered 2.04
+  unsigned duplicates = 0;     // Retransmissions answered from the exchange cache
+  unsigned dropped = 0;
+  unsigned lost = 0;
+  unsigned resets = 0;
+  unsigned separates = 0;      // Separate responses sent (first copy)
+  unsigned separateAcks = 0;   // ... acknowledged by the device
+  std::map<uint16_t, std::vector<std::chrono::steady_clock::time_point>> arrivals;  // Per message id, within EXCHANGE_LIFETIME
+};
+
+// ===== REQUEST PARSING =====
+struct CoapRequest {
+  uint8_t type;
+  uint8_t code;
+  uint16_t messageId;
+  std::vector<uint8_t> token;
+  std::string path;
+  const uint8_t* payload = nullptr;
+  size_t payloadLength = 0;
+};
+
+static bool readExtended(uint16_t& field, const uint8_t* data, size_t length, size_t& offset) {
+  if (field == 13 && offset + 1 <= length) {
+    field = 13 + data[offset];
+    offset += 1;
+  } else if (field == 14 && offset + 2 <= length) {
+    field = 269 + ((data[offset] << 8) | data[offset + 1]);
+    offset += 2;
+  } else if (field >= 13) {
+    return false;
+  }
+  return true;
+}
+
+static bool parseRequest(const uint8_t* data, size_t length, CoapRequest& request) {
+  if (length < 4 || (data[0] >> 6) != 1) {
+    return false;
+  }
+  request.type = (data[0] >> 4) & 0x03;
+  uint8_t tokenLength = data[0] & 0x0F;
+  request.code = data[1];
+  request.messageId = (uint16_t)((data[2] << 8) | data[3]);
+  if (tokenLength > 8 || length < 4u + tokenLength) {
+    return false;
+  }
+  request.token.assign(data + 4, data + 4 + tokenLength);
+
+  size_t offset = 4 + tokenLength;
+  uint16_t number = 0;
+  while (offset < length) {
+    uint8_t byte = data[offset++];
+    if (byte == 0xFF) {
+      request.payload = data + offset;
+      request.payloadLength = length - offset;
+      return request.payloadLength > 0;
+    }
+    uint16_t delta = byte >> 4;
+    uint16_t optionLength = byte & 0x0F;
+    if (!readExtended(delta, data, length, offset) || !readExtended(optionLength, data, length, offset) ||
+        offset + optionLength > length) {
+      return false;
+    }
+    number += delta;
+    if (number == OPTION_URI_PATH) {
+      request.path += (request.path.empty() ? "" : "/") + std::string((const char*)data + offset, optionLength);
+    }
+    offset += optionLength;
+  }
+  return true;
+}
+
+// Piggybacked (ACK, request MID) or separate (CON, own MID) response
+static std::vector<uint8_t> buildResponse(const CoapRequest& request, uint8_t type, uint16_t messageId,
+                                          uint8_t code, const std::vector<uint8_t>& body) {
+  std::vector<uint8_t> message = {(uint8_t)(0x40 | (type << 4) | request.token.size()), code,
+                                  (uint8_t)(messageId >> 8), (uint8_t)messageId};
+  message.insert(message.end(), request.token.begin(), request.token.end());
+  if (!body.empty()) {
+    message.push_back(0xC1);  // Content-Format (12), 1 byte
+    message.push_back(FORMAT_OCTET_STREAM);
+    message.push_back(0xFF);
+    message.insert(message.end(), body.begin(), body.end());
+  }
+  return message;
+}
+
+static std::vector<uint8_t> buildEmpty(uint8_t type, uint16_t messageId) {
+  return {(uint8_t)(0x40 | (type << 4)), 0, (uint8_t)(messageId >> 8), (uint8_t)messageId};
+}
+
+// ===== SERVER =====
+// serve() runs until stop() (any thread); stats() may be read meanwhile
+class CoapStandIn {
+public:
+  explicit CoapStandIn(const CoapStandInOptions& standInOptions) : options(standInOptions) {}
+  ~CoapStandIn() {
+    if (sock >= 0) {
+      close(sock);
+    }
+  }
+
+  bool open() {
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(options.port);
+    socklen_t length = sizeof(local);
+    if (sock < 0 || bind(sock, (sockaddr*)&local, sizeof(local)) != 0 ||
+        getsockname(sock, (sockaddr*)&local, &length) != 0) {
+      return false;
+    }
+    boundPort = ntohs(local.sin_port);
+    return true;
+  }
+
+  uint16_t port() const { return boundPort; }
+  void stop() { running = false; }
+
+  CoapStandInStats stats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+  }
+
+  void serve() {
+    uint8_t buffer[1500];
+    while (running) {
+      pollfd wait = {sock, POLLIN, 0};
+      if (poll(&wait, 1, 20) == 1) {
+        sockaddr_in peer = {};
+        socklen_t peerLength = sizeof(peer);
+        ssize_t length = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr*)&peer, &peerLength);
+        if (length > 0) {
+          handleDatagram(buffer, (size_t)length, peer);
+        }
+      }
+      sendSeparateResponses();
+    }
+  }
+
+private:
+  struct Exchange {
+    std::vector<uint8_t> response;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  struct Separate {
+    sockaddr_in peer;
+    std::vector<uint8_t> message;
+    uint16_t messageId;
+    std::chrono::steady_clock::time_point due;
+    int sent = 0;
+  };
+
+  CoapStandInOptions options;
+  int sock = -1;
+  uint16_t boundPort = 0;
+  std::atomic<bool> running{true};
+  std::mutex lock;
+  CoapStandInStats counters;
+  std::map<std::string, Exchange> exchanges;  // "ip:port:mid" -> stored answer
+  std::vector<Separate> separates;            // Waiting or not yet ACKed
+  uint16_t nextMessageId = 0x8000;
+
+  void log(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    if (options.quiet) {
+      return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    fflush(stdout);
+  }
+
+  void reply(const std::vector<uint8_t>& message, const sockaddr_in& peer) {
+    sendto(sock, message.data(), message.size(), 0, (const sockaddr*)&peer, sizeof(peer));
+  }
+
+  static bool nth(unsigned every, unsigned count) { return every > 0 && count % every == 0; }
+
+  void handleDatagram(const uint8_t* buffer, size_t length, const sockaddr_in& peer) {
+    char peerText[32];
+    snprintf(peerText, sizeof(peerText), "%s:%u", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+    auto now = std::chrono::steady_clock::now();
+
+    CoapRequest request;
+    if (!parseRequest(buffer, length, request)) {
+      log("%s: malformed message (%zu bytes)\n", peerText, length);
+      if (length >= 4 && ((buffer[0] >> 4) & 0x03) == COAP_TYPE_CON) {
+        reply(buildEmpty(COAP_TYPE_RST, (uint16_t)((buffer[2] << 8) | buffer[3])), peer);
+      }
+      return;
+    }
+    if (request.type == COAP_TYPE_ACK && request.code == 0) {
+      acknowledgeSeparate(request.messageId, peerText);
+      return;
+    }
+    if (request.type != COAP_TYPE_CON) {
+      return;  // Device only sends confirmable requests
+    }
+
+    // Deduplication: same endpoint and message id within EXCHANGE_LIFETIME
+    auto expired = now - std::chrono::seconds(EXCHANGE_LIFETIME_S);
+    for (auto it = exchanges.begin(); it != exchanges.end();) {
+      it = it->second.time < expired ? exchanges.erase(it) : std::next(it);
+    }
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      for (auto it = counters.arrivals.begin(); it != counters.arrivals.end();) {
+        it = it->second.back() < expired ? counters.arrivals.erase(it) : std::next(it);
+      }
+      counters.arrivals[request.messageId].push_back(now);
+    }
+    std::string key = std::string(peerText) + ":" + std::to_string(request.messageId);
+    auto previous = exchanges.find(key);
+    if (previous != exchanges.end()) {
+      log("%s: MID %u retransmission - stored answer sent again\n", peerText, request.messageId);
+      std::lock_guard<std::mutex> guard(lock);
+      counters.duplicates++;
+      reply(previous->second.response, peer);
+      return;
+    }
+
+    unsigned received;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      received = ++counters.requests;
+    }
+    if (nth(options.drop, received)) {
+      log("%s: MID %u dropped (--drop %u)\n", peerText, request.messageId, options.drop);
+      std::lock_guard<std::mutex> guard(lock);
+      counters.dropped++;
+      return;
+    }
+    if (nth(options.reset, received)) {
+      log("%s: MID %u reset (--reset %u)\n", peerText, request.messageId, options.reset);
+      std::vector<uint8_t> rst = buildEmpty(COAP_TYPE_RST, request.messageId);
+      exchanges[key] = Exchange{rst, now};
+      std::lock_guard<std::mutex> guard(lock);
+      counters.resets++;
+      reply(rst, peer);
+      return;
+    }
+
+    uint8_t code;
+    std::vector<uint8_t> body;
+    if (request.path != "sensor-data" || request.code != COAP_POST) {
+      log("%s: MID %u rejected (code %u.%02u, path /%s)\n", peerText, request.messageId,
+          request.code >> 5, request.code & 0x1F, request.path.c_str());
+      code = request.path != "sensor-data" ? COAP_NOT_FOUND : COAP_NOT_ALLOWED;
+    } else {
+      WirePacket packet;
+      if (!inspectPacket(request.payload, request.payloadLength, packet)) {
+        log("%s: MID %u invalid packet (%zu bytes)\n", peerText, request.messageId, request.payloadLength);
+        code = COAP_BAD_REQUEST;
+      } else {
+        float aqi = pm25Aqi(packet.pm25);
+        body = aqiResponse(aqi);
+        code = COAP_CHANGED;
+        log("%s: MID %u, %zu B packet, boot %u seq %u, sections 0x%02X, PM2.5 %.0f -> AQI %.1f (level %u)\n",
+            peerText, request.messageId, packet.length, packet.bootCount, packet.sequence,
+            packet.sections, packet.pm25, aqi, body[3]);
+        std::lock_guard<std::mutex> guard(lock);
+        counters.handled++;
+      }
+    }
+
+    if (nth(options.separate, received)) {
+      // Empty ACK now (also for retransmissions), response as its own CON later
+      std::vector<uint8_t> ack = buildEmpty(COAP_TYPE_ACK, request.messageId);
+      exchanges[key] = Exchange{ack, now};
+      reply(ack, peer);
+      uint16_t messageId = nextMessageId++;
+      separates.push_back(Separate{peer, buildResponse(request, COAP_TYPE_CON, messageId, code, body), messageId,
+                                   now + std::chrono::milliseconds(options.delayMs)});
+      log("%s: MID %u acknowledged, separate response MID %u follows\n", peerText, request.messageId, messageId);
+      return;
+    }
+
+    std::vector<uint8_t> response = buildResponse(request, COAP_TYPE_ACK, request.messageId, code, body);
+    if (options.delayMs > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(options.delayMs));
+    }
+    exchanges[key] = Exchange{response, now};
+    if (nth(options.lose, received)) {
+      log("%s: MID %u answer lost (--lose %u)\n", peerText, request.messageId, options.lose);
+      std::lock_guard<std::mutex> guard(lock);
+      counters.lost++;
+      return;
+    }
+    reply(response, peer);
+  }
+
+  void acknowledgeSeparate(uint16_t messageId, const char* peerText) {
+    for (auto it = separates.begin(); it != separates.end(); ++it) {
+      if (it->messageId == messageId && it->sent > 0) {
+        log("%s: separate response MID %u acknowledged\n", peerText, messageId);
+        separates.erase(it);
+        std::lock_guard<std::mutex> guard(lock);
+        counters.separateAcks++;
+        return;
+      }
+    }
+  }
+
+  void sendSeparateResponses() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = separates.begin(); it != separates.end();) {
+      if (now < it->due) {
+        ++it;
+      } else if (it->sent > SEPARATE_MAX_RETRANSMIT) {
+        log("separate response MID %u never acknowledged\n", it->messageId);
+        it = separates.erase(it);
+      } else {
+        reply(it->message, it->peer);
+        if (it->sent++ == 0) {
+          std::lock_guard<std::mutex> guard(lock);
+          counters.separates++;
+        }
+        it->due = now + std::chrono::milliseconds(SEPARATE_RETRY_MS);
+        ++it;
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,334 @@
+// ===== COLUMN DECODER BENCHMARK =====
+// Decodes a packet archive into columns (tools/packet_columns.h) with the
+// scalar reference and the AVX2 kernel, checks that both give identical
+// columns and checksum results, and reports records/s and the time to
+// rescan one device-year (one packet per DATA_SEND_INTERVAL, 10 s).
+// With --file it scans a real archive and prints per-field statistics.
+//
+// Build and run from the repository root (Linux, x86-64 for AVX2):
+//   g++ -std=c++17 -O2 -I. tools/column_bench.cpp -o column_bench && ./column_bench --format v1
+// Options: --format v1|v2|v3 (v3), --records N (3153600 = one device-year),
+// --corrupt N (every Nth record gets a flipped byte, 0 = none),
+// --repeat N (3, best run counts), --chunk MB (4),
+// --file PATH (archive in --format instead of generated records).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "packet_columns.h"
+
+static const size_t DEVICE_YEAR_RECORDS = 365ull * 24 * 3600 / 10;
+
+struct Options {
+  ArchiveFormat format = ArchiveFormat::V3;
+  size_t records = DEVICE_YEAR_RECORDS;
+  size_t corruptEvery = 0;
+  unsigned repeat = 3;
+  size_t chunkBytes = 4u << 20;
+  std::string file;
+};
+
+static const char* formatName(ArchiveFormat format) {
+  return format == ArchiveFormat::V1 ? "v1" : format == ArchiveFormat::V2 ? "v2" : "v3";
+}
+
+// ===== ARCHIVE GENERATOR =====
+static void appendRecord(const SensorDataPacket& packet, ArchiveFormat format, std::vector<uint8_t>& archive) {
+  const uint8_t* raw = (const uint8_t*)&packet;
+  if (format == ArchiveFormat::V3) {
+    uint8_t wire[PACKET_WIRE_MAX_SIZE];
+    size_t length = PacketEncoder::encode(packet, wire);
+    archive.insert(archive.end(), wire, wire + length);
+  } else if (format == ArchiveFormat::V2) {
+    // Legacy layouts end with the system section
+    SensorDataPacket v2 = packet;
+    v2.magic_version = PACKET_MAGIC_V2;
+    uint32_t crc = Crc32::update(0, (const uint8_t*)&v2, PACKET_LEGACY_SIZE);
+    archive.insert(archive.end(), (const uint8_t*)&v2, (const uint8_t*)&v2 + PACKET_LEGACY_SIZE);
+    archive.insert(archive.end(), (const uint8_t*)&crc, (const uint8_t*)&crc + sizeof(crc));
+  } else {
+    uint8_t checksum = 0;
+    for (size_t i = PACKET_V1_BODY_START; i < PACKET_LEGACY_SIZE; i++) {
+      checksum ^= raw[i];
+    }
+    archive.insert(archive.end(), raw + PACKET_V1_BODY_START, raw + PACKET_LEGACY_SIZE);
+    archive.push_back(checksum);
+  }
+}
+
+static std::vector<uint8_t> generateArchive(const Options& options) {
+  std::mt19937 rng(12);
+  auto walk = [&rng](int value, int step, int low, int high) {
+    return std::min(high, std::max(low, value + (int)(rng() % (2 * step + 1)) - step));
+  };
+
+  SensorDataPacket p;
+  memset(&p, 0, sizeof(p));
+  p.magic_version = PACKET_MAGIC_V3;
+  uint8_t id[6] = {0x24, 0x6F, 0x28, 0x12, 0x34, 0x56};
+  memcpy(p.device_id, id, sizeof(id));
+  p.boot_count = 3;
+  p.bme_temperature = 2150;
+  p.bme_humidity = 4500;
+  p.bme_pressure = 10130;
+  p.gas_resistance = 120000;
+  p.iaq = 500;
+  p.co2_equivalent = 600;
+  p.breath_voc = 80;
+  p.pm1_0 = 4;
+  p.pm2_5 = 8;
+  p.pm10 = 12;
+  p.wifi_rssi = -60;
+
+  std::vector<uint8_t> archive;
+  archive.reserve(options.records * PACKET_WIRE_MAX_SIZE);
+  for (size_t i = 0; i < options.records; i++) {
+    p.sequence++;
+    p.timestamp = (uint32_t)(i * 10000);
+    p.uptime_seconds += 10;
+    p.bme_temperature = (int16_t)walk(p.bme_temperature, 5, -2000, 5000);
+    p.bme_humidity = (uint16_t)walk(p.bme_humidity, 20, 0, 10000);
+    p.bme_pressure = (uint16_t)walk(p.bme_pressure, 1, 9000, 11000);
+    p.gas_resistance = (uint32_t)walk((int)p.gas_resistance, 500, 1000, 1000000);
+    p.iaq = (uint16_t)walk(p.iaq, 10, 0, 5000);
+    p.static_iaq = p.iaq;
+    p.co2_equivalent = (uint16_t)walk(p.co2_equivalent, 5, 400, 5000);
+    p.breath_voc = (uint16_t)walk(p.breath_voc, 2, 0, 3000);
+    p.iaq_accuracy = p.co2_accuracy = p.voc_accuracy = (uint8_t)std::min<size_t>(3, i / 1000);
+    p.bme_flags = 1 | (p.iaq_accuracy >= 2 ? 2 : 0);
+    // Sensors drop out now and then - mixed v3 lengths
+    p.ds_flags = rng() % 8 != 0;
+    p.ds_temperature = p.ds_flags ? (int16_t)(p.bme_temperature - 50) : 0;
+    p.pms_flags = rng() % 16 != 0;
+    p.pm2_5 = (uint16_t)walk(p.pm2_5, 1, 0, 500);
+    p.wifi_rssi = (int8_t)walk(p.wifi_rssi, 1, -100, -30);
+
+    size_t recordStart = archive.size();
+    appendRecord(p, options.format, archive);
+    if (options.corruptEvery != 0 && i % options.corruptEvery == options.corruptEvery - 1) {
+      // Payload byte, keeps the v3 magic and bitmap intact so the record still indexes
+      archive[recordStart + PacketDecoder::HEADER_SIZE + 2] ^= 0x40;
+    }
+  }
+  return archive;
+}
+
+// ===== DECODE PASSES =====
+struct ScanResult {
+  size_t records = 0;
+  size_t invalid = 0;
+  size_t used = 0;
+  double checksum = 0;   // Sum over all columns, keeps the work observable
+};
+
+static ScanResult scan(const std::vector<uint8_t>& archive, const Options& options,
+                       ColumnDecoder::Kernel kernel, PacketColumns& columns) {
+  ScanResult result;
+  while (result.used < archive.size()) {
+    size_t length = std::min(options.chunkBytes, archive.size() - result.used);
+    size_t used = ColumnDecoder::decode(archive.data() + result.used, length, options.format, columns, kernel);
+    if (used == 0) {
+      break;  // Damaged v3 stream or trailing bytes
+    }
+    result.used += used;
+    result.records += columns.size();
+    result.invalid += columns.invalidCount();
+    const float* temperature = columns.scaled(fieldIndex("bme_temperature"));
+    const uint32_t* sequence = columns.raw(fieldIndex("sequence"));
+    for (size_t i = 0; i < columns.size(); i++) {
+      result.checksum += temperature[i] + sequence[i];
+    }
+  }
+  return result;
+}
+
+static bool sameColumns(const PacketColumns& a, const PacketColumns& b) {
+  size_t n = a.size();
+  if (n != b.size() || memcmp(a.valid(), b.valid(), n) != 0 || memcmp(a.sections(), b.sections(), n) != 0 ||
+      memcmp(a.deviceId(), b.deviceId(), n * sizeof(uint64_t)) != 0) {
+    return false;
+  }
+  for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+    if ((a.raw(f) != nullptr && memcmp(a.raw(f), b.raw(f), n * sizeof(uint32_t)) != 0) ||
+        (a.scaled(f) != nullptr && memcmp(a.scaled(f), b.scaled(f), n * sizeof(float)) != 0)) {
+      fprintf(stderr, "column %s differs\n", PACKET_SCHEMA[f].name);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Scalar and AVX2 columns must match bit for bit, and both must agree with
+// the per-packet decoder on checksum results
+static bool verify(const std::vector<uint8_t>& archive, const Options& options) {
+  PacketColumns reference;
+  PacketColumns fast;
+  size_t offset = 0;
+  while (offset < archive.size()) {
+    size_t length = std::min(options.chunkBytes, archive.size() - offset);
+    size_t used = ColumnDecoder::decode(archive.data() + offset, length, options.format, reference,
+                                        ColumnDecoder::SCALAR);
+    ColumnDecoder::decode(archive.data() + offset, length, options.format, fast, ColumnDecoder::bestKernel());
+    if (used == 0 || !sameColumns(reference, fast)) {
+      fprintf(stderr, "mismatch in chunk at byte %zu\n", offset);
+      return false;
+    }
+    if (options.format == ArchiveFormat::V3) {
+      size_t record = 0;
+      for (size_t i = 0; i < reference.size(); i++) {
+        SensorDataPacket packet;
+        size_t decoded = PacketDecoder::decode(archive.data() + offset + record, used - record, packet);
+        record += PacketDecoder::wireLength(archive.data() + offset + record, used - record);
+        if ((decoded != 0) != (reference.valid()[i] != 0)) {
+          fprintf(stderr, "checksum result differs from PacketDecoder at record %zu\n", i);
+          return false;
+        }
+      }
+    }
+    offset += used;
+  }
+  return true;
+}
+
+static double timeScan(const std::vector<uint8_t>& archive, const Options& options, ColumnDecoder::Kernel kernel,
+                       ScanResult& result) {
+  PacketColumns columns;
+  double best = 1e30;
+  for (unsigned run = 0; run < options.repeat; run++) {
+    auto start = std::chrono::steady_clock::now();
+    result = scan(archive, options, kernel, columns);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    best = std::min(best, seconds);
+  }
+  return best;
+}
+
+static void printStatistics(const std::vector<uint8_t>& archive, const Options& options) {
+  std::vector<double> sum(PACKET_FIELD_COUNT, 0);
+  std::vector<double> low(PACKET_FIELD_COUNT, INFINITY);
+  std::vector<double> high(PACKET_FIELD_COUNT, -INFINITY);
+  std::vector<size_t> seen(PACKET_FIELD_COUNT, 0);
+  PacketColumns columns;
+  ScanResult result;
+
+  while (result.used < archive.size()) {
+    size_t length = std::min(options.chunkBytes, archive.size() - result.used);
+    size_t used = ColumnDecoder::decode(archive.data() + result.used, length, options.format, columns);
+    if (used == 0) {
+      break;
+    }
+    result.used += used;
+    result.records += columns.size();
+    result.invalid += columns.invalidCount();
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      if (columns.raw(f) == nullptr) {
+        continue;
+      }
+      for (size_t i = 0; i < columns.size(); i++) {
+        // Valid records that carry the field's section
+        if (!columns.valid()[i] || !(columns.sections()[i] & (1 << field.section))) {
+          continue;
+        }
+        double value = field.scale != 1 ? columns.scaled(f)[i]
+                     : isSignedField(field.type) ? (double)(int32_t)columns.raw(f)[i] : (double)columns.raw(f)[i];
+        sum[f] += value;
+        low[f] = std::min(low[f], value);
+        high[f] = std::max(high[f], value);
+        seen[f]++;
+      }
+    }
+  }
+
+  printf("%s: %zu records, %zu invalid, %zu of %zu bytes decoded\n", options.file.c_str(), result.records,
+         result.invalid, result.used, archive.size());
+  printf("%-18s %10s %14s %14s %14s\n", "field", "count", "min", "mean", "max");
+  for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+    if (seen[f] > 0) {
+      printf("%-18s %10zu %14.2f %14.2f %14.2f %s\n", PACKET_SCHEMA[f].name, seen[f], low[f], sum[f] / seen[f],
+             high[f], PACKET_SCHEMA[f].unit);
+    }
+  }
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--records") {
+      options.records = (size_t)atol(value.c_str());
+    } else if (arg == "--corrupt") {
+      options.corruptEvery = (size_t)atol(value.c_str());
+    } else if (arg == "--repeat") {
+      options.repeat = (unsigned)atoi(value.c_str());
+    } else if (arg == "--chunk") {
+      options.chunkBytes = (size_t)atol(value.c_str()) << 20;
+    } else if (arg == "--file") {
+      options.file = value;
+    } else if (arg == "--format") {
+      if (value == "v1") options.format = ArchiveFormat::V1;
+      else if (value == "v2") options.format = ArchiveFormat::V2;
+      else if (value == "v3") options.format = ArchiveFormat::V3;
+      else return false;
+    } else {
+      return false;
+    }
+  }
+  return options.records > 0 && options.repeat > 0 && options.chunkBytes > 0 && options.chunkBytes < (2u << 30);
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--format v1|v2|v3] [--records N] [--corrupt N] [--repeat N] [--chunk MB]\n"
+                    "       [--file PATH]\n", argv[0]);
+    return 2;
+  }
+
+  if (!options.file.empty()) {
+    std::ifstream in(options.file, std::ios::binary);
+    if (!in) {
+      perror(options.file.c_str());
+      return 1;
+    }
+    std::vector<uint8_t> archive((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    printStatistics(archive, options);
+    return 0;
+  }
+
+  std::vector<uint8_t> archive = generateArchive(options);
+  printf("%s archive: %zu records, %.1f MB\n", formatName(options.format), options.records, archive.size() / 1e6);
+
+  if (!verify(archive, options)) {
+    return 1;
+  }
+  printf("verify: %s columns match scalar, checksums match PacketDecoder\n",
+         ColumnDecoder::kernelName(ColumnDecoder::bestKernel()));
+
+  ColumnDecoder::Kernel kernels[] = {ColumnDecoder::SCALAR, ColumnDecoder::bestKernel()};
+  ScanResult results[2];
+  double seconds[2];
+  for (size_t k = 0; k < 2; k++) {
+    seconds[k] = timeScan(archive, options, kernels[k], results[k]);
+    double perYear = seconds[k] / results[k].records * DEVICE_YEAR_RECORDS;
+    printf("%-7s %8.1f ms  %7.1f M records/s  %6.2f GB/s  %6.1f ms per device-year  invalid %zu\n",
+           ColumnDecoder::kernelName(kernels[k]), seconds[k] * 1e3, results[k].records / seconds[k] / 1e6,
+           results[k].used / seconds[k] / 1e9, perYear * 1e3, results[k].invalid);
+  }
+  if (results[0].checksum != results[1].checksum || results[0].invalid != results[1].invalid) {
+    fprintf(stderr, "kernels disagree\n");
+    return 1;
+  }
+  printf("speedup %.2fx\n", seconds[0] / seconds[1]);
+  return 0;
+}
@@ -0,0 +1,970 @@
+// ===== FLEET SIMULATOR =====
+// Emulates a fleet of monitors against the ingest side (Node-RED flow or
+// tools/ingest_server) for capacity planning. Every virtual device runs
+// the firmware's sending logic with its constants from config.h:
+//  - a sample every DATA_SEND_INTERVAL plus loop jitter, readings from a
+//    sensor model (diurnal temperature, random walks, pollution events)
+//    packed once by packSensorData() like loop() and createPacket(),
+//    stamped with the host clock as synced device time (time section)
+//  - send-on-change (SEND_ON_CHANGE, off by default): the firmware's
+//    SendFilter skips samples within the deadbands, the AQI class is the
+//    level of the local AQI
+//  - one request at a time, like the network task: the live packet on the
+//    send connection with the binary AQI answer (AQI_COMBINED_RESPONSE), or
+//    /sensor-data followed by /calculate-aqi on a second connection (--split)
+//  - WiFi outages: samples go to the backlog, which is uploaded in batch
+//    frames of BACKLOG_BATCH_SIZE every BACKLOG_DRAIN_INTERVAL once the
+//    device is back; failed live uploads end up there as well
+//  - PMS5003 read failures, devices without DS18B20, reboots
+// Reports throughput, error rates by cause and latency histograms per
+// request type.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/fleet_sim.cpp -o fleet_sim && ./fleet_sim --devices 5000 --duration 120
+// Options: --host H (127.0.0.1), --port N (1880), --devices N (1000),
+// --duration S (60), --interval MS (DATA_SEND_INTERVAL), --jitter PCT (5),
+// --split (two requests per sample), --outages PCT (0.1, chance per sample
+// that WiFi drops), --outage-s S (60, mean outage), --sensor-faults PCT (1),
+// --reboots PCT (0.01), --send-on-change 0|1 (SEND_ON_CHANGE),
+// --report S (10, 0 = summary only), --seed N (1).
+// Two connections per device with --split: raise ulimit -n accordingly.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "SensorData.h"
+#include "SendFilter.h"
+#include "AQIEngine.h"
+#include "ClockMapping.h"
+
+static const size_t BACKLOG_CAPACITY = BACKLOG_SEGMENT_RECORDS * BACKLOG_MAX_SEGMENTS;
+static const int64_t SEND_TIMEOUT_US = 5000 * 1000;   // sendConnection.post(..., 5000)
+static const int64_t AQI_TIMEOUT_US = 3000 * 1000;    // aqiConnection.post(..., 3000)
+static const int64_t BOOT_US = 8 * 1000000LL;         // Reboot until the first sample
+static const uint8_t AQI_RESPONSE_MAGIC = 0xA1;
+static const size_t MAX_CONNECTING = 256;             // Parallel TCP handshakes
+static const double PI = 3.14159265358979323846;
+
+struct Options {
+  std::string host = "127.0.0.1";
+  uint16_t port = 1880;
+  size_t devices = 1000;
+  unsigned durationS = 60;
+  unsigned intervalMs = DATA_SEND_INTERVAL;
+  double jitter = 0.05;
+  bool split = !AQI_COMBINED_RESPONSE;
+  double outages = 0.001;
+  double outageS = 60;
+  double sensorFaults = 0.01;
+  double reboots = 0.0001;
+  bool sendOnChange = SEND_ON_CHANGE;
+  unsigned reportS = 10;
+  unsigned seed = 1;
+};
+
+static int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ===== LATENCY HISTOGRAM =====
+// Log-linear buckets: 4 per power of two from 16 us up to ~130 s
+class Histogram {
+public:
+  static const size_t SUB = 4;
+  static const size_t BUCKETS = 23 * SUB;
+
+  void add(int64_t us) {
+    counts[bucket(us)]++;
+    total++;
+    maxUs = std::max(maxUs, us);
+  }
+  uint64_t count() const { return total; }
+  int64_t max() const { return maxUs; }
+
+  // Upper bound of the bucket holding the p-th percentile
+  double percentileMs(double p) const {
+    uint64_t rank = (uint64_t)std::ceil(p / 100 * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if (seen >= rank && seen > 0) {
+        return std::min<double>(upperUs(i), (double)maxUs) / 1000.0;
+      }
+    }
+    return 0;
+  }
+
+  void print(const char* name) const {
+    if (total == 0) {
+      return;
+    }
+    printf("\n%s latency:\n", name);
+    uint64_t peak = *std::max_element(counts, counts + BUCKETS);
+    size_t first = 0;
+    size_t last = BUCKETS - 1;
+    while (counts[first] == 0) first++;
+    while (counts[last] == 0) last--;
+    // Two buckets per row keep the chart short
+    for (size_t i = first & ~(size_t)1; i <= last; i += 2) {
+      uint64_t n = counts[i] + (i + 1 < BUCKETS ? counts[i + 1] : 0);
+      int bar = (int)std::ceil(40.0 * n / (2 * peak));
+      printf("  <%9.3f ms %10llu %s\n", upperUs(std::min(i + 1, BUCKETS - 1)) / 1000.0,
+             (unsigned long long)n, std::string((size_t)bar, '#').c_str());
+    }
+  }
+
+private:
+  uint64_t counts[BUCKETS] = {};
+  uint64_t total = 0;
+  int64_t maxUs = 0;
+
+  static size_t bucket(int64_t us) {
+    if (us < 16) {
+      return 0;
+    }
+    int power = 63 - __builtin_clzll((uint64_t)us);    // 2^power <= us
+    size_t sub = (size_t)((us >> (power - 2)) & 3);     // Next two bits
+    return std::min(BUCKETS - 1, (size_t)(power - 4) * SUB + sub);
+  }
+  static double upperUs(size_t index) {
+    int power = (int)(index / SUB) + 4;
+    return std::ldexp(1.0 + (index % SUB + 1) / 4.0, power);
+  }
+};
+
+// ===== REQUEST STATISTICS =====
+enum RequestKind { REQUEST_LIVE, REQUEST_AQI, REQUEST_BACKLOG, REQUEST_KIND_COUNT };
+enum Outcome { OUTCOME_OK, OUTCOME_CONNECT, OUTCOME_TIMEOUT, OUTCOME_CLOSED, OUTCOME_4XX, OUTCOME_5XX,
+               OUTCOME_BODY, OUTCOME_COUNT };
+
+static const char* const REQUEST_NAMES[REQUEST_KIND_COUNT] = {"live", "aqi", "backlog"};
+static const char* const OUTCOME_NAMES[OUTCOME_COUNT] = {"ok", "connect", "timeout", "closed", "4xx", "5xx",
+                                                         "body"};
+
+struct RequestStats {
+  uint64_t outcomes[OUTCOME_COUNT] = {};
+  uint64_t packets = 0;   // Delivered (ok) packets
+  Histogram latency;      // Successful requests, incl. connect
+
+  uint64_t total() const {
+    uint64_t sum = 0;
+    for (uint64_t n : outcomes) sum += n;
+    return sum;
+  }
+};
+
+// ===== SENSOR MODEL =====
+// Indoor readings that look like a real room: temperature follows the time
+// of day, humidity and pressure wander, now and then someone cooks (IAQ
+// and PM go up, then decay). BSEC accuracy depends on the uptime like on
+// the device.
+class SensorModel {
+public:
+  void init(std::mt19937& rng, bool hasDs18b20);
+  void read(std::mt19937& rng, double dayFraction, uint32_t uptimeS, bool pmsFault, SensorData& data);
+  int8_t rssi() const { return baseRssi; }
+
+private:
+  double baseTemperature = 21;
+  double humidity = 45;
+  double pressure = 1013;
+  double gasResistance = 120000;
+  double pollution = 0;     // Event level 0..1, decays
+  double pmBase = 5;
+  bool ds18b20 = false;
+  int8_t baseRssi = -60;
+
+  static double uniform(std::mt19937& rng, double low, double high) {
+    return std::uniform_real_distribution<double>(low, high)(rng);
+  }
+};
+
+void SensorModel::init(std::mt19937& rng, bool hasDs18b20) {
+  baseTemperature = uniform(rng, 19, 24);
+  humidity = uniform(rng, 35, 60);
+  pressure = uniform(rng, 995, 1030);
+  gasResistance = uniform(rng, 60000, 250000);
+  pmBase = uniform(rng, 2, 15);
+  ds18b20 = hasDs18b20;
+  baseRssi = (int8_t)uniform(rng, -85, -45);
+}
+
+void SensorModel::read(std::mt19937& rng, double dayFraction, uint32_t uptimeS, bool pmsFault, SensorData& data) {
+  // Pollution event: rare start, exponential decay
+  if (uniform(rng, 0, 1) < 0.0005) {
+    pollution = uniform(rng, 0.3, 1.0);
+  }
+  pollution *= 0.995;
+
+  humidity = std::min(90.0, std::max(15.0, humidity + uniform(rng, -0.2, 0.2) + pollution * 0.05));
+  pressure = std::min(1050.0, std::max(960.0, pressure + uniform(rng, -0.05, 0.05)));
+  gasResistance = std::min(400000.0, std::max(5000.0, gasResistance * (1 + uniform(rng, -0.01, 0.01))
+                                                      * (1 - pollution * 0.01)));
+
+  // Coolest around 3:00, warmest around 15:00
+  double temperature = baseTemperature + 1.5 * std::sin(2 * PI * (dayFraction - 0.375)) + uniform(rng, -0.05, 0.05);
+  double iaq = std::min(500.0, 25 + 30 * std::log(250000 / gasResistance) + pollution * 250);
+
+  data.bme68xAvailable = true;
+  data.temperature = (float)temperature;
+  data.humidity = (float)humidity;
+  data.pressure = (float)pressure;
+  data.gasResistance = (float)gasResistance;
+  data.iaq = (float)std::max(0.0, iaq);
+  data.staticIaq = (float)std::max(0.0, iaq * 0.95);
+  data.co2Equivalent = (float)(450 + std::max(0.0, iaq) * 6);
+  data.breathVocEquivalent = (float)(0.5 + std::max(0.0, iaq) / 50);
+
+  // BSEC: no accuracy in the first 5 minutes, calibrated after ~30
+  uint8_t accuracy = uptimeS < 300 ? 0 : uptimeS < 1800 ? 1 : 3;
+  data.iaqAccuracy = data.staticIaqAccuracy = data.co2Accuracy = data.breathVocAccuracy = accuracy;
+  data.bsecCalibrated = accuracy == 3;
+
+  data.ds18b20Available = ds18b20;
+  data.externalTemp = ds18b20 ? (float)(temperature - 0.4 + uniform(rng, -0.1, 0.1)) : 0.0f;
+
+  data.pms5003Available = !pmsFault;
+  double pm25 = pmBase * (1 + pollution * 8) * uniform(rng, 0.9, 1.1);
+  data.pm1_0 = (uint16_t)(pm25 * 0.7);
+  data.pm2_5 = (uint16_t)pm25;
+  data.pm10 = (uint16_t)(pm25 * 1.4);
+}
+
+// ===== SIMULATED DEVICE =====
+struct Connection {
+  int fd = -1;
+  bool connecting = false;
+  std::string out;
+  size_t outOffset = 0;
+  std::string in;
+};
+
+struct Device {
+  uint8_t id[6];
+  uint16_t bootCount = 1;
+  uint32_t sequence = 0;
+  int64_t bootUs = 0;        // Steady clock at boot (before the start, or ahead while rebooting)
+  SensorModel model;
+  SendFilter filter;
+  bool online = true;
+  int64_t offlineUntil = 0;
+  std::deque<SensorDataPacket> queue;     // NET_QUEUE_LENGTH
+  std::deque<SensorDataPacket> backlog;   // PacketStore
+  int64_t lastDrainUs = 0;
+  bool drainTimer = false;
+  Connection connections[2];              // sendConnection, aqiConnection
+
+  // Request in flight (one at a time, like the network task)
+  bool busy = false;
+  RequestKind kind = REQUEST_LIVE;
+  uint32_t requestId = 0;
+  int64_t requestStart = 0;
+  size_t requestPackets = 0;
+  SensorDataPacket current;
+};
+
+class Fleet {
+public:
+  explicit Fleet(const Options& options)
+    : options(options), devices(options.devices), rng(options.seed) {}
+  int run();
+
+private:
+  enum TimerKind { TIMER_SAMPLE, TIMER_ONLINE, TIMER_DRAIN, TIMER_TIMEOUT };
+  struct Timer {
+    int64_t due;
+    size_t device;
+    TimerKind kind;
+    uint32_t requestId;
+    bool operator>(const Timer& other) const { return due > other.due; }
+  };
+
+  const Options& options;
+  std::vector<Device> devices;
+  std::mt19937 rng;
+  sockaddr_storage address = {};
+  socklen_t addressLength = 0;
+  int epollFd = -1;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+  std::deque<std::pair<size_t, int>> connectQueue;   // Device, connection
+  size_t connecting = 0;
+
+  int64_t startUs = 0;
+  RequestStats stats[REQUEST_KIND_COUNT];
+  RequestStats window[REQUEST_KIND_COUNT];   // Since the last progress line
+  uint64_t samples = 0;
+  uint64_t suppressed = 0;       // Skipped by send-on-change
+  uint64_t stored = 0;           // Samples that went to the backlog
+  uint64_t queueDrops = 0;
+  uint64_t backlogDrops = 0;
+  uint64_t outageCount = 0;
+  uint64_t rebootCount = 0;
+  uint64_t aqiAnswers = 0;
+
+  bool resolve();
+  void initDevice(size_t index);
+  void schedule(size_t index, int64_t due, TimerKind kind, uint32_t requestId = 0);
+  void onTimer(const Timer& timer);
+  void sample(size_t index);
+  void store(Device& device, const SensorDataPacket& packet);
+  void pump(size_t index);
+  void startRequest(size_t index, RequestKind kind);
+  void startConnect(size_t index, int which);
+  void onConnected(size_t index, int which);
+  void flush(size_t index, int which);
+  void readable(size_t index, int which);
+  void finish(size_t index, Outcome outcome, const std::string& body);
+  void closeConnection(size_t index, int which);
+  void goOffline(size_t index, int64_t until, bool keepCurrent);
+  void record(RequestKind kind, Outcome outcome, int64_t latencyUs, size_t packets);
+  void progress(int64_t now);
+  void report() const;
+};
+
+bool Fleet::resolve() {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  std::string port = std::to_string(options.port);
+  if (getaddrinfo(options.host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr) {
+    return false;
+  }
+  memcpy(&address, result->ai_addr, result->ai_addrlen);
+  addressLength = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+void Fleet::initDevice(size_t index) {
+  Device& device = devices[index];
+  uint8_t id[6] = {0x24, 0x6F, 0x28, (uint8_t)(index >> 16), (uint8_t)(index >> 8), (uint8_t)index};
+  memcpy(device.id, id, sizeof(id));
+  device.bootCount = (uint16_t)(1 + rng() % 50);
+  // Booted up to a day ago: mixed BSEC accuracy, no synchronized start
+  device.bootUs = startUs - (int64_t)(rng() % 86400) * 1000000;
+  device.sequence = (uint32_t)((startUs - device.bootUs) / ((int64_t)options.intervalMs * 1000));
+  device.model.init(rng, index % 4 != 0);  // Not every device has the DS18B20
+
+  // Devices boot at random times: spread the first sample over one interval
+  schedule(index, startUs + (int64_t)(rng() % (options.intervalMs * 1000ull)), TIMER_SAMPLE);
+}
+
+void Fleet::schedule(size_t index, int64_t due, TimerKind kind, uint32_t requestId) {
+  timers.push(Timer{due, index, kind, requestId});
+}
+
+void Fleet::onTimer(const Timer& timer) {
+  Device& device = devices[timer.device];
+  switch (timer.kind) {
+    case TIMER_SAMPLE:
+      sample(timer.device);
+      break;
+    case TIMER_ONLINE:
+      if (!device.online && nowUs() >= device.offlineUntil) {
+        device.online = true;
+        pump(timer.device);
+      }
+      break;
+    case TIMER_DRAIN:
+      device.drainTimer = false;
+      pump(timer.device);
+      break;
+    case TIMER_TIMEOUT:
+      if (device.busy && device.requestId == timer.requestId) {
+        finish(timer.device, OUTCOME_TIMEOUT, std::string());
+      }
+      break;
+  }
+}
+
+void Fleet::sample(size_t index) {
+  Device& device = devices[index];
+  int64_t now = nowUs();
+  std::uniform_real_distribution<double> chance(0, 1);
+
+  // Main loop: the send deadline is armed when a sample is queued, and the
+  // next one waits for the following BSEC output, so the interval stretches and jitters
+  double jitter = options.jitter * options.intervalMs * 1000 * (2 * chance(rng) - 1);
+  schedule(index, now + (int64_t)(options.intervalMs * 1000 + jitter), TIMER_SAMPLE);
+  if (now < device.bootUs) {
+    return;  // Still rebooting
+  }
+
+  if (chance(rng) < options.reboots) {
+    // Restart: new boot count, sequence and uptime from 0, backlog survives
+    rebootCount++;
+    device.bootCount++;
+    device.sequence = 0;
+    device.filter = SendFilter();
+    device.bootUs = now + BOOT_US;
+    device.queue.clear();
+    goOffline(index, now + BOOT_US, false);
+    return;
+  }
+  if (device.online && chance(rng) < options.outages) {
+    outageCount++;
+    std::exponential_distribution<double> duration(1.0 / options.outageS);
+    goOffline(index, now + (int64_t)(duration(rng) * 1e6), true);
+  }
+
+  // createPacket()
+  uint32_t uptimeS = (uint32_t)((now - device.bootUs) / 1000000);
+  auto wall = std::chrono::system_clock::now().time_since_epoch();
+  double dayFraction = std::fmod(std::chrono::duration<double>(wall).count() / 86400.0, 1.0);
+  SensorData data;
+  device.model.read(rng, dayFraction, uptimeS, chance(rng) < options.sensorFaults, data);
+  samples++;
+
+  // loop(): one conversion per sample, shared by AQI, send filter and packet
+  SensorDataPacket sample = {};
+  packSensorData(data, sample);
+
+  // queueData(): unchanged samples are skipped before a sequence number is used
+  AQILevel aqiClass = AQI_LEVEL_UNKNOWN;
+  if (options.sendOnChange) {
+    // Level of the local AQI, as calculateLocalAQI() (AQI_LOCAL)
+    aqiClass = AQIEngine::combined(sample).level;
+    if (!device.filter.shouldSend(sample, aqiClass, (uint32_t)(now / 1000))) {
+      suppressed++;
+      return;
+    }
+  }
+
+  SensorDataPacket packet = sample;
+  packet.magic_version = PACKET_MAGIC_V3;
+  memcpy(packet.device_id, device.id, sizeof(packet.device_id));
+  packet.boot_count = device.bootCount;
+  packet.sequence = device.sequence++;
+  packet.uptime_seconds = uptimeS;
+  packet.wifi_rssi = (int8_t)(device.model.rssi() + (int)(rng() % 5) - 2);
+  // WallClock::stamp(): the simulated devices have SNTP time
+  int64_t wallMs = std::chrono::duration_cast<std::chrono::milliseconds>(wall).count();
+  packet.timestamp = (uint32_t)(wallMs / 1000);
+  packet.time_ms = (uint16_t)(wallMs % 1000);
+  packet.time_quality = TIME_QUALITY_DRIFT_CORRECTED;
+
+  // queueData(): never blocks, a full queue drops the sample - and leaves the
+  // filter reference where it was
+  if (device.online && device.queue.size() >= NET_QUEUE_LENGTH) {
+    queueDrops++;
+    return;
+  }
+  if (options.sendOnChange) {
+    device.filter.markSent(sample, aqiClass, (uint32_t)(now / 1000));
+  }
+  if (!device.online) {
+    store(device, packet);
+  } else {
+    device.queue.push_back(packet);
+    pump(index);
+  }
+}
+
+void Fleet::store(Device& device, const SensorDataPacket& packet) {
+  // PacketStore drops the oldest segment when full
+  if (device.backlog.size() >= BACKLOG_CAPACITY) {
+    size_t drop = std::min<size_t>(BACKLOG_SEGMENT_RECORDS, device.backlog.size());
+    device.backlog.erase(device.backlog.begin(), device.backlog.begin() + drop);
+    backlogDrops += drop;
+  }
+  device.backlog.push_back(packet);
+  stored++;
+}
+
+void Fleet::goOffline(size_t index, int64_t until, bool keepCurrent) {
+  Device& device = devices[index];
+  if (device.busy) {
+    // Lost with the link: a live packet goes to the backlog (not on a
+    // reboot, it was only in RAM), a backlog batch is read again later
+    if (device.kind == REQUEST_LIVE && keepCurrent) {
+      store(device, device.current);
+    }
+    device.busy = false;
+    device.requestId++;
+  }
+  closeConnection(index, 0);
+  closeConnection(index, 1);
+  device.online = false;
+  device.offlineUntil = std::max(device.offlineUntil, until);
+  schedule(index, until, TIMER_ONLINE);
+}
+
+void Fleet::pump(size_t index) {
+  Device& device = devices[index];
+  if (device.busy || !device.online) {
+    return;
+  }
+  if (!device.queue.empty()) {
+    device.current = device.queue.front();
+    device.queue.pop_front();
+    startRequest(index, REQUEST_LIVE);
+    return;
+  }
+  if (device.backlog.empty()) {
+    return;
+  }
+  // Live samples first: drain only while none is waiting, rate limited
+  int64_t due = device.lastDrainUs + BACKLOG_DRAIN_INTERVAL * 1000LL;
+  if (nowUs() >= due) {
+    startRequest(index, REQUEST_BACKLOG);
+  } else if (!device.drainTimer) {
+    device.drainTimer = true;
+    schedule(index, due, TIMER_DRAIN);
+  }
+}
+
+void Fleet::startRequest(size_t index, RequestKind kind) {
+  Device& device = devices[index];
+  static uint8_t body[BatchFrameEncoder::maxFrameSize(BACKLOG_BATCH_SIZE) + BACKLOG_BATCH_SIZE * PACKET_WIRE_MAX_SIZE];
+  size_t length = 0;
+  char headers[256];
+  const char* path = "/sensor-data";
+  const char* type = "application/octet-stream";
+  int which = 0;
+  int64_t now = nowUs();
+  uint32_t uptimeS = (uint32_t)((now - device.bootUs) / 1000000);
+  device.requestPackets = 1;
+
+  if (kind == REQUEST_LIVE) {
+    length = PacketEncoder::encode(device.current, body);
+    snprintf(headers, sizeof(headers), "X-Packet-Size: %zu\r\nX-Device-Uptime: %u\r\nX-Boot-Count: %u\r\n%s",
+             length, uptimeS, device.bootCount, options.split ? "" : "X-AQI-Response: binary\r\n");
+  } else if (kind == REQUEST_AQI) {
+    const SensorDataPacket& p = device.current;
+    length = (size_t)snprintf((char*)body, 128, "{\"pm2_5\":%u,\"pm10\":%u,\"iaq\":%g,\"co2\":%u,\"calibrated\":%s}",
+                              p.pm2_5, p.pm10, p.iaq / 10.0, p.co2_equivalent, p.bme_flags & 2 ? "true" : "false");
+    path = "/calculate-aqi";
+    type = "application/json";
+    headers[0] = '\0';
+    which = 1;
+  } else {
+    // drainBacklog(): oldest first, acknowledged on 2xx
+    device.lastDrainUs = now;
+    SensorDataPacket batch[BACKLOG_BATCH_SIZE];
+    size_t count = std::min<size_t>(BACKLOG_BATCH_SIZE, device.backlog.size());
+    std::copy(device.backlog.begin(), device.backlog.begin() + count, batch);
+    const char* format = "raw";
+#if BACKLOG_BATCH_FRAMES
+    length = BatchFrameEncoder::encode(batch, count, body, sizeof(body));
+    format = length > 0 ? "batch" : "raw";
+#endif
+    if (length == 0) {
+      for (size_t i = 0; i < count; i++) {
+        length += PacketEncoder::encode(batch[i], body + length);
+      }
+    }
+    snprintf(headers, sizeof(headers), "X-Packet-Format: %s\r\nX-Backlog: %zu\r\nX-Device-Uptime: %u\r\n"
+             "X-Boot-Count: %u\r\n", format, count, uptimeS, device.bootCount);
+    device.requestPackets = count;
+  }
+
+  Connection& connection = device.connections[which];
+  char request[512];
+  int headerLength = snprintf(request, sizeof(request), "POST %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n"
+                              "Content-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                              path, options.host.c_str(), type, length, headers);
+  connection.out.assign(request, (size_t)headerLength);
+  connection.out.append((const char*)body, length);
+  connection.outOffset = 0;
+  connection.in.clear();
+
+  device.busy = true;
+  device.kind = kind;
+  device.requestId++;
+  device.requestStart = now;
+  schedule(index, now + (kind == REQUEST_AQI ? AQI_TIMEOUT_US : SEND_TIMEOUT_US), TIMER_TIMEOUT, device.requestId);
+
+  if (connection.fd < 0) {
+    // HttpConnection reconnects on demand; handshakes are rate limited here
+    connectQueue.push_back(std::make_pair(index, which));
+  } else if (!connection.connecting) {
+    flush(index, which);
+  }
+}
+
+void Fleet::startConnect(size_t index, int which) {
+  Device& device = devices[index];
+  Connection& connection = device.connections[which];
+  if (!device.busy || (device.kind == REQUEST_AQI ? 1 : 0) != which || connection.fd >= 0) {
+    return;  // Request ended (timeout, outage) while queued
+  }
+  connection.fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (connection.fd < 0) {
+    finish(index, OUTCOME_CONNECT, std::string());
+    return;
+  }
+  int on = 1;
+  setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  int result = connect(connection.fd, (sockaddr*)&address, addressLength);
+  if (result != 0 && errno != EINPROGRESS) {
+    finish(index, OUTCOME_CONNECT, std::string());
+    return;
+  }
+  connection.connecting = true;
+  connecting++;
+  epoll_event event = {};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+  event.data.u64 = index * 2 + which;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, connection.fd, &event);
+}
+
+void Fleet::onConnected(size_t index, int which) {
+  Connection& connection = devices[index].connections[which];
+  int error = 0;
+  socklen_t length = sizeof(error);
+  getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+  connection.connecting = false;
+  connecting--;
+  if (error != 0) {
+    finish(index, OUTCOME_CONNECT, std::string());
+    return;
+  }
+  flush(index, which);
+}
+
+void Fleet::flush(size_t index, int which) {
+  Connection& connection = devices[index].connections[which];
+  while (connection.outOffset < connection.out.size()) {
+    ssize_t n = ::send(connection.fd, connection.out.data() + connection.outOffset,
+                       connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+    if (n > 0) {
+      connection.outOffset += (size_t)n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;  // EPOLLOUT continues
+    } else {
+      finish(index, OUTCOME_CLOSED, std::string());
+      return;
+    }
+  }
+}
+
+void Fleet::readable(size_t index, int which) {
+  Device& device = devices[index];
+  Connection& connection = device.connections[which];
+  char buffer[4096];
+  bool closed = false;
+  for (;;) {
+    ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      connection.in.append(buffer, (size_t)n);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      closed = true;
+      break;
+    }
+  }
+
+  bool mine = device.busy && (device.kind == REQUEST_AQI ? 1 : 0) == which;
+  size_t headerEnd = connection.in.find("\r\n\r\n");
+  size_t contentLength = 0;
+  if (headerEnd != std::string::npos) {
+    const char* field = strcasestr(connection.in.c_str(), "\r\ncontent-length:");
+    if (field != nullptr && (size_t)(field - connection.in.c_str()) < headerEnd) {
+      contentLength = strtoul(field + 17, nullptr, 10);
+    }
+  }
+  bool complete = headerEnd != std::string::npos && connection.in.size() >= headerEnd + 4 + contentLength;
+
+  if (!complete || !mine) {
+    if (closed) {
+      // Server closed an idle keep-alive connection: reconnect on the next request
+      if (mine) {
+        finish(index, OUTCOME_CLOSED, std::string());
+      } else {
+        closeConnection(index, which);
+      }
+    }
+    return;
+  }
+
+  int status = atoi(connection.in.c_str() + 9);
+  std::string body = connection.in.substr(headerEnd + 4, contentLength);
+  bool keepAlive = !closed && strcasestr(connection.in.c_str(), "\r\nconnection: close") == nullptr;
+  connection.in.clear();
+  if (!keepAlive) {
+    closeConnection(index, which);
+  }
+  finish(index, status >= 500 ? OUTCOME_5XX : status >= 300 ? OUTCOME_4XX : OUTCOME_OK, body);
+}
+
+void Fleet::finish(size_t index, Outcome outcome, const std::string& body) {
+  Device& device = devices[index];
+  int64_t now = nowUs();
+  RequestKind kind = device.kind;
+  int which = kind == REQUEST_AQI ? 1 : 0;
+  device.busy = false;
+  device.requestId++;
+
+  bool binaryAqi = false;
+  if (outcome == OUTCOME_OK && kind == REQUEST_LIVE && !options.split) {
+    // AQIResponsePacket: magic and XOR checksum; anything else means "ask again"
+    uint8_t checksum = 0;
+    for (size_t i = 0; i + 1 < body.size(); i++) {
+      checksum ^= (uint8_t)body[i];
+    }
+    binaryAqi = body.size() == 8 && (uint8_t)body[0] == AQI_RESPONSE_MAGIC && checksum == (uint8_t)body[7];
+  } else if (outcome == OUTCOME_OK && kind == REQUEST_AQI &&
+             (body.find("\"aqi\"") == std::string::npos || body.find("\"combined\"") == std::string::npos)) {
+    outcome = OUTCOME_BODY;
+  }
+  if (outcome != OUTCOME_OK) {
+    closeConnection(index, which);  // HTTPClient drops the session after an error
+  }
+  record(kind, outcome, now - device.requestStart, device.requestPackets);
+
+  if (kind == REQUEST_LIVE) {
+    if (outcome != OUTCOME_OK) {
+      store(device, device.current);
+    } else if (binaryAqi) {
+      aqiAnswers++;
+    } else {
+      startRequest(index, REQUEST_AQI);  // transmitPacket(): JSON AQI request
+      return;
+    }
+  } else if (kind == REQUEST_AQI) {
+    aqiAnswers += outcome == OUTCOME_OK;
+  } else if (outcome == OUTCOME_OK) {
+    device.backlog.erase(device.backlog.begin(), device.backlog.begin() + device.requestPackets);
+  }
+  pump(index);
+}
+
+void Fleet::closeConnection(size_t index, int which) {
+  Connection& connection = devices[index].connections[which];
+  if (connection.fd >= 0) {
+    if (connection.connecting) {
+      connecting--;
+    }
+    close(connection.fd);
+  }
+  connection.fd = -1;
+  connection.connecting = false;
+  connection.in.clear();
+}
+
+void Fleet::record(RequestKind kind, Outcome outcome, int64_t latencyUs, size_t packets) {
+  for (RequestStats* target : {&stats[kind], &window[kind]}) {
+    target->outcomes[outcome]++;
+    if (outcome == OUTCOME_OK) {
+      target->packets += packets;
+      target->latency.add(latencyUs);
+    }
+  }
+}
+
+int Fleet::run() {
+  if (!resolve()) {
+    fprintf(stderr, "cannot resolve %s\n", options.host.c_str());
+    return 1;
+  }
+  epollFd = epoll_create1(0);
+  startUs = nowUs();
+  for (size_t i = 0; i < devices.size(); i++) {
+    initDevice(i);
+  }
+
+  int64_t endUs = startUs + (int64_t)options.durationS * 1000000;
+  int64_t nextProgress = startUs + (int64_t)options.reportS * 1000000;
+  std::vector<epoll_event> events(1024);
+
+  for (;;) {
+    int64_t now = nowUs();
+    if (now >= endUs) {
+      break;
+    }
+    if (options.reportS > 0 && now >= nextProgress) {
+      progress(now);
+      nextProgress += (int64_t)options.reportS * 1000000;
+    }
+    while (!timers.empty() && timers.top().due <= now) {
+      Timer timer = timers.top();
+      timers.pop();
+      onTimer(timer);
+    }
+    while (!connectQueue.empty() && connecting < MAX_CONNECTING) {
+      std::pair<size_t, int> next = connectQueue.front();
+      connectQueue.pop_front();
+      startConnect(next.first, next.second);
+    }
+
+    int timeout = timers.empty() ? 10 : (int)std::min<int64_t>(10, (timers.top().due - now + 999) / 1000);
+    int count = epoll_wait(epollFd, events.data(), (int)events.size(), std::max(0, timeout));
+    for (int i = 0; i < count; i++) {
+      size_t index = (size_t)(events[i].data.u64 / 2);
+      int which = (int)(events[i].data.u64 % 2);
+      Connection& connection = devices[index].connections[which];
+      if (connection.fd < 0) {
+        continue;
+      }
+      if (connection.connecting) {
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+          onConnected(index, which);
+        }
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) {
+        flush(index, which);
+      }
+      if (connection.fd >= 0 && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        readable(index, which);
+      }
+    }
+  }
+
+  report();
+  return 0;
+}
+
+void Fleet::progress(int64_t now) {
+  double seconds = options.reportS;
+  size_t online = 0;
+  size_t pending = 0;
+  for (const Device& device : devices) {
+    online += device.online;
+    pending += device.backlog.size();
+  }
+  printf("%5.0f s  online %zu/%zu  backlog %zu", (now - startUs) / 1e6, online, devices.size(), pending);
+  for (size_t k = 0; k < REQUEST_KIND_COUNT; k++) {
+    const RequestStats& s = window[k];
+    if (s.total() > 0) {
+      printf("  | %s %.0f/s err %llu p99 %.1f ms", REQUEST_NAMES[k], s.total() / seconds,
+             (unsigned long long)(s.total() - s.outcomes[OUTCOME_OK]), s.latency.percentileMs(99));
+    }
+  }
+  printf("\n");
+  fflush(stdout);
+  for (RequestStats& s : window) {
+    s = RequestStats();
+  }
+}
+
+void Fleet::report() const {
+  double seconds = options.durationS;
+  size_t pending = 0;
+  for (const Device& device : devices) {
+    pending += device.backlog.size();
+  }
+  uint64_t delivered = stats[REQUEST_LIVE].packets + stats[REQUEST_BACKLOG].packets;
+
+  printf("\nfleet: %zu devices, %u s, sample every %u ms +-%.0f%%, %s\n", devices.size(), options.durationS,
+         options.intervalMs, options.jitter * 100,
+         options.split ? "sensor-data + calculate-aqi" : "combined binary AQI answer");
+  printf("samples %llu, unchanged %llu (%.1f%%), delivered %llu (%.0f packets/s), to backlog %llu, pending %zu, "
+         "lost %llu (queue full %llu, backlog full %llu)\n",
+         (unsigned long long)samples, (unsigned long long)suppressed, samples > 0 ? 100.0 * suppressed / samples : 0.0,
+         (unsigned long long)delivered, delivered / seconds,
+         (unsigned long long)stored, pending, (unsigned long long)(queueDrops + backlogDrops),
+         (unsigned long long)queueDrops, (unsigned long long)backlogDrops);
+  printf("outages %llu, reboots %llu, AQI answers %llu\n\n", (unsigned long long)outageCount,
+         (unsigned long long)rebootCount, (unsigned long long)aqiAnswers);
+
+  printf("%-8s %9s %8s %7s", "request", "count", "req/s", "error%");
+  for (size_t o = 1; o < OUTCOME_COUNT; o++) {
+    printf(" %7s", OUTCOME_NAMES[o]);
+  }
+  printf(" %8s %8s %8s %8s %8s\n", "p50 ms", "p90", "p99", "p99.9", "max");
+  for (size_t k = 0; k < REQUEST_KIND_COUNT; k++) {
+    const RequestStats& s = stats[k];
+    uint64_t total = s.total();
+    printf("%-8s %9llu %8.1f %6.2f%%", REQUEST_NAMES[k], (unsigned long long)total, total / seconds,
+           total > 0 ? 100.0 * (total - s.outcomes[OUTCOME_OK]) / total : 0.0);
+    for (size_t o = 1; o < OUTCOME_COUNT; o++) {
+      printf(" %7llu", (unsigned long long)s.outcomes[o]);
+    }
+    printf(" %8.2f %8.2f %8.2f %8.2f %8.2f\n", s.latency.percentileMs(50), s.latency.percentileMs(90),
+           s.latency.percentileMs(99), s.latency.percentileMs(99.9), s.latency.max() / 1000.0);
+  }
+  for (size_t k = 0; k < REQUEST_KIND_COUNT; k++) {
+    stats[k].latency.print(REQUEST_NAMES[k]);
+  }
+}
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--split") {
+      options.split = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--host") {
+      options.host = value;
+    } else if (arg == "--port") {
+      options.port = (uint16_t)atoi(value.c_str());
+    } else if (arg == "--devices") {
+      options.devices = (size_t)atol(value.c_str());
+    } else if (arg == "--duration") {
+      options.durationS = (unsigned)atoi(value.c_str());
+    } else if (arg == "--interval") {
+      options.intervalMs = (unsigned)atoi(value.c_str());
+    } else if (arg == "--jitter") {
+      options.jitter = atof(value.c_str()) / 100;
+    } else if (arg == "--outages") {
+      options.outages = atof(value.c_str()) / 100;
+    } else if (arg == "--outage-s") {
+      options.outageS = atof(value.c_str());
+    } else if (arg == "--sensor-faults") {
+      options.sensorFaults = atof(value.c_str()) / 100;
+    } else if (arg == "--reboots") {
+      options.reboots = atof(value.c_str()) / 100;
+    } else if (arg == "--send-on-change") {
+      options.sendOnChange = atoi(value.c_str()) != 0;
+    } else if (arg == "--report") {
+      options.reportS = (unsigned)atoi(value.c_str());
+    } else if (arg == "--seed") {
+      options.seed = (unsigned)atoi(value.c_str());
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0 && options.devices > 0 && options.devices < (1u << 24) && options.durationS > 0 &&
+         options.intervalMs > 0 && options.jitter >= 0 && options.jitter < 1 && options.outageS > 0;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--host H] [--port N] [--devices N] [--duration S] [--interval MS] [--jitter PCT]\n"
+                    "       [--split] [--outages PCT] [--outage-s S] [--sensor-faults PCT] [--reboots PCT]\n"
+                    "       [--send-on-change 0|1] [--report S] [--seed N]\n", argv[0]);
+    return 2;
+  }
+
+  rlimit limit;
+  rlim_t needed = options.devices * (options.split ? 2 : 1) + 16;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < needed) {
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, needed);
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < needed) {
+      fprintf(stderr, "warning: only %llu file descriptors (ulimit -n)\n", (unsigned long long)limit.rlim_cur);
+    }
+  }
+
+  Fleet fleet(options);
+  return fleet.run();
+}
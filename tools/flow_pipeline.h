@@ -0,0 +1,525 @@
+#ifndef FLOW_PIPELINE_H
+#define FLOW_PIPELINE_H
+
+// ===== FLOW PIPELINE =====
+// Native port of what the Node-RED flow does with one decoded sample:
+// "AQI Calculator" -> "Comfort Calculator" -> "Air Quality Classifier" ->
+// "InfluxDB v2 Object Formatter", and the "AQI Response Generator" that
+// answers the device. Same breakpoints, weights, evaluation order and
+// Math.round in double precision, so rows and answers match the flow's.
+// Keep both in step when a function node changes.
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "packet_decoder.h"
+
+static const uint8_t FLOW_AQI_RESPONSE_MAGIC = 0xA1;  // AQI_RESPONSE_MAGIC in ByteTransmission.h
+
+// Decoded sample with scaled values - msg.payload after the Binary Data Decoder
+struct FlowSample {
+  char deviceId[13];            // Hex eFuse MAC
+  double temperature;           // environment.main_temperature
+  double humidity;
+  double pressure;
+  double dsTemperature;
+  double gasResistance;         // air_quality.*
+  double iaq;
+  double staticIaq;
+  double co2;
+  double breathVoc;
+  double iaqAccuracy;
+  double co2Accuracy;
+  double vocAccuracy;
+  double pm1;
+  double pm25;
+  double pm10;
+  double uptime;                // system.*
+  double rssi;
+  int sensorsAvailable;         // BME680 + DS18B20 + PMS5003 flags
+};
+
+// Fields the device sends to /calculate-aqi (absent = undefined in the flow)
+struct AqiRequest {
+  bool hasPm1 = false, hasPm25 = false, hasPm10 = false, hasCo2 = false, hasIaq = false;
+  double pm1 = 0, pm25 = 0, pm10 = 0, co2 = 0, iaq = 0;
+};
+
+// Result of the AQI Response Generator
+struct AqiAnswer {
+  double combined;
+  double pm1Aqi, pm25Aqi, pm10Aqi, co2Aqi, iaqAqi;
+  uint8_t levelId;              // Index in AQI_LEVEL_NAMES / enum AQILevel
+  uint32_t color;
+  const char* dominant;
+};
+
+class FlowPipeline {
+public:
+  static void toSample(const SensorDataPacket& packet, FlowSample& sample);
+
+  // "Binary Data Decoder": acquisition time from the device clock, false if
+  // the packet has no time section (time then comes from the uptime)
+  static bool deviceTime(const SensorDataPacket& packet, int64_t& timeMs);
+
+  // "AQI Response Router": the fields a binary /sensor-data answer is computed from
+  static AqiRequest requestFor(const FlowSample& sample);
+
+  // "AQI Response Generator"
+  static AqiAnswer answer(const AqiRequest& request);
+  static void appendBinaryAnswer(std::string& out, const AqiAnswer& answer);
+  static void appendJsonAnswer(std::string& out, const AqiAnswer& answer, int64_t nowMs);
+
+  // Calculator, comfort, classifier and formatter: one line protocol row
+  // (measurement air_quality, ms precision) for the InfluxDB v2 write API
+  static void appendInfluxLine(std::string& out, const FlowSample& sample, int64_t timeMs);
+
+  static void appendNumber(std::string& out, double value);
+
+  // "AQI Calculator": weighted combined AQI (aqi_index) and the PM2.5, PM10, IAQ sub-indices
+  static double weightedAqi(const FlowSample& sample, double& pm25, double& pm10, double& iaq);
+
+  // getAQILevel(): level name (as index) and color
+  static void level(double aqi, uint8_t& levelId, uint32_t& color);
+
+private:
+  static double jsRound(double value);
+
+  static double pm25Aqi(double pm25);
+  static double pm10Aqi(double pm10);
+  static double pm1Aqi(double pm1);
+  static double co2Aqi(double co2);
+  static double vocAqi(double voc);
+  static double gasResistanceAqi(double resistance);
+  static double iaqToAqi(double iaq);
+
+  template <size_t I>
+  static double scaled(const SensorDataPacket& packet);
+};
+
+// ===== IMPLEMENTATION =====
+template <size_t I>
+double FlowPipeline::scaled(const SensorDataPacket& packet) {
+  static_assert(I < PACKET_FIELD_COUNT, "Field not in PACKET_SCHEMA");
+  const PacketFieldSpec& field = PACKET_SCHEMA[I];
+  const uint8_t* p = (const uint8_t*)&packet + field.offset;
+  double raw;
+  switch (field.type) {
+    case FieldType::I8:
+      raw = (int8_t)p[0];
+      break;
+    case FieldType::U16: {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      raw = v;
+      break;
+    }
+    case FieldType::I16: {
+      int16_t v;
+      memcpy(&v, p, sizeof(v));
+      raw = v;
+      break;
+    }
+    case FieldType::U32: {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      raw = v;
+      break;
+    }
+    default:
+      raw = p[0];
+      break;
+  }
+  return field.scale == 1 ? raw : raw / field.scale;  // Same division as scalePacketV3()
+}
+
+void FlowPipeline::toSample(const SensorDataPacket& packet, FlowSample& sample) {
+  snprintf(sample.deviceId, sizeof(sample.deviceId), "%02x%02x%02x%02x%02x%02x",
+           packet.device_id[0], packet.device_id[1], packet.device_id[2],
+           packet.device_id[3], packet.device_id[4], packet.device_id[5]);
+  sample.temperature = scaled<fieldIndex("bme_temperature")>(packet);
+  sample.humidity = scaled<fieldIndex("bme_humidity")>(packet);
+  sample.pressure = scaled<fieldIndex("bme_pressure")>(packet);
+  sample.dsTemperature = scaled<fieldIndex("ds_temperature")>(packet);
+  sample.gasResistance = scaled<fieldIndex("gas_resistance")>(packet);
+  sample.iaq = scaled<fieldIndex("iaq")>(packet);
+  sample.staticIaq = scaled<fieldIndex("static_iaq")>(packet);
+  sample.co2 = scaled<fieldIndex("co2_equivalent")>(packet);
+  sample.breathVoc = scaled<fieldIndex("breath_voc")>(packet);
+  sample.iaqAccuracy = scaled<fieldIndex("iaq_accuracy")>(packet);
+  sample.co2Accuracy = scaled<fieldIndex("co2_accuracy")>(packet);
+  sample.vocAccuracy = scaled<fieldIndex("voc_accuracy")>(packet);
+  sample.pm1 = scaled<fieldIndex("pm1_0")>(packet);
+  sample.pm25 = scaled<fieldIndex("pm2_5")>(packet);
+  sample.pm10 = scaled<fieldIndex("pm10")>(packet);
+  sample.uptime = scaled<fieldIndex("uptime_seconds")>(packet);
+  sample.rssi = scaled<fieldIndex("wifi_rssi")>(packet);
+  sample.sensorsAvailable = (packet.bme_flags & 1) + (packet.ds_flags & 1) + (packet.pms_flags & 1);
+}
+
+bool FlowPipeline::deviceTime(const SensorDataPacket& packet, int64_t& timeMs) {
+  if (packet.time_quality == 0) {
+    return false;
+  }
+  timeMs = (int64_t)packet.timestamp * 1000 + packet.time_ms;
+  return true;
+}
+
+// Math.round: halves round up, also for negative values
+double FlowPipeline::jsRound(double value) {
+  double down = floor(value);
+  return value - down >= 0.5 ? down + 1 : down;
+}
+
+// ===== AQI BREAKPOINTS =====
+// Written like the function nodes - the constant folding must not change
+double FlowPipeline::pm25Aqi(double pm25) {
+  if (pm25 <= 12) return jsRound((50.0 / 12) * pm25);
+  if (pm25 <= 35.4) return jsRound(50 + ((100.0 - 50) / (35.4 - 12.1)) * (pm25 - 12.1));
+  if (pm25 <= 55.4) return jsRound(100 + ((150.0 - 100) / (55.4 - 35.5)) * (pm25 - 35.5));
+  if (pm25 <= 150.4) return jsRound(150 + ((200.0 - 150) / (150.4 - 55.5)) * (pm25 - 55.5));
+  if (pm25 <= 250.4) return jsRound(200 + ((300.0 - 200) / (250.4 - 150.5)) * (pm25 - 150.5));
+  return jsRound(300 + ((500.0 - 300) / (500.4 - 250.5)) * (pm25 - 250.5));
+}
+
+double FlowPipeline::pm10Aqi(double pm10) {
+  if (pm10 <= 54) return jsRound((50.0 / 54) * pm10);
+  if (pm10 <= 154) return jsRound(50 + ((100.0 - 50) / (154 - 55)) * (pm10 - 55));
+  if (pm10 <= 254) return jsRound(100 + ((150.0 - 100) / (254 - 155)) * (pm10 - 155));
+  if (pm10 <= 354) return jsRound(150 + ((200.0 - 150) / (354 - 255)) * (pm10 - 255));
+  if (pm10 <= 424) return jsRound(200 + ((300.0 - 200) / (424 - 355)) * (pm10 - 355));
+  return jsRound(300 + ((500.0 - 300) / (604 - 425)) * (pm10 - 425));
+}
+
+double FlowPipeline::pm1Aqi(double pm1) {
+  if (pm1 <= 8) return jsRound((50.0 / 8) * pm1);
+  if (pm1 <= 25) return jsRound(50 + ((100.0 - 50) / (25 - 8)) * (pm1 - 8));
+  if (pm1 <= 40) return jsRound(100 + ((150.0 - 100) / (40 - 25)) * (pm1 - 25));
+  if (pm1 <= 60) return jsRound(150 + ((200.0 - 150) / (60 - 40)) * (pm1 - 40));
+  if (pm1 <= 100) return jsRound(200 + ((300.0 - 200) / (100 - 60)) * (pm1 - 60));
+  return fmin(500, jsRound(300 + ((500.0 - 300) / (200 - 100)) * (pm1 - 100)));
+}
+
+double FlowPipeline::co2Aqi(double co2) {
+  if (co2 <= 400) return 25;
+  if (co2 <= 600) return jsRound(25 + ((50.0 - 25) / (600 - 400)) * (co2 - 400));
+  if (co2 <= 800) return jsRound(50 + ((100.0 - 50) / (800 - 600)) * (co2 - 600));
+  if (co2 <= 1000) return jsRound(100 + ((150.0 - 100) / (1000 - 800)) * (co2 - 800));
+  if (co2 <= 1500) return jsRound(150 + ((200.0 - 150) / (1500 - 1000)) * (co2 - 1000));
+  if (co2 <= 2000) return jsRound(200 + ((300.0 - 200) / (2000 - 1500)) * (co2 - 1500));
+  return fmin(500, jsRound(300 + ((500.0 - 300) / (5000 - 2000)) * (co2 - 2000)));
+}
+
+double FlowPipeline::vocAqi(double voc) {
+  if (voc <= 0.3) return 25;
+  if (voc <= 0.5) return jsRound(25 + ((50.0 - 25) / (0.5 - 0.3)) * (voc - 0.3));
+  if (voc <= 1.0) return jsRound(50 + ((100.0 - 50) / (1.0 - 0.5)) * (voc - 0.5));
+  if (voc <= 2.0) return jsRound(100 + ((150.0 - 100) / (2.0 - 1.0)) * (voc - 1.0));
+  if (voc <= 3.0) return jsRound(150 + ((200.0 - 150) / (3.0 - 2.0)) * (voc - 2.0));
+  if (voc <= 5.0) return jsRound(200 + ((300.0 - 200) / (5.0 - 3.0)) * (voc - 3.0));
+  return fmin(500, jsRound(300 + ((500.0 - 300) / (25.0 - 5.0)) * (voc - 5.0)));
+}
+
+double FlowPipeline::gasResistanceAqi(double r) {
+  if (r >= 500000) return 25;
+  if (r >= 200000) return jsRound(25 + ((50.0 - 25) / (500000 - 200000)) * (500000 - r));
+  if (r >= 100000) return jsRound(50 + ((100.0 - 50) / (200000 - 100000)) * (200000 - r));
+  if (r >= 50000) return jsRound(100 + ((150.0 - 100) / (100000 - 50000)) * (100000 - r));
+  if (r >= 20000) return jsRound(150 + ((200.0 - 150) / (50000 - 20000)) * (50000 - r));
+  if (r >= 10000) return jsRound(200 + ((300.0 - 200) / (20000 - 10000)) * (20000 - r));
+  return fmin(500, jsRound(300 + ((500.0 - 300) / (10000 - 1000)) * (10000 - r)));
+}
+
+double FlowPipeline::iaqToAqi(double iaq) {
+  if (iaq <= 50) return jsRound(iaq);
+  if (iaq <= 100) return jsRound(50 + ((100.0 - 50) / 50) * (iaq - 50));
+  if (iaq <= 150) return jsRound(100 + ((150.0 - 100) / 50) * (iaq - 100));
+  if (iaq <= 200) return jsRound(150 + ((200.0 - 150) / 50) * (iaq - 150));
+  if (iaq <= 300) return jsRound(200 + ((300.0 - 200) / 100) * (iaq - 200));
+  return jsRound(300 + ((500.0 - 300) / 200) * (iaq - 300));
+}
+
+// getAQILevel(): level name (as index) and color gradient
+void FlowPipeline::level(double aqi, uint8_t& levelId, uint32_t& color) {
+  uint32_t r, g, b = 0;
+  if (aqi <= 50) {
+    r = (uint32_t)jsRound(aqi / 50 * 128);
+    g = 255;
+    levelId = aqi <= 25 ? 1 : 2;
+  } else if (aqi <= 100) {
+    r = (uint32_t)jsRound(128 + (aqi - 50) / 50 * 127);
+    g = 255;
+    levelId = aqi <= 75 ? 3 : 4;
+  } else if (aqi <= 150) {
+    r = 255;
+    g = (uint32_t)jsRound(255 - (aqi - 100) / 50 * 129);
+    levelId = aqi <= 125 ? 5 : 6;
+  } else if (aqi <= 200) {
+    r = 255;
+    g = (uint32_t)jsRound(126 - (aqi - 150) / 50 * 126);
+    levelId = aqi <= 175 ? 7 : 8;
+  } else if (aqi <= 300) {
+    double ratio = (aqi - 200) / 100;
+    r = (uint32_t)jsRound(255 - ratio * 112);
+    g = 0;
+    b = (uint32_t)jsRound(ratio * 151);
+    levelId = aqi <= 250 ? 9 : 10;
+  } else {
+    r = 0x80;
+    g = 0;
+    levelId = 11;
+  }
+  color = (r << 16) | (g << 8) | b;
+}
+
+// ===== AQI RESPONSE GENERATOR =====
+AqiRequest FlowPipeline::requestFor(const FlowSample& sample) {
+  // Router passes pm2_5, pm10, iaq and co2 - always set for v3 packets
+  AqiRequest request;
+  request.hasPm25 = request.hasPm10 = request.hasCo2 = request.hasIaq = true;
+  request.pm25 = sample.pm25;
+  request.pm10 = sample.pm10;
+  request.iaq = sample.iaq;
+  request.co2 = sample.co2;
+  return request;
+}
+
+AqiAnswer FlowPipeline::answer(const AqiRequest& request) {
+  AqiAnswer answer = {};
+  double sum = 0;
+  int count = 0;
+
+  if (request.hasPm1 && request.pm1 >= 0) {
+    answer.pm1Aqi = pm1Aqi(request.pm1);
+    sum += answer.pm1Aqi;
+    count++;
+  }
+  if (request.hasPm25 && request.pm25 >= 0) {
+    answer.pm25Aqi = pm25Aqi(request.pm25);
+    sum += answer.pm25Aqi;
+    count++;
+  }
+  if (request.hasPm10 && request.pm10 >= 0) {
+    answer.pm10Aqi = pm10Aqi(request.pm10);
+    sum += answer.pm10Aqi;
+    count++;
+  }
+  if (request.hasCo2 && request.co2 > 0) {
+    answer.co2Aqi = co2Aqi(request.co2);
+    sum += answer.co2Aqi;
+    count++;
+  }
+  if (request.hasIaq && request.iaq > 0) {
+    answer.iaqAqi = iaqToAqi(request.iaq);
+    sum += answer.iaqAqi;
+    count++;
+  }
+
+  answer.dominant = "N/A";
+  if (count > 0) {
+    answer.combined = jsRound(sum / count);
+    double maxAqi = fmax(fmax(fmax(answer.pm1Aqi, answer.pm25Aqi), fmax(answer.pm10Aqi, answer.co2Aqi)), answer.iaqAqi);
+    if (maxAqi == answer.pm1Aqi && answer.pm1Aqi > 0) answer.dominant = "PM1.0";
+    else if (maxAqi == answer.pm25Aqi && answer.pm25Aqi > 0) answer.dominant = "PM2.5";
+    else if (maxAqi == answer.pm10Aqi && answer.pm10Aqi > 0) answer.dominant = "PM10";
+    else if (maxAqi == answer.co2Aqi && answer.co2Aqi > 0) answer.dominant = "CO2";
+    else if (maxAqi == answer.iaqAqi && answer.iaqAqi > 0) answer.dominant = "VOC/Gas";
+  } else {
+    answer.combined = 25;  // Fallback
+    answer.dominant = "Sensors active";
+  }
+
+  level(answer.combined, answer.levelId, answer.color);
+  return answer;
+}
+
+void FlowPipeline::appendBinaryAnswer(std::string& out, const AqiAnswer& answer) {
+  // AQIResponsePacket, little endian
+  uint16_t value = (uint16_t)fmin(65535, jsRound(answer.combined * 10));
+  uint8_t packet[8] = {FLOW_AQI_RESPONSE_MAGIC, (uint8_t)value, (uint8_t)(value >> 8), answer.levelId,
+                       (uint8_t)(answer.color >> 16), (uint8_t)(answer.color >> 8), (uint8_t)answer.color, 0};
+  for (size_t i = 0; i < 7; i++) {
+    packet[7] ^= packet[i];
+  }
+  out.append((const char*)packet, sizeof(packet));
+}
+
+void FlowPipeline::appendJsonAnswer(std::string& out, const AqiAnswer& answer, int64_t nowMs) {
+  // AQI_LEVELS in the generator, same order as enum AQILevel
+  static const char* const LEVELS[] = {
+    "No Data", "Sehr gut", "Gut", "Still good", "Moderate", "Unhealthy",
+    "Unhealthy for sensitive groups", "Leicht ungesund", "Ungesund",
+    "Sehr ungesund", "Extrem ungesund", "Hazardous"
+  };
+  char color[8];
+  snprintf(color, sizeof(color), "#%06x", (unsigned)answer.color);
+
+  out += "{\"success\":true,\"timestamp\":";
+  appendNumber(out, (double)nowMs);
+  out += ",\"aqi\":{\"combined\":";
+  appendNumber(out, answer.combined);
+  out += ",\"pm1_0_aqi\":";
+  appendNumber(out, answer.pm1Aqi);
+  out += ",\"pm2_5_aqi\":";
+  appendNumber(out, answer.pm25Aqi);
+  out += ",\"pm10_aqi\":";
+  appendNumber(out, answer.pm10Aqi);
+  out += ",\"co2_aqi\":";
+  appendNumber(out, answer.co2Aqi);
+  out += ",\"iaq_aqi\":";
+  appendNumber(out, answer.iaqAqi);
+  out += ",\"level\":\"";
+  out += LEVELS[answer.levelId];
+  out += "\",\"color\":\"";
+  out += color;
+  out += "\",\"dominant_pollutant\":\"";
+  out += answer.dominant;
+  out += "\"}}";
+}
+
+// ===== AQI CALCULATOR =====
+// Weighted mean of all components, at least 25; returns the combined AQI
+double FlowPipeline::weightedAqi(const FlowSample& s, double& pm25, double& pm10, double& iaq) {
+  // Summed in the flow's insertion order: pm1_0, pm2_5, pm10, co2, voc, gas, iaq
+  double total = 0;
+  double weights = 0;
+  auto add = [&](double aqi, double weight) {
+    total += aqi * weight;
+    weights += weight;
+  };
+
+  pm25 = pm10 = iaq = 0;
+  if (s.pm1 >= 0) add(pm1Aqi(s.pm1), 0.9);
+  if (s.pm25 >= 0) add(pm25 = pm25Aqi(s.pm25), 1.0);
+  if (s.pm10 >= 0) add(pm10 = pm10Aqi(s.pm10), 0.8);
+  if (s.co2 > 0) add(co2Aqi(s.co2), s.co2Accuracy >= 2 ? 0.9 : 0.6);
+  if (s.breathVoc > 0) add(vocAqi(s.breathVoc), s.vocAccuracy >= 2 ? 0.8 : 0.5);
+  if (s.gasResistance > 0) add(gasResistanceAqi(s.gasResistance), 0.6);
+  if (s.iaq > 0) add(iaq = iaqToAqi(s.iaq), s.iaqAccuracy >= 2 ? 1.0 : 0.7);
+
+  double combined = weights > 0 ? jsRound(total / weights) : 25;
+  return fmax(25, combined);
+}
+
+// ===== INFLUXDB FORMATTER =====
+void FlowPipeline::appendNumber(std::string& out, double value) {
+  // getNumericValue(): NaN becomes 0; Infinity is not valid line protocol either
+  if (!std::isfinite(value) || value == 0) {
+    value = 0;
+  }
+  // Number.prototype.toString(): integers without exponent below 1e21,
+  // shortest round-trip digits otherwise
+  char buffer[64];
+  std::to_chars_result result;
+  if (value == floor(value) && fabs(value) < 1e21) {
+    result = std::to_chars(buffer, buffer + sizeof(buffer), (long long)value);
+  } else {
+    result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                           fabs(value) >= 1e-6 ? std::chars_format::fixed : std::chars_format::scientific);
+  }
+  out.append(buffer, result.ptr);
+}
+
+void FlowPipeline::appendInfluxLine(std::string& out, const FlowSample& s, int64_t timeMs) {
+  double pm25, pm10, iaq;
+  double combined = weightedAqi(s, pm25, pm10, iaq);
+
+  // Comfort Calculator
+  double tempF = s.temperature * 9 / 5 + 32;
+  double heatIndex = s.temperature;
+  if (tempF >= 80) {
+    double h = s.humidity;
+    double hi = -42.379 + 2.04901523 * tempF + 10.14333127 * h
+              - 0.22475541 * tempF * h - 0.00683783 * tempF * tempF
+              - 0.05481717 * h * h + 0.00122874 * tempF * tempF * h
+              + 0.00085282 * tempF * h * h - 0.00000199 * tempF * tempF * h * h;
+    heatIndex = (hi - 32) * 5 / 9;
+  }
+  double alpha = ((17.27 * s.temperature) / (237.7 + s.temperature)) + log(s.humidity / 100.0);
+  double dewPoint = (237.7 * alpha) / (17.27 - alpha);
+  double saturation = 6.112 * exp((17.67 * s.temperature) / (s.temperature + 243.5));
+  double absoluteHumidity = (2.1674 * ((s.humidity / 100) * saturation)) / (s.temperature + 273.15);
+
+  double score = 1.0;
+  if (s.temperature < 18) score *= 0.7;
+  else if (s.temperature > 26) score *= 0.8;
+  else if (s.temperature >= 20 && s.temperature <= 24) score *= 1.0;
+  else score *= 0.9;
+  if (s.humidity < 30) score *= 0.6;
+  else if (s.humidity > 70) score *= 0.7;
+  else if (s.humidity >= 40 && s.humidity <= 60) score *= 1.0;
+  else score *= 0.85;
+  if (heatIndex > s.temperature + 2) score *= 0.8;
+  score = jsRound(score * 100) / 100;
+
+  // Air Quality Classifier
+  bool ventilation = s.iaq > 100 || s.co2 > 800;
+
+  // Tags sorted by key - the order InfluxDB stores them in
+  out += "air_quality,data_type=environmental,device_id=";
+  out += s.deviceId;
+  out += ",device_type=AirQualityMonitor,location=default_location ";
+
+  const struct {
+    const char* name;
+    double value;
+  } fields[] = {
+    {"temperature_celsius", s.temperature},
+    {"humidity_percent", s.humidity},
+    {"pressure_hpa", s.pressure},
+    {"ds_temperature_celsius", s.dsTemperature},
+    {"dew_point_celsius", jsRound(dewPoint * 100) / 100},
+    {"heat_index_celsius", jsRound(heatIndex * 100) / 100},
+    {"absolute_humidity_gm3", jsRound(absoluteHumidity * 100) / 100},
+    {"comfort_index", score * 100},
+    {"aqi_index", combined},
+    {"aqi_category", (double)(combined <= 50 ? 1 : combined <= 100 ? 2 : combined <= 150 ? 3 : combined <= 200 ? 4 : 5)},
+    {"pm2_5_aqi", pm25},
+    {"pm10_aqi", pm10},
+    {"iaq_aqi", iaq},
+    {"iaq_index", s.iaq},
+    {"static_iaq", s.staticIaq},
+    {"iaq_accuracy_level", s.iaqAccuracy},
+    {"gas_resistance_ohm", s.gasResistance},
+    {"co2_equivalent_ppm", s.co2},
+    {"co2_bme_equivalent_ppm", s.co2},
+    {"co2_accuracy_level", s.co2Accuracy},
+    {"tvoc_ppb", s.breathVoc * 1000},
+    {"tvoc_mgm3", s.breathVoc},
+    {"voc_accuracy_level", s.vocAccuracy},
+    {"pm1_0_ugm3", s.pm1},
+    {"pm2_5_ugm3", s.pm25},
+    {"pm10_ugm3", s.pm10},
+    {"sensor_reliable", 1},  // Packets with a bad CRC are rejected before
+    {"bme68x_stable", (double)(s.iaqAccuracy >= 2)},
+    {"bme68x_runin_complete", (double)(s.iaqAccuracy >= 3)},
+    {"sensors_available_count", (double)s.sensorsAvailable},
+    {"wifi_rssi_dbm", s.rssi},
+    {"alert_aqi", (double)(combined > 100)},
+    {"alert_co2", (double)(s.co2 > 1000)},
+    {"alert_pm25", (double)(s.pm25 > 35)},
+    {"alert_tvoc", (double)(s.breathVoc > 1.0)},
+    {"alert_humidity_low", (double)(s.humidity < 30)},
+    {"alert_humidity_high", (double)(s.humidity > 70)},
+    {"ventilation_needed", (double)ventilation},
+    {"uptime_seconds", s.uptime},
+    {"timestamp", (double)timeMs}
+  };
+
+  // Numbers are written as float fields, like the influxdb node does
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += fields[i].name;
+    out += '=';
+    appendNumber(out, fields[i].value);
+  }
+  out += ' ';
+  out += std::to_string(timeMs);
+  out += '\n';
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ===== HOST ARDUINO CORE =====
+// The few arduino-esp32 core calls the firmware headers under test make,
+// for host tests that compile them unchanged (packet_store_test,
+// http_session_test, tls_session_test, coap_session_test,
+// mqtt_session_test). Add -Itools/host after -I. - config.h comes from the
+// repository root.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+
+inline unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+inline int64_t esp_timer_get_time() {
+  return (int64_t)millis() * 1000;
+}
+
+inline void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// FreeRTOS ticks are milliseconds here
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+inline uint32_t esp_random() {
+  static std::mt19937 rng(std::random_device{}());
+  return rng();
+}
+
+// ===== STRING =====
+// The part of Arduino's String the headers use
+class String {
+public:
+  String() {}
+  String(const char* text) : text(text != nullptr ? text : "") {}
+  String(const std::string& text) : text(text) {}
+
+  const char* c_str() const { return text.c_str(); }
+  unsigned length() const { return (unsigned)text.size(); }
+  bool startsWith(const char* prefix) const { return text.compare(0, strlen(prefix), prefix) == 0; }
+  int indexOf(const char* part, unsigned from = 0) const {
+    size_t position = text.find(part, from);
+    return position != std::string::npos ? (int)position : -1;
+  }
+  String substring(unsigned from) const { return from < text.size() ? text.substr(from) : std::string(); }
+  String substring(unsigned from, unsigned to) const {
+    return from < to && from < text.size() ? text.substr(from, to - from) : std::string();
+  }
+  long toInt() const { return atol(text.c_str()); }
+  bool operator==(const char* other) const { return text == other; }
+
+private:
+  std::string text;
+};
+
+// ===== IP ADDRESS =====
+class IPAddress {
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+
+  uint8_t operator[](int index) const { return bytes[index]; }
+  uint8_t& operator[](int index) { return bytes[index]; }
+  bool operator==(const IPAddress& other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+  bool operator!=(const IPAddress& other) const { return !(*this == other); }
+  String toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(text);
+  }
+
+private:
+  uint8_t bytes[4] = {0, 0, 0, 0};
+};
+
+// ===== SERIAL =====
+// DEBUG_* output goes to stderr; quiet drops it (tests that reboot a lot)
+class HardwareSerial {
+public:
+  bool quiet = false;
+
+  int printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    if (quiet) {
+      return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int length = vfprintf(stderr, format, args);
+    va_end(args);
+    return length;
+  }
+};
+
+inline HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+// ===== HOST FLASH =====
+// In-memory file system behind the arduino-esp32 FS/File API, with power
+// cuts: after cutPowerAfter(n) the next n flash writes go through and every
+// later one is lost, until powerOn() - the test then "reboots" by starting
+// over with new objects on the same files.
+//
+// A flash write is one File::write() on a file opened "a" (appended on the
+// spot, so a cut between two writes leaves a torn record - LittleFS itself
+// commits appends on close, this is the worse case), the close of a file
+// opened "w" (the new content replaces the old one as a whole, as LittleFS
+// commits it), a remove() or a mkdir().
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct HostFlash {
+  std::map<std::string, std::vector<uint8_t>> files;
+  std::set<std::string> dirs = {"/"};
+  long writesLeft = -1;           // Until the power cut (-1: no cut)
+  uint32_t writes = 0;            // Flash writes that went through
+
+  // True if a write reaches the flash
+  bool write() {
+    if (writesLeft == 0) {
+      return false;
+    }
+    if (writesLeft > 0) {
+      writesLeft--;
+    }
+    writes++;
+    return true;
+  }
+};
+
+class File {
+private:
+  struct Handle {
+    HostFlash* flash = nullptr;
+    std::string path;
+    char mode = 'r';
+    bool directory = false;
+    bool open = true;
+    size_t position = 0;
+    std::vector<uint8_t> replacement;     // Mode "w": content written on close
+    std::vector<std::string> listing;     // Directory: entries not yet returned
+
+    void close() {
+      if (open && mode == 'w' && flash->write()) {
+        flash->files[path] = replacement;
+      }
+      open = false;
+    }
+    ~Handle() { close(); }
+  };
+
+  std::shared_ptr<Handle> handle;
+
+  const std::vector<uint8_t>* content() const {
+    if (handle->mode == 'w') {
+      return &handle->replacement;
+    }
+    auto file = handle->flash->files.find(handle->path);
+    return file != handle->flash->files.end() ? &file->second : nullptr;
+  }
+
+public:
+  File() {}
+  File(HostFlash* flash, const std::string& path, char mode, bool directory) : handle(std::make_shared<Handle>()) {
+    handle->flash = flash;
+    handle->path = path;
+    handle->mode = mode;
+    handle->directory = directory;
+    if (directory) {
+      std::string prefix = path == "/" ? "/" : path + "/";
+      for (const auto& file : flash->files) {
+        if (file.first.compare(0, prefix.size(), prefix) == 0 &&
+            file.first.find('/', prefix.size()) == std::string::npos) {
+          handle->listing.push_back(file.first);
+        }
+      }
+    }
+  }
+
+  explicit operator bool() const { return handle && handle->open; }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    if (!*this || handle->directory || handle->mode == 'r') {
+      return 0;
+    }
+    if (handle->mode == 'w') {
+      handle->replacement.insert(handle->replacement.end(), buf, buf + size);
+    } else if (handle->flash->write()) {
+      std::vector<uint8_t>& data = handle->flash->files[handle->path];
+      data.insert(data.end(), buf, buf + size);
+    }
+    return size;  // After a power cut nobody looks at the result anymore
+  }
+  size_t write(uint8_t data) { return write(&data, 1); }
+
+  size_t read(uint8_t* buf, size_t size) {
+    const std::vector<uint8_t>* data = *this ? content() : nullptr;
+    if (data == nullptr || handle->position >= data->size()) {
+      return 0;
+    }
+    size_t count = std::min(size, data->size() - handle->position);
+    memcpy(buf, data->data() + handle->position, count);
+    handle->position += count;
+    return count;
+  }
+  int read() {
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+  }
+
+  bool seek(uint32_t position, SeekMode mode = SeekSet) {
+    if (!*this) {
+      return false;
+    }
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? handle->position : size();
+    handle->position = base + position;
+    return true;
+  }
+  size_t position() const { return handle ? handle->position : 0; }
+  size_t size() const {
+    const std::vector<uint8_t>* data = handle ? content() : nullptr;
+    return data != nullptr ? data->size() : 0;
+  }
+
+  void close() {
+    if (handle) {
+      handle->close();
+    }
+  }
+
+  const char* path() const { return handle ? handle->path.c_str() : ""; }
+  const char* name() const {
+    const char* slash = strrchr(path(), '/');
+    return slash != nullptr ? slash + 1 : path();
+  }
+  bool isDirectory() const { return handle && handle->directory; }
+
+  File openNextFile(const char* mode = "r") {
+    (void)mode;
+    if (!isDirectory() || handle->listing.empty()) {
+      return File();
+    }
+    std::string next = handle->listing.front();
+    handle->listing.erase(handle->listing.begin());
+    return File(handle->flash, next, 'r', false);
+  }
+};
+
+class FS {
+protected:
+  HostFlash flash;
+
+public:
+  File open(const char* path, const char* mode = "r", bool create = false) {
+    (void)create;
+    std::string name(path);
+    if (flash.dirs.count(name) > 0) {
+      return File(&flash, name, 'r', true);
+    }
+    if (mode[0] == 'r' && flash.files.count(name) == 0) {
+      return File();
+    }
+    if (mode[0] == 'a' && flash.files.count(name) == 0 && flash.write()) {
+      flash.files[name];  // Created empty, like fopen()
+    }
+    return File(&flash, name, mode[0], false);
+  }
+
+  bool exists(const char* path) { return flash.files.count(path) > 0 || flash.dirs.count(path) > 0; }
+
+  bool remove(const char* path) {
+    if (flash.files.count(path) == 0) {
+      return false;
+    }
+    if (flash.write()) {
+      flash.files.erase(path);
+    }
+    return true;
+  }
+
+  bool mkdir(const char* path) {
+    if (flash.write()) {
+      flash.dirs.insert(path);
+    }
+    return true;
+  }
+
+  // ===== HOST ONLY =====
+  void cutPowerAfter(long writes) { flash.writesLeft = writes; }
+  void powerOn() { flash.writesLeft = -1; }
+  bool powerCut() const { return flash.writesLeft == 0; }  // Later writes are lost
+  uint32_t flashWrites() const { return flash.writes; }
+  std::map<std::string, std::vector<uint8_t>>& files() { return flash.files; }
+  void erase() { flash = HostFlash(); }
+};
+
+}  // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef HOST_HTTP_CLIENT_H
+#define HOST_HTTP_CLIENT_H
+
+// ===== HOST HTTPCLIENT =====
+// The request path of the arduino-esp32 HTTPClient HttpConnection relies
+// on, with its error codes and reuse rules:
+//  - sendRequest() keeps a connected client (dropping stale received
+//    bytes) and connects only if it is not
+//  - every error stops the client (returnError()), a read timeout included
+//  - end() keeps the session open if reuse is on and the answer allowed it
+//    (HTTP/1.1 without "Connection: close")
+// Identity bodies with Content-Length only - no chunked transfer, no
+// redirects.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_CONNECTION_LOST     (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER      (-7)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+class HTTPClient {
+private:
+  WiFiClient* client = nullptr;
+  std::string host;
+  uint16_t port = 80;
+  std::string uri;
+  std::string headers;
+  bool reuse = true;
+  bool canReuse = false;
+  uint16_t tcpTimeout = 5000;
+  int returnCode = 0;
+  int size = -1;
+
+public:
+  bool begin(WiFiClient& tcp, String hostName, uint16_t hostPort, String path = "/", bool https = false) {
+    (void)https;
+    client = &tcp;
+    clear();
+    host = hostName.c_str();
+    port = hostPort;
+    uri = path.c_str();
+    return true;
+  }
+
+  void setReuse(bool enabled) { reuse = enabled; }
+  void setTimeout(uint16_t timeoutMs) { tcpTimeout = timeoutMs; }
+
+  void addHeader(const String& name, const String& value) {
+    headers += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+  }
+
+  int POST(uint8_t* payload, size_t length) { return sendRequest("POST", payload, length); }
+
+  int sendRequest(const char* type, uint8_t* payload, size_t length) {
+    if (!connect()) {
+      return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
+    }
+    if (payload != nullptr && length > 0) {
+      addHeader("Content-Length", std::to_string(length));
+    }
+    if (!sendHeader(type)) {
+      return returnError(HTTPC_ERROR_SEND_HEADER_FAILED);
+    }
+    if (payload != nullptr && length > 0 && client->write(payload, length) != length) {
+      return returnError(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+    }
+    return returnError(handleHeaderResponse());
+  }
+
+  bool connected() { return client != nullptr && (client->available() > 0 || client->connected()); }
+
+  int getSize() { return size; }
+  WiFiClient* getStreamPtr() { return connected() ? client : nullptr; }
+
+  // Reads the Content-Length body
+  String getString() {
+    std::string body;
+    unsigned long lastData = millis();
+    while (size > 0 && (int)body.size() < size && connected() && millis() - lastData <= tcpTimeout) {
+      uint8_t buf[256];
+      int count = client->read(buf, std::min(sizeof(buf), (size_t)size - body.size()));
+      if (count > 0) {
+        body.append((const char*)buf, count);
+        lastData = millis();
+      } else {
+        delay(1);
+      }
+    }
+    return String(body);
+  }
+
+  void end() {
+    disconnect();
+    clear();
+  }
+
+private:
+  void clear() {
+    returnCode = 0;
+    size = -1;
+    headers.clear();
+  }
+
+  bool connect() {
+    if (connected()) {
+      while (client->available() > 0) {
+        client->read();
+      }
+      return true;
+    }
+    return client != nullptr && client->connect(host.c_str(), port, tcpTimeout) && connected();
+  }
+
+  bool sendHeader(const char* type) {
+    if (!connected()) {
+      return false;
+    }
+    std::string header = std::string(type) + " " + uri + " HTTP/1.1\r\nHost: " + host;
+    if (port != 80 && port != 443) {
+      header += ":" + std::to_string(port);
+    }
+    header += "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: ";
+    header += reuse ? "keep-alive" : "close";
+    header += "\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n" + headers + "\r\n";
+    return client->write((const uint8_t*)header.data(), header.size()) == header.size();
+  }
+
+  // Reads a line without its line end; false if none is complete yet
+  bool readLine(std::string& pending, std::string& line) {
+    int data;
+    while ((data = client->read()) >= 0) {
+      if (data == '\n') {
+        line.swap(pending);
+        pending.clear();
+        if (!line.empty() && line.back() == '\r') {
+          line.pop_back();
+        }
+        return true;
+      }
+      pending += (char)data;
+    }
+    return false;
+  }
+
+  int handleHeaderResponse() {
+    if (!connected()) {
+      return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    clear();
+    canReuse = reuse;
+    unsigned long lastData = millis();
+    bool firstLine = true;
+    std::string pending;
+    std::string line;
+
+    while (connected()) {
+      if (client->available() > 0 && readLine(pending, line)) {
+        lastData = millis();
+        if (firstLine) {
+          firstLine = false;
+          canReuse = canReuse && line.compare(0, 8, "HTTP/1.1") == 0;
+          size_t codeStart = line.find(' ');
+          returnCode = codeStart != std::string::npos ? atoi(line.c_str() + codeStart + 1) : 0;
+        } else if (line.empty()) {
+          return returnCode != 0 ? returnCode : HTTPC_ERROR_NO_HTTP_SERVER;
+        } else {
+          std::string name = line.substr(0, line.find(':'));
+          std::string value = line.find(':') != std::string::npos ? line.substr(line.find(':') + 1) : "";
+          for (char& c : name) {
+            c = (char)tolower(c);
+          }
+          if (name == "content-length") {
+            size = atoi(value.c_str());
+          } else if (name == "connection" && value.find("close") != std::string::npos &&
+                     value.find("keep-alive") == std::string::npos) {
+            canReuse = false;
+          }
+        }
+      } else {
+        if (millis() - lastData > tcpTimeout) {
+          return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        delay(1);
+      }
+    }
+    return HTTPC_ERROR_CONNECTION_LOST;
+  }
+
+  int returnError(int error) {
+    if (error < 0 && connected()) {
+      client->stop();
+    }
+    return error;
+  }
+
+  void disconnect() {
+    if (!connected()) {
+      return;
+    }
+    while (client->available() > 0) {
+      client->read();
+    }
+    if (!reuse || !canReuse) {
+      client->stop();
+    }
+  }
+};
+
+#endif
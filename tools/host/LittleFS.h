@@ -0,0 +1,23 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+// ===== HOST LITTLEFS =====
+// The FS.h flash stand-in under the name the firmware mounts.
+
+#include <FS.h>
+
+class LittleFSFS : public fs::FS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs") {
+    (void)formatOnFail;
+    (void)basePath;
+    (void)maxOpenFiles;
+    (void)partitionLabel;
+    return true;
+  }
+};
+
+inline LittleFSFS LittleFS;
+
+#endif
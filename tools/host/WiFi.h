@@ -0,0 +1,160 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+// ===== HOST WIFI =====
+// WiFiClient on a POSIX TCP socket, behaving like the arduino-esp32 one
+// where HttpConnection depends on it: connected() stays true while
+// received data is waiting and turns false once the peer closed or reset
+// the connection, a failed write() stops the client, read() returns -1
+// without data. WiFi.hostByName() resolves through getaddrinfo().
+
+#include <Arduino.h>
+#include <Client.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class WiFiClient : public Client {
+private:
+  int socketFd = -1;
+
+public:
+  WiFiClient() {}
+  WiFiClient(const WiFiClient&) = delete;
+  WiFiClient& operator=(const WiFiClient&) = delete;
+  ~WiFiClient() override { WiFiClient::stop(); }
+
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+    WiFiClient::stop();
+    socketFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socketFd < 0) {
+      return 0;
+    }
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    uint8_t bytes[4] = {ip[0], ip[1], ip[2], ip[3]};
+    memcpy(&address.sin_addr, bytes, sizeof(bytes));
+
+    // Non-blocking connect with timeout, then back to blocking
+    int flags = fcntl(socketFd, F_GETFL, 0);
+    fcntl(socketFd, F_SETFL, flags | O_NONBLOCK);
+    int result = ::connect(socketFd, (sockaddr*)&address, sizeof(address));
+    if (result < 0 && errno == EINPROGRESS) {
+      pollfd wait = {socketFd, POLLOUT, 0};
+      int error = 0;
+      socklen_t length = sizeof(error);
+      result = poll(&wait, 1, timeoutMs) == 1 &&
+               getsockopt(socketFd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0 ? 0 : -1;
+    }
+    if (result < 0) {
+      WiFiClient::stop();
+      return 0;
+    }
+    fcntl(socketFd, F_SETFL, flags);
+    return 1;
+  }
+  int connect(IPAddress ip, uint16_t port) override { return connect(ip, port, 3000); }
+  int connect(const char* host, uint16_t port, int32_t timeoutMs);
+  int connect(const char* host, uint16_t port) override { return connect(host, port, 3000); }
+
+  size_t write(const uint8_t* buf, size_t size) override {
+    size_t sent = 0;
+    while (socketFd >= 0 && sent < size) {
+      ssize_t count = send(socketFd, buf + sent, size - sent, MSG_NOSIGNAL);
+      if (count <= 0) {
+        WiFiClient::stop();
+        break;
+      }
+      sent += count;
+    }
+    return sent;
+  }
+  size_t write(uint8_t data) override { return write(&data, 1); }
+
+  int available() override {
+    int count = 0;
+    if (socketFd < 0 || ioctl(socketFd, FIONREAD, &count) < 0) {
+      return 0;
+    }
+    return count;
+  }
+
+  int read(uint8_t* buf, size_t size) override {
+    if (socketFd < 0) {
+      return -1;
+    }
+    ssize_t count = recv(socketFd, buf, size, MSG_DONTWAIT);
+    return count > 0 ? (int)count : -1;
+  }
+  int read() override {
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+  }
+  int peek() override {
+    uint8_t data;
+    return socketFd >= 0 && recv(socketFd, &data, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? data : -1;
+  }
+
+  // Drops received data, like arduino-esp32
+  void flush() override {
+    while (read() >= 0) {
+    }
+  }
+
+  void stop() override {
+    if (socketFd >= 0) {
+      close(socketFd);
+      socketFd = -1;
+    }
+  }
+
+  uint8_t connected() override {
+    if (socketFd < 0) {
+      return 0;
+    }
+    uint8_t data;
+    ssize_t count = recv(socketFd, &data, 1, MSG_PEEK | MSG_DONTWAIT);
+    return count > 0 || (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+  operator bool() override { return connected(); }
+
+  void setNoDelay(bool enabled) {
+    int value = enabled;
+    if (socketFd >= 0) {
+      setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    }
+  }
+};
+
+class WiFiClass {
+public:
+  int hostByName(const char* host, IPAddress& address) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr) {
+      return 0;
+    }
+    const uint8_t* bytes = (const uint8_t*)&((sockaddr_in*)result->ai_addr)->sin_addr;
+    address = IPAddress(bytes[0], bytes[1], bytes[2], bytes[3]);
+    freeaddrinfo(result);
+    return 1;
+  }
+};
+
+inline WiFiClass WiFi;
+
+inline int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  IPAddress ip;
+  return WiFi.hostByName(host, ip) ? connect(ip, port, timeoutMs) : 0;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef HOST_WIFI_UDP_H
+#define HOST_WIFI_UDP_H
+
+// ===== HOST WIFIUDP =====
+// WiFiUDP on a POSIX UDP socket, as far as CoapConnection uses it: one
+// datagram per beginPacket()/endPacket(), parsePacket() takes the next
+// received datagram without waiting and read() returns it from there.
+
+#include <algorithm>
+#include <Arduino.h>
+#include <WiFi.h>
+
+class WiFiUDP {
+private:
+  int socketFd = -1;
+  sockaddr_in target = {};
+  std::string outgoing;
+  uint8_t incoming[1500];
+  size_t incomingLength = 0;
+  size_t incomingOffset = 0;
+  IPAddress sender;
+  uint16_t senderPort = 0;
+
+public:
+  WiFiUDP() {}
+  WiFiUDP(const WiFiUDP&) = delete;
+  WiFiUDP& operator=(const WiFiUDP&) = delete;
+  ~WiFiUDP() { stop(); }
+
+  uint8_t begin(uint16_t port) {
+    stop();
+    socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    if (socketFd < 0 || bind(socketFd, (sockaddr*)&local, sizeof(local)) != 0) {
+      stop();
+      return 0;
+    }
+    return 1;
+  }
+
+  void stop() {
+    if (socketFd >= 0) {
+      close(socketFd);
+      socketFd = -1;
+    }
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    if (socketFd < 0) {
+      return 0;
+    }
+    target = {};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    uint8_t bytes[4] = {ip[0], ip[1], ip[2], ip[3]};
+    memcpy(&target.sin_addr, bytes, sizeof(bytes));
+    outgoing.clear();
+    return 1;
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    outgoing.append((const char*)buf, size);
+    return size;
+  }
+
+  int endPacket() {
+    return socketFd >= 0 && sendto(socketFd, outgoing.data(), outgoing.size(), 0, (sockaddr*)&target,
+                                   sizeof(target)) == (ssize_t)outgoing.size();
+  }
+
+  // Size of the next datagram, 0 if none is waiting
+  int parsePacket() {
+    incomingLength = incomingOffset = 0;
+    sockaddr_in from = {};
+    socklen_t fromLength = sizeof(from);
+    ssize_t count = socketFd >= 0 ? recvfrom(socketFd, incoming, sizeof(incoming), MSG_DONTWAIT,
+                                             (sockaddr*)&from, &fromLength) : -1;
+    if (count <= 0) {
+      return 0;
+    }
+    const uint8_t* bytes = (const uint8_t*)&from.sin_addr;
+    sender = IPAddress(bytes[0], bytes[1], bytes[2], bytes[3]);
+    senderPort = ntohs(from.sin_port);
+    incomingLength = (size_t)count;
+    return (int)count;
+  }
+
+  int read(uint8_t* buf, size_t size) {
+    size_t count = std::min(size, incomingLength - incomingOffset);
+    memcpy(buf, incoming + incomingOffset, count);
+    incomingOffset += count;
+    return (int)count;
+  }
+
+  IPAddress remoteIP() const { return sender; }
+  uint16_t remotePort() const { return senderPort; }
+};
+
+#endif
@@ -0,0 +1,6 @@
+// Host stand-in - see ssl.h
+#if HOST_MBEDTLS
+#include_next <mbedtls/entropy.h>
+#else
+#include "ssl.h"
+#endif
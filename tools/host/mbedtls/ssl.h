@@ -0,0 +1,93 @@
+#ifndef HOST_MBEDTLS_SSL_H
+#define HOST_MBEDTLS_SSL_H
+
+// ===== HOST MBEDTLS =====
+// Just the mbedtls API TlsClient.h calls, so it compiles on the host. There
+// is no TLS behind it: the setup fails, so an https:// endpoint fails to
+// connect and plain http:// never gets here. The other mbedtls/ headers
+// only include this one.
+//
+// With -DHOST_MBEDTLS every mbedtls/ header here passes on to the system's
+// mbedtls (libmbedtls-dev, link -lmbedtls -lmbedx509 -lmbedcrypto) - the
+// 2.28 API of the ESP32 core - for tests of the real handshakes
+// (tls_session_test).
+
+#if HOST_MBEDTLS
+#include_next <mbedtls/ssl.h>
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+#define MBEDTLS_SSL_VERIFY_OPTIONAL 1
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+#define MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE -0x7080
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+#define MBEDTLS_ERR_SSL_TIMEOUT -0x6800
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
+
+struct mbedtls_entropy_context {};
+struct mbedtls_ctr_drbg_context {};
+struct mbedtls_x509_crt {};
+struct mbedtls_ssl_config {};
+struct mbedtls_ssl_context {};
+struct mbedtls_ssl_session {};
+
+typedef int mbedtls_ssl_send_t(void*, const unsigned char*, size_t);
+typedef int mbedtls_ssl_recv_t(void*, unsigned char*, size_t);
+typedef int mbedtls_ssl_recv_timeout_t(void*, unsigned char*, size_t, uint32_t);
+typedef int mbedtls_rng_t(void*, unsigned char*, size_t);
+typedef int mbedtls_verify_t(void*, mbedtls_x509_crt*, int, uint32_t*);
+
+inline void mbedtls_entropy_init(mbedtls_entropy_context*) {}
+inline int mbedtls_entropy_func(void*, unsigned char*, size_t) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context*) {}
+inline int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context*, mbedtls_rng_t*, void*, const unsigned char*, size_t) {
+  return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+}
+inline int mbedtls_ctr_drbg_random(void*, unsigned char*, size_t) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline void mbedtls_x509_crt_init(mbedtls_x509_crt*) {}
+inline int mbedtls_x509_crt_parse(mbedtls_x509_crt*, const unsigned char*, size_t) {
+  return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+}
+
+inline void mbedtls_ssl_config_init(mbedtls_ssl_config*) {}
+inline int mbedtls_ssl_config_defaults(mbedtls_ssl_config*, int, int, int) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline void mbedtls_ssl_conf_rng(mbedtls_ssl_config*, mbedtls_rng_t*, void*) {}
+inline void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config*, mbedtls_x509_crt*, void*) {}
+inline void mbedtls_ssl_conf_authmode(mbedtls_ssl_config*, int) {}
+
+inline void mbedtls_ssl_init(mbedtls_ssl_context*) {}
+inline void mbedtls_ssl_free(mbedtls_ssl_context*) {}
+inline int mbedtls_ssl_setup(mbedtls_ssl_context*, const mbedtls_ssl_config*) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline int mbedtls_ssl_set_hostname(mbedtls_ssl_context*, const char*) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline void mbedtls_ssl_set_verify(mbedtls_ssl_context*, mbedtls_verify_t*, void*) {}
+inline void mbedtls_ssl_set_bio(mbedtls_ssl_context*, void*, mbedtls_ssl_send_t*, mbedtls_ssl_recv_t*,
+                                mbedtls_ssl_recv_timeout_t*) {}
+inline int mbedtls_ssl_handshake(mbedtls_ssl_context*) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline int mbedtls_ssl_read(mbedtls_ssl_context*, unsigned char*, size_t) { return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE; }
+inline int mbedtls_ssl_write(mbedtls_ssl_context*, const unsigned char*, size_t) {
+  return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+}
+inline size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context*) { return 0; }
+inline int mbedtls_ssl_close_notify(mbedtls_ssl_context*) { return 0; }
+inline uint32_t mbedtls_ssl_get_verify_result(const mbedtls_ssl_context*) { return 0; }
+inline const char* mbedtls_ssl_get_version(const mbedtls_ssl_context*) { return "none"; }
+inline const char* mbedtls_ssl_get_ciphersuite(const mbedtls_ssl_context*) { return "none"; }
+
+inline void mbedtls_ssl_session_init(mbedtls_ssl_session*) {}
+inline void mbedtls_ssl_session_free(mbedtls_ssl_session*) {}
+inline int mbedtls_ssl_set_session(mbedtls_ssl_context*, const mbedtls_ssl_session*) {
+  return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+}
+inline int mbedtls_ssl_get_session(const mbedtls_ssl_context*, mbedtls_ssl_session*) {
+  return MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+}
+
+#endif  // HOST_MBEDTLS
+
+#endif
@@ -0,0 +1,6 @@
+// Host stand-in - see ssl.h
+#if HOST_MBEDTLS
+#include_next <mbedtls/x509_crt.h>
+#else
+#include "ssl.h"
+#endif
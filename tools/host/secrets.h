@@ -0,0 +1,9 @@
+#ifndef SECRETS_H
+#define SECRETS_H
+
+// ===== HOST SECRETS =====
+// What the firmware headers under test read from secrets.h (see
+// secrets_template.h). A secrets.h in the repository root is found first.
+#define TLS_CA_CERT ""
+
+#endif
@@ -0,0 +1,244 @@
+// ===== HTTP SESSION TEST =====
+// Runs HttpConnection.h unchanged against a local HTTP stand-in. The host
+// shim in tools/host puts WiFiClient on a POSIX socket and follows the
+// request path of the arduino-esp32 HTTPClient. The body of each request
+// picks how the stand-in treats it:
+//  - ok: answered, the session stays open - a series of POSTs must share
+//    one TCP session and one DNS lookup
+//  - close: answered, then the server closes the idle session - the next
+//    POST opens a new one
+//  - drop: the server handles the request and closes the session without
+//    an answer - the POST fails with a connection error and is not
+//    sent a second time (the server may have stored it), the next POST
+//    opens a new session
+//  - slow: answered after the response timeout - the POST fails with
+//    HTTPC_ERROR_READ_TIMEOUT, is not sent a second time, and the late
+//    answer is not taken for the next request's
+// Every answer echoes the request body, so each POST checks it got its own.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. -Itools/host tools/http_session_test.cpp -o http_session_test -lpthread && ./http_session_test
+// Options: --verbose (DEBUG output of HttpConnection).
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HttpConnection.h"
+
+static const uint16_t TIMEOUT_MS = 300;
+static const uint16_t SLOW_ANSWER_MS = 800;     // Later than TIMEOUT_MS
+
+static int failures = 0;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", name);
+    failures++;
+  }
+}
+
+// ===== HTTP STAND-IN =====
+// One thread per connection, requests in order; counts per request body
+class StandIn {
+public:
+  uint16_t port = 0;
+
+  bool start() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 8) != 0 ||
+        getsockname(listenFd, (sockaddr*)&address, &length) != 0) {
+      return false;
+    }
+    port = ntohs(address.sin_port);
+    acceptor = std::thread([this] { acceptLoop(); });
+    return true;
+  }
+
+  void stop() {
+    shutdown(listenFd, SHUT_RDWR);
+    close(listenFd);
+    acceptor.join();
+    for (std::thread& connection : connections) {
+      connection.join();
+    }
+  }
+
+  int sessions() {
+    std::lock_guard<std::mutex> guard(lock);
+    return (int)connections.size();
+  }
+  int received(const std::string& body) {
+    std::lock_guard<std::mutex> guard(lock);
+    return receivedCount[body];
+  }
+  int handled(const std::string& body) {
+    std::lock_guard<std::mutex> guard(lock);
+    return handledCount[body];
+  }
+
+private:
+  int listenFd = -1;
+  std::thread acceptor;
+  std::vector<std::thread> connections;
+  std::mutex lock;
+  std::map<std::string, int> receivedCount;
+  std::map<std::string, int> handledCount;
+
+  void acceptLoop() {
+    int fd;
+    while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+      std::lock_guard<std::mutex> guard(lock);
+      connections.emplace_back([this, fd] { serve(fd); });
+    }
+  }
+
+  // Next request body; false once the client closed the session
+  static bool readRequest(int fd, std::string& buffer, std::string& body) {
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+      char data[512];
+      ssize_t count = recv(fd, data, sizeof(data), 0);
+      if (count <= 0) {
+        return false;
+      }
+      buffer.append(data, count);
+    }
+    size_t lengthField = buffer.find("Content-Length: ");
+    size_t length = lengthField < headerEnd ? strtoul(buffer.c_str() + lengthField + 16, nullptr, 10) : 0;
+    size_t bodyStart = headerEnd + 4;
+    while (buffer.size() < bodyStart + length) {
+      char data[512];
+      ssize_t count = recv(fd, data, sizeof(data), 0);
+      if (count <= 0) {
+        return false;
+      }
+      buffer.append(data, count);
+    }
+    body = buffer.substr(bodyStart, length);
+    buffer.erase(0, bodyStart + length);
+    return true;
+  }
+
+  void serve(int fd) {
+    std::string buffer;
+    std::string body;
+    while (readRequest(fd, buffer, body)) {
+      std::string mode = body.substr(0, body.find(':'));
+      int arrivals;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        arrivals = ++receivedCount[body];
+      }
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        handledCount[body]++;
+      }
+      if (mode == "drop" && arrivals == 1) {
+        break;
+      }
+      if (mode == "slow") {
+        delay(SLOW_ANSWER_MS);
+      }
+      std::string answer = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\n\r\n" + body;
+      send(fd, answer.data(), answer.size(), MSG_NOSIGNAL);
+      if (mode == "close") {
+        break;
+      }
+    }
+    close(fd);
+  }
+};
+
+// ===== CLIENT SIDE =====
+// One upload as ByteTransmission does it; answer is the echoed body
+static int post(HttpConnection& connection, const std::string& body, std::string& answer) {
+  int code = connection.post("text/plain", nullptr, 0, (const uint8_t*)body.data(), body.size(), TIMEOUT_MS);
+  answer = code == 200 ? connection.response().getString().c_str() : "";
+  connection.finish();
+  return code;
+}
+
+static bool postEchoed(HttpConnection& connection, const std::string& body) {
+  std::string answer;
+  return post(connection, body, answer) == 200 && answer == body;
+}
+
+// The connection closes its session when it goes out of scope
+static void runCases(StandIn& server) {
+  std::string url = "http://localhost:" + std::to_string(server.port) + "/sensor-data";
+  HttpConnection connection(url.c_str());
+  const HttpConnectionStats& stats = connection.getStats();
+
+  // Keep-alive: one session, one lookup
+  bool echoed = true;
+  for (int i = 0; i < 5; i++) {
+    echoed = postEchoed(connection, "ok:" + std::to_string(i)) && echoed;
+  }
+  expect(echoed, "keep-alive: answers");
+  expect(stats.connects == 1 && server.sessions() == 1, "keep-alive: one session for 5 requests");
+  expect(stats.dnsLookups == 1, "keep-alive: one DNS lookup");
+
+  // Idle session closed by the server after an answer
+  expect(postEchoed(connection, "close:1"), "idle close: answer before the close");
+  delay(50);
+  expect(postEchoed(connection, "ok:5"), "idle close: next request answered");
+  expect(stats.connects == 2 && server.sessions() == 2, "idle close: new session");
+
+  // Session lost after the server handled the request
+  std::string answer;
+  int code = post(connection, "drop:1", answer);
+  expect(code == HTTPC_ERROR_CONNECTION_LOST || code == HTTPC_ERROR_NOT_CONNECTED,
+         "lost answer: connection loss reported");
+  expect(server.received("drop:1") == 1 && server.handled("drop:1") == 1, "lost answer: request not sent twice");
+  expect(postEchoed(connection, "ok:7"), "lost answer: next request answered");
+  expect(stats.connects == 3 && server.sessions() == 3, "lost answer: one reconnect");
+
+  // Answer after the response timeout
+  code = post(connection, "slow:1", answer);
+  expect(code == HTTPC_ERROR_READ_TIMEOUT, "timeout: read timeout reported");
+  expect(postEchoed(connection, "ok:6"), "timeout: next request gets its own answer");
+  delay(SLOW_ANSWER_MS + 200);
+  expect(server.received("slow:1") == 1, "timeout: request not sent twice");
+  expect(stats.connects == 4, "timeout: session not reused after the timeout");
+  expect(stats.dnsLookups == 1, "one DNS lookup in all");
+
+  printf("HTTP sessions: %u requests, %u failures, %u connects, %u DNS lookups, %u ms average\n",
+         (unsigned)stats.requests, (unsigned)stats.failures, (unsigned)stats.connects,
+         (unsigned)stats.dnsLookups, (unsigned)stats.averageRequestMs());
+}
+
+int main(int argc, char** argv) {
+  Serial.quiet = true;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--verbose") {
+      Serial.quiet = false;
+    } else {
+      fprintf(stderr, "Usage: %s [--verbose]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  StandIn server;
+  if (!server.start()) {
+    fprintf(stderr, "Cannot listen on the loopback interface\n");
+    return 1;
+  }
+  runCases(server);
+  server.stop();
+
+  if (failures > 0) {
+    printf("FAIL: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("OK: keep-alive reuse, reconnect after server close, no repeated POST after a lost answer or a timeout\n");
+  return 0;
+}
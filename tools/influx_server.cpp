@@ -0,0 +1,419 @@
+// ===== INFLUXDB STAND-IN SERVER =====
+// Minimal InfluxDB v2 write endpoint for testing INFLUX_DIRECT without an
+// InfluxDB instance. Accepts POST /api/v2/write on keep-alive connections,
+// inflates Content-Encoding: gzip bodies with zlib (an implementation
+// independent of Gzip.h), checks every line (measurement, tags, float
+// fields, timestamp) and answers 204 like InfluxDB, or 400 with the first
+// bad line. --token checks the Authorization header (401 otherwise).
+//
+// --selftest N runs the firmware encoders on the host instead: N random
+// packets through LineProtocolEncoder and GzipEncoder in batches as the
+// device sends them, each batch inflated with zlib and compared.
+//
+// Build and run from the repository root (Linux, zlib):
+//   g++ -std=c++17 -I. tools/influx_server.cpp -o influx_server -lz && ./influx_server
+// Options: --port N (default 8086), --token T, --lines FILE (append the
+// received lines), --fail N (answer every Nth write with 503 to exercise the
+// device's retry), --selftest N (no server), --batch N (samples per batch
+// in the self test, default INFLUX_BATCH_SAMPLES).
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "Gzip.h"
+#include "LineProtocol.h"
+
+static const size_t MAX_BODY_SIZE = 1 << 20;
+
+struct Options {
+  uint16_t port = 8086;
+  std::string token;
+  std::string linesFile;
+  unsigned fail = 0;
+  size_t selftest = 0;
+  size_t batch = INFLUX_BATCH_SAMPLES;
+};
+
+struct Client {
+  int fd = -1;
+  std::string peer;
+  std::string rx;
+};
+
+static Options options;
+static std::map<int, Client> clients;
+static FILE* linesOut = nullptr;
+static unsigned writes = 0;
+static uint64_t totalLines = 0;
+
+// ===== LINE CHECKS =====
+// Inflates a gzip member; false if the stream or its CRC/size trailer is bad
+static bool gunzip(const std::string& in, std::string& out) {
+  z_stream stream = {};
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+    return false;
+  }
+  stream.next_in = (Bytef*)in.data();
+  stream.avail_in = (uInt)in.size();
+  char buffer[16384];
+  int status;
+  do {
+    stream.next_out = (Bytef*)buffer;
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_NO_FLUSH);
+    out.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (status == Z_OK && out.size() <= MAX_BODY_SIZE * 16);
+  inflateEnd(&stream);
+  return status == Z_STREAM_END && stream.avail_in == 0;
+}
+
+static bool isNumber(const std::string& text) {
+  char* end;
+  strtod(text.c_str(), &end);
+  return !text.empty() && *end == '\0';
+}
+
+// measurement,tag=value,... field=number,... timestamp
+static bool checkLine(const std::string& line, std::string& error) {
+  size_t tagsEnd = std::string::npos;
+  for (size_t i = 0; i < line.size(); i++) {
+    if (line[i] == '\\') {
+      i++;
+    } else if (line[i] == ' ') {
+      tagsEnd = i;
+      break;
+    }
+  }
+  size_t fieldsEnd = line.rfind(' ');
+  if (tagsEnd == std::string::npos || fieldsEnd == tagsEnd || line.compare(0, 12, "air_quality,") != 0) {
+    error = "expected measurement air_quality with tags, fields and timestamp";
+    return false;
+  }
+  std::string timestamp = line.substr(fieldsEnd + 1);
+  if (timestamp.empty() || timestamp.find_first_not_of("0123456789") != std::string::npos) {
+    error = "bad timestamp";
+    return false;
+  }
+  std::string fields = line.substr(tagsEnd + 1, fieldsEnd - tagsEnd - 1) + ",";
+  for (size_t start = 0, comma; (comma = fields.find(',', start)) != std::string::npos; start = comma + 1) {
+    std::string field = fields.substr(start, comma - start);
+    size_t equals = field.find('=');
+    if (equals == std::string::npos || equals == 0 || !isNumber(field.substr(equals + 1))) {
+      error = "bad field '" + field + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+// ===== HTTP =====
+static void sendResponse(Client& client, int status, const char* reason, const std::string& body) {
+  std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+  if (!body.empty()) {
+    response += "Content-Type: application/json\r\n";
+  }
+  response += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  send(client.fd, response.data(), response.size(), MSG_NOSIGNAL);
+}
+
+static std::string headerValue(const std::string& head, const char* name) {
+  std::string lower = head;
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  std::string key = std::string("\r\n") + name + ":";
+  size_t at = lower.find(key);
+  if (at == std::string::npos) {
+    return "";
+  }
+  size_t start = head.find_first_not_of(' ', at + key.size());
+  return head.substr(start, head.find("\r\n", start) - start);
+}
+
+static void handleWrite(Client& client, const std::string& head, const std::string& body) {
+  if (!options.token.empty() && headerValue(head, "authorization") != "Token " + options.token) {
+    sendResponse(client, 401, "Unauthorized", "{\"code\":\"unauthorized\",\"message\":\"unauthorized access\"}");
+    return;
+  }
+  writes++;
+  if (options.fail != 0 && writes % options.fail == 0) {
+    printf("%s: write %u answered with 503 (--fail)\n", client.peer.c_str(), writes);
+    sendResponse(client, 503, "Service Unavailable", "");
+    return;
+  }
+
+  std::string text = body;
+  bool gzip = headerValue(head, "content-encoding") == "gzip";
+  if (gzip) {
+    text.clear();
+    if (!gunzip(body, text)) {
+      sendResponse(client, 400, "Bad Request", "{\"code\":\"invalid\",\"message\":\"gzip body not readable\"}");
+      return;
+    }
+  }
+
+  size_t lines = 0;
+  for (size_t start = 0; start < text.size();) {
+    size_t end = text.find('\n', start);
+    std::string line = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    start = end == std::string::npos ? text.size() : end + 1;
+    if (line.empty()) {
+      continue;
+    }
+    std::string error;
+    if (!checkLine(line, error)) {
+      printf("%s: line %zu rejected - %s\n  %s\n", client.peer.c_str(), lines + 1, error.c_str(), line.c_str());
+      sendResponse(client, 400, "Bad Request", "{\"code\":\"invalid\",\"message\":\"line " +
+                   std::to_string(lines + 1) + ": " + error + "\"}");
+      return;
+    }
+    lines++;
+  }
+  totalLines += lines;
+  if (linesOut != nullptr) {
+    fwrite(text.data(), 1, text.size(), linesOut);
+    fflush(linesOut);
+  }
+  if (gzip) {
+    printf("%s: %zu lines, %zu bytes gzip -> %zu bytes (%.1fx), %llu lines total\n", client.peer.c_str(), lines,
+           body.size(), text.size(), (double)text.size() / std::max<size_t>(1, body.size()),
+           (unsigned long long)totalLines);
+  } else {
+    printf("%s: %zu lines, %zu bytes, %llu lines total\n", client.peer.c_str(), lines, text.size(),
+           (unsigned long long)totalLines);
+  }
+  sendResponse(client, 204, "No Content", "");
+}
+
+// Handles every complete request in rx; false closes the connection
+static bool processInput(Client& client) {
+  for (;;) {
+    size_t headEnd = client.rx.find("\r\n\r\n");
+    if (headEnd == std::string::npos) {
+      return client.rx.size() <= 8192;
+    }
+    std::string head = client.rx.substr(0, headEnd + 2);
+    std::string lengthText = headerValue(head, "content-length");
+    size_t length = lengthText.empty() ? 0 : (size_t)atol(lengthText.c_str());
+    if (length > MAX_BODY_SIZE) {
+      sendResponse(client, 413, "Payload Too Large", "");
+      return false;
+    }
+    if (client.rx.size() < headEnd + 4 + length) {
+      return true;  // Wait for the rest of the body
+    }
+    std::string body = client.rx.substr(headEnd + 4, length);
+    client.rx.erase(0, headEnd + 4 + length);
+
+    static const std::string WRITE = "POST /api/v2/write";
+    if (head.compare(0, WRITE.size(), WRITE) == 0 && (head[WRITE.size()] == '?' || head[WRITE.size()] == ' ')) {
+      handleWrite(client, head, body);
+    } else {
+      sendResponse(client, 404, "Not Found", "{\"code\":\"not found\",\"message\":\"path not found\"}");
+    }
+    if (strcasecmp(headerValue(head, "connection").c_str(), "close") == 0) {
+      return false;
+    }
+  }
+}
+
+// ===== SELF TEST =====
+static int selftest() {
+  std::mt19937 rng(15);
+  uint16_t hashTable[GzipEncoder::HASH_SIZE];
+  std::vector<char> lines(options.batch * LineProtocolEncoder::MAX_LINE_LENGTH);
+  std::vector<uint8_t> gzip(GzipEncoder::maxEncodedSize(lines.size()));
+
+  SensorDataPacket packet = {};
+  packet.magic_version = PACKET_MAGIC_V3;
+  uint8_t id[6] = {0x24, 0x6F, 0x28, 0xAB, 0xCD, 0xEF};
+  memcpy(packet.device_id, id, sizeof(id));
+
+  size_t rawBytes = 0, gzipBytes = 0, longest = 0, batches = 0;
+  double encodeSeconds = 0;
+  uint64_t time = 1767571200000ull;
+  for (size_t done = 0; done < options.selftest;) {
+    size_t length = 0;
+    size_t count = std::min(options.batch, options.selftest - done);
+    for (size_t i = 0; i < count; i++, done++, time += 10000) {
+      // Random values across each field's range, sensors present or not
+      uint8_t* raw = (uint8_t*)&packet;
+      for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+        const PacketFieldSpec& field = PACKET_SCHEMA[f];
+        if (!isConstantField(field.type)) {
+          for (size_t b = 0; b < field.size; b++) {
+            raw[field.offset + b] = (uint8_t)rng();
+          }
+        }
+      }
+      packet.ds_flags = rng() % 2;
+      packet.pms_flags = rng() % 4 != 0;
+      // Every third line with the worst-case location (all characters escaped)
+      static const std::string LOCATIONS[3] = {"default_location", "living room",
+                                               std::string(LineProtocolEncoder::MAX_LOCATION_LENGTH, ',')};
+      const char* location = LOCATIONS[i % 3].c_str();
+      size_t used = LineProtocolEncoder::encode(packet, location, time, lines.data() + length, lines.size() - length);
+      if (used == 0 || used > LineProtocolEncoder::MAX_LINE_LENGTH) {
+        fprintf(stderr, "line does not fit into MAX_LINE_LENGTH\n");
+        return 1;
+      }
+      std::string error;
+      if (!checkLine(std::string(lines.data() + length, used - 1), error)) {
+        fprintf(stderr, "bad line (%s): %.*s", error.c_str(), (int)used, lines.data() + length);
+        return 1;
+      }
+      longest = std::max(longest, used);
+      length += used;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t compressed = GzipEncoder::encode((const uint8_t*)lines.data(), length, gzip.data(), gzip.size(), hashTable);
+    encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::string inflated;
+    if (compressed == 0 || !gunzip(std::string((const char*)gzip.data(), compressed), inflated) ||
+        inflated != std::string(lines.data(), length)) {
+      fprintf(stderr, "gzip round trip failed in batch %zu\n", batches);
+      return 1;
+    }
+    rawBytes += length;
+    gzipBytes += compressed;
+    batches++;
+  }
+
+  // Worst case of the encoder: incompressible input stays within the bound
+  std::vector<uint8_t> noise(GzipEncoder::MAX_INPUT_LENGTH);
+  for (uint8_t& byte : noise) {
+    byte = (uint8_t)rng();
+  }
+  std::vector<uint8_t> noiseOut(GzipEncoder::maxEncodedSize(noise.size()));
+  size_t noiseLength = GzipEncoder::encode(noise.data(), noise.size(), noiseOut.data(), noiseOut.size(), hashTable);
+  std::string inflated;
+  if (noiseLength == 0 || !gunzip(std::string((const char*)noiseOut.data(), noiseLength), inflated) ||
+      inflated != std::string(noise.begin(), noise.end())) {
+    fprintf(stderr, "gzip round trip of random bytes failed\n");
+    return 1;
+  }
+
+  printf("%zu lines in %zu batches of %zu: %zu bytes -> %zu bytes gzip (%.1fx), longest line %zu of %zu bytes\n",
+         options.selftest, batches, options.batch, rawBytes, gzipBytes, (double)rawBytes / gzipBytes, longest,
+         LineProtocolEncoder::MAX_LINE_LENGTH);
+  printf("gzip: %.1f MB/s on this host, random 64 KB -> %zu bytes (bound %zu); zlib inflates every batch\n",
+         rawBytes / encodeSeconds / 1e6, noiseLength, noiseOut.size());
+  return 0;
+}
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--port") {
+      options.port = (uint16_t)atoi(argv[++i]);
+    } else if (arg == "--token") {
+      options.token = argv[++i];
+    } else if (arg == "--lines") {
+      options.linesFile = argv[++i];
+    } else if (arg == "--fail") {
+      options.fail = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--selftest") {
+      options.selftest = (size_t)atol(argv[++i]);
+    } else if (arg == "--batch") {
+      options.batch = (size_t)atol(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0 && options.batch > 0 &&
+         options.batch * LineProtocolEncoder::MAX_LINE_LENGTH <= GzipEncoder::MAX_INPUT_LENGTH;
+}
+
+static void closeClient(int fd) {
+  printf("%s: closed\n", clients[fd].peer.c_str());
+  close(fd);
+  clients.erase(fd);
+}
+
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) {
+    fprintf(stderr, "usage: %s [--port N] [--token T] [--lines FILE] [--fail N] [--selftest N [--batch N]]\n",
+            argv[0]);
+    return 2;
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  if (options.selftest > 0) {
+    return selftest();
+  }
+  if (!options.linesFile.empty()) {
+    linesOut = options.linesFile == "-" ? stdout : fopen(options.linesFile.c_str(), "a");
+    if (linesOut == nullptr) {
+      perror(options.linesFile.c_str());
+      return 1;
+    }
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(options.port);
+  if (listener < 0 || bind(listener, (sockaddr*)&local, sizeof(local)) != 0 || listen(listener, 8) != 0) {
+    perror("listen");
+    return 1;
+  }
+  printf("InfluxDB stand-in listening on tcp/%u - POST /api/v2/write%s\n", options.port,
+         options.token.empty() ? "" : " (token required)");
+
+  for (;;) {
+    std::vector<pollfd> fds = {{listener, POLLIN, 0}};
+    for (const auto& entry : clients) {
+      fds.push_back({entry.first, POLLIN, 0});
+    }
+    poll(fds.data(), fds.size(), -1);
+
+    if (fds[0].revents & POLLIN) {
+      sockaddr_in peer = {};
+      socklen_t peerLength = sizeof(peer);
+      int fd = accept(listener, (sockaddr*)&peer, &peerLength);
+      if (fd >= 0) {
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        Client& client = clients[fd];
+        client.fd = fd;
+        client.peer = std::string(inet_ntoa(peer.sin_addr)) + ":" + std::to_string(ntohs(peer.sin_port));
+      }
+    }
+
+    for (size_t i = 1; i < fds.size(); i++) {
+      if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+        continue;
+      }
+      Client& client = clients[fds[i].fd];
+      char buffer[16384];
+      ssize_t count = recv(client.fd, buffer, sizeof(buffer), 0);
+      if (count <= 0) {
+        closeClient(fds[i].fd);
+        continue;
+      }
+      client.rx.append(buffer, (size_t)count);
+      if (!processInput(client)) {
+        closeClient(fds[i].fd);
+      }
+    }
+  }
+}
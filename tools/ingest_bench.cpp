@@ -0,0 +1,519 @@
+// ===== INGEST BENCHMARK =====
+// Load generator for tools/ingest_server (or the Node-RED flow): simulates
+// N devices, each on its own keep-alive connection, sending what
+// ByteTransmissionManager sends - live v3 packets with X-AQI-Response:
+// binary, backlog uploads (back to back or as batch frame) or
+// /calculate-aqi requests. Reports requests/s and latency percentiles.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/ingest_bench.cpp -o ingest_bench && ./ingest_bench --devices 10000
+// Options: --host H (127.0.0.1), --port N (1880), --devices N (1000),
+// --duration S (10), --warmup S (2), --interval MS (0 = closed loop: next
+// request as soon as the answer is in; 10000 = DATA_SEND_INTERVAL),
+// --mode live|backlog|batch|aqi (live), --backlog N (32 packets per upload).
+// 10k devices need ~10k file descriptors on both sides (ulimit -n).
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "packet_decoder.h"
+
+static const size_t MAX_CONNECTING = 256;   // Parallel TCP handshakes
+static const uint8_t AQI_RESPONSE_MAGIC = 0xA1;
+
+enum class Mode { LIVE, BACKLOG, BATCH, AQI };
+
+struct Options {
+  std::string host = "127.0.0.1";
+  uint16_t port = 1880;
+  size_t devices = 1000;
+  unsigned durationS = 10;
+  unsigned warmupS = 2;
+  unsigned intervalMs = 0;
+  Mode mode = Mode::LIVE;
+  size_t backlog = 32;
+};
+
+enum class State { IDLE, CONNECTING, CONNECTED, WAITING };
+
+struct Device {
+  int fd = -1;
+  State state = State::IDLE;
+  SensorDataPacket packet;
+  std::string out;
+  size_t outOffset = 0;
+  std::string in;
+  int64_t sentAt = 0;
+};
+
+static int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ===== SIMULATED DEVICE =====
+class Bench {
+public:
+  explicit Bench(const Options& options) : options(options), devices(options.devices) {}
+  int run();
+
+private:
+  typedef std::pair<int64_t, size_t> Timer;  // Due time (us), device
+
+  const Options& options;
+  std::vector<Device> devices;
+  sockaddr_storage address = {};
+  socklen_t addressLength = 0;
+  int epollFd = -1;
+  std::mt19937 rng{42};
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+  std::vector<size_t> connectQueue;
+  size_t connecting = 0;
+  size_t connected = 0;
+
+  int64_t measureStart = 0;
+  int64_t measureEnd = 0;
+  std::vector<uint32_t> latencies;
+  uint64_t requests = 0;
+  uint64_t packets = 0;
+  uint64_t errors = 0;
+  uint64_t reconnects = 0;
+
+  bool resolve();
+  void initPacket(size_t index);
+  void nextSample(SensorDataPacket& packet);
+  void startConnect(size_t index);
+  void onConnected(size_t index);
+  void send(size_t index);
+  void flush(size_t index);
+  void readable(size_t index);
+  void fail(size_t index);
+  void schedule(size_t index, int64_t delayUs);
+  bool checkResponse(const std::string& body) const;
+  void report(int64_t connectUs) const;
+};
+
+bool Bench::resolve() {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  std::string port = std::to_string(options.port);
+  if (getaddrinfo(options.host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr) {
+    return false;
+  }
+  memcpy(&address, result->ai_addr, result->ai_addrlen);
+  addressLength = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+void Bench::initPacket(size_t index) {
+  SensorDataPacket& p = devices[index].packet;
+  memset(&p, 0, sizeof(p));
+  p.magic_version = PACKET_MAGIC_V3;
+  uint8_t id[6] = {0x24, 0x6F, 0x28, (uint8_t)(index >> 16), (uint8_t)(index >> 8), (uint8_t)index};
+  memcpy(p.device_id, id, sizeof(id));
+  p.boot_count = 1 + rng() % 50;
+  p.uptime_seconds = 60 + rng() % 86400;
+  p.bme_temperature = 1800 + rng() % 800;
+  p.bme_humidity = 3000 + rng() % 4000;
+  p.bme_pressure = 9800 + rng() % 400;
+  p.gas_resistance = 50000 + rng() % 200000;
+  p.iaq = 250 + rng() % 1500;
+  p.static_iaq = p.iaq;
+  p.co2_equivalent = 450 + rng() % 1000;
+  p.breath_voc = 30 + rng() % 200;
+  p.iaq_accuracy = p.co2_accuracy = p.voc_accuracy = rng() % 4;
+  p.bme_flags = 1 | (p.iaq_accuracy >= 2 ? 2 : 0);
+  p.ds_flags = index % 4 != 0;  // Not every device has the DS18B20
+  p.ds_temperature = p.ds_flags ? p.bme_temperature - 50 : 0;
+  p.pms_flags = 1;
+  p.pm1_0 = 2 + rng() % 20;
+  p.pm2_5 = p.pm1_0 + rng() % 30;
+  p.pm10 = p.pm2_5 + rng() % 30;
+  p.wifi_rssi = -40 - (int8_t)(rng() % 50);
+}
+
+void Bench::nextSample(SensorDataPacket& p) {
+  // Small random walk like real readings - keeps batch frame deltas realistic
+  auto walk = [this](int value, int step, int low, int high) {
+    return std::min(high, std::max(low, value + (int)(rng() % (2 * step + 1)) - step));
+  };
+  p.sequence++;
+  p.uptime_seconds += 10;
+  p.bme_temperature = (int16_t)walk(p.bme_temperature, 5, -2000, 5000);
+  p.bme_humidity = (uint16_t)walk(p.bme_humidity, 20, 0, 10000);
+  p.bme_pressure = (uint16_t)walk(p.bme_pressure, 1, 9000, 11000);
+  p.gas_resistance = (uint32_t)walk((int)p.gas_resistance, 500, 1000, 1000000);
+  p.iaq = (uint16_t)walk(p.iaq, 10, 0, 5000);
+  p.static_iaq = p.iaq;
+  p.co2_equivalent = (uint16_t)walk(p.co2_equivalent, 5, 400, 5000);
+  p.breath_voc = (uint16_t)walk(p.breath_voc, 2, 0, 3000);
+  p.pm2_5 = (uint16_t)walk(p.pm2_5, 1, 0, 500);
+  p.wifi_rssi = (int8_t)walk(p.wifi_rssi, 1, -100, -30);
+}
+
+void Bench::startConnect(size_t index) {
+  Device& device = devices[index];
+  device.fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  int on = 1;
+  setsockopt(device.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  int result = connect(device.fd, (sockaddr*)&address, addressLength);
+  if (device.fd < 0 || (result != 0 && errno != EINPROGRESS)) {
+    perror("connect");
+    fail(index);
+    return;
+  }
+  device.state = State::CONNECTING;
+  connecting++;
+  epoll_event event = {};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+  event.data.u64 = index;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, device.fd, &event);
+}
+
+void Bench::onConnected(size_t index) {
+  Device& device = devices[index];
+  int error = 0;
+  socklen_t length = sizeof(error);
+  getsockopt(device.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+  connecting--;
+  if (error != 0) {
+    fail(index);
+    return;
+  }
+  device.state = State::CONNECTED;
+  connected++;
+
+  // Devices boot at random times: spread the first send over one interval
+  schedule(index, options.intervalMs > 0 ? (int64_t)(rng() % (options.intervalMs * 1000)) : 0);
+}
+
+void Bench::schedule(size_t index, int64_t delayUs) {
+  timers.push(Timer(nowUs() + delayUs, index));
+}
+
+void Bench::send(size_t index) {
+  Device& device = devices[index];
+  if (device.state != State::CONNECTED) {
+    return;
+  }
+
+  static uint8_t body[BatchFrameEncoder::maxFrameSize(255) + 255 * PACKET_WIRE_MAX_SIZE];
+  size_t length = 0;
+  char headers[256];
+  const char* path = "/sensor-data";
+  const char* type = "application/octet-stream";
+  size_t count = 1;
+
+  if (options.mode == Mode::LIVE) {
+    nextSample(device.packet);
+    length = PacketEncoder::encode(device.packet, body);
+    snprintf(headers, sizeof(headers), "X-Packet-Size: %zu\r\nX-Device-Uptime: %u\r\nX-Boot-Count: %u\r\n"
+             "X-AQI-Response: binary\r\n", length, device.packet.uptime_seconds, device.packet.boot_count);
+  } else if (options.mode == Mode::AQI) {
+    nextSample(device.packet);
+    const SensorDataPacket& p = device.packet;
+    length = (size_t)snprintf((char*)body, 128, "{\"pm2_5\":%u,\"pm10\":%u,\"iaq\":%g,\"co2\":%u,\"calibrated\":%s}",
+                              p.pm2_5, p.pm10, p.iaq / 10.0, p.co2_equivalent, p.bme_flags & 2 ? "true" : "false");
+    path = "/calculate-aqi";
+    type = "application/json";
+    headers[0] = '\0';
+  } else {
+    // Oldest first, as PacketStore hands them out
+    SensorDataPacket batch[255];
+    count = std::min<size_t>(options.backlog, 255);
+    for (size_t i = 0; i < count; i++) {
+      nextSample(device.packet);
+      batch[i] = device.packet;
+    }
+    if (options.mode == Mode::BATCH) {
+      length = BatchFrameEncoder::encode(batch, count, body, sizeof(body));
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        length += PacketEncoder::encode(batch[i], body + length);
+      }
+    }
+    snprintf(headers, sizeof(headers), "X-Packet-Format: %s\r\nX-Backlog: %zu\r\nX-Device-Uptime: %u\r\n"
+             "X-Boot-Count: %u\r\n", options.mode == Mode::BATCH ? "batch" : "raw", count,
+             device.packet.uptime_seconds + 5, device.packet.boot_count);
+  }
+
+  char request[512];
+  int headerLength = snprintf(request, sizeof(request), "POST %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n"
+                              "Content-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                              path, options.host.c_str(), type, length, headers);
+  device.out.assign(request, (size_t)headerLength);
+  device.out.append((const char*)body, length);
+  device.outOffset = 0;
+  device.in.clear();
+  device.sentAt = nowUs();
+  device.state = State::WAITING;
+  packets += count;
+  flush(index);
+}
+
+void Bench::flush(size_t index) {
+  Device& device = devices[index];
+  while (device.outOffset < device.out.size()) {
+    ssize_t n = ::send(device.fd, device.out.data() + device.outOffset, device.out.size() - device.outOffset,
+                       MSG_NOSIGNAL);
+    if (n > 0) {
+      device.outOffset += (size_t)n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;  // EPOLLOUT continues
+    } else {
+      fail(index);
+      return;
+    }
+  }
+}
+
+void Bench::readable(size_t index) {
+  Device& device = devices[index];
+  char buffer[4096];
+  for (;;) {
+    ssize_t n = recv(device.fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      device.in.append(buffer, (size_t)n);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      fail(index);  // Server closed the connection
+      return;
+    }
+  }
+  if (device.state != State::WAITING) {
+    return;
+  }
+
+  size_t headerEnd = device.in.find("\r\n\r\n");
+  if (headerEnd == std::string::npos) {
+    return;
+  }
+  size_t contentLength = 0;
+  const char* field = strcasestr(device.in.c_str(), "\r\ncontent-length:");
+  if (field != nullptr && (size_t)(field - device.in.c_str()) < headerEnd) {
+    contentLength = strtoul(field + 17, nullptr, 10);
+  }
+  if (device.in.size() < headerEnd + 4 + contentLength) {
+    return;
+  }
+
+  int64_t now = nowUs();
+  int status = atoi(device.in.c_str() + 9);
+  bool valid = status == 200 && checkResponse(device.in.substr(headerEnd + 4, contentLength));
+  if (now >= measureStart && now < measureEnd) {
+    requests++;
+    if (valid) {
+      latencies.push_back((uint32_t)(now - device.sentAt));
+    } else {
+      errors++;
+    }
+  }
+  device.state = State::CONNECTED;
+  schedule(index, options.intervalMs > 0 ? (int64_t)options.intervalMs * 1000 - (now - device.sentAt) : 0);
+}
+
+bool Bench::checkResponse(const std::string& body) const {
+  if (options.mode != Mode::LIVE) {
+    return !body.empty();
+  }
+  // AQIResponsePacket: magic and XOR checksum
+  if (body.size() != 8 || (uint8_t)body[0] != AQI_RESPONSE_MAGIC) {
+    return false;
+  }
+  uint8_t checksum = 0;
+  for (size_t i = 0; i < 7; i++) {
+    checksum ^= (uint8_t)body[i];
+  }
+  return checksum == (uint8_t)body[7];
+}
+
+void Bench::fail(size_t index) {
+  Device& device = devices[index];
+  if (device.state == State::CONNECTING) {
+    connecting--;
+  } else if (device.state == State::CONNECTED || device.state == State::WAITING) {
+    connected--;
+  }
+  if (device.state == State::WAITING && nowUs() >= measureStart) {
+    errors++;
+  }
+  if (device.fd >= 0) {
+    close(device.fd);
+    device.fd = -1;
+  }
+  device.state = State::IDLE;
+  reconnects++;
+  connectQueue.push_back(index);
+}
+
+int Bench::run() {
+  if (!resolve()) {
+    fprintf(stderr, "cannot resolve %s\n", options.host.c_str());
+    return 1;
+  }
+  epollFd = epoll_create1(0);
+  for (size_t i = 0; i < devices.size(); i++) {
+    initPacket(i);
+    connectQueue.push_back(devices.size() - 1 - i);
+  }
+  reconnects = 0;
+
+  // Connect phase, then warmup and measurement
+  int64_t start = nowUs();
+  int64_t connectUs = -1;
+  std::vector<epoll_event> events(1024);
+  measureStart = INT64_MAX;
+  measureEnd = INT64_MAX;
+
+  for (;;) {
+    int64_t now = nowUs();
+    while (!connectQueue.empty() && connecting < MAX_CONNECTING) {
+      size_t index = connectQueue.back();
+      connectQueue.pop_back();
+      startConnect(index);
+    }
+    if (connectUs < 0 && connected == devices.size()) {
+      connectUs = now - start;
+      measureStart = now + (int64_t)options.warmupS * 1000000;
+      measureEnd = measureStart + (int64_t)options.durationS * 1000000;
+      fprintf(stderr, "%zu devices connected in %.0f ms, measuring for %u s after %u s warmup\n",
+              devices.size(), connectUs / 1000.0, options.durationS, options.warmupS);
+    }
+    if (now >= measureEnd) {
+      break;
+    }
+    if (connectUs < 0 && now - start > 60 * 1000000LL) {
+      fprintf(stderr, "only %zu of %zu devices connected after 60 s\n", connected, devices.size());
+      return 1;
+    }
+
+    while (!timers.empty() && timers.top().first <= now) {
+      size_t index = timers.top().second;
+      timers.pop();
+      send(index);
+    }
+
+    int timeout = timers.empty() ? 10 : (int)std::min<int64_t>(10, (timers.top().first - now + 999) / 1000);
+    int count = epoll_wait(epollFd, events.data(), (int)events.size(), std::max(0, timeout));
+    for (int i = 0; i < count; i++) {
+      size_t index = (size_t)events[i].data.u64;
+      Device& device = devices[index];
+      if (device.state == State::CONNECTING) {
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+          onConnected(index);
+        }
+        continue;
+      }
+      if (device.state == State::IDLE) {
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) {
+        flush(index);
+      }
+      if (device.state != State::IDLE && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        readable(index);
+      }
+    }
+  }
+
+  report(connectUs);
+  return 0;
+}
+
+void Bench::report(int64_t connectUs) const {
+  static const char* const MODES[] = {"live", "backlog", "batch", "aqi"};
+  std::vector<uint32_t> sorted(latencies);
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&sorted](double p) {
+    return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, (size_t)(p / 100 * sorted.size()))] / 1000.0;
+  };
+
+  double seconds = options.durationS;
+  printf("devices %zu, mode %s, %s, connect %.0f ms\n", devices.size(), MODES[(int)options.mode],
+         options.intervalMs > 0 ? ("one request per device every " + std::to_string(options.intervalMs) + " ms").c_str()
+                                : "closed loop", connectUs / 1000.0);
+  printf("requests %llu in %.0f s: %.0f req/s", (unsigned long long)requests, seconds, requests / seconds);
+  if (options.mode == Mode::BACKLOG || options.mode == Mode::BATCH) {
+    printf(" (%zu packets each)", std::min<size_t>(options.backlog, 255));
+  }
+  printf(", errors %llu, reconnects %llu\n", (unsigned long long)errors, (unsigned long long)reconnects);
+  printf("latency ms: p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+         percentile(50), percentile(90), percentile(99), percentile(99.9),
+         sorted.empty() ? 0.0 : sorted.back() / 1000.0);
+}
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--host") {
+      options.host = value;
+    } else if (arg == "--port") {
+      options.port = (uint16_t)atoi(value.c_str());
+    } else if (arg == "--devices") {
+      options.devices = (size_t)atol(value.c_str());
+    } else if (arg == "--duration") {
+      options.durationS = (unsigned)atoi(value.c_str());
+    } else if (arg == "--warmup") {
+      options.warmupS = (unsigned)atoi(value.c_str());
+    } else if (arg == "--interval") {
+      options.intervalMs = (unsigned)atoi(value.c_str());
+    } else if (arg == "--backlog") {
+      options.backlog = (size_t)atol(value.c_str());
+    } else if (arg == "--mode") {
+      if (value == "live") options.mode = Mode::LIVE;
+      else if (value == "backlog") options.mode = Mode::BACKLOG;
+      else if (value == "batch") options.mode = Mode::BATCH;
+      else if (value == "aqi") options.mode = Mode::AQI;
+      else return false;
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0 && options.devices > 0 && options.durationS > 0 && options.backlog > 0;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--host H] [--port N] [--devices N] [--duration S] [--warmup S] [--interval MS]\n"
+                    "       [--mode live|backlog|batch|aqi] [--backlog N]\n", argv[0]);
+    return 2;
+  }
+
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < options.devices + 16) {
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, options.devices + 16);
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < options.devices + 16) {
+      fprintf(stderr, "warning: only %llu file descriptors (ulimit -n)\n", (unsigned long long)limit.rlim_cur);
+    }
+  }
+
+  Bench bench(options);
+  return bench.run();
+}
@@ -0,0 +1,1003 @@
+// ===== INGEST SERVER =====
+// Native replacement for the Node-RED ingest path: speaks the same HTTP
+// protocol as ByteTransmissionManager (POST /sensor-data with v3 packets or
+// batch frames, POST /calculate-aqi with JSON) and writes the rows of the
+// "InfluxDB v2 Object Formatter" to the InfluxDB v2 write API in batches.
+// Packets are decoded with packet_decoder.h (driven by PacketSchema.h), AQI,
+// comfort values and fields come from flow_pipeline.h.
+//
+// One epoll loop per worker thread, each with its own SO_REUSEPORT listen
+// socket so the kernel spreads the devices' keep-alive connections. Workers
+// collect line protocol and hand full batches to a single writer thread.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/ingest_server.cpp -o ingest_server -pthread && ./ingest_server
+// Options: --port N (default 1880, like Node-RED), --workers N (default: one
+// per core), --influx http://host:8086 --org ORG --bucket BUCKET (token in
+// INFLUX_TOKEN or --token), --lines FILE (line protocol to a file, - = stdout,
+// instead of InfluxDB), --batch-lines N (5000), --flush-ms MS (1000),
+// --idle-timeout S (60), --stats S (10, 0 = off), --store DIR (also append
+// every packet to a series_store.h store with 1 min / 1 h / 1 day rollups).
+// Without --influx or --lines the rows are built and counted, not stored.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "flow_pipeline.h"
+#include "series_store.h"
+
+static const size_t MAX_HEADER_SIZE = 8192;
+static const size_t MAX_BODY_SIZE = 256 * 1024;
+static const size_t MIN_WIRE_SIZE = PacketFieldCodec<0>::size(PacketFieldCodec<0>::fixedSections()) + 1 + 4;
+static const size_t MAX_PACKETS = MAX_BODY_SIZE / MIN_WIRE_SIZE;
+static const int TICK_MS = 100;
+
+struct Options {
+  uint16_t port = 1880;
+  unsigned workers = 0;
+  std::string influx;
+  std::string org;
+  std::string bucket;
+  std::string token;
+  std::string linesFile;
+  std::string storeDir;
+  size_t batchLines = 5000;
+  unsigned flushMs = 1000;
+  unsigned idleTimeoutS = 60;
+  unsigned statsS = 10;
+};
+
+static std::atomic<bool> running(true);
+
+static int64_t wallClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int64_t steadyMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ===== INFLUX WRITER =====
+// Single thread that posts merged worker batches to /api/v2/write over one
+// keep-alive connection (plain HTTP). Failed batches are retried; if the
+// queue grows past its limit the oldest batch is dropped.
+class InfluxWriter {
+public:
+  std::atomic<uint64_t> lines{0};
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> failures{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> postMicros{0};
+
+  bool start(const Options& options);
+  void submit(std::string&& batch, size_t count);
+  void stop();
+
+private:
+  struct Batch {
+    std::string body;
+    size_t count;
+  };
+
+  Options options;
+  std::string host;
+  std::string port = "8086";
+  std::string path;
+  FILE* file = nullptr;
+  int sock = -1;
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<Batch> queue;
+  bool stopping = false;
+  std::thread thread;
+
+  static const size_t QUEUE_LIMIT = 64;
+
+  void run();
+  bool write(const Batch& batch, bool& retry);
+  bool post(const std::string& body, int& status);
+  bool connectSocket();
+  void closeSocket();
+  static std::string urlEncode(const std::string& text);
+};
+
+bool InfluxWriter::start(const Options& opts) {
+  options = opts;
+  if (!options.linesFile.empty()) {
+    file = options.linesFile == "-" ? stdout : fopen(options.linesFile.c_str(), "a");
+    if (file == nullptr) {
+      perror(options.linesFile.c_str());
+      return false;
+    }
+  } else if (!options.influx.empty()) {
+    const std::string scheme = "http://";
+    if (options.influx.compare(0, scheme.size(), scheme) != 0 || options.org.empty() || options.bucket.empty()) {
+      fprintf(stderr, "--influx needs an http:// URL, --org and --bucket\n");
+      return false;
+    }
+    std::string rest = options.influx.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    std::string base = slash == std::string::npos ? "" : rest.substr(slash);
+    while (!base.empty() && base.back() == '/') {
+      base.pop_back();
+    }
+    size_t colon = authority.rfind(':');
+    host = authority.substr(0, colon);
+    if (colon != std::string::npos) {
+      port = authority.substr(colon + 1);
+    }
+    path = base + "/api/v2/write?org=" + urlEncode(options.org) + "&bucket=" + urlEncode(options.bucket) +
+           "&precision=ms";
+  }
+  thread = std::thread(&InfluxWriter::run, this);
+  return true;
+}
+
+void InfluxWriter::submit(std::string&& batch, size_t count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.push_back(Batch{std::move(batch), count});
+  if (queue.size() > QUEUE_LIMIT) {
+    dropped += queue.front().count;
+    queue.pop_front();
+  }
+  ready.notify_one();
+}
+
+void InfluxWriter::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  ready.notify_one();
+  thread.join();
+  if (file != nullptr && file != stdout) {
+    fclose(file);
+  }
+  closeSocket();
+}
+
+void InfluxWriter::run() {
+  for (;;) {
+    Batch batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty()) {
+        return;  // Stopping and drained
+      }
+      // Merge queued worker batches up to the batch size
+      batch = std::move(queue.front());
+      queue.pop_front();
+      while (!queue.empty() && batch.count + queue.front().count <= options.batchLines) {
+        batch.body += queue.front().body;
+        batch.count += queue.front().count;
+        queue.pop_front();
+      }
+    }
+
+    for (int attempt = 0;; attempt++) {
+      bool retry = false;
+      if (write(batch, retry)) {
+        lines += batch.count;
+        break;
+      }
+      failures++;
+      bool stop;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = stopping;
+      }
+      if (!retry || stop || attempt >= 4) {
+        dropped += batch.count;
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(500 << attempt));
+    }
+  }
+}
+
+bool InfluxWriter::write(const Batch& batch, bool& retry) {
+  if (file != nullptr) {
+    fwrite(batch.body.data(), 1, batch.body.size(), file);
+    fflush(file);
+    return true;
+  }
+  if (host.empty()) {
+    return true;  // No sink - rows are only counted
+  }
+
+  int64_t start = steadyMs();
+  int status = 0;
+  bool sent = post(batch.body, status);
+  requests++;
+  postMicros += (uint64_t)(steadyMs() - start) * 1000;
+  if (sent && status == 204) {
+    return true;
+  }
+
+  // Connection errors, 429 and 5xx are worth another try, other 4xx are not
+  retry = !sent || status == 429 || status >= 500;
+  fprintf(stderr, "InfluxDB write failed: %s (%zu lines)\n",
+          sent ? ("HTTP " + std::to_string(status)).c_str() : "connection error", batch.count);
+  return false;
+}
+
+bool InfluxWriter::post(const std::string& body, int& status) {
+  std::string header = "POST " + path + " HTTP/1.1\r\nHost: " + host + ":" + port +
+                       "\r\nContent-Type: text/plain; charset=utf-8\r\nContent-Length: " +
+                       std::to_string(body.size()) + "\r\n";
+  if (!options.token.empty()) {
+    header += "Authorization: Token " + options.token + "\r\n";
+  }
+  header += "\r\n";
+
+  // A kept-alive connection may have been closed by the server meanwhile
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (sock < 0 && !connectSocket()) {
+      return false;
+    }
+    std::string request = header + body;
+    size_t sent = 0;
+    while (sent < request.size()) {
+      ssize_t n = send(sock, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        break;
+      }
+      sent += (size_t)n;
+    }
+
+    std::string response;
+    char buffer[4096];
+    size_t headerEnd = std::string::npos;
+    while (sent == request.size() && headerEnd == std::string::npos) {
+      ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        break;
+      }
+      response.append(buffer, (size_t)n);
+      headerEnd = response.find("\r\n\r\n");
+    }
+    if (headerEnd == std::string::npos || response.compare(0, 5, "HTTP/") != 0) {
+      closeSocket();
+      continue;
+    }
+
+    status = atoi(response.c_str() + response.find(' ') + 1);
+    size_t contentLength = 0;
+    bool close = false;
+    size_t lineStart = response.find("\r\n") + 2;
+    while (lineStart < headerEnd) {
+      size_t lineEnd = response.find("\r\n", lineStart);
+      std::string line = response.substr(lineStart, lineEnd - lineStart);
+      if (strncasecmp(line.c_str(), "content-length:", 15) == 0) {
+        contentLength = strtoul(line.c_str() + 15, nullptr, 10);
+      } else if (strncasecmp(line.c_str(), "connection:", 11) == 0 && strcasestr(line.c_str(), "close")) {
+        close = true;
+      }
+      lineStart = lineEnd + 2;
+    }
+    while (response.size() < headerEnd + 4 + contentLength) {
+      ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        close = true;
+        break;
+      }
+      response.append(buffer, (size_t)n);
+    }
+    if (status != 204) {
+      fprintf(stderr, "InfluxDB: %.200s\n", response.c_str() + headerEnd + 4);
+    }
+    if (close) {
+      closeSocket();
+    }
+    return true;
+  }
+  return false;
+}
+
+bool InfluxWriter::connectSocket() {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+    return false;
+  }
+  for (addrinfo* ai = result; ai != nullptr && sock < 0; ai = ai->ai_next) {
+    sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (sock < 0) {
+      continue;
+    }
+    timeval timeout = {10, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(sock, ai->ai_addr, ai->ai_addrlen) != 0) {
+      closeSocket();
+    }
+  }
+  freeaddrinfo(result);
+  return sock >= 0;
+}
+
+void InfluxWriter::closeSocket() {
+  if (sock >= 0) {
+    close(sock);
+    sock = -1;
+  }
+}
+
+std::string InfluxWriter::urlEncode(const std::string& text) {
+  std::string encoded;
+  for (unsigned char c : text) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      encoded += (char)c;
+    } else {
+      char escape[4];
+      snprintf(escape, sizeof(escape), "%%%02X", c);
+      encoded += escape;
+    }
+  }
+  return encoded;
+}
+
+// ===== HTTP REQUEST PARSING =====
+struct HttpRequest {
+  std::string_view method;
+  std::string_view path;
+  std::string_view packetFormat;     // X-Packet-Format
+  std::string_view aqiResponse;      // X-AQI-Response
+  long deviceUptime = -1;            // X-Device-Uptime
+  long bootCount = -1;               // X-Boot-Count
+  size_t contentLength = 0;
+  bool chunked = false;
+  bool keepAlive = true;
+  const char* body = nullptr;
+};
+
+enum ParseResult { PARSE_INCOMPLETE, PARSE_OK, PARSE_BAD, PARSE_TOO_LARGE };
+
+static std::string_view trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+static bool headerIs(std::string_view name, const char* expected) {
+  return name.size() == strlen(expected) && strncasecmp(name.data(), expected, name.size()) == 0;
+}
+
+static long headerNumber(std::string_view value) {
+  // parseInt(): leading digits, -1 if there are none
+  long number = 0;
+  size_t i = 0;
+  for (; i < value.size() && value[i] >= '0' && value[i] <= '9' && i < 12; i++) {
+    number = number * 10 + (value[i] - '0');
+  }
+  return i > 0 ? number : -1;
+}
+
+// Parses the request at the start of data; consumed is set for PARSE_OK
+static ParseResult parseRequest(const char* data, size_t length, HttpRequest& request, size_t& consumed) {
+  std::string_view text(data, length < MAX_HEADER_SIZE ? length : MAX_HEADER_SIZE);
+  size_t headerEnd = text.find("\r\n\r\n");
+  if (headerEnd == std::string_view::npos) {
+    return length >= MAX_HEADER_SIZE ? PARSE_TOO_LARGE : PARSE_INCOMPLETE;
+  }
+
+  request = HttpRequest();
+  size_t lineEnd = text.find("\r\n");
+  std::string_view line = text.substr(0, lineEnd);
+  size_t space1 = line.find(' ');
+  size_t space2 = line.rfind(' ');
+  if (space1 == std::string_view::npos || space2 <= space1) {
+    return PARSE_BAD;
+  }
+  request.method = line.substr(0, space1);
+  request.path = line.substr(space1 + 1, space2 - space1 - 1);
+  request.path = request.path.substr(0, request.path.find('?'));
+  request.keepAlive = line.substr(space2 + 1) == "HTTP/1.1";
+
+  size_t lineStart = lineEnd + 2;
+  while (lineStart < headerEnd) {
+    lineEnd = text.find("\r\n", lineStart);
+    line = text.substr(lineStart, lineEnd - lineStart);
+    lineStart = lineEnd + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      return PARSE_BAD;
+    }
+    std::string_view name = line.substr(0, colon);
+    std::string_view value = trim(line.substr(colon + 1));
+    if (headerIs(name, "content-length")) {
+      long number = headerNumber(value);
+      if (number < 0) {
+        return PARSE_BAD;
+      }
+      request.contentLength = (size_t)number;
+    } else if (headerIs(name, "transfer-encoding")) {
+      request.chunked = true;
+    } else if (headerIs(name, "connection")) {
+      request.keepAlive = headerIs(value, "keep-alive") || (request.keepAlive && !headerIs(value, "close"));
+    } else if (headerIs(name, "x-packet-format")) {
+      request.packetFormat = value;
+    } else if (headerIs(name, "x-aqi-response")) {
+      request.aqiResponse = value;
+    } else if (headerIs(name, "x-device-uptime")) {
+      request.deviceUptime = headerNumber(value);
+    } else if (headerIs(name, "x-boot-count")) {
+      request.bootCount = headerNumber(value);
+    }
+  }
+
+  if (request.contentLength > MAX_BODY_SIZE) {
+    return PARSE_TOO_LARGE;
+  }
+  if (length < headerEnd + 4 + request.contentLength) {
+    return PARSE_INCOMPLETE;
+  }
+  request.body = data + headerEnd + 4;
+  consumed = headerEnd + 4 + request.contentLength;
+  return PARSE_OK;
+}
+
+// Number of "key": value in a flat JSON object, false if absent or not a number
+static bool jsonNumber(std::string_view json, const char* key, double& value) {
+  std::string quoted = std::string("\"") + key + "\"";
+  size_t position = json.find(quoted);
+  if (position == std::string_view::npos) {
+    return false;
+  }
+  std::string rest(json.substr(position + quoted.size(), 64));
+  const char* p = rest.c_str();
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+  if (*p++ != ':') {
+    return false;
+  }
+  char* end;
+  value = strtod(p, &end);
+  return end != p;
+}
+
+// ===== WORKER =====
+struct Connection {
+  int fd;
+  std::string in;
+  std::string out;
+  size_t outOffset = 0;
+  bool closeAfterWrite = false;
+  bool writeWait = false;
+  int64_t lastActive;
+};
+
+struct WorkerStats {
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> packets{0};
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> connections{0};
+};
+
+class Worker {
+public:
+  WorkerStats stats;
+
+  Worker(const Options& options, InfluxWriter& writer, SeriesStore* store)
+    : options(options), writer(writer), store(store) {}
+  bool listen();
+  void run();
+
+private:
+  const Options& options;
+  InfluxWriter& writer;
+  SeriesStore* store;           // nullptr without --store
+  int epollFd = -1;
+  int listenFd = -1;
+  std::vector<std::unique_ptr<Connection>> connections;  // By fd
+  std::vector<SensorDataPacket> packets = std::vector<SensorDataPacket>(MAX_PACKETS);
+
+  std::string lines;
+  size_t lineCount = 0;
+  int64_t batchStart = 0;
+
+  void accept();
+  void readable(Connection& connection);
+  void flush(Connection& connection);
+  void closeConnection(Connection& connection);
+  void handle(const HttpRequest& request, Connection& connection);
+  int sensorData(const HttpRequest& request, std::string& body, const char*& contentType);
+  int calculateAqi(const HttpRequest& request, std::string& body);
+  void handOff(bool force);
+};
+
+bool Worker::listen() {
+  listenFd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  int on = 1;
+  int off = 0;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  setsockopt(listenFd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+  sockaddr_in6 local = {};
+  local.sin6_family = AF_INET6;
+  local.sin6_addr = in6addr_any;
+  local.sin6_port = htons(options.port);
+  if (listenFd < 0 || bind(listenFd, (sockaddr*)&local, sizeof(local)) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+    perror("listen");
+    return false;
+  }
+
+  epollFd = epoll_create1(0);
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = listenFd;
+  return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+}
+
+void Worker::run() {
+  std::vector<epoll_event> events(1024);
+  int64_t lastSweep = steadyMs();
+
+  while (running) {
+    int count = epoll_wait(epollFd, events.data(), (int)events.size(), TICK_MS);
+    for (int i = 0; i < count; i++) {
+      int fd = events[i].data.fd;
+      if (fd == listenFd) {
+        accept();
+        continue;
+      }
+      Connection* connection = (size_t)fd < connections.size() ? connections[fd].get() : nullptr;
+      if (connection == nullptr) {
+        continue;
+      }
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        closeConnection(*connection);
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) {
+        flush(*connection);
+        connection = connections[fd].get();
+      }
+      if (connection != nullptr && (events[i].events & (EPOLLIN | EPOLLRDHUP))) {
+        readable(*connection);
+      }
+    }
+
+    int64_t now = steadyMs();
+    handOff(false);
+    if (now - lastSweep >= 1000) {
+      lastSweep = now;
+      for (auto& connection : connections) {
+        if (connection && now - connection->lastActive > (int64_t)options.idleTimeoutS * 1000) {
+          closeConnection(*connection);
+        }
+      }
+    }
+  }
+
+  handOff(true);
+  for (auto& connection : connections) {
+    if (connection) {
+      closeConnection(*connection);
+    }
+  }
+  close(listenFd);
+  close(epollFd);
+}
+
+void Worker::accept() {
+  for (;;) {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("accept");
+      }
+      return;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if ((size_t)fd >= connections.size()) {
+      connections.resize(fd + 1024);
+    }
+    connections[fd].reset(new Connection());
+    connections[fd]->fd = fd;
+    connections[fd]->lastActive = steadyMs();
+    stats.connections++;
+
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+  }
+}
+
+void Worker::readable(Connection& connection) {
+  // Edge triggered: read until the socket is drained
+  char buffer[16384];
+  bool peerClosed = false;
+  for (;;) {
+    ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      connection.in.append(buffer, (size_t)n);
+      continue;
+    }
+    if (n == 0) {
+      peerClosed = true;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      peerClosed = true;
+    }
+    break;
+  }
+  connection.lastActive = steadyMs();
+
+  // Several requests may be queued (pipelining)
+  size_t offset = 0;
+  while (!connection.closeAfterWrite && offset < connection.in.size()) {
+    HttpRequest request;
+    size_t consumed = 0;
+    ParseResult result = parseRequest(connection.in.data() + offset, connection.in.size() - offset, request, consumed);
+    if (result == PARSE_INCOMPLETE) {
+      break;
+    }
+    if (result != PARSE_OK) {
+      stats.errors++;
+      const char* response = result == PARSE_TOO_LARGE
+        ? "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+        : "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      connection.out += response;
+      connection.closeAfterWrite = true;
+      break;
+    }
+    handle(request, connection);
+    offset += consumed;
+  }
+  connection.in.erase(0, offset);
+
+  if (peerClosed && connection.out.size() == connection.outOffset) {
+    closeConnection(connection);
+    return;
+  }
+  connection.closeAfterWrite |= peerClosed;
+  flush(connection);
+}
+
+void Worker::flush(Connection& connection) {
+  while (connection.outOffset < connection.out.size()) {
+    ssize_t n = send(connection.fd, connection.out.data() + connection.outOffset,
+                     connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+    if (n > 0) {
+      connection.outOffset += (size_t)n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!connection.writeWait) {
+        // Socket buffer full - continue when it drains
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.writeWait = true;
+      }
+      return;
+    } else {
+      closeConnection(connection);
+      return;
+    }
+  }
+
+  connection.out.clear();
+  connection.outOffset = 0;
+  if (connection.closeAfterWrite) {
+    closeConnection(connection);
+  } else if (connection.writeWait) {
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.fd = connection.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.writeWait = false;
+  }
+}
+
+void Worker::closeConnection(Connection& connection) {
+  int fd = connection.fd;
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  connections[fd].reset();
+  stats.connections--;
+}
+
+void Worker::handle(const HttpRequest& request, Connection& connection) {
+  stats.requests++;
+  std::string body;
+  const char* contentType = "application/json";
+  int status;
+
+  if (request.path != "/sensor-data" && request.path != "/calculate-aqi") {
+    status = 404;
+  } else if (request.method != "POST") {
+    status = 405;
+  } else if (request.chunked) {
+    status = 411;  // The firmware always sends Content-Length
+  } else if (request.path == "/sensor-data") {
+    status = sensorData(request, body, contentType);
+  } else {
+    status = calculateAqi(request, body);
+  }
+  if (status >= 400) {
+    stats.errors++;
+  }
+
+  const char* reason = status == 200 ? "OK" : status == 400 ? "Bad Request" : status == 404 ? "Not Found"
+                     : status == 405 ? "Method Not Allowed" : "Length Required";
+  char header[160];
+  int headerLength = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                              status, reason, contentType, body.size(), request.keepAlive ? "" : "Connection: close\r\n");
+  connection.out.append(header, (size_t)headerLength);
+  connection.out += body;
+  connection.closeAfterWrite = !request.keepAlive;
+}
+
+int Worker::sensorData(const HttpRequest& request, std::string& body, const char*& contentType) {
+  const uint8_t* data = (const uint8_t*)request.body;
+  size_t length = request.contentLength;
+  size_t count = 0;
+
+  if (request.packetFormat == "batch") {
+    count = BatchFrameDecoder::decode(data, length, packets.data(), packets.size());
+  } else {
+    // v3 packets back to back - v1/v2 firmware is not supported here
+    for (size_t offset = 0; offset < length && count < packets.size(); count++) {
+      size_t used = PacketDecoder::decode(data + offset, length - offset, packets[count]);
+      if (used == 0) {
+        count = 0;
+        break;
+      }
+      offset += used;
+    }
+  }
+  if (count == 0) {
+    body = "{\"success\":false,\"error\":\"Invalid packet\"}";
+    return 400;
+  }
+  stats.packets += count;
+
+  // Acquisition time from the device clock, else of queued samples from
+  // uptime and boot count at send time
+  int64_t now = wallClockMs();
+  FlowSample sample;
+  for (size_t i = 0; i < count; i++) {
+    const SensorDataPacket& packet = packets[i];
+    FlowPipeline::toSample(packet, sample);
+    bool sameBoot = request.bootCount < 0 || packet.boot_count == request.bootCount;
+    int64_t time = now;
+    if (FlowPipeline::deviceTime(packet, time)) {
+      // Packet time section
+    } else if (request.deviceUptime >= 0 && sameBoot && (long)packet.uptime_seconds <= request.deviceUptime) {
+      time = now - ((int64_t)request.deviceUptime - packet.uptime_seconds) * 1000;
+    }
+    if (lineCount == 0) {
+      batchStart = steadyMs();
+    }
+    FlowPipeline::appendInfluxLine(lines, sample, time);
+    lineCount++;
+    if (store != nullptr && !store->append(packet, time)) {
+      stats.errors++;
+    }
+  }
+  handOff(false);
+
+  // Combined mode: AQI of the live packet in the answer
+  if (count == 1 && request.aqiResponse == "binary") {
+    FlowPipeline::appendBinaryAnswer(body, FlowPipeline::answer(FlowPipeline::requestFor(sample)));
+    contentType = "application/octet-stream";
+    return 200;
+  }
+  body = "{\"success\":true,\"stored\":" + std::to_string(count) + "}";
+  return 200;
+}
+
+int Worker::calculateAqi(const HttpRequest& request, std::string& body) {
+  std::string_view json = trim(std::string_view(request.body, request.contentLength));
+  if (json.empty() || json.front() != '{') {
+    body = "{\"success\":false,\"error\":\"Invalid JSON\"}";
+    return 400;
+  }
+  AqiRequest aqi;
+  aqi.hasPm1 = jsonNumber(json, "pm1_0", aqi.pm1);
+  aqi.hasPm25 = jsonNumber(json, "pm2_5", aqi.pm25);
+  aqi.hasPm10 = jsonNumber(json, "pm10", aqi.pm10);
+  aqi.hasCo2 = jsonNumber(json, "co2", aqi.co2);
+  aqi.hasIaq = jsonNumber(json, "iaq", aqi.iaq);
+  FlowPipeline::appendJsonAnswer(body, FlowPipeline::answer(aqi), wallClockMs());
+  return 200;
+}
+
+void Worker::handOff(bool force) {
+  if (lineCount == 0) {
+    return;
+  }
+  if (force || lineCount >= options.batchLines || steadyMs() - batchStart >= (int64_t)options.flushMs) {
+    writer.submit(std::move(lines), lineCount);
+    lines = std::string();
+    lineCount = 0;
+  }
+}
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--port") {
+      options.port = (uint16_t)atoi(value.c_str());
+    } else if (arg == "--workers") {
+      options.workers = (unsigned)atoi(value.c_str());
+    } else if (arg == "--influx") {
+      options.influx = value;
+    } else if (arg == "--org") {
+      options.org = value;
+    } else if (arg == "--bucket") {
+      options.bucket = value;
+    } else if (arg == "--token") {
+      options.token = value;
+    } else if (arg == "--lines") {
+      options.linesFile = value;
+    } else if (arg == "--store") {
+      options.storeDir = value;
+    } else if (arg == "--batch-lines") {
+      options.batchLines = (size_t)atol(value.c_str());
+    } else if (arg == "--flush-ms") {
+      options.flushMs = (unsigned)atoi(value.c_str());
+    } else if (arg == "--idle-timeout") {
+      options.idleTimeoutS = (unsigned)atoi(value.c_str());
+    } else if (arg == "--stats") {
+      options.statsS = (unsigned)atoi(value.c_str());
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0 && options.batchLines > 0;
+}
+
+static void onSignal(int) {
+  running = false;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (const char* token = getenv("INFLUX_TOKEN")) {
+    options.token = token;
+  }
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--port N] [--workers N] [--influx URL --org ORG --bucket BUCKET [--token T]]\n"
+                    "       [--lines FILE] [--batch-lines N] [--flush-ms MS] [--idle-timeout S] [--stats S]\n"
+                    "       [--store DIR]\n", argv[0]);
+    return 2;
+  }
+  if (options.workers == 0) {
+    options.workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // One descriptor per device connection
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  InfluxWriter writer;
+  if (!writer.start(options)) {
+    return 1;
+  }
+  std::unique_ptr<SeriesStore> store;
+  if (!options.storeDir.empty()) {
+    store.reset(new SeriesStore(options.storeDir));
+    if (!store->open()) {
+      return 1;
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (unsigned i = 0; i < options.workers; i++) {
+    workers.emplace_back(new Worker(options, writer, store.get()));
+    if (!workers.back()->listen()) {
+      return 1;
+    }
+  }
+  std::vector<std::thread> threads;
+  for (auto& worker : workers) {
+    threads.emplace_back(&Worker::run, worker.get());
+  }
+
+  const char* sink = !options.linesFile.empty() ? options.linesFile.c_str()
+                   : !options.influx.empty() ? options.influx.c_str() : "none (rows counted only)";
+  fprintf(stderr, "Ingest server on tcp/%u: %u worker(s), InfluxDB: %s, batches of %zu lines / %u ms\n",
+          options.port, options.workers, sink, options.batchLines, options.flushMs);
+  if (store) {
+    fprintf(stderr, "Series store: %s\n", options.storeDir.c_str());
+  }
+
+  // Totals every --stats seconds
+  uint64_t lastRequests = 0;
+  uint64_t lastPackets = 0;
+  int64_t lastTime = steadyMs();
+  int64_t nextStats = lastTime + options.statsS * 1000;
+  while (running) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(TICK_MS));
+    if (options.statsS == 0 || steadyMs() < nextStats) {
+      continue;
+    }
+    uint64_t requests = 0, packets = 0, errors = 0, connections = 0;
+    for (auto& worker : workers) {
+      requests += worker->stats.requests;
+      packets += worker->stats.packets;
+      errors += worker->stats.errors;
+      connections += worker->stats.connections;
+    }
+    int64_t now = steadyMs();
+    double seconds = (now - lastTime) / 1000.0;
+    uint64_t posts = writer.requests;
+    fprintf(stderr, "%llu connections, %.0f req/s, %.0f packets/s, %llu errors - InfluxDB: %llu lines, %llu dropped, "
+                    "%llu writes (avg %.1f ms), %llu failed\n",
+            (unsigned long long)connections, (requests - lastRequests) / seconds, (packets - lastPackets) / seconds,
+            (unsigned long long)errors, (unsigned long long)writer.lines.load(), (unsigned long long)writer.dropped.load(),
+            (unsigned long long)posts, posts > 0 ? writer.postMicros / 1000.0 / posts : 0.0,
+            (unsigned long long)writer.failures.load());
+    lastRequests = requests;
+    lastPackets = packets;
+    lastTime = now;
+    nextStats = now + options.statsS * 1000;
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  writer.stop();
+  if (store) {
+    store->sync();
+    fprintf(stderr, "Store %s: %llu packets appended, %llu outside rollups\n", options.storeDir.c_str(),
+            (unsigned long long)store->appended(), (unsigned long long)store->outsideRollups());
+  }
+  fprintf(stderr, "Stopped - %llu lines written, %llu dropped\n",
+          (unsigned long long)writer.lines.load(), (unsigned long long)writer.dropped.load());
+  return 0;
+}
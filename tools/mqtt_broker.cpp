@@ -0,0 +1,73 @@
+// ===== MQTT STAND-IN BROKER =====
+// Small MQTT 3.1.1 broker for testing TRANSPORT_MODE TRANSPORT_MQTT without
+// mosquitto: CONNECT with persistent sessions (subscriptions are kept for
+// clean-session-off clients), SUBSCRIBE with + and # wildcards, QoS 0/1
+// PUBLISH, retained messages, PINGREQ and DISCONNECT. Messages to
+// subscribers are sent once, without redelivery or an offline queue.
+//
+// With --aqi the broker also stands in for the Node-RED flow: every valid
+// packet on <prefix>/<device>/data is answered with a retained
+// AQIResponsePacket (PM2.5 AQI only) on <prefix>/<device>/aqi. The broker
+// itself is tools/mqtt_stand_in.h, which tools/mqtt_session_test runs
+// against MqttUplink.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -I. tools/mqtt_broker.cpp -o mqtt_broker && ./mqtt_broker --aqi
+// Options: --port N (default 1883), --prefix P (default aqm), --ack-delay MS
+// (hold PUBACKs back to see publishes pipelining), --drop-acks N (never
+// acknowledge every Nth QoS1 publish), --reorder-acks N (collect N PUBACKs
+// and send them newest first), --double-acks (send every PUBACK twice).
+
+#include "mqtt_stand_in.h"
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv, MqttStandInOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--aqi") {
+      options.aqi = true;
+      continue;
+    }
+    if (arg == "--double-acks") {
+      options.doubleAcks = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--port") {
+      options.port = (uint16_t)atoi(argv[++i]);
+    } else if (arg == "--prefix") {
+      options.prefix = argv[++i];
+    } else if (arg == "--ack-delay") {
+      options.ackDelayMs = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--drop-acks") {
+      options.dropAcks = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--reorder-acks") {
+      options.reorderAcks = (unsigned)atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0;
+}
+
+int main(int argc, char** argv) {
+  MqttStandInOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--port N] [--aqi] [--prefix P] [--ack-delay MS] [--drop-acks N] "
+            "[--reorder-acks N] [--double-acks]\n", argv[0]);
+    return 2;
+  }
+
+  MqttStandIn broker(options);
+  if (!broker.open()) {
+    perror("listen");
+    return 1;
+  }
+  printf("MQTT stand-in listening on tcp/%u%s\n", broker.port(),
+         options.aqi ? (" - answering " + options.prefix + "/+/data with retained AQI").c_str() : "");
+  fflush(stdout);
+  broker.serve();
+  return 0;
+}
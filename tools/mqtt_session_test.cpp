@@ -0,0 +1,354 @@
+// ===== MQTT SESSION TEST =====
+// Runs MqttUplink.h and MqttConnection.h unchanged against the mqtt_broker
+// stand-in (tools/mqtt_stand_in.h) in a thread, with a PacketStore on the
+// in-memory LittleFS of tools/host as backlog. MQTT_KEEPALIVE is cut to
+// 1 s and MQTT_RECONNECT_INTERVAL to 200 ms so the timers play out in
+// seconds. Cases, each against its own stand-in:
+//  - window: three windows of packets with the PUBACKs held back 100 ms -
+//    MQTT_MAX_INFLIGHT publishes in flight, every packet acked once, the
+//    pushed AQI is the one for the last packet
+//  - PUBACK matching: the broker sends the PUBACKs of a window newest first
+//    and each one twice - every publish matched once, no session lost
+//  - keep-alive: PINGREQs answered keep the idle session; unanswered, the
+//    session is given up and resumed on the next connect
+//  - retained AQI: after a reconnect the subscription brings the last AQI
+//    back without a new packet
+//  - loss mid-flight: a window plus one unacknowledged when the broker
+//    drops the connection - the unacked packets go to the backlog, which
+//    is drained on the next session; every packet reaches the broker, and
+//    none is both acked live and sent again in the backlog
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. -Itools/host tools/mqtt_session_test.cpp -o mqtt_session_test -lpthread && ./mqtt_session_test
+// Options: --verbose (DEBUG output of MqttUplink and the stand-in's log).
+
+#include <Arduino.h>
+#include "config.h"
+#undef MQTT_KEEPALIVE
+#define MQTT_KEEPALIVE 1
+#undef MQTT_RECONNECT_INTERVAL
+#define MQTT_RECONNECT_INTERVAL 200
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tools/mqtt_stand_in.h"   // Before MqttUplink.h: its constants share names with the macros there
+#include "MqttUplink.h"
+#include "SensorData.h"
+
+static const uint8_t DEVICE_ID[6] = {0xA4, 0xCF, 0x12, 0x34, 0x56, 0x78};
+static const unsigned ACK_DELAY_MS = 100;
+static const unsigned long WAIT_MS = 3000;  // Longest wait for anything the broker does
+
+typedef std::vector<uint32_t> Ids;
+
+static int failures = 0;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", name);
+    failures++;
+  }
+}
+
+// ===== PACKETS =====
+static SensorDataPacket makePacket(uint32_t sequence, uint16_t pm25) {
+  SensorData data;
+  data.temperature = 21.4f;
+  data.humidity = 48.0f;
+  data.pressure = 1013.2f;
+  data.bme68xAvailable = true;
+  data.pm1_0 = pm25 / 2;
+  data.pm2_5 = pm25;
+  data.pm10 = pm25 + 4;
+  data.pms5003Available = true;
+
+  SensorDataPacket packet = {};
+  packSensorData(data, packet);
+  packet.magic_version = PACKET_MAGIC_V3;
+  memcpy(packet.device_id, DEVICE_ID, sizeof(packet.device_id));
+  packet.boot_count = 7;
+  packet.sequence = sequence;
+  return packet;
+}
+
+static Ids sorted(Ids ids) {
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+static Ids range(uint32_t first, uint32_t count) {
+  Ids ids;
+  for (uint32_t id = first; id < first + count; id++) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+static bool unique(const Ids& ids) {
+  return std::set<uint32_t>(ids.begin(), ids.end()).size() == ids.size();
+}
+
+// ===== DEVICE =====
+// The network task's side: the uplink, its backlog and the AQI it was pushed
+struct Device {
+  PacketStore backlog;
+  MqttUplink uplink;
+  std::vector<std::vector<uint8_t>> aqi;  // Empty entry: session lost
+  Ids drained;                            // Sequence numbers sent from the backlog
+
+  explicit Device(const std::string& url)
+    : backlog(sizeof(SensorDataPacket)), uplink(url.c_str(), "", "") {
+    LittleFS.erase();
+    backlog.begin();
+    uplink.begin(DEVICE_ID, &backlog, aqiEntry, this);
+  }
+
+  static void aqiEntry(void* context, const uint8_t* payload, size_t length) {
+    static_cast<Device*>(context)->aqi.emplace_back(payload, payload + length);
+  }
+
+  // A live packet as handleLivePacket() sends it: kept in the backlog if not sent
+  bool send(uint32_t sequence, uint16_t pm25) {
+    SensorDataPacket packet = makePacket(sequence, pm25);
+    if (uplink.publish(packet, true)) {
+      return true;
+    }
+    backlog.push((const uint8_t*)&packet);
+    return false;
+  }
+
+  // Network task loop until done() or the timeout
+  bool pollUntil(const std::function<bool()>& done, unsigned long timeoutMs = WAIT_MS) {
+    unsigned long start = millis();
+    while (!done()) {
+      if (millis() - start > timeoutMs) {
+        return false;
+      }
+      uplink.poll(true);
+      delay(5);
+    }
+    return true;
+  }
+
+  // One drainBacklog() round: a batch frame, acknowledged on its PUBACK
+  bool drainBatch() {
+    if (!pollUntil([this] { return uplink.canPublishBacklog(); })) {
+      return false;
+    }
+    SensorDataPacket batch[BACKLOG_BATCH_SIZE];
+    uint8_t frame[BatchFrameEncoder::maxFrameSize(BACKLOG_BATCH_SIZE)];
+    size_t count = backlog.read((uint8_t*)batch, BACKLOG_BATCH_SIZE);
+    size_t length = BatchFrameEncoder::encode(batch, count, frame, sizeof(frame));
+    if (count == 0 || length == 0 || !uplink.publishBacklog("batch", "7", "60", frame, length, count)) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      drained.push_back(batch[i].sequence);
+    }
+    return pollUntil([this] { return uplink.canPublishBacklog(); });
+  }
+
+  bool aqiIs(size_t index, uint16_t pm25) const {
+    return index < aqi.size() && aqi[index] == aqiResponse(pm25Aqi(pm25));
+  }
+};
+
+// Stand-in with these options in a thread, one device talking to it
+static void withBroker(MqttStandInOptions options, const std::function<void(MqttStandIn&, Device&)>& run) {
+  options.port = 0;
+  options.quiet = Serial.quiet;
+  MqttStandIn broker(options);
+  if (!broker.open()) {
+    expect(false, "stand-in: TCP socket");
+    return;
+  }
+  std::thread serving([&broker] { broker.serve(); });
+  Device device("mqtt://127.0.0.1:" + std::to_string(broker.port()));
+  run(broker, device);
+  broker.stop();
+  serving.join();
+}
+
+// ===== CASES =====
+static void runWindow() {
+  MqttStandInOptions options;
+  options.aqi = true;
+  options.ackDelayMs = ACK_DELAY_MS;
+  withBroker(options, [](MqttStandIn& broker, Device& device) {
+    const uint32_t count = 3 * MQTT_MAX_INFLIGHT;
+    bool sent = true;
+    unsigned long start = millis();
+    for (uint32_t i = 0; i < count; i++) {
+      sent = device.send(i, (uint16_t)(10 + i)) && sent;
+      device.uplink.poll(true);
+    }
+    bool acked = device.pollUntil([&device] { return device.uplink.getPending() == 0; });
+    unsigned long elapsed = millis() - start;
+
+    const MqttConnectionStats& stats = device.uplink.getStats();
+    MqttStandInStats seen = broker.stats();
+    expect(sent && acked, "window: every packet published and acked");
+    expect(stats.maxInFlight == MQTT_MAX_INFLIGHT, "window: MQTT_MAX_INFLIGHT publishes in flight");
+    expect(elapsed < count * ACK_DELAY_MS / 2, "window: PUBACK waits overlap");
+    expect(seen.live == range(0, count), "window: broker got every packet once, in order");
+    expect(sorted(seen.acked) == range(0, count) && stats.acks == count, "window: every packet acked once");
+    expect(device.backlog.pending() == 0 && stats.failures == 0, "window: nothing kept, no session lost");
+    expect(device.pollUntil([&device] { return device.aqiIs(device.aqi.size() - 1, 10 + count - 1); }),
+           "window: pushed AQI is the last packet's");
+  });
+}
+
+static void runAckMatching() {
+  MqttStandInOptions options;
+  options.reorderAcks = MQTT_MAX_INFLIGHT;
+  options.doubleAcks = true;
+  withBroker(options, [](MqttStandIn& broker, Device& device) {
+    const uint32_t count = 2 * MQTT_MAX_INFLIGHT;
+    bool sent = true;
+    for (uint32_t i = 0; i < count; i++) {
+      sent = device.send(i, 12) && sent;
+      device.uplink.poll(true);
+    }
+    bool acked = device.pollUntil([&device] { return device.uplink.getPending() == 0; });
+
+    const MqttConnectionStats& stats = device.uplink.getStats();
+    MqttStandInStats seen = broker.stats();
+    expect(sent && acked, "PUBACK matching: every packet acked");
+    expect(seen.acks == count && stats.acks == count, "PUBACK matching: doubled PUBACKs counted once");
+    expect(sorted(seen.acked) == range(0, count), "PUBACK matching: newest-first PUBACKs matched");
+    expect(stats.connects == 1 && stats.failures == 0 && device.backlog.pending() == 0,
+           "PUBACK matching: session kept, nothing in the backlog");
+  });
+}
+
+static void runKeepAlive() {
+  withBroker(MqttStandInOptions(), [](MqttStandIn& broker, Device& device) {
+    const unsigned long keepAliveMs = MQTT_KEEPALIVE * 1000UL;
+    device.send(0, 12);
+    device.pollUntil([] { return false; }, 3 * keepAliveMs);
+
+    const MqttConnectionStats& stats = device.uplink.getStats();
+    expect(broker.stats().pings >= 4, "keep-alive: pinged every half interval while idle");
+    expect(device.uplink.connected() && stats.connects == 1 && stats.failures == 0,
+           "keep-alive: answered pings keep the session");
+    expect(device.aqi.empty(), "keep-alive: no loss reported");
+
+    broker.answerPings(false);
+    unsigned long start = millis();
+    // poll() reconnects right after the loss - the failure count tells
+    bool lost = device.pollUntil([&stats] { return stats.failures > 0; }, 3 * keepAliveMs);
+    unsigned long elapsed = millis() - start;
+    expect(lost && elapsed + 100 >= keepAliveMs && elapsed <= keepAliveMs * 3 / 2 + 100,
+           "keep-alive: no PINGRESP for one interval - session given up");
+    expect(device.aqi.size() == 1 && device.aqi[0].empty(), "keep-alive: loss reported to the AQI display");
+
+    broker.answerPings(true);
+    expect(device.pollUntil([&device] { return device.uplink.connected(); }), "keep-alive: reconnected");
+    expect(stats.connects == 2 && stats.sessionsResumed == 1 && stats.failures == 1,
+           "keep-alive: persistent session resumed");
+  });
+}
+
+static void runRetainedAqi() {
+  MqttStandInOptions options;
+  options.aqi = true;
+  withBroker(options, [](MqttStandIn& broker, Device& device) {
+    device.send(0, 55);
+    expect(device.pollUntil([&device] { return device.aqi.size() == 1; }) && device.aqiIs(0, 55),
+           "retained AQI: pushed for the packet");
+
+    broker.disconnectAll();
+    expect(device.pollUntil([&device] { return device.aqi.size() == 3; }),
+           "retained AQI: loss reported, AQI back after the reconnect");
+    expect(device.aqi.size() == 3 && device.aqi[1].empty() && device.aqiIs(2, 55),
+           "retained AQI: the last AQI comes back");
+    expect(broker.stats().live.size() == 1 && device.uplink.getStats().connects == 2,
+           "retained AQI: without a new packet");
+  });
+}
+
+static void runLossMidFlight() {
+  withBroker(MqttStandInOptions(), [](MqttStandIn& broker, Device& device) {
+    // One window acked, then a full window and one more without PUBACK
+    const uint32_t window = MQTT_MAX_INFLIGHT;
+    for (uint32_t i = 0; i < window; i++) {
+      device.send(i, 20);
+    }
+    bool acked = device.pollUntil([&device] { return device.uplink.getPending() == 0; });
+    broker.holdAcks(true);
+    for (uint32_t i = window; i < 2 * window; i++) {
+      device.send(i, 20);
+    }
+    expect(acked && device.uplink.getPending() == window, "loss: window full, PUBACKs held");
+
+    std::thread dropper([&broker] {
+      delay(200);
+      broker.disconnectAll();
+    });
+    bool sent = device.send(2 * window, 20);  // Waits for a free slot until the drop
+    dropper.join();
+
+    MqttStandInStats atLoss = broker.stats();
+    const MqttConnectionStats& stats = device.uplink.getStats();
+    expect(!sent && !device.uplink.connected() && stats.failures == 1, "loss: session lost while waiting");
+    expect(device.uplink.getPending() == 0 && device.backlog.pending() == window + 1,
+           "loss: unacked packets and the waiting one in the backlog");
+    expect(stats.acks == atLoss.acks && sorted(atLoss.acked) == range(0, window),
+           "loss: device and broker agree on the acks");
+    expect(!device.aqi.empty() && device.aqi.back().empty(), "loss: reported to the AQI display");
+
+    // Next session: live packets again, the backlog drained in between
+    broker.holdAcks(false);
+    bool reconnected = device.pollUntil([&device] { return device.uplink.connected(); });
+    uint32_t next = 2 * window + 1;
+    for (; next < 2 * window + 1 + window / 2; next++) {
+      device.send(next, 20);
+    }
+    bool drained = true;
+    while (drained && device.backlog.pending() > 0) {
+      drained = device.drainBatch();
+    }
+    acked = device.pollUntil([&device] { return device.uplink.getPending() == 0; });
+
+    MqttStandInStats seen = broker.stats();
+    Ids live = seen.acked;
+    Ids all = live;
+    all.insert(all.end(), seen.backlog.begin(), seen.backlog.end());
+    expect(reconnected && drained && acked && device.backlog.pending() == 0, "loss: backlog drained after reconnect");
+    expect(sorted(seen.backlog) == sorted(device.drained) && sorted(device.drained) == range(window, window + 1),
+           "loss: backlog holds exactly the unacked packets");
+    expect(sorted(all) == range(0, next), "loss: every packet acked once - none lost, none acked twice");
+    expect(unique(seen.live), "loss: no live packet sent twice");
+  });
+}
+
+int main(int argc, char** argv) {
+  Serial.quiet = true;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--verbose") {
+      Serial.quiet = false;
+    } else {
+      fprintf(stderr, "Usage: %s [--verbose]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  runWindow();
+  runAckMatching();
+  runKeepAlive();
+  runRetainedAqi();
+  runLossMidFlight();
+
+  if (failures > 0) {
+    printf("FAIL: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("OK: pipelined window, PUBACK matching, keep-alive, retained AQI, loss mid-flight to backlog\n");
+  return 0;
+}
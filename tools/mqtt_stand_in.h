@@ -0,0 +1,640 @@
+#ifndef MQTT_STAND_IN_H
+#define MQTT_STAND_IN_H
+
+// ===== MQTT STAND-IN =====
+// The broker of mqtt_broker, shared with mqtt_session_test. MQTT 3.1.1:
+// CONNECT with persistent sessions (subscriptions are kept for
+// clean-session-off clients), SUBSCRIBE with + and # wildcards, QoS 0/1
+// PUBLISH, retained messages, PINGREQ and DISCONNECT. Messages to
+// subscribers are sent once, without redelivery or an offline queue.
+//
+// With the aqi option the broker also stands in for the Node-RED flow:
+// every valid packet on <prefix>/<device>/data is answered with a retained
+// AQIResponsePacket (PM2.5 AQI only) on <prefix>/<device>/aqi. The
+// sequence numbers of the live packets, of those whose PUBACK went out and
+// of the backlog batches (<prefix>/<device>/backlog/<format>/...) are
+// recorded for the test.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "stand_in.h"
+
+// ===== PROTOCOL CONSTANTS =====
+// Same values as MqttConnection.h (Arduino header)
+static const uint8_t MQTT_CONNECT = 0x10;
+static const uint8_t MQTT_CONNACK = 0x20;
+static const uint8_t MQTT_PUBLISH = 0x30;
+static const uint8_t MQTT_PUBACK = 0x40;
+static const uint8_t MQTT_SUBSCRIBE = 0x80;
+static const uint8_t MQTT_SUBACK = 0x90;
+static const uint8_t MQTT_PINGREQ = 0xC0;
+static const uint8_t MQTT_PINGRESP = 0xD0;
+static const uint8_t MQTT_DISCONNECT = 0xE0;
+
+struct MqttStandInOptions {
+  uint16_t port = 1883;     // 0 = any free port
+  std::string prefix = "aqm";
+  bool aqi = false;
+  unsigned ackDelayMs = 0;  // Hold PUBACKs back to see publishes pipelining
+  unsigned dropAcks = 0;    // Never acknowledge every Nth QoS1 publish
+  unsigned reorderAcks = 0; // Collect N PUBACKs, send them newest first
+  bool doubleAcks = false;  // Every PUBACK twice
+  bool quiet = false;       // No line per packet
+};
+
+struct MqttStandInStats {
+  unsigned connects = 0;
+  unsigned pings = 0;                     // PINGREQs answered
+  unsigned acks = 0;                      // PUBACKs sent (doubled ones once)
+  std::vector<uint32_t> live;             // Sequence numbers on <prefix>/+/data, in arrival order
+  std::vector<uint32_t> acked;            // ... whose PUBACK went out
+  std::vector<uint32_t> backlog;          // Sequence numbers in backlog batches
+};
+
+// ===== BROKER =====
+// serve() runs until stop(); the other public calls may come from any thread
+class MqttStandIn {
+public:
+  explicit MqttStandIn(const MqttStandInOptions& standInOptions) : options(standInOptions) {}
+  ~MqttStandIn() {
+    for (auto& entry : clients) {
+      close(entry.first);
+    }
+    if (listener >= 0) {
+      close(listener);
+    }
+  }
+
+  bool open() {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(options.port);
+    socklen_t length = sizeof(local);
+    if (listener < 0 || bind(listener, (sockaddr*)&local, sizeof(local)) != 0 || listen(listener, 8) != 0 ||
+        getsockname(listener, (sockaddr*)&local, &length) != 0) {
+      return false;
+    }
+    boundPort = ntohs(local.sin_port);
+    return true;
+  }
+
+  uint16_t port() const { return boundPort; }
+  void stop() { running = false; }
+
+  MqttStandInStats stats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+  }
+
+  // PUBACKs of later publishes are withheld (and dropped with the connection)
+  void holdAcks(bool hold) {
+    std::lock_guard<std::mutex> guard(lock);
+    acksHeld = hold;
+  }
+
+  // PINGREQs go unanswered
+  void answerPings(bool answer) {
+    std::lock_guard<std::mutex> guard(lock);
+    pingsAnswered = answer;
+  }
+
+  // Closes every client connection, as a broker restart or a NAT timeout would
+  void disconnectAll() {
+    std::lock_guard<std::mutex> guard(lock);
+    while (!clients.empty()) {
+      closeClient(clients.begin()->first);
+    }
+  }
+
+  void serve() {
+    while (running) {
+      std::vector<pollfd> fds = {{listener, POLLIN, 0}};
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        for (const auto& entry : clients) {
+          fds.push_back({entry.first, POLLIN, 0});
+        }
+      }
+      poll(fds.data(), fds.size(), 10);
+
+      std::lock_guard<std::mutex> guard(lock);
+      if (fds[0].revents & POLLIN) {
+        accept();
+      }
+      for (size_t i = 1; i < fds.size(); i++) {
+        if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0 && clients.count(fds[i].fd) > 0) {
+          receive(clients[fds[i].fd]);
+        }
+      }
+      sendDueAcks();
+      expireKeepAlive();
+    }
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Client {
+    int fd;
+    std::string peer;
+    std::string id;                 // Empty until CONNECT
+    uint16_t keepAlive = 0;
+    Clock::time_point lastSeen;
+    std::vector<uint8_t> rx;
+    uint16_t nextPacketId = 1;
+  };
+
+  struct Subscription {
+    std::string filter;
+    uint8_t qos;
+  };
+
+  struct DelayedAck {
+    int fd;
+    uint16_t packetId;
+    Clock::time_point due;
+    int64_t sequence;               // Live packet, -1 for anything else
+  };
+
+  MqttStandInOptions options;
+  int listener = -1;
+  uint16_t boundPort = 0;
+  std::atomic<bool> running{true};
+  std::mutex lock;                  // Everything below
+  std::map<int, Client> clients;
+  std::map<std::string, std::vector<Subscription>> sessions;  // client id -> subscriptions
+  std::map<std::string, std::vector<uint8_t>> retained;       // topic -> payload
+  std::vector<DelayedAck> delayedAcks;
+  std::vector<DelayedAck> reordered;                          // Due, collected for reorderAcks
+  unsigned qos1Publishes = 0;
+  bool acksHeld = false;
+  bool pingsAnswered = true;
+  MqttStandInStats counters;
+
+  void log(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    if (options.quiet) {
+      return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    fflush(stdout);
+  }
+
+  // ===== ENCODING =====
+  static void appendLength(std::vector<uint8_t>& out, size_t length) {
+    do {
+      uint8_t digit = length % 128;
+      length /= 128;
+      out.push_back(digit | (length > 0 ? 0x80 : 0));
+    } while (length > 0);
+  }
+
+  static void appendString(std::vector<uint8_t>& out, const std::string& text) {
+    out.push_back((uint8_t)(text.size() >> 8));
+    out.push_back((uint8_t)text.size());
+    out.insert(out.end(), text.begin(), text.end());
+  }
+
+  static void sendBytes(int fd, const std::vector<uint8_t>& bytes) {
+    send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+  }
+
+  static void sendPublish(Client& client, const std::string& topic, const std::vector<uint8_t>& payload,
+                          uint8_t qos, bool retain) {
+    std::vector<uint8_t> body;
+    appendString(body, topic);
+    if (qos > 0) {
+      uint16_t packetId = client.nextPacketId++;
+      if (client.nextPacketId == 0) {
+        client.nextPacketId = 1;
+      }
+      body.push_back((uint8_t)(packetId >> 8));
+      body.push_back((uint8_t)packetId);
+    }
+    body.insert(body.end(), payload.begin(), payload.end());
+
+    std::vector<uint8_t> packet = {(uint8_t)(MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0))};
+    appendLength(packet, body.size());
+    packet.insert(packet.end(), body.begin(), body.end());
+    sendBytes(client.fd, packet);
+  }
+
+  // ===== ROUTING =====
+  static bool topicMatches(const std::string& filter, const std::string& topic) {
+    size_t f = 0;
+    size_t t = 0;
+    while (f < filter.size()) {
+      size_t filterEnd = filter.find('/', f);
+      std::string level = filter.substr(f, filterEnd == std::string::npos ? std::string::npos : filterEnd - f);
+      if (level == "#") {
+        return true;
+      }
+      if (t > topic.size()) {
+        return false;
+      }
+      size_t topicEnd = topic.find('/', t);
+      std::string topicLevel = topic.substr(t, topicEnd == std::string::npos ? std::string::npos : topicEnd - t);
+      if (level != "+" && level != topicLevel) {
+        return false;
+      }
+      f = filterEnd == std::string::npos ? filter.size() + 1 : filterEnd + 1;
+      t = topicEnd == std::string::npos ? topic.size() + 1 : topicEnd + 1;
+    }
+    return t > topic.size();
+  }
+
+  void route(const std::string& topic, const std::vector<uint8_t>& payload, uint8_t qos, bool retain) {
+    if (retain) {
+      if (payload.empty()) {
+        retained.erase(topic);
+      } else {
+        retained[topic] = payload;
+      }
+    }
+
+    for (auto& entry : clients) {
+      Client& client = entry.second;
+      if (client.id.empty()) {
+        continue;
+      }
+      // Highest matching subscription QoS, one delivery per client
+      int granted = -1;
+      for (const Subscription& subscription : sessions[client.id]) {
+        if (topicMatches(subscription.filter, topic) && subscription.qos > granted) {
+          granted = subscription.qos;
+        }
+      }
+      if (granted >= 0) {
+        sendPublish(client, topic, payload, (uint8_t)std::min<int>(qos, granted), false);
+      }
+    }
+  }
+
+  // Sequence number of a valid packet on <prefix>/+/data, -1 otherwise
+  int64_t livePacket(const std::string& topic, const std::vector<uint8_t>& payload, WirePacket& packet) {
+    if (!topicMatches(options.prefix + "/+/data", topic)) {
+      return -1;
+    }
+    if (!inspectPacket(payload.data(), payload.size(), packet)) {
+      log("  invalid packet on %s (%zu bytes)\n", topic.c_str(), payload.size());
+      return -1;
+    }
+    counters.live.push_back(packet.sequence);
+    return packet.sequence;
+  }
+
+  void recordBacklog(const std::string& topic, const std::vector<uint8_t>& payload) {
+    std::string prefix = options.prefix + "/+/backlog/";
+    if (!topicMatches(prefix + "#", topic)) {
+      return;
+    }
+    std::vector<SensorDataPacket> packets(256);
+    size_t count = 0;
+    if (topicMatches(prefix + "batch/#", topic)) {
+      count = BatchFrameDecoder::decode(payload.data(), payload.size(), packets.data(), packets.size());
+    } else {
+      size_t offset = 0;
+      size_t length;
+      while (offset < payload.size() && count < packets.size() &&
+             (length = PacketDecoder::decode(payload.data() + offset, payload.size() - offset, packets[count])) > 0) {
+        offset += length;
+        count++;
+      }
+    }
+    for (size_t i = 0; i < count; i++) {
+      counters.backlog.push_back(packets[i].sequence);
+    }
+    log("  backlog: %zu packets\n", count);
+  }
+
+  void answerAqi(const std::string& topic, const WirePacket& packet) {
+    // <prefix>/<device>/data -> retained AQI on <prefix>/<device>/aqi
+    float aqi = pm25Aqi(packet.pm25);
+    std::vector<uint8_t> body = aqiResponse(aqi);
+    std::string aqiTopic = topic.substr(0, topic.size() - 4) + "aqi";
+    log("  boot %u seq %u, sections 0x%02X, PM2.5 %.0f -> AQI %.1f (level %u) retained on %s\n",
+        packet.bootCount, packet.sequence, packet.sections, packet.pm25, aqi, body[3], aqiTopic.c_str());
+    route(aqiTopic, body, 1, true);
+  }
+
+  // ===== PACKET HANDLING =====
+  static bool readString(const std::vector<uint8_t>& body, size_t& offset, std::string& text) {
+    if (offset + 2 > body.size()) {
+      return false;
+    }
+    size_t length = (body[offset] << 8) | body[offset + 1];
+    if (offset + 2 + length > body.size()) {
+      return false;
+    }
+    text.assign((const char*)body.data() + offset + 2, length);
+    offset += 2 + length;
+    return true;
+  }
+
+  bool handleConnect(Client& client, const std::vector<uint8_t>& body) {
+    size_t offset = 0;
+    std::string protocol;
+    std::string id;
+    if (!readString(body, offset, protocol) || protocol != "MQTT" || offset + 4 > body.size()) {
+      return false;
+    }
+    uint8_t level = body[offset];
+    uint8_t flags = body[offset + 1];
+    client.keepAlive = (uint16_t)((body[offset + 2] << 8) | body[offset + 3]);
+    offset += 4;
+    if (level != 4 || !readString(body, offset, id)) {
+      sendBytes(client.fd, {MQTT_CONNACK, 2, 0, 1});  // Unacceptable protocol version
+      return false;
+    }
+
+    bool cleanSession = (flags & 0x02) != 0;
+    if (id.empty() && !cleanSession) {
+      sendBytes(client.fd, {MQTT_CONNACK, 2, 0, 2});  // Identifier rejected
+      return false;
+    }
+
+    // Session takeover: an older connection with the same id is closed
+    for (auto& entry : clients) {
+      if (entry.first != client.fd && entry.second.id == id) {
+        log("%s: takes over session %s - closing %s\n", client.peer.c_str(), id.c_str(),
+            entry.second.peer.c_str());
+        shutdown(entry.first, SHUT_RDWR);
+      }
+    }
+
+    bool sessionPresent = !cleanSession && sessions.count(id) > 0;
+    if (cleanSession) {
+      sessions.erase(id);
+    }
+    sessions[id];
+    client.id = id;
+    counters.connects++;
+
+    log("%s: CONNECT %s, keep-alive %u s, %s session%s\n", client.peer.c_str(), id.c_str(), client.keepAlive,
+        cleanSession ? "clean" : "persistent", sessionPresent ? " (present)" : "");
+    sendBytes(client.fd, {MQTT_CONNACK, 2, (uint8_t)(sessionPresent ? 1 : 0), 0});
+    return true;
+  }
+
+  bool handleSubscribe(Client& client, const std::vector<uint8_t>& body) {
+    if (body.size() < 2) {
+      return false;
+    }
+    std::vector<uint8_t> ack = {body[0], body[1]};
+    std::vector<Subscription>& subscriptions = sessions[client.id];
+    std::vector<std::string> filters;
+
+    size_t offset = 2;
+    while (offset < body.size()) {
+      std::string filter;
+      if (!readString(body, offset, filter) || offset >= body.size()) {
+        return false;
+      }
+      uint8_t qos = std::min<uint8_t>(body[offset++], 1);  // QoS 2 is granted as 1
+      for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+        it = it->filter == filter ? subscriptions.erase(it) : it + 1;
+      }
+      subscriptions.push_back({filter, qos});
+      filters.push_back(filter);
+      ack.push_back(qos);
+      log("%s: SUBSCRIBE %s (QoS %u)\n", client.peer.c_str(), filter.c_str(), qos);
+    }
+
+    std::vector<uint8_t> packet = {MQTT_SUBACK};
+    appendLength(packet, ack.size());
+    packet.insert(packet.end(), ack.begin(), ack.end());
+    sendBytes(client.fd, packet);
+
+    // Retained messages for the new subscriptions
+    for (const std::string& filter : filters) {
+      for (const auto& entry : retained) {
+        if (topicMatches(filter, entry.first)) {
+          sendPublish(client, entry.first, entry.second, 1, true);
+        }
+      }
+    }
+    return true;
+  }
+
+  bool handlePublish(Client& client, uint8_t header, const std::vector<uint8_t>& body) {
+    uint8_t qos = (header >> 1) & 0x03;
+    bool retain = (header & 0x01) != 0;
+    size_t offset = 0;
+    std::string topic;
+    if (qos > 1 || !readString(body, offset, topic) || (qos == 1 && offset + 2 > body.size())) {
+      return false;  // QoS 2 not supported
+    }
+
+    uint16_t packetId = 0;
+    if (qos == 1) {
+      packetId = (uint16_t)((body[offset] << 8) | body[offset + 1]);
+      offset += 2;
+    }
+    std::vector<uint8_t> payload(body.begin() + offset, body.end());
+
+    log("%s: PUBLISH %s, %zu bytes, QoS %u%s%s\n", client.peer.c_str(), topic.c_str(), payload.size(), qos,
+        retain ? ", retained" : "", packetId ? (" id " + std::to_string(packetId)).c_str() : "");
+
+    WirePacket packet;
+    int64_t sequence = livePacket(topic, payload, packet);
+    recordBacklog(topic, payload);
+
+    if (qos == 1) {
+      qos1Publishes++;
+      if (options.dropAcks > 0 && qos1Publishes % options.dropAcks == 0) {
+        log("  PUBACK %u withheld (--drop-acks %u)\n", packetId, options.dropAcks);
+      } else if (acksHeld) {
+        log("  PUBACK %u held\n", packetId);
+      } else {
+        delayedAcks.push_back({client.fd, packetId, Clock::now() + std::chrono::milliseconds(options.ackDelayMs),
+                               sequence});
+      }
+    }
+
+    route(topic, payload, qos, retain);
+    if (options.aqi && sequence >= 0) {
+      answerAqi(topic, packet);
+    }
+    return true;
+  }
+
+  // Returns false when the client has to be disconnected
+  bool handlePacket(Client& client, uint8_t header, const std::vector<uint8_t>& body) {
+    uint8_t type = header & 0xF0;
+    if (client.id.empty() && type != MQTT_CONNECT) {
+      return false;  // CONNECT must come first
+    }
+
+    switch (type) {
+      case MQTT_CONNECT:
+        return client.id.empty() && handleConnect(client, body);
+      case MQTT_PUBLISH:
+        return handlePublish(client, header, body);
+      case MQTT_PUBACK:
+        return true;  // No redelivery - nothing to release
+      case MQTT_SUBSCRIBE:
+        return handleSubscribe(client, body);
+      case MQTT_PINGREQ:
+        if (pingsAnswered) {
+          sendBytes(client.fd, {MQTT_PINGRESP, 0});
+          counters.pings++;
+        }
+        return true;
+      case MQTT_DISCONNECT:
+        log("%s: DISCONNECT\n", client.peer.c_str());
+        return false;
+      default:
+        log("%s: unsupported packet type 0x%02X\n", client.peer.c_str(), type);
+        return false;
+    }
+  }
+
+  // Parses all complete packets in the receive buffer
+  bool processInput(Client& client) {
+    for (;;) {
+      std::vector<uint8_t>& rx = client.rx;
+      size_t length = 0;
+      size_t multiplier = 1;
+      size_t offset = 1;
+      bool complete = false;
+      while (offset < rx.size() && offset <= 4) {
+        uint8_t byte = rx[offset++];
+        length += (byte & 0x7F) * multiplier;
+        multiplier *= 128;
+        if ((byte & 0x80) == 0) {
+          complete = true;
+          break;
+        }
+      }
+      if (!complete) {
+        return rx.size() <= 5;  // Length field longer than 4 bytes is malformed
+      }
+      if (rx.size() < offset + length) {
+        return true;  // Wait for the rest
+      }
+
+      uint8_t header = rx[0];
+      std::vector<uint8_t> body(rx.begin() + offset, rx.begin() + offset + length);
+      rx.erase(rx.begin(), rx.begin() + offset + length);
+      if (!handlePacket(client, header, body)) {
+        return false;
+      }
+    }
+  }
+
+  // ===== CONNECTIONS =====
+  void accept() {
+    sockaddr_in peer = {};
+    socklen_t peerLength = sizeof(peer);
+    int fd = ::accept(listener, (sockaddr*)&peer, &peerLength);
+    if (fd >= 0) {
+      int noDelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+      Client& client = clients[fd];
+      client.fd = fd;
+      client.peer = std::string(inet_ntoa(peer.sin_addr)) + ":" + std::to_string(ntohs(peer.sin_port));
+      client.lastSeen = Clock::now();
+    }
+  }
+
+  void receive(Client& client) {
+    uint8_t buffer[4096];
+    ssize_t count = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (count <= 0) {
+      closeClient(client.fd);
+      return;
+    }
+    client.lastSeen = Clock::now();
+    client.rx.insert(client.rx.end(), buffer, buffer + count);
+    if (!processInput(client)) {
+      closeClient(client.fd);
+    }
+  }
+
+  void closeClient(int fd) {
+    log("%s: closed\n", clients[fd].peer.c_str());
+    close(fd);
+    clients.erase(fd);
+    for (auto it = delayedAcks.begin(); it != delayedAcks.end();) {
+      it = it->fd == fd ? delayedAcks.erase(it) : it + 1;
+    }
+    for (auto it = reordered.begin(); it != reordered.end();) {
+      it = it->fd == fd ? reordered.erase(it) : it + 1;
+    }
+  }
+
+  void sendAck(const DelayedAck& ack) {
+    std::vector<uint8_t> packet = {MQTT_PUBACK, 2, (uint8_t)(ack.packetId >> 8), (uint8_t)ack.packetId};
+    sendBytes(ack.fd, packet);
+    if (options.doubleAcks) {
+      sendBytes(ack.fd, packet);
+    }
+    counters.acks++;
+    if (ack.sequence >= 0) {
+      counters.acked.push_back((uint32_t)ack.sequence);
+    }
+  }
+
+  // Due PUBACKs in the order the publishes arrived; with reorderAcks newest first
+  void sendDueAcks() {
+    Clock::time_point now = Clock::now();
+    std::vector<DelayedAck> due;
+    for (auto it = delayedAcks.begin(); it != delayedAcks.end();) {
+      if (it->due > now) {
+        ++it;
+        continue;
+      }
+      due.push_back(*it);
+      it = delayedAcks.erase(it);
+    }
+    if (options.reorderAcks > 0) {
+      reordered.insert(reordered.end(), due.begin(), due.end());
+      if (reordered.size() < options.reorderAcks) {
+        return;
+      }
+      due.assign(reordered.rbegin(), reordered.rend());
+      reordered.clear();
+    }
+    for (const DelayedAck& ack : due) {
+      sendAck(ack);
+    }
+  }
+
+  // Keep-alive: 1.5 x the client's interval without any packet
+  void expireKeepAlive() {
+    Clock::time_point now = Clock::now();
+    std::vector<int> expired;
+    for (const auto& entry : clients) {
+      const Client& client = entry.second;
+      if (client.keepAlive > 0 && now - client.lastSeen > std::chrono::milliseconds(client.keepAlive * 1500)) {
+        expired.push_back(entry.first);
+      }
+    }
+    for (int fd : expired) {
+      log("%s: keep-alive expired\n", clients[fd].peer.c_str());
+      closeClient(fd);
+    }
+  }
+};
+
+#endif
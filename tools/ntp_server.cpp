@@ -0,0 +1,388 @@
+// ===== NTP STAND-IN SERVER =====
+// Minimal SNTP server (RFC 4330, server mode) for testing the firmware's
+// wall clock against a clock you control: the served time is the host
+// clock plus --offset, running --drift ppm fast (the device then measures
+// that drift), with +-jitter noise per reply; --drop N ignores every Nth
+// request to exercise the client's retries. The lwIP SNTP client always
+// asks port 123 - point TIME_NTP_SERVER at this host and run it as root
+// (or with CAP_NET_BIND_SERVICE).
+//
+// --query HOST asks an NTP server once and prints offset and round trip
+// (checks this stand-in on another port, or a real server).
+//
+// --selftest DAYS runs the firmware's ClockMapping on the host instead:
+// a simulated device syncs every --interval against this server's clock
+// model (same drift, offset and jitter, replies built and parsed like on
+// the wire) through a sync outage, a backward step and a small slewed
+// step. Checks that mapped time never runs backwards except at the step,
+// the drift estimate, the error against the server clock, and the quality
+// flag; prints the error of a clock without drift correction next to it.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/ntp_server.cpp -o ntp_server && sudo ./ntp_server --drift 40
+// Options: --port N (default 123), --offset MS (0), --drift PPM (0),
+// --jitter MS (0), --drop N (0 = answer all), --query HOST (client mode),
+// --selftest DAYS (no server), --interval S (sync interval of the self
+// test, default TIME_SYNC_INTERVAL).
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include "config.h"
+#include "ClockMapping.h"
+
+static const size_t NTP_PACKET_SIZE = 48;
+static const int64_t NTP_UNIX_OFFSET_S = 2208988800ll;   // 1900-01-01 to 1970-01-01
+
+struct Options {
+  uint16_t port = 123;
+  double offsetMs = 0;
+  double driftPpm = 0;
+  double jitterMs = 0;
+  unsigned drop = 0;
+  std::string query;
+  double selftestDays = 0;
+  double intervalS = TIME_SYNC_INTERVAL / 1000.0;
+};
+
+static Options options;
+static std::mt19937 rng(17);
+
+// ===== NTP PACKETS =====
+// 64-bit NTP timestamp: seconds since 1900 and a 32-bit fraction, big-endian
+static void writeTimestamp(uint8_t* out, int64_t unixUs) {
+  uint64_t seconds = (uint64_t)(unixUs / 1000000 + NTP_UNIX_OFFSET_S);
+  uint64_t fraction = ((uint64_t)(unixUs % 1000000) << 32) / 1000000;
+  uint64_t value = seconds << 32 | fraction;
+  for (int i = 0; i < 8; i++) {
+    out[i] = (uint8_t)(value >> (56 - 8 * i));
+  }
+}
+
+static int64_t readTimestamp(const uint8_t* in) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = value << 8 | in[i];
+  }
+  int64_t seconds = (int64_t)(value >> 32) - NTP_UNIX_OFFSET_S;
+  int64_t fraction = (int64_t)(((value & 0xFFFFFFFFull) * 1000000 + (1ull << 31)) >> 32);
+  return seconds * 1000000 + fraction;
+}
+
+static void buildRequest(uint8_t* request, int64_t clientUs) {
+  memset(request, 0, NTP_PACKET_SIZE);
+  request[0] = 4 << 3 | 3;   // LI 0, version 4, mode 3 (client)
+  writeTimestamp(request + 40, clientUs);
+}
+
+// Server reply to a client request, 0 if it is none
+static size_t buildReply(const uint8_t* request, size_t length, int64_t receiveUs, int64_t transmitUs,
+                         uint8_t* reply) {
+  if (length < NTP_PACKET_SIZE || (request[0] & 7) != 3) {
+    return 0;
+  }
+  memset(reply, 0, NTP_PACKET_SIZE);
+  reply[0] = (request[0] & 0x38) | 4;   // Client's version, mode 4 (server)
+  reply[1] = 1;                         // Stratum 1: primary reference
+  reply[2] = request[2];                // Poll
+  reply[3] = (uint8_t)-20;              // Precision ~1 us
+  reply[11] = 0x10;                     // Root dispersion 1/16 s
+  memcpy(reply + 12, "LOCL", 4);
+  writeTimestamp(reply + 16, transmitUs);     // Reference
+  memcpy(reply + 24, request + 40, 8);        // Origin = client's transmit
+  writeTimestamp(reply + 32, receiveUs);
+  writeTimestamp(reply + 40, transmitUs);
+  return NTP_PACKET_SIZE;
+}
+
+// Checks a reply like lwIP's SNTP client (mode, stratum, origin) and
+// returns the server's receive and transmit times
+static bool parseReply(const uint8_t* reply, size_t length, const uint8_t* request, int64_t& receiveUs,
+                       int64_t& transmitUs) {
+  if (length < NTP_PACKET_SIZE || (reply[0] & 7) != 4 || reply[1] == 0 || memcmp(reply + 24, request + 40, 8) != 0) {
+    return false;
+  }
+  receiveUs = readTimestamp(reply + 32);
+  transmitUs = readTimestamp(reply + 40);
+  return true;
+}
+
+// ===== SERVED CLOCK =====
+// Time this server hands out for the reference time hostUs
+static int64_t servedTime(int64_t hostUs, int64_t startUs, bool withJitter = true) {
+  double drift = (double)(hostUs - startUs) * options.driftPpm * 1e-6;
+  double jitter = withJitter && options.jitterMs > 0
+                    ? std::uniform_real_distribution<double>(-options.jitterMs, options.jitterMs)(rng) * 1000 : 0;
+  return hostUs + (int64_t)(options.offsetMs * 1000 + drift + jitter);
+}
+
+static int64_t hostTimeUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string formatUtc(int64_t unixUs) {
+  time_t seconds = (time_t)(unixUs / 1000000);
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  char text[80];
+  snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", utc.tm_year + 1900, utc.tm_mon + 1,
+           utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, (int)(unixUs % 1000000 / 1000));
+  return text;
+}
+
+// ===== SELF TEST =====
+// One simulated sync: request and reply go through the packet code, the
+// client takes the server's transmit time at the (symmetric) receive
+static bool simulateSync(int64_t serverUs, int64_t clientUs, int64_t& utcUs) {
+  uint8_t request[NTP_PACKET_SIZE];
+  uint8_t reply[NTP_PACKET_SIZE];
+  int64_t receiveUs;
+  buildRequest(request, clientUs);
+  size_t length = buildReply(request, sizeof(request), serverUs, serverUs, reply);
+  return parseReply(reply, length, request, receiveUs, utcUs);
+}
+
+static int selftest() {
+  const int64_t HOUR_US = 3600ll * 1000000;
+  const int64_t bootUs = 1767225600ll * 1000000;    // 2026-01-01, device boot
+  const int64_t serverStartUs = bootUs - 24 * HOUR_US;
+  const int64_t endUs = (int64_t)(options.selftestDays * 24 * HOUR_US);
+  const int64_t intervalUs = (int64_t)(options.intervalS * 1e6);
+  const int64_t staleUs = (int64_t)TIME_SYNC_STALE * 1000;
+  const int64_t outageFrom = 30 * HOUR_US, outageTo = 36 * HOUR_US;   // No replies
+  const int64_t bigStepAt = 48 * HOUR_US, bigStepUs = -2500000;       // Server switch: steps back
+  const int64_t smallStepAt = 54 * HOUR_US, smallStepUs = 300000;     // Slewed in
+  const int64_t settleUs = 2 * HOUR_US;                               // Not counted after boot and steps
+
+  ClockMapping mapping;
+  int64_t naiveUptime = 0, naiveUtc = 0;   // Reference: last sync + uptime, no drift correction
+  bool naiveSynced = false;
+  int64_t previousMapped = 0;
+  int64_t backwardJumps = 0, expectedBackward = 0;
+  double maxError = 0, sumSquares = 0, naiveMaxError = 0;
+  size_t counted = 0, requests = 0, dropped = 0, staleChecks = 0, staleWrong = 0;
+  int64_t nextSync = 5 * 1000000;
+
+  for (int64_t uptime = 0; uptime <= endUs; uptime += 1000000) {
+    // Server clock at this moment (device uptime = reference time): offset, drift and steps
+    int64_t reference = bootUs + uptime;
+    int64_t stepUs = (uptime >= bigStepAt ? bigStepUs : 0) + (uptime >= smallStepAt ? smallStepUs : 0);
+    int64_t serverClock = servedTime(reference, serverStartUs, false) + stepUs;
+
+    if (uptime >= nextSync) {
+      nextSync += intervalUs;
+      requests++;
+      bool lost = (uptime >= outageFrom && uptime < outageTo) || (options.drop != 0 && requests % options.drop == 0);
+      int64_t utcUs;
+      if (lost) {
+        dropped++;
+      } else if (!simulateSync(servedTime(reference, serverStartUs) + stepUs, mapping.toUtc(uptime), utcUs)) {
+        fprintf(stderr, "NTP reply not accepted\n");
+        return 1;
+      } else {
+        int64_t before = mapping.toUtc(uptime);
+        uint32_t steps = mapping.getSteps();
+        mapping.addSync(uptime, utcUs);
+        if (mapping.getSteps() != steps && mapping.toUtc(uptime) < before) {
+          expectedBackward++;
+        }
+        naiveUptime = uptime;
+        naiveUtc = utcUs;
+        naiveSynced = true;
+      }
+    }
+    if (!mapping.isSynced()) {
+      continue;
+    }
+
+    int64_t mapped = mapping.toUtc(uptime);
+    if (previousMapped != 0 && mapped < previousMapped) {
+      backwardJumps++;
+    }
+    previousMapped = mapped;
+
+    TimeQuality quality = mapping.quality(uptime, staleUs);
+    if (uptime >= outageFrom + intervalUs + staleUs && uptime < outageTo) {
+      staleChecks++;
+      staleWrong += quality != TIME_QUALITY_ESTIMATED;
+    }
+
+    bool settling = uptime < settleUs || (uptime >= bigStepAt && uptime < bigStepAt + settleUs) ||
+                    (uptime >= smallStepAt && uptime < smallStepAt + settleUs) ||
+                    (uptime >= outageFrom && uptime < outageTo + settleUs);
+    if (!settling) {
+      double error = fabs((double)(mapped - serverClock)) / 1000;
+      maxError = std::max(maxError, error);
+      sumSquares += error * error;
+      counted++;
+      if (naiveSynced) {
+        naiveMaxError = std::max(naiveMaxError, fabs((double)(naiveUtc + uptime - naiveUptime - serverClock)) / 1000);
+      }
+    }
+  }
+
+  TimeQuality finalQuality = mapping.quality(endUs, staleUs);
+  // A drift sample carries two jitters over one span; the median only narrows that
+  double spanUs = std::max((double)intervalUs, (double)ClockMapping::MIN_DRIFT_INTERVAL_US);
+  double driftTolerance = 0.1 + 2 * options.jitterMs * 1000 / spanUs * 1e6;
+  // Between syncs: jitter of the last sync plus the residual drift over one interval
+  double errorBound = 2 * options.jitterMs + driftTolerance * 1e-6 * options.intervalS * 1000 + 1;
+
+  printf("%.1f days, sync every %.0f s: %zu requests, %zu lost (%zu by --drop, outage %lld-%lld h)\n",
+         options.selftestDays, options.intervalS, requests, dropped,
+         options.drop != 0 ? requests / options.drop : 0, (long long)(outageFrom / HOUR_US),
+         (long long)(outageTo / HOUR_US));
+  printf("drift: estimated %+.2f ppm, served %+.2f ppm (tolerance %.2f)\n", mapping.getDriftPpm(), options.driftPpm,
+         driftTolerance);
+  printf("error vs served clock: max %.1f ms, rms %.1f ms (bound %.1f ms); without drift correction max %.1f ms\n",
+         maxError, counted ? sqrt(sumSquares / counted) : 0.0, errorBound, naiveMaxError);
+  printf("steps %u, backward jumps %lld (expected %lld), stale quality %zu/%zu, final quality %d\n",
+         mapping.getSteps(), (long long)backwardJumps, (long long)expectedBackward, staleChecks - staleWrong,
+         staleChecks, (int)finalQuality);
+
+  bool driftOk = options.selftestDays * 24 * 3600 < 4 * ClockMapping::MIN_DRIFT_INTERVAL_US / 1e6 ||
+                 fabs(mapping.getDriftPpm() - options.driftPpm) <= driftTolerance;
+  if (!driftOk || maxError > errorBound || backwardJumps != expectedBackward || staleWrong != 0 ||
+      finalQuality != TIME_QUALITY_DRIFT_CORRECTED || (options.selftestDays >= 3 && mapping.getSteps() != 1)) {
+    fprintf(stderr, "self test failed\n");
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
+
+// ===== CLIENT =====
+static int query() {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo* address = nullptr;
+  if (getaddrinfo(options.query.c_str(), std::to_string(options.port).c_str(), &hints, &address) != 0) {
+    fprintf(stderr, "%s: host not found\n", options.query.c_str());
+    return 1;
+  }
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  timeval timeout = {2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  uint8_t request[NTP_PACKET_SIZE];
+  uint8_t reply[NTP_PACKET_SIZE];
+  int64_t sent = hostTimeUs();
+  buildRequest(request, sent);
+  sendto(fd, request, sizeof(request), 0, address->ai_addr, address->ai_addrlen);
+  ssize_t length = recv(fd, reply, sizeof(reply), 0);
+  int64_t received = hostTimeUs();
+  freeaddrinfo(address);
+  close(fd);
+
+  int64_t serverReceive, serverTransmit;
+  if (length < 0 || !parseReply(reply, (size_t)length, request, serverReceive, serverTransmit)) {
+    fprintf(stderr, "%s: no valid reply\n", options.query.c_str());
+    return 1;
+  }
+  // RFC 4330: offset ((T2 - T1) + (T3 - T4)) / 2, delay (T4 - T1) - (T3 - T2)
+  double offsetMs = ((serverReceive - sent) + (serverTransmit - received)) / 2000.0;
+  double delayMs = ((received - sent) - (serverTransmit - serverReceive)) / 1000.0;
+  printf("%s: %s, offset %+.3f ms, round trip %.3f ms, stratum %u\n", options.query.c_str(),
+         formatUtc(serverTransmit).c_str(), offsetMs, delayMs, reply[1]);
+  return 0;
+}
+
+// ===== MAIN =====
+static bool parseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--port") {
+      options.port = (uint16_t)atoi(argv[++i]);
+    } else if (arg == "--offset") {
+      options.offsetMs = atof(argv[++i]);
+    } else if (arg == "--drift") {
+      options.driftPpm = atof(argv[++i]);
+    } else if (arg == "--jitter") {
+      options.jitterMs = atof(argv[++i]);
+    } else if (arg == "--drop") {
+      options.drop = (unsigned)atoi(argv[++i]);
+    } else if (arg == "--query") {
+      options.query = argv[++i];
+    } else if (arg == "--selftest") {
+      options.selftestDays = atof(argv[++i]);
+    } else if (arg == "--interval") {
+      options.intervalS = atof(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options.port != 0 && options.intervalS >= 15 && options.jitterMs >= 0 &&
+         fabs(options.driftPpm) < ClockMapping::MAX_DRIFT_PPM;
+}
+
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) {
+    fprintf(stderr, "usage: %s [--port N] [--offset MS] [--drift PPM] [--jitter MS] [--drop N] [--query HOST] "
+            "[--selftest DAYS [--interval S]]\n", argv[0]);
+    return 2;
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  if (options.selftestDays > 0) {
+    return selftest();
+  }
+  if (!options.query.empty()) {
+    return query();
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(options.port);
+  if (fd < 0 || bind(fd, (sockaddr*)&local, sizeof(local)) != 0) {
+    perror("bind");
+    return 1;
+  }
+  printf("NTP stand-in on udp/%u: offset %+.1f ms, drift %+.2f ppm, jitter +-%.1f ms%s\n", options.port,
+         options.offsetMs, options.driftPpm, options.jitterMs, options.drop ? ", dropping requests" : "");
+
+  const int64_t startUs = hostTimeUs();
+  unsigned requests = 0;
+  for (;;) {
+    uint8_t request[512];
+    uint8_t reply[NTP_PACKET_SIZE];
+    sockaddr_in peer = {};
+    socklen_t peerLength = sizeof(peer);
+    ssize_t length = recvfrom(fd, request, sizeof(request), 0, (sockaddr*)&peer, &peerLength);
+    int64_t receiveUs = servedTime(hostTimeUs(), startUs);
+    if (length <= 0) {
+      continue;
+    }
+    std::string name = std::string(inet_ntoa(peer.sin_addr)) + ":" + std::to_string(ntohs(peer.sin_port));
+    requests++;
+    if (options.drop != 0 && requests % options.drop == 0) {
+      printf("%s: request %u dropped (--drop)\n", name.c_str(), requests);
+      continue;
+    }
+    int64_t transmitUs = servedTime(hostTimeUs(), startUs);
+    transmitUs = transmitUs < receiveUs ? receiveUs : transmitUs;   // Jitter must not reorder them
+    size_t replyLength = buildReply(request, (size_t)length, receiveUs, transmitUs, reply);
+    if (replyLength == 0) {
+      printf("%s: not a client request (mode %u)\n", name.c_str(), request[0] & 7);
+      continue;
+    }
+    sendto(fd, reply, replyLength, 0, (sockaddr*)&peer, peerLength);
+    printf("%s: request %u answered with %s\n", name.c_str(), requests, formatUtc(transmitUs).c_str());
+  }
+}
@@ -0,0 +1,368 @@
+// ===== SAMPLE PATH NUMERIC BENCHMARK =====
+// CPU cycles (rdtsc) of the sample path before and after the switch to
+// integer wire units, on the same synthetic readings:
+//  - before: packSensorData() with a truncating float cast per field, the
+//    double AQI engine (breakpoints in µg/m³, mg/m³ and IAQ as the flow's
+//    literals, Math.round in double) - and loop() converting the sample
+//    three times: calculateLocalAQI(), the send filter probe, createPacket()
+//  - after: packSensorData() rounding to the wire unit (toWire), the integer
+//    AQIEngine.h on the packet, one conversion per sample
+// Both engines must give the same combined AQI, level and color for every
+// packet; the wire values of the two conversions are compared and their
+// differences (truncation vs rounding) counted.
+//
+// One rounded, clamped conversion costs more than a truncating cast; the
+// sample path gains because it converts once instead of three times.
+//
+// The host has a double FPU; the ESP32 has none and runs every double
+// operation in software, so the device gains more than shown here. Device
+// numbers: CYCLE_BENCH in config.h.
+//
+// Build and run from the repository root (Linux, x86):
+//   g++ -std=c++17 -O2 -I. tools/numeric_bench.cpp -o numeric_bench && ./numeric_bench
+// Options: --samples N (100000), --seed N (1).
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <x86intrin.h>
+#include "SensorData.h"
+#include "AQIEngine.h"
+
+// ===== BEFORE =====
+namespace before {
+
+inline void packSensorData(const SensorData& data, SensorDataPacket& packet) {
+  if (data.bme68xAvailable) {
+    packet.bme_temperature = (int16_t)(data.temperature * 100);
+    packet.bme_humidity = (uint16_t)(data.humidity * 100);
+    packet.bme_pressure = (uint16_t)(data.pressure * 10);
+    packet.gas_resistance = (uint32_t)data.gasResistance;
+    packet.iaq = (uint16_t)(data.iaq * 10);
+    packet.static_iaq = (uint16_t)(data.staticIaq * 10);
+    packet.co2_equivalent = (uint16_t)data.co2Equivalent;
+    packet.breath_voc = (uint16_t)(data.breathVocEquivalent * 100);
+    packet.iaq_accuracy = data.iaqAccuracy;
+    packet.co2_accuracy = data.co2Accuracy;
+    packet.voc_accuracy = data.breathVocAccuracy;
+    packet.bme_flags = (data.bme68xAvailable ? 1 : 0) | (data.bsecCalibrated ? 2 : 0);
+  }
+  if (data.ds18b20Available) {
+    packet.ds_temperature = (int16_t)(data.externalTemp * 100);
+    packet.ds_flags = 1;
+  }
+  if (data.pms5003Available) {
+    packet.pm1_0 = data.pm1_0;
+    packet.pm2_5 = data.pm2_5;
+    packet.pm10 = data.pm10;
+    packet.pms_flags = 1;
+  }
+}
+
+struct Breakpoint {
+  double from, to, indexFrom, indexTo;
+};
+
+struct Scale {
+  const Breakpoint* bands;
+  uint8_t count;
+  bool falling;
+  double maxIndex;
+  double divisor;   // Wire unit -> flow unit
+};
+
+static constexpr Breakpoint PM1_0[] = {
+  {0, 8, 0, 50}, {8, 25, 50, 100}, {25, 40, 100, 150}, {40, 60, 150, 200}, {60, 100, 200, 300},
+  {100, 200, 300, 500}
+};
+static constexpr Breakpoint PM2_5[] = {
+  {0, 12, 0, 50}, {12.1, 35.4, 50, 100}, {35.5, 55.4, 100, 150}, {55.5, 150.4, 150, 200},
+  {150.5, 250.4, 200, 300}, {250.5, 500.4, 300, 500}
+};
+static constexpr Breakpoint PM10[] = {
+  {0, 54, 0, 50}, {55, 154, 50, 100}, {155, 254, 100, 150}, {255, 354, 150, 200}, {355, 424, 200, 300},
+  {425, 604, 300, 500}
+};
+static constexpr Breakpoint CO2[] = {
+  {0, 400, 25, 25}, {400, 600, 25, 50}, {600, 800, 50, 100}, {800, 1000, 100, 150}, {1000, 1500, 150, 200},
+  {1500, 2000, 200, 300}, {2000, 5000, 300, 500}
+};
+static constexpr Breakpoint VOC[] = {
+  {0, 0.3, 25, 25}, {0.3, 0.5, 25, 50}, {0.5, 1.0, 50, 100}, {1.0, 2.0, 100, 150}, {2.0, 3.0, 150, 200},
+  {3.0, 5.0, 200, 300}, {5.0, 25.0, 300, 500}
+};
+static constexpr Breakpoint GAS[] = {
+  {1000000, 500000, 25, 25}, {500000, 200000, 25, 50}, {200000, 100000, 50, 100}, {100000, 50000, 100, 150},
+  {50000, 20000, 150, 200}, {20000, 10000, 200, 300}, {10000, 1000, 300, 500}
+};
+static constexpr Breakpoint IAQ[] = {
+  {0, 50, 0, 50}, {50, 100, 50, 100}, {100, 150, 100, 150}, {150, 200, 150, 200}, {200, 300, 200, 300},
+  {300, 500, 300, 500}
+};
+
+template <size_t N>
+constexpr Scale scale(const Breakpoint (&bands)[N], double divisor = 1, bool falling = false, double maxIndex = 0) {
+  return {bands, (uint8_t)N, falling, maxIndex, divisor};
+}
+
+static constexpr Scale FLOW_SCALES[AQI_POLLUTANT_COUNT] = {
+  scale(PM1_0, 1, false, 500), scale(PM2_5), scale(PM10), scale(CO2, 1, false, 500), scale(VOC, 100, false, 500),
+  scale(GAS, 1, true, 500), scale(IAQ, 10)
+};
+
+static double jsRound(double value) {
+  double down = floor(value);
+  return value - down >= 0.5 ? down + 1 : down;
+}
+
+static double interpolate(const Scale& scale, double value) {
+  uint8_t i = 0;
+  if (scale.falling) {
+    while (i + 1 < scale.count && value < scale.bands[i].to) {
+      i++;
+    }
+  } else {
+    while (i + 1 < scale.count && value > scale.bands[i].to) {
+      i++;
+    }
+  }
+  const Breakpoint& band = scale.bands[i];
+  double index = jsRound(band.indexFrom + ((band.indexTo - band.indexFrom) / (band.to - band.from)) *
+                         (value - band.from));
+  return scale.maxIndex > 0 && index > scale.maxIndex ? scale.maxIndex : index;
+}
+
+static uint32_t rawValue(const SensorDataPacket& packet, uint8_t pollutant) {
+  const uint32_t raw[AQI_POLLUTANT_COUNT] = {
+    packet.pm1_0, packet.pm2_5, packet.pm10, packet.co2_equivalent, packet.breath_voc, packet.gas_resistance,
+    packet.iaq
+  };
+  return raw[pollutant];
+}
+
+static AQILevel level(double aqi, uint32_t& color) {
+  uint32_t r, g, b = 0;
+  AQILevel id;
+  if (aqi <= 50) {
+    r = (uint32_t)jsRound(aqi / 50 * 128);
+    g = 255;
+    id = aqi <= 25 ? AQI_LEVEL_VERY_GOOD : AQI_LEVEL_GOOD;
+  } else if (aqi <= 100) {
+    r = (uint32_t)jsRound(128 + (aqi - 50) / 50 * 127);
+    g = 255;
+    id = aqi <= 75 ? AQI_LEVEL_STILL_GOOD : AQI_LEVEL_MODERATE;
+  } else if (aqi <= 150) {
+    r = 255;
+    g = (uint32_t)jsRound(255 - (aqi - 100) / 50 * 129);
+    id = aqi <= 125 ? AQI_LEVEL_UNHEALTHY : AQI_LEVEL_UNHEALTHY_SENSITIVE;
+  } else if (aqi <= 200) {
+    r = 255;
+    g = (uint32_t)jsRound(126 - (aqi - 150) / 50 * 126);
+    id = aqi <= 175 ? AQI_LEVEL_SLIGHTLY_UNHEALTHY : AQI_LEVEL_UNHEALTHY_HIGH;
+  } else if (aqi <= 300) {
+    double ratio = (aqi - 200) / 100;
+    r = (uint32_t)jsRound(255 - ratio * 112);
+    g = 0;
+    b = (uint32_t)jsRound(ratio * 151);
+    id = aqi <= 250 ? AQI_LEVEL_VERY_UNHEALTHY : AQI_LEVEL_EXTREMELY_UNHEALTHY;
+  } else {
+    r = 0x80;
+    g = 0;
+    id = AQI_LEVEL_HAZARDOUS;
+  }
+  color = (r << 16) | (g << 8) | b;
+  return id;
+}
+
+static AQIResult combined(const SensorDataPacket& packet) {
+  static const double WEIGHTS[AQI_POLLUTANT_COUNT][2] = {
+    {0.9, 0.9}, {1.0, 1.0}, {0.8, 0.8}, {0.6, 0.9}, {0.5, 0.8}, {0.6, 0.6}, {0.7, 1.0}
+  };
+  const uint8_t accuracy[AQI_POLLUTANT_COUNT] = {
+    3, 3, 3, packet.co2_accuracy, packet.voc_accuracy, 3, packet.iaq_accuracy
+  };
+  double total = 0;
+  double weights = 0;
+  for (uint8_t p = 0; p < AQI_POLLUTANT_COUNT; p++) {
+    const Scale& scale = FLOW_SCALES[p];
+    double value = scale.divisor == 1 ? (double)rawValue(packet, p) : rawValue(packet, p) / scale.divisor;
+    if (p > AQI_POLLUTANT_PM10 && value <= 0) {
+      continue;
+    }
+    double weight = WEIGHTS[p][accuracy[p] >= 2 ? 1 : 0];
+    total += interpolate(scale, value) * weight;
+    weights += weight;
+  }
+  double aqi = weights > 0 ? jsRound(total / weights) : 25;
+  if (aqi < 25) {
+    aqi = 25;
+  }
+  AQIResult result;
+  result.success = true;
+  result.aqi = (float)aqi;
+  result.level = level(aqi, result.colorCode);
+  return result;
+}
+
+// calculateLocalAQI(data): converted the readings itself
+static AQIResult calculateLocalAQI(const SensorData& data) {
+  SensorDataPacket packet = {};
+  before::packSensorData(data, packet);
+  return combined(packet);
+}
+
+}  // namespace before
+
+// ===== READINGS =====
+static void randomReading(std::mt19937& rng, SensorData& data) {
+  std::uniform_real_distribution<float> unit(0, 1);
+  data.bme68xAvailable = rng() % 10 != 0;
+  data.bsecCalibrated = rng() % 2 != 0;
+  data.temperature = -10 + unit(rng) * 50;
+  data.humidity = unit(rng) * 100;
+  data.pressure = 950 + unit(rng) * 100;
+  data.gasResistance = 1000 + unit(rng) * 2000000;
+  data.iaq = unit(rng) * 500;
+  data.staticIaq = data.iaq;
+  data.co2Equivalent = 400 + unit(rng) * 4600;
+  data.breathVocEquivalent = unit(rng) * 30;
+  data.iaqAccuracy = (uint8_t)(rng() % 4);
+  data.co2Accuracy = (uint8_t)(rng() % 4);
+  data.breathVocAccuracy = (uint8_t)(rng() % 4);
+  data.ds18b20Available = rng() % 4 != 0;
+  data.externalTemp = data.temperature - unit(rng) * 2;
+  data.pms5003Available = rng() % 10 != 0;
+  data.pm1_0 = (uint16_t)(rng() % 150);
+  data.pm2_5 = (uint16_t)(data.pm1_0 + rng() % 150);
+  data.pm10 = (uint16_t)(data.pm2_5 + rng() % 150);
+}
+
+// ===== TIMING =====
+// Cycles per sample, best of 5 runs
+template <typename F>
+static double cyclesPerCall(const std::vector<SensorData>& readings, uint64_t& sink, F call) {
+  double best = 1e30;
+  for (int run = 0; run < 5; run++) {
+    uint64_t start = __rdtsc();
+    for (const SensorData& data : readings) {
+      sink += call(data);
+    }
+    double cycles = (double)(__rdtsc() - start) / readings.size();
+    best = cycles < best ? cycles : best;
+  }
+  return best;
+}
+
+static uint64_t digest(const SensorDataPacket& packet) {
+  return (uint64_t)packet.bme_temperature + packet.iaq + packet.breath_voc + packet.gas_resistance +
+         packet.ds_temperature + packet.pm2_5;
+}
+
+int main(int argc, char** argv) {
+  uint64_t count = 100000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--samples" && i + 1 < argc) {
+      count = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--samples N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (count == 0) {
+    fprintf(stderr, "--samples must be > 0\n");
+    return 2;
+  }
+
+  std::mt19937 rng(seed);
+  std::vector<SensorData> readings(count);
+  for (SensorData& data : readings) {
+    randomReading(rng, data);
+  }
+
+  // Same packet, same AQI; the conversions differ by design
+  uint64_t aqiDifferences = 0;
+  uint64_t wireDifferences = 0;
+  for (const SensorData& data : readings) {
+    SensorDataPacket old = {};
+    before::packSensorData(data, old);
+    SensorDataPacket packet = {};
+    packSensorData(data, packet);
+    for (const SensorDataPacket* p : {&old, &packet}) {
+      AQIResult a = before::combined(*p);
+      AQIResult b = AQIEngine::combined(*p);
+      if (a.aqi != b.aqi || a.level != b.level || a.colorCode != b.colorCode) {
+        if (aqiDifferences++ < 10) {
+          fprintf(stderr, "AQI differs: double %.0f %06X, integer %.0f %06X\n", a.aqi, (unsigned)a.colorCode,
+                  b.aqi, (unsigned)b.colorCode);
+        }
+      }
+    }
+    wireDifferences += memcmp(&old, &packet, sizeof(packet)) != 0;
+  }
+  printf("%llu samples: %llu AQI differences double vs integer engine, %llu packets rounded differently "
+         "than truncated\n", (unsigned long long)count, (unsigned long long)aqiDifferences,
+         (unsigned long long)wireDifferences);
+
+  uint64_t sink = 0;
+  double packBefore = cyclesPerCall(readings, sink, [](const SensorData& data) {
+    SensorDataPacket packet = {};
+    before::packSensorData(data, packet);
+    return digest(packet);
+  });
+  double packAfter = cyclesPerCall(readings, sink, [](const SensorData& data) {
+    SensorDataPacket packet = {};
+    packSensorData(data, packet);
+    return digest(packet);
+  });
+
+  std::vector<SensorDataPacket> packets(count);  // Zero-initialized
+  for (size_t i = 0; i < count; i++) {
+    packSensorData(readings[i], packets[i]);
+  }
+  double aqiBefore = cyclesPerCall(readings, sink, [](const SensorData& data) {
+    return (uint64_t)before::calculateLocalAQI(data).colorCode;
+  });
+  size_t next = 0;
+  double aqiAfter = cyclesPerCall(readings, sink, [&](const SensorData&) {
+    const SensorDataPacket& sample = packets[next++ % packets.size()];
+    return (uint64_t)AQIEngine::combined(sample).colorCode;
+  });
+
+  // loop() per sample: AQI, send filter probe and packet
+  double pathBefore = cyclesPerCall(readings, sink, [](const SensorData& data) {
+    AQIResult local = before::calculateLocalAQI(data);
+    SensorDataPacket probe = {};
+    before::packSensorData(data, probe);
+    SensorDataPacket packet = {};
+    before::packSensorData(data, packet);
+    return local.colorCode + digest(probe) + digest(packet);
+  });
+  double pathAfter = cyclesPerCall(readings, sink, [](const SensorData& data) {
+    SensorDataPacket sample = {};
+    packSensorData(data, sample);
+    AQIResult local = AQIEngine::combined(sample);
+    SensorDataPacket packet = sample;
+    return local.colorCode + digest(sample) + digest(packet);
+  });
+
+  printf("\n%-36s %10s %10s\n", "host cycles/sample", "before", "after");
+  printf("%-36s %10.1f %10.1f\n", "packSensorData (one conversion)", packBefore, packAfter);
+  printf("%-36s %10.1f %10.1f\n", "calculateLocalAQI", aqiBefore, aqiAfter);
+  printf("%-36s %10.1f %10.1f\n", "sample path (loop)", pathBefore, pathAfter);
+  printf("(checksum %llu)\n", (unsigned long long)sink);
+
+  if (aqiDifferences > 0) {
+    printf("FAIL: %llu AQI differences\n", (unsigned long long)aqiDifferences);
+    return 1;
+  }
+  printf("OK: integer engine gives the double engine's AQI\n");
+  return 0;
+}
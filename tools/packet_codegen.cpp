@@ -0,0 +1,335 @@
+// ===== PACKET CODE GENERATOR =====
+// Emits everything that has to match the packet layout from the field table
+// in PacketSchema.h:
+//   - the v3 packet reader in the Node-RED "Binary Data Decoder" function
+//   - the packet tables in README.md and DATENPUNKTE.md
+// Each target contains a BEGIN/END marker pair; only the text between the
+// markers is replaced.
+//
+// Build and run from the repository root:
+//   g++ -std=c++17 -I. tools/packet_codegen.cpp -o packet_codegen && ./packet_codegen
+// Pass --check to only verify that the generated parts are up to date.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "PacketSchema.h"
+
+// ===== TARGETS =====
+static const char* const FLOW_FILE = "NodeRed/AirQualityMonitor.json";
+static const char* const JS_BEGIN = "// ===== GENERATED PACKET SCHEMA (tools/packet_codegen) - do not edit =====";
+static const char* const JS_END = "// ===== END GENERATED PACKET SCHEMA =====";
+static const char* const DOC_BEGIN = "<!-- BEGIN GENERATED PACKET TABLE (tools/packet_codegen) -->";
+static const char* const DOC_END = "<!-- END GENERATED PACKET TABLE -->";
+
+struct DocTarget {
+  const char* path;
+  const char* columns;          // Markdown header row
+  const char* sizeText;         // printf: min, max, header bytes
+  const char* optionalText;     // printf: section list
+};
+
+static const DocTarget DOC_TARGETS[] = {
+  {"README.md",
+   "| Field | Section | Type | Bytes | Scale | Unit |",
+   "Wire size %u–%u bytes: header (%u B) + section bitmap (1 B) + present sections + CRC-32 (4 B).",
+   "Optional sections, only sent while their flags are non-zero: %s."},
+  {"DATENPUNKTE.md",
+   "| Feld | Abschnitt | Typ | Bytes | Skalierung | Einheit |",
+   "Paketgröße %u–%u Bytes: Header (%u B) + Abschnitts-Bitmap (1 B) + vorhandene Abschnitte + CRC-32 (4 B).",
+   "Optionale Abschnitte, nur gesendet solange ihre Flags ungleich 0 sind: %s."}
+};
+
+// ===== SCHEMA HELPERS =====
+static const char* typeName(FieldType type) {
+  switch (type) {
+    case FieldType::U8: return "u8";
+    case FieldType::I8: return "i8";
+    case FieldType::U16: return "u16";
+    case FieldType::I16: return "i16";
+    case FieldType::U32: return "u32";
+    case FieldType::FLAGS: return "flags";
+    case FieldType::MAGIC: return "magic";
+    case FieldType::MAC: return "mac";
+  }
+  return "?";
+}
+
+static const char* jsReader(FieldType type) {
+  switch (type) {
+    case FieldType::I8: return "readInt8";
+    case FieldType::U16: return "readUInt16LE";
+    case FieldType::I16: return "readInt16LE";
+    case FieldType::U32: return "readUInt32LE";
+    default: return "readUInt8";
+  }
+}
+
+static unsigned sectionSize(int section) {
+  unsigned size = 0;
+  for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+    if (PACKET_SCHEMA[i].section == section) size += PACKET_SCHEMA[i].size;
+  }
+  return size;
+}
+
+static bool isOptionalSection(int section) {
+  return !(PacketFieldCodec<0>::fixedSections() & (1 << section));
+}
+
+static std::string hexByte(unsigned value) {
+  char text[8];
+  snprintf(text, sizeof(text), "0x%02X", value);
+  return text;
+}
+
+// ===== JAVASCRIPT =====
+static void emitReadField(std::ostringstream& js, const PacketFieldSpec& field, const char* indent) {
+  if (field.type == FieldType::MAC) {
+    js << indent << "values." << field.name << " = buffer.toString(\"hex\", offset, offset + "
+       << (unsigned)field.size << "); offset += " << (unsigned)field.size << ";\n";
+  } else {
+    js << indent << "values." << field.name << " = buffer." << jsReader(field.type)
+       << "(offset); offset += " << (unsigned)field.size << ";\n";
+  }
+}
+
+static std::string generateJs() {
+  std::ostringstream js;
+  unsigned headerSize = sectionSize(SECTION_HEADER);
+
+  js << JS_BEGIN << "\n";
+  js << "const PACKET_MAGIC_V3 = " << hexByte(PACKET_MAGIC_V3) << ";\n";
+  js << "const PACKET_V3_SECTIONS = [";
+  for (int s = 0; s < SECTION_COUNT; s++) {
+    js << (s ? ", " : "") << "\"" << PACKET_SECTION_NAMES[s] << "\"";
+  }
+  js << "];\n\n";
+
+  js << "// [name, section, delta-encoded in batch frames]\n";
+  js << "const PACKET_V3_FIELDS = [\n";
+  for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+    const PacketFieldSpec& field = PACKET_SCHEMA[i];
+    js << "    [\"" << field.name << "\", " << (unsigned)field.section << ", "
+       << (isConstantField(field.type) ? "false" : "true") << "]"
+       << (i + 1 < PACKET_FIELD_COUNT ? "," : "") << "\n";
+  }
+  js << "];\n\n";
+
+  // Length from the section bitmap
+  js << "function packetV3Length(sections) {\n";
+  js << "    return " << headerSize + 1;
+  for (int s = 1; s < SECTION_COUNT; s++) {
+    if (isOptionalSection(s)) {
+      js << " + (sections & " << hexByte(1 << s) << " ? " << sectionSize(s) << " : 0)";
+    } else {
+      js << " + " << sectionSize(s);
+    }
+  }
+  js << " + 4;\n}\n\n";
+
+  // Reader: raw integer values, absent sections read as 0
+  js << "// Raw field values of the v3 packet at start, null if truncated\n";
+  js << "function readPacketV3(buffer, start) {\n";
+  js << "    if (buffer.length < start + " << headerSize + 1 << ") {\n";
+  js << "        return null;\n    }\n";
+  js << "    const values = {};\n";
+  js << "    let offset = start;\n";
+  for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+    if (PACKET_SCHEMA[i].section == SECTION_HEADER) emitReadField(js, PACKET_SCHEMA[i], "    ");
+  }
+  js << "    const sections = buffer.readUInt8(offset); offset += 1;\n";
+  js << "    const length = packetV3Length(sections);\n";
+  js << "    if (buffer.length < start + length) {\n";
+  js << "        return null;\n    }\n";
+  for (int s = 1; s < SECTION_COUNT; s++) {
+    const char* indent = "    ";
+    if (isOptionalSection(s)) {
+      js << "    if (sections & " << hexByte(1 << s) << ") {\n";
+      indent = "        ";
+    }
+    for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+      if (PACKET_SCHEMA[i].section == s) emitReadField(js, PACKET_SCHEMA[i], indent);
+    }
+    if (isOptionalSection(s)) {
+      js << "    } else {\n";
+      for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+        if (PACKET_SCHEMA[i].section == s) js << "        values." << PACKET_SCHEMA[i].name << " = 0;\n";
+      }
+      js << "    }\n";
+    }
+  }
+  js << "    const received_crc = buffer.readUInt32LE(offset);\n";
+  js << "    const calculated_crc = crc32(buffer.subarray(start, offset), offset - start);\n";
+  js << "    return { values: values, sections: sections, length: length,\n";
+  js << "             received_crc: received_crc, calculated_crc: calculated_crc };\n";
+  js << "}\n\n";
+
+  // Scaled values in the decoder output structure, groups in order of appearance
+  js << "// Decoded object (scaled values) from raw field values\n";
+  js << "function scalePacketV3(values) {\n";
+  js << "    return {\n";
+  std::vector<std::string> groups;
+  for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+    std::string path = PACKET_SCHEMA[i].output;
+    if (path.empty()) continue;
+    size_t dot = path.find('.');
+    std::string group = dot == std::string::npos ? path : path.substr(0, dot);
+    bool known = false;
+    for (const std::string& g : groups) known = known || g == group;
+    if (!known) groups.push_back(group);
+  }
+  for (size_t g = 0; g < groups.size(); g++) {
+    bool nested = false;
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[i];
+      std::string path = field.output;
+      if (path.empty() || path.compare(0, groups[g].size(), groups[g]) != 0) continue;
+      if (path.size() > groups[g].size() && path[groups[g].size()] != '.') continue;
+
+      std::string value = std::string("values.") + field.name;
+      if (field.scale != 1) value += " / " + std::to_string(field.scale);
+      if (path.size() == groups[g].size()) {
+        lines.push_back(value);
+      } else {
+        nested = true;
+        lines.push_back(path.substr(groups[g].size() + 1) + ": " + value);
+      }
+    }
+    std::string comma = g + 1 < groups.size() ? "," : "";
+    if (!nested) {
+      js << "        " << groups[g] << ": " << lines[0] << comma << "\n";
+      continue;
+    }
+    js << "        " << groups[g] << ": {\n";
+    for (size_t l = 0; l < lines.size(); l++) {
+      js << "            " << lines[l] << (l + 1 < lines.size() ? "," : "") << "\n";
+    }
+    js << "        }" << comma << "\n";
+  }
+  js << "    };\n}\n";
+  js << JS_END;
+  return js.str();
+}
+
+// ===== DOCUMENTATION =====
+static std::string generateDoc(const DocTarget& target) {
+  std::ostringstream doc;
+  unsigned headerSize = sectionSize(SECTION_HEADER);
+  unsigned minSize = headerSize + 1 + 4;
+  unsigned maxSize = headerSize + 1 + 4;
+  std::string optional;
+  for (int s = 1; s < SECTION_COUNT; s++) {
+    maxSize += sectionSize(s);
+    if (isOptionalSection(s)) {
+      if (!optional.empty()) optional += ", ";
+      optional += std::string("`") + PACKET_SECTION_NAMES[s] + "` (" + std::to_string(sectionSize(s)) + " B)";
+    } else {
+      minSize += sectionSize(s);
+    }
+  }
+
+  char line[256];
+  doc << DOC_BEGIN << "\n";
+  doc << target.columns << "\n";
+  doc << "|---|---|---|---|---|---|\n";
+  for (size_t i = 0; i < PACKET_FIELD_COUNT; i++) {
+    const PacketFieldSpec& field = PACKET_SCHEMA[i];
+    std::string scale = field.scale != 1 ? "× " + std::to_string(field.scale) : "";
+    doc << "| `" << field.name << "` | " << PACKET_SECTION_NAMES[field.section] << " | "
+        << typeName(field.type) << " | " << (unsigned)field.size << " | " << scale << " | "
+        << field.unit << " |\n";
+  }
+  doc << "\n";
+  snprintf(line, sizeof(line), target.sizeText, minSize, maxSize, headerSize);
+  doc << line << "\n";
+  snprintf(line, sizeof(line), target.optionalText, optional.c_str());
+  doc << line << "\n";
+  doc << DOC_END;
+  return doc.str();
+}
+
+// ===== FILE PATCHING =====
+static std::string jsonEscape(const std::string& text) {
+  std::string out;
+  for (char c : text) {
+    switch (c) {
+      case '\\': out += "\\\\"; break;
+      case '"': out += "\\\""; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      default: out += c;
+    }
+  }
+  return out;
+}
+
+static bool readFile(const char* path, std::string& content) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+// Returns 0 = unchanged, 1 = updated (or outdated with check), -1 = error
+static int patchFile(const char* path, const std::string& begin, const std::string& end,
+                     const std::string& replacement, bool check) {
+  std::string content;
+  if (!readFile(path, content)) {
+    fprintf(stderr, "%s: cannot read\n", path);
+    return -1;
+  }
+
+  size_t from = content.find(begin);
+  size_t to = from == std::string::npos ? std::string::npos : content.find(end, from);
+  if (to == std::string::npos) {
+    fprintf(stderr, "%s: generated section markers not found\n", path);
+    return -1;
+  }
+  to += end.size();
+
+  if (content.compare(from, to - from, replacement) == 0) {
+    return 0;
+  }
+  if (check) {
+    fprintf(stderr, "%s: generated section is out of date\n", path);
+    return 1;
+  }
+
+  content.replace(from, to - from, replacement);
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << content;
+  printf("%s: updated\n", path);
+  return file ? 1 : -1;
+}
+
+int main(int argc, char** argv) {
+  bool check = argc > 1 && std::string(argv[1]) == "--check";
+  int outdated = 0;
+  bool failed = false;
+
+  // The flow stores the function body as a JSON string
+  int result = patchFile(FLOW_FILE, jsonEscape(JS_BEGIN), jsonEscape(JS_END),
+                         jsonEscape(generateJs()), check);
+  failed = failed || result < 0;
+  outdated += result > 0;
+
+  for (const DocTarget& target : DOC_TARGETS) {
+    result = patchFile(target.path, DOC_BEGIN, DOC_END, generateDoc(target), check);
+    failed = failed || result < 0;
+    outdated += result > 0;
+  }
+
+  if (failed) {
+    return 2;
+  }
+  if (!check && outdated == 0) {
+    printf("All generated sections up to date\n");
+  }
+  return check && outdated > 0 ? 1 : 0;
+}
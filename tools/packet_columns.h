@@ -0,0 +1,508 @@
+#ifndef PACKET_COLUMNS_H
+#define PACKET_COLUMNS_H
+
+// ===== COLUMNAR PACKET DECODER =====
+// Decodes archives of sensor packets into one array per field (struct of
+// arrays) for backfills and reprocessing. Archive formats:
+//   V3 - v3 wire packets back to back, as in a /sensor-data backlog body
+//   V2 - fixed 58-byte packets (magic 0xD2, device ID, boot count,
+//        sequence, body, CRC-32)
+//   V1 - fixed 42-byte packets (body and XOR checksum)
+// The v1/v2 body is the SensorDataPacket field order from the timestamp
+// on, so all three layouts come from the field table in PacketSchema.h.
+//
+// Two passes: an index pass finds record and section starts (a v3
+// packet's length depends on its bitmap), then every field column is
+// filled with 8-lane AVX2 gathers - section start + field offset, absent
+// sections masked to 0 - and scaled to float. The
+// checksums of 8 records are computed side by side (slicing-by-4 CRC-32
+// with gathered table lookups). The scalar kernel is the reference; both
+// give bit-identical columns. AVX2 is chosen at run time.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "packet_decoder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACKET_COLUMNS_AVX2 1
+#else
+#define PACKET_COLUMNS_AVX2 0
+#endif
+
+enum class ArchiveFormat : uint8_t { V1, V2, V3 };
+
+// v1/v2 packets end with the system section - later sections (time) came
+// with v3 and are appended to the struct, so the legacy offsets still hold
+static const uint8_t PACKET_LEGACY_SECTIONS = (1 << (SECTION_SYSTEM + 1)) - 1;
+static const size_t PACKET_LEGACY_SIZE = PacketFieldCodec<0>::size(PACKET_LEGACY_SECTIONS);
+
+static const uint8_t PACKET_MAGIC_V2 = 0xD2;
+static const size_t PACKET_V2_SIZE = PACKET_LEGACY_SIZE + 4;
+static const size_t PACKET_V1_BODY_START = offsetof(SensorDataPacket, timestamp);
+static const size_t PACKET_V1_SIZE = PACKET_LEGACY_SIZE - PACKET_V1_BODY_START + 1;
+static_assert(PACKET_V2_SIZE == 58 && PACKET_V1_SIZE == 42, "Legacy packet layout changed");
+
+// Scaled columns are converted from int32 lanes
+constexpr bool scaledFieldsFitInt32(size_t index = 0) {
+  return index >= PACKET_FIELD_COUNT ||
+         ((PACKET_SCHEMA[index].scale == 1 || PACKET_SCHEMA[index].type != FieldType::U32) &&
+          scaledFieldsFitInt32(index + 1));
+}
+static_assert(scaledFieldsFitInt32(), "Scaled U32 fields need an unsigned conversion");
+
+class PacketColumns {
+public:
+  size_t size() const { return count; }
+
+  // Raw field value, sign-extended for I8/I16 (cast to int32_t), 0 if the
+  // field's section is absent or the format has no such field. nullptr for
+  // the device ID, see deviceId().
+  const uint32_t* raw(size_t field) const {
+    return PACKET_SCHEMA[field].size <= 4 ? rawColumns[field].data() : nullptr;
+  }
+
+  // raw / scale for fields with a scale other than 1, nullptr otherwise
+  const float* scaled(size_t field) const {
+    return PACKET_SCHEMA[field].scale != 1 ? scaledColumns[field].data() : nullptr;
+  }
+
+  const uint64_t* deviceId() const { return deviceIds.data(); }   // eFuse MAC, byte 0 lowest
+  const uint8_t* sections() const { return sectionBits.data(); }  // Section bitmap (v1/v2: all but time)
+  const uint8_t* valid() const { return validFlags.data(); }      // Checksum OK
+  size_t invalidCount() const;
+
+private:
+  friend class ColumnDecoder;
+
+  size_t count = 0;
+  std::vector<uint32_t> start;                    // Record offset in the decoded buffer
+  std::vector<int32_t> sectionStart[SECTION_COUNT];  // Section offset in the buffer (v1 header: < 0)
+  std::vector<uint8_t> length;                    // Record length incl. checksum
+  std::vector<uint8_t> sectionBits;
+  std::vector<uint8_t> validFlags;
+  std::vector<uint64_t> deviceIds;
+  std::vector<uint32_t> rawColumns[PACKET_FIELD_COUNT];
+  std::vector<float> scaledColumns[PACKET_FIELD_COUNT];
+
+  void resize(size_t records);
+};
+
+class ColumnDecoder {
+public:
+  enum Kernel { SCALAR, AVX2 };
+
+  static Kernel bestKernel();
+  static const char* kernelName(Kernel kernel) { return kernel == AVX2 ? "avx2" : "scalar"; }
+
+  // Decodes the complete records at the start of data into columns and
+  // returns the bytes used; an incomplete record at the end is left for the
+  // next call. A v3 record without magic ends the pass early (used bytes
+  // point at it). Buffers up to 2 GB.
+  static size_t decode(const uint8_t* data, size_t length, ArchiveFormat format,
+                       PacketColumns& columns, Kernel kernel = bestKernel());
+
+private:
+  // Sections start at an offset that depends on the bitmap (v3 leaves
+  // absent ones out), fields sit at a fixed offset within their section.
+  // fieldOffset -1 = the format has no such field.
+  struct Layout {
+    int32_t sectionOffset[SECTION_COUNT][1 << SECTION_COUNT];
+    int32_t fieldOffset[PACKET_FIELD_COUNT];
+  };
+
+  static const size_t FIELD_TILE = 256;   // Records per field pass, a multiple of 8
+
+  static const Layout& layout(ArchiveFormat format);
+  static const uint32_t* crcTables();   // 4 x 256 entries, slicing-by-4
+
+  static size_t index(const uint8_t* data, size_t length, ArchiveFormat format, const Layout& layout,
+                      PacketColumns& columns);
+  static void fieldsScalar(const uint8_t* data, const Layout& layout, PacketColumns& columns, size_t from);
+  static void checksScalar(const uint8_t* data, ArchiveFormat format, PacketColumns& columns, size_t from);
+#if PACKET_COLUMNS_AVX2
+  // Kernels run on the first `records` records (a multiple of 8)
+  __attribute__((target("avx2"))) static void fieldsAvx2(const uint8_t* data, const Layout& layout,
+                                                          PacketColumns& columns, size_t records);
+  __attribute__((target("avx2"))) static void xorAvx2(const uint8_t* data, PacketColumns& columns, size_t records);
+  __attribute__((target("avx2"))) static void crcAvx2(const uint8_t* data, uint8_t magic, PacketColumns& columns,
+                                                       size_t records);
+#endif
+};
+
+// ===== IMPLEMENTATION =====
+void PacketColumns::resize(size_t records) {
+  // Columns only grow: reused across chunks without zero-filling again
+  count = records;
+  if (start.size() >= records) {
+    return;
+  }
+  start.resize(records);
+  for (size_t s = 0; s < SECTION_COUNT; s++) {
+    sectionStart[s].resize(records);
+  }
+  length.resize(records);
+  sectionBits.resize(records);
+  validFlags.resize(records);
+  deviceIds.resize(records);
+  for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+    if (PACKET_SCHEMA[f].size <= 4) {
+      rawColumns[f].resize(records);
+    }
+    if (PACKET_SCHEMA[f].scale != 1) {
+      scaledColumns[f].resize(records);
+    }
+  }
+}
+
+size_t PacketColumns::invalidCount() const {
+  size_t invalid = 0;
+  for (size_t i = 0; i < count; i++) {
+    invalid += validFlags[i] == 0;
+  }
+  return invalid;
+}
+
+ColumnDecoder::Kernel ColumnDecoder::bestKernel() {
+#if PACKET_COLUMNS_AVX2
+  return __builtin_cpu_supports("avx2") ? AVX2 : SCALAR;
+#else
+  return SCALAR;
+#endif
+}
+
+const ColumnDecoder::Layout& ColumnDecoder::layout(ArchiveFormat format) {
+  static const std::vector<Layout> layouts = [] {
+    // Struct offset and size of each section; fields of a section are
+    // adjacent in the struct and on the wire
+    size_t sectionStruct[SECTION_COUNT] = {};
+    size_t sectionSize[SECTION_COUNT] = {};
+    for (size_t f = PACKET_FIELD_COUNT; f-- > 0;) {
+      sectionStruct[PACKET_SCHEMA[f].section] = PACKET_SCHEMA[f].offset;
+      sectionSize[PACKET_SCHEMA[f].section] += PACKET_SCHEMA[f].size;
+    }
+
+    std::vector<Layout> built(3);
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      int32_t inSection = (int32_t)(field.offset - sectionStruct[field.section]);
+      built[(int)ArchiveFormat::V3].fieldOffset[f] = inSection;
+      bool legacy = (PACKET_LEGACY_SECTIONS & (1 << field.section)) != 0;
+      built[(int)ArchiveFormat::V2].fieldOffset[f] = legacy ? inSection : -1;
+      built[(int)ArchiveFormat::V1].fieldOffset[f] = legacy && field.offset >= PACKET_V1_BODY_START ? inSection : -1;
+    }
+    for (uint8_t bits = 0; bits < (1 << SECTION_COUNT); bits++) {
+      size_t v3Offset = PacketDecoder::HEADER_SIZE + 1;  // Section bitmap
+      for (size_t s = 0; s < SECTION_COUNT; s++) {
+        int32_t legacy = (int32_t)sectionStruct[s];
+        built[(int)ArchiveFormat::V2].sectionOffset[s][bits] = legacy;
+        built[(int)ArchiveFormat::V1].sectionOffset[s][bits] = legacy - (int32_t)PACKET_V1_BODY_START;
+        if (s == SECTION_HEADER) {
+          built[(int)ArchiveFormat::V3].sectionOffset[s][bits] = 0;
+        } else {
+          built[(int)ArchiveFormat::V3].sectionOffset[s][bits] = (int32_t)v3Offset;
+          v3Offset += (bits & (1 << s)) ? sectionSize[s] : 0;
+        }
+      }
+    }
+    return built;
+  }();
+  return layouts[(int)format];
+}
+
+const uint32_t* ColumnDecoder::crcTables() {
+  // T[k][b]: CRC of byte b followed by k zero bytes; T[0] is Crc32::TABLE
+  // (one update step from an all-ones register leaves ~TABLE[b])
+  static const std::vector<uint32_t> tables = [] {
+    std::vector<uint32_t> built(4 * 256);
+    for (uint32_t b = 0; b < 256; b++) {
+      uint8_t byte = (uint8_t)b;
+      built[b] = ~Crc32::update(0xFFFFFFFF, &byte, 1);
+    }
+    for (size_t k = 1; k < 4; k++) {
+      for (size_t b = 0; b < 256; b++) {
+        uint32_t previous = built[(k - 1) * 256 + b];
+        built[k * 256 + b] = (previous >> 8) ^ built[previous & 0xFF];
+      }
+    }
+    return built;
+  }();
+  return tables.data();
+}
+
+size_t ColumnDecoder::index(const uint8_t* data, size_t length, ArchiveFormat format, const Layout& layout,
+                            PacketColumns& columns) {
+  size_t count = 0;
+  size_t offset = 0;
+
+  if (format == ArchiveFormat::V3) {
+    // Upper bound (all sections absent), trimmed below
+    columns.resize(length / (PacketDecoder::HEADER_SIZE + 1 + 4));
+    for (;;) {
+      size_t recordLength = PacketDecoder::wireLength(data + offset, length - offset);
+      if (recordLength == 0 || offset + recordLength > length || data[offset] != PACKET_MAGIC_V3) {
+        break;
+      }
+      uint8_t bits = PacketDecoder::sections(data + offset) | (1 << SECTION_HEADER);
+      columns.start[count] = (uint32_t)offset;
+      columns.length[count] = (uint8_t)recordLength;
+      columns.sectionBits[count] = bits;
+      for (size_t s = 0; s < SECTION_COUNT; s++) {
+        columns.sectionStart[s][count] = (int32_t)offset + layout.sectionOffset[s][bits & ((1 << SECTION_COUNT) - 1)];
+      }
+      uint64_t id = 0;
+      memcpy(&id, data + offset + offsetof(SensorDataPacket, device_id), 6);
+      columns.deviceIds[count] = id;
+      offset += recordLength;
+      count++;
+    }
+  } else {
+    size_t stride = format == ArchiveFormat::V2 ? PACKET_V2_SIZE : PACKET_V1_SIZE;
+    count = length / stride;
+    columns.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      columns.start[i] = (uint32_t)(i * stride);
+      for (size_t s = 0; s < SECTION_COUNT; s++) {
+        columns.sectionStart[s][i] = (int32_t)(i * stride) + layout.sectionOffset[s][PACKET_LEGACY_SECTIONS];
+      }
+      columns.length[i] = (uint8_t)stride;
+      columns.sectionBits[i] = PACKET_LEGACY_SECTIONS;
+      uint64_t id = 0;
+      if (format == ArchiveFormat::V2) {
+        memcpy(&id, data + i * stride + offsetof(SensorDataPacket, device_id), 6);
+      }
+      columns.deviceIds[i] = id;
+    }
+    offset = count * stride;
+  }
+
+  columns.resize(count);
+  return offset;
+}
+
+size_t ColumnDecoder::decode(const uint8_t* data, size_t length, ArchiveFormat format,
+                             PacketColumns& columns, Kernel kernel) {
+  const Layout& fields = layout(format);
+  size_t used = index(data, length, format, fields, columns);
+  size_t vectorized = 0;
+
+#if PACKET_COLUMNS_AVX2
+  if (kernel == AVX2) {
+    // A gather reads 4 bytes per lane, at most 3 past the end of a record:
+    // blocks ending that close to the buffer end go to the scalar kernel
+    vectorized = columns.count / 8 * 8;
+    while (vectorized > 0 && columns.start[vectorized - 1] + columns.length[vectorized - 1] + 3 > length) {
+      vectorized -= 8;
+    }
+    fieldsAvx2(data, fields, columns, vectorized);
+    if (format == ArchiveFormat::V1) {
+      xorAvx2(data, columns, vectorized);
+    } else {
+      crcAvx2(data, format == ArchiveFormat::V2 ? PACKET_MAGIC_V2 : PACKET_MAGIC_V3, columns, vectorized);
+    }
+  }
+#else
+  (void)kernel;
+#endif
+
+  fieldsScalar(data, fields, columns, vectorized);
+  checksScalar(data, format, columns, vectorized);
+  return used;
+}
+
+// ===== SCALAR KERNEL (reference) =====
+void ColumnDecoder::fieldsScalar(const uint8_t* data, const Layout& layout, PacketColumns& columns, size_t from) {
+  // Same tiling as the AVX2 kernel
+  for (size_t tile = from; tile < columns.count; tile += FIELD_TILE) {
+    size_t tileEnd = tile + FIELD_TILE < columns.count ? tile + FIELD_TILE : columns.count;
+
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      if (field.size > 4) {
+        continue;  // Device ID comes from the index pass
+      }
+      // Copies: the stores below may alias the schema's uint8_t members
+      const int32_t offset = layout.fieldOffset[f];
+      const uint8_t bit = offset >= 0 ? (uint8_t)(1 << field.section) : 0;
+      const size_t size = field.size;
+      const bool isSigned = isSignedField(field.type);
+      const float scale = (float)field.scale;
+      const int32_t* sectionStart = columns.sectionStart[field.section].data();
+      const uint8_t* sectionBits = columns.sectionBits.data();
+      uint32_t* raw = columns.rawColumns[f].data();
+      float* scaled = field.scale != 1 ? columns.scaledColumns[f].data() : nullptr;
+
+      for (size_t i = tile; i < tileEnd; i++) {
+        uint32_t value = 0;
+        if (sectionBits[i] & bit) {
+          const uint8_t* p = data + sectionStart[i] + offset;
+          if (size == 1) {
+            value = isSigned ? (uint32_t)(int32_t)(int8_t)p[0] : p[0];
+          } else if (size == 2) {
+            uint16_t v;
+            memcpy(&v, p, sizeof(v));
+            value = isSigned ? (uint32_t)(int32_t)(int16_t)v : v;
+          } else {
+            memcpy(&value, p, sizeof(value));
+          }
+        }
+        raw[i] = value;
+        if (scaled != nullptr) {
+          scaled[i] = (float)(int32_t)value / scale;
+        }
+      }
+    }
+  }
+}
+
+void ColumnDecoder::checksScalar(const uint8_t* data, ArchiveFormat format, PacketColumns& columns, size_t from) {
+  for (size_t i = from; i < columns.count; i++) {
+    const uint8_t* record = data + columns.start[i];
+    size_t length = columns.length[i];
+    if (format == ArchiveFormat::V1) {
+      uint8_t checksum = 0;
+      for (size_t k = 0; k < length - 1; k++) {
+        checksum ^= record[k];
+      }
+      columns.validFlags[i] = checksum == record[length - 1];
+    } else {
+      uint32_t crc;
+      memcpy(&crc, record + length - 4, sizeof(crc));
+      columns.validFlags[i] = Crc32::update(0, record, length - 4) == crc &&
+                              record[0] == (format == ArchiveFormat::V2 ? PACKET_MAGIC_V2 : PACKET_MAGIC_V3);
+    }
+  }
+}
+
+// ===== AVX2 KERNEL =====
+#if PACKET_COLUMNS_AVX2
+void ColumnDecoder::fieldsAvx2(const uint8_t* data, const Layout& layout, PacketColumns& columns, size_t records) {
+
+  // Field by field over tiles of records that stay in L1 - field by field
+  // over the whole buffer would pull every record from memory per field
+  for (size_t tile = 0; tile < records; tile += FIELD_TILE) {
+    size_t tileEnd = tile + FIELD_TILE < records ? tile + FIELD_TILE : records;
+
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      if (field.size > 4) {
+        continue;
+      }
+      // Absent fields read nothing (mask 0) and stay 0
+      int32_t offset = layout.fieldOffset[f];
+      const int* base = (const int*)(data + (offset >= 0 ? offset : 0));
+      const int32_t* sectionStart = columns.sectionStart[field.section].data();
+      const __m256i bit = _mm256_set1_epi32(offset >= 0 ? 1 << field.section : 0x100);
+      uint32_t* raw = columns.rawColumns[f].data();
+      float* scaled = field.scale != 1 ? columns.scaledColumns[f].data() : nullptr;
+      const __m256 scale = _mm256_set1_ps((float)field.scale);
+      const int shift = 32 - 8 * field.size;
+      const bool isSigned = isSignedField(field.type);
+
+      for (size_t i = tile; i < tileEnd; i += 8) {
+        __m256i starts = _mm256_loadu_si256((const __m256i*)&sectionStart[i]);
+        __m256i bits = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&columns.sectionBits[i]));
+        __m256i present = _mm256_cmpeq_epi32(_mm256_and_si256(bits, bit), bit);
+        __m256i value = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, starts, present, 1);
+        if (shift > 0) {
+          // Keep the field's bytes, sign-extended for I8/I16
+          value = _mm256_slli_epi32(value, shift);
+          value = isSigned ? _mm256_srai_epi32(value, shift) : _mm256_srli_epi32(value, shift);
+        }
+        _mm256_storeu_si256((__m256i*)&raw[i], value);
+        if (scaled != nullptr) {
+          _mm256_storeu_ps(&scaled[i], _mm256_div_ps(_mm256_cvtepi32_ps(value), scale));
+        }
+      }
+    }
+  }
+}
+
+void ColumnDecoder::xorAvx2(const uint8_t* data, PacketColumns& columns, size_t records) {
+  // Fixed-size records: XOR whole words, fold the 4 bytes at the end
+  const int* base = (const int*)data;
+  const __m256i byteMask = _mm256_set1_epi32(0xFF);
+  int covered = columns.count > 0 ? columns.length[0] - 1 : 0;
+
+  for (size_t i = 0; i < records; i += 8) {
+    __m256i starts = _mm256_loadu_si256((const __m256i*)&columns.start[i]);
+    __m256i sum = _mm256_setzero_si256();
+    int position = 0;
+    for (; position + 4 <= covered; position += 4) {
+      __m256i word = _mm256_i32gather_epi32(base, _mm256_add_epi32(starts, _mm256_set1_epi32(position)), 1);
+      sum = _mm256_xor_si256(sum, word);
+    }
+    sum = _mm256_xor_si256(sum, _mm256_srli_epi32(sum, 16));
+    sum = _mm256_xor_si256(sum, _mm256_srli_epi32(sum, 8));
+    // Last 1-3 bytes of the body, then the checksum byte itself: XOR over all is 0
+    for (; position <= covered; position++) {
+      __m256i byte = _mm256_i32gather_epi32(base, _mm256_add_epi32(starts, _mm256_set1_epi32(position)), 1);
+      sum = _mm256_xor_si256(sum, byte);
+    }
+    __m256i ok = _mm256_cmpeq_epi32(_mm256_and_si256(sum, byteMask), _mm256_setzero_si256());
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(ok));
+    for (size_t k = 0; k < 8; k++) {
+      columns.validFlags[i + k] = (mask >> k) & 1;
+    }
+  }
+}
+
+void ColumnDecoder::crcAvx2(const uint8_t* data, uint8_t magic, PacketColumns& columns, size_t records) {
+  const int* tables = (const int*)crcTables();
+  const int* base = (const int*)data;
+  const __m256i byteMask = _mm256_set1_epi32(0xFF);
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const __m256i expected = _mm256_set1_epi32(magic);
+
+  for (size_t i = 0; i < records; i += 8) {
+    __m256i starts = _mm256_loadu_si256((const __m256i*)&columns.start[i]);
+    __m256i lengths = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&columns.length[i])),
+                                       _mm256_set1_epi32(4));
+    int maxLength = 0;
+    for (size_t k = 0; k < 8; k++) {
+      maxLength = columns.length[i + k] - 4 > maxLength ? columns.length[i + k] - 4 : maxLength;
+    }
+
+    // Four bytes per step: one data gather, four independent table gathers
+    __m256i crc = ones;
+    int position = 0;
+    for (; position + 4 <= maxLength; position += 4) {
+      __m256i active = _mm256_cmpgt_epi32(lengths, _mm256_set1_epi32(position + 3));
+      __m256i word = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base,
+                                                 _mm256_add_epi32(starts, _mm256_set1_epi32(position)), active, 1);
+      __m256i x = _mm256_xor_si256(crc, word);
+      __m256i t3 = _mm256_i32gather_epi32(tables + 3 * 256, _mm256_and_si256(x, byteMask), 4);
+      __m256i t2 = _mm256_i32gather_epi32(tables + 2 * 256, _mm256_and_si256(_mm256_srli_epi32(x, 8), byteMask), 4);
+      __m256i t1 = _mm256_i32gather_epi32(tables + 256, _mm256_and_si256(_mm256_srli_epi32(x, 16), byteMask), 4);
+      __m256i t0 = _mm256_i32gather_epi32(tables, _mm256_srli_epi32(x, 24), 4);
+      __m256i next = _mm256_xor_si256(_mm256_xor_si256(t0, t1), _mm256_xor_si256(t2, t3));
+      crc = _mm256_blendv_epi8(crc, next, active);
+    }
+
+    // Remaining 0-3 bytes per lane, from each lane's last full word on
+    __m256i tail = _mm256_andnot_si256(_mm256_set1_epi32(3), lengths);
+    for (int k = 0; k < 3; k++) {
+      __m256i at = _mm256_add_epi32(tail, _mm256_set1_epi32(k));
+      __m256i active = _mm256_cmpgt_epi32(lengths, at);
+      __m256i byte = _mm256_and_si256(_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base,
+                                                                  _mm256_add_epi32(starts, at), active, 1), byteMask);
+      __m256i index = _mm256_and_si256(_mm256_xor_si256(crc, byte), byteMask);
+      __m256i next = _mm256_xor_si256(_mm256_i32gather_epi32(tables, index, 4), _mm256_srli_epi32(crc, 8));
+      crc = _mm256_blendv_epi8(crc, next, active);
+    }
+
+    crc = _mm256_xor_si256(crc, ones);
+    __m256i stored = _mm256_i32gather_epi32(base, _mm256_add_epi32(starts, lengths), 1);
+    __m256i first = _mm256_and_si256(_mm256_i32gather_epi32(base, starts, 1), byteMask);
+    int ok = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(crc, stored),
+                                                                      _mm256_cmpeq_epi32(first, expected))));
+    for (size_t k = 0; k < 8; k++) {
+      columns.validFlags[i + k] = (ok >> k) & 1;
+    }
+  }
+}
+#endif
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef PACKET_DECODER_H
+#define PACKET_DECODER_H
+
+// ===== PACKET DECODER =====
+// Host-side inverse of PacketEncoder / BatchFrameEncoder (PacketSchema.h):
+// turns v3 wire packets and batch frames back into SensorDataPacket
+// structs. Driven by the same field table, so a schema change reaches the
+// host tools with a rebuild. Absent sections decode as 0, like in the flow.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "PacketSchema.h"
+
+class PacketDecoder {
+public:
+  static constexpr size_t HEADER_SIZE = PacketFieldCodec<0>::size(1 << SECTION_HEADER);
+
+  // Wire length of the v3 packet at the start of wire (incl. CRC), 0 if the
+  // buffer is too short to hold its section bitmap
+  static size_t wireLength(const uint8_t* wire, size_t length);
+
+  // Decodes the v3 packet at the start of wire, returns its wire length.
+  // 0 if magic, length or CRC-32 do not match.
+  static size_t decode(const uint8_t* wire, size_t length, SensorDataPacket& packet);
+
+  // Section bitmap as sent on the wire
+  static uint8_t sections(const uint8_t* wire) { return wire[HEADER_SIZE]; }
+};
+
+class BatchFrameDecoder {
+public:
+  // Decodes a version 3 batch frame, returns the number of packets. 0 if
+  // magic, version or CRC-32 do not match, the frame is truncated or has
+  // trailing bytes, or it holds more than capacity packets.
+  static size_t decode(const uint8_t* frame, size_t length, SensorDataPacket* packets, size_t capacity);
+
+private:
+  static bool readVarint(const uint8_t* data, size_t end, size_t& offset, uint64_t& value);
+  static int64_t readField(const uint8_t* packet, const PacketFieldSpec& field);
+  static void writeField(uint8_t* packet, const PacketFieldSpec& field, int64_t value);
+};
+
+// ===== IMPLEMENTATION =====
+size_t PacketDecoder::wireLength(const uint8_t* wire, size_t length) {
+  if (length <= HEADER_SIZE) {
+    return 0;
+  }
+  uint8_t present = sections(wire) | (1 << SECTION_HEADER);
+  return PacketFieldCodec<0>::size(present) + 1 + 4;
+}
+
+size_t PacketDecoder::decode(const uint8_t* wire, size_t length, SensorDataPacket& packet) {
+  size_t expected = wireLength(wire, length);
+  if (expected == 0 || expected > length || wire[0] != PACKET_MAGIC_V3) {
+    return 0;
+  }
+  uint32_t crc;
+  memcpy(&crc, wire + expected - 4, sizeof(crc));
+  if (Crc32::update(0, wire, expected - 4) != crc) {
+    return 0;
+  }
+
+  memset(&packet, 0, sizeof(packet));
+  uint8_t* raw = (uint8_t*)&packet;
+  uint8_t present = sections(wire);
+  PacketFieldCodec<0>::decode(wire, 1 << SECTION_HEADER, raw);
+  PacketFieldCodec<0>::decode(wire + HEADER_SIZE + 1, present & ~(1 << SECTION_HEADER), raw);
+  return expected;
+}
+
+size_t BatchFrameDecoder::decode(const uint8_t* frame, size_t length, SensorDataPacket* packets, size_t capacity) {
+  if (length < 3 + 4 || frame[0] != BATCH_FRAME_MAGIC || frame[1] != BATCH_FRAME_VERSION) {
+    return 0;
+  }
+  size_t end = length - 4;
+  uint32_t crc;
+  memcpy(&crc, frame + end, sizeof(crc));
+  size_t count = frame[2];
+  if (count == 0 || count > capacity || Crc32::update(0, frame, end) != crc) {
+    return 0;
+  }
+
+  // The first packet carries its own CRC as well
+  size_t offset = 3;
+  size_t first = PacketDecoder::decode(frame + offset, end - offset, packets[0]);
+  if (first == 0) {
+    return 0;
+  }
+  offset += first;
+
+  for (size_t i = 1; i < count; i++) {
+    if (offset >= end) {
+      return 0;
+    }
+    uint8_t present = frame[offset++] | (1 << SECTION_HEADER);
+    const uint8_t* previous = (const uint8_t*)&packets[i - 1];
+    uint8_t* current = (uint8_t*)&packets[i];
+
+    // Constant fields repeat, the rest is previous + delta (previous is 0 if absent)
+    memcpy(current, previous, sizeof(SensorDataPacket));
+    for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+      const PacketFieldSpec& field = PACKET_SCHEMA[f];
+      if (isConstantField(field.type)) {
+        continue;
+      }
+      int64_t value = 0;
+      if (present & (1 << field.section)) {
+        uint64_t zigzag;
+        if (!readVarint(frame, end, offset, zigzag)) {
+          return 0;
+        }
+        int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        value = readField(previous, field) + delta;
+      }
+      writeField(current, field, value);
+    }
+  }
+
+  return offset == end ? count : 0;
+}
+
+bool BatchFrameDecoder::readVarint(const uint8_t* data, size_t end, size_t& offset, uint64_t& value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64 && offset < end; shift += 7) {
+    uint8_t byte = data[offset++];
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int64_t BatchFrameDecoder::readField(const uint8_t* packet, const PacketFieldSpec& field) {
+  // Little endian like the packet, same widening as BatchFrameEncoder::readField
+  const uint8_t* p = packet + field.offset;
+  bool isSigned = isSignedField(field.type);
+  switch (field.size) {
+    case 1:
+      return isSigned ? (int64_t)(int8_t)p[0] : (int64_t)p[0];
+    case 2: {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      return isSigned ? (int64_t)(int16_t)v : (int64_t)v;
+    }
+    default: {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return isSigned ? (int64_t)(int32_t)v : (int64_t)v;
+    }
+  }
+}
+
+void BatchFrameDecoder::writeField(uint8_t* packet, const PacketFieldSpec& field, int64_t value) {
+  uint32_t v = (uint32_t)value;  // Truncated to the field width below
+  memcpy(packet + field.offset, &v, field.size);
+}
+
+#endif
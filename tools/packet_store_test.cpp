@@ -0,0 +1,327 @@
+// ===== PACKET STORE TEST =====
+// Runs PacketStore.h unchanged against the in-memory LittleFS of
+// tools/host, which can cut the power after any flash write; a reboot is a
+// new PacketStore on the same files. Every record carries its sequence
+// number, so each case checks exactly which records come out of the store:
+//  - format record: written by begin(), segments without it or with
+//    another record size are dropped
+//  - torn append: a record without its check byte (power cut between the
+//    two writes), a record with a wrong check byte
+//  - power cut in acknowledge() between removeSegment() and saveState()
+//  - store full: the oldest segments are dropped and counted, also while a
+//    read is outstanding
+//  - reboot in the middle of a drain: between read() and acknowledge(), and
+//    with the power cut after each flash write of a whole drain in turn -
+//    nothing may be lost, and at most one batch is sent twice
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. -Itools/host tools/packet_store_test.cpp -o packet_store_test && ./packet_store_test
+// Options: --verbose (DEBUG output of the store).
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PacketStore.h"
+
+static const size_t RECORD_SIZE = 48;
+static const size_t STRIDE = RECORD_SIZE + 1;
+static const uint32_t SEGMENT = BACKLOG_SEGMENT_RECORDS;
+static const uint32_t CAPACITY = BACKLOG_SEGMENT_RECORDS * BACKLOG_MAX_SEGMENTS;
+
+typedef std::vector<uint32_t> Ids;
+
+static int failures = 0;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", name);
+    failures++;
+  }
+}
+
+// ===== RECORDS =====
+// Sequence number, then a pattern derived from it
+static void makeRecord(uint32_t id, uint8_t* record) {
+  memcpy(record, &id, sizeof(id));
+  for (size_t i = sizeof(id); i < RECORD_SIZE; i++) {
+    record[i] = (uint8_t)(id * 31 + i);
+  }
+}
+
+static bool recordIntact(const uint8_t* record, uint32_t& id) {
+  memcpy(&id, record, sizeof(id));
+  uint8_t expected[RECORD_SIZE];
+  makeRecord(id, expected);
+  return memcmp(record, expected, RECORD_SIZE) == 0;
+}
+
+// ===== DEVICE =====
+// Power back on, new store on the same flash
+static std::unique_ptr<PacketStore> boot(size_t recordSize = RECORD_SIZE) {
+  LittleFS.powerOn();
+  std::unique_ptr<PacketStore> store(new PacketStore(recordSize));
+  store->begin();
+  return store;
+}
+
+static std::unique_ptr<PacketStore> freshStore() {
+  LittleFS.erase();
+  return boot();
+}
+
+static void push(PacketStore& store, uint32_t first, uint32_t count) {
+  uint8_t record[RECORD_SIZE];
+  for (uint32_t id = first; id < first + count; id++) {
+    makeRecord(id, record);
+    store.push(record);
+  }
+}
+
+static std::vector<uint8_t>& segmentFile(uint32_t segment) {
+  char path[32];
+  snprintf(path, sizeof(path), "%s/%08lu.seg", BACKLOG_DIR, (unsigned long)segment);
+  return LittleFS.files()[path];
+}
+
+static size_t segmentFiles() {
+  size_t count = 0;
+  for (const auto& file : LittleFS.files()) {
+    count += file.first.find(".seg") != std::string::npos;
+  }
+  return count;
+}
+
+// One upload as ByteTransmission does it: read a batch, send it, acknowledge.
+// The ids reach the server before acknowledge() runs.
+static size_t readBatch(PacketStore& store, Ids& received) {
+  uint8_t batch[BACKLOG_BATCH_SIZE * RECORD_SIZE];
+  size_t count = store.read(batch, BACKLOG_BATCH_SIZE);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t id;
+    expect(recordIntact(batch + i * RECORD_SIZE, id), "record content");
+    received.push_back(id);
+  }
+  return count;
+}
+
+static void drain(PacketStore& store, Ids& received) {
+  for (int guard = 0; store.pending() > 0 && guard < 100000; guard++) {
+    readBatch(store, received);
+    store.acknowledge();
+  }
+}
+
+static Ids range(uint32_t first, uint32_t end) {
+  Ids ids;
+  for (uint32_t id = first; id < end; id++) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+// Every id of [first, end) in order, none missing; a repeated stretch may go
+// back at most one batch. Returns the number of repeated records or -1.
+static long deliveredOnce(const Ids& received, uint32_t first, uint32_t end) {
+  uint32_t next = first;
+  long repeated = 0;
+  for (uint32_t id : received) {
+    if (id == next) {
+      next++;
+    } else if (id < next && next - id <= BACKLOG_BATCH_SIZE) {
+      repeated++;
+    } else {
+      return -1;
+    }
+  }
+  return next == end ? repeated : -1;
+}
+
+// ===== CASES =====
+static void testFormatRecord() {
+  std::unique_ptr<PacketStore> store = freshStore();
+  expect(LittleFS.exists(BACKLOG_DIR "/state"), "format: state written by begin()");
+
+  push(*store, 0, 10);
+  store = boot();
+  expect(store->pending() == 10, "format: records kept across a reboot");
+
+  LittleFS.remove(BACKLOG_DIR "/state");
+  store = boot();
+  expect(store->pending() == 0 && segmentFiles() == 0, "format: segments without state dropped");
+  expect(LittleFS.exists(BACKLOG_DIR "/state"), "format: state rewritten");
+
+  push(*store, 0, 10);
+  store = boot(RECORD_SIZE + 4);
+  expect(store->pending() == 0 && segmentFiles() == 0, "format: segments of another record size dropped");
+}
+
+static void testTornAppend() {
+  // Power cut after the record, before its check byte
+  std::unique_ptr<PacketStore> store = freshStore();
+  push(*store, 0, 100);
+  LittleFS.cutPowerAfter(1);
+  push(*store, 100, 1);
+  expect(segmentFile(2).size() == 36 * STRIDE + RECORD_SIZE, "torn: record without check byte on flash");
+
+  store = boot();
+  expect(store->pending() == 100, "torn: pending after reboot");
+  push(*store, 101, 10);
+  expect(segmentFile(2).size() == 36 * STRIDE + RECORD_SIZE && segmentFile(3).size() == 10 * STRIDE,
+         "torn: next record in a new segment");
+
+  Ids received;
+  drain(*store, received);
+  Ids expected = range(0, 100);
+  Ids after = range(101, 111);
+  expected.insert(expected.end(), after.begin(), after.end());
+  expect(received == expected, "torn: all other records in order");
+  expect(store->getCorruptRecords() == 1, "torn: one corrupt record");
+
+  // Wrong check byte in the middle of a segment
+  store = freshStore();
+  push(*store, 0, 100);
+  segmentFile(1)[10 * STRIDE + 5] ^= 0x40;
+  store = boot();
+  received.clear();
+  drain(*store, received);
+  expected = range(0, 100);
+  expected.erase(expected.begin() + 10);
+  expect(received == expected, "check byte: damaged record skipped");
+  expect(store->getCorruptRecords() == 1, "check byte: one corrupt record");
+}
+
+static void testCutBeforeSaveState() {
+  std::unique_ptr<PacketStore> store = freshStore();
+  push(*store, 0, 3 * SEGMENT);
+
+  // Two batches empty segment 1; the third ends in segment 2, so its
+  // acknowledge() removes segment 1 and then saves the state
+  Ids received;
+  for (int batch = 0; batch < 2; batch++) {
+    readBatch(*store, received);
+    store->acknowledge();
+  }
+  readBatch(*store, received);
+  LittleFS.cutPowerAfter(1);
+  store->acknowledge();
+  expect(segmentFiles() == 2, "cut before saveState: segment 1 removed");
+
+  store = boot();
+  expect(store->pending() == 2 * SEGMENT, "cut before saveState: read from segment 2");
+  drain(*store, received);
+  expect(deliveredOnce(received, 0, 3 * SEGMENT) == BACKLOG_BATCH_SIZE,
+         "cut before saveState: nothing lost, one batch again");
+}
+
+static void testStoreFull() {
+  // 4 segments more than fit
+  std::unique_ptr<PacketStore> store = freshStore();
+  uint32_t total = CAPACITY + 3 * SEGMENT + 5;
+  push(*store, 0, total);
+  expect(store->getDroppedRecords() == 4 * SEGMENT, "full: dropped count");
+  expect(store->pending() == total - 4 * SEGMENT, "full: pending");
+  expect(segmentFiles() == BACKLOG_MAX_SEGMENTS, "full: segment files");
+
+  store = boot();
+  expect(store->pending() == total - 4 * SEGMENT, "full: pending after reboot");
+  Ids received;
+  drain(*store, received);
+  expect(received == range(4 * SEGMENT, total), "full: newest records in order");
+
+  // Oldest segment dropped while a batch of it is being uploaded
+  store = freshStore();
+  push(*store, 0, CAPACITY);
+  received.clear();
+  readBatch(*store, received);
+  push(*store, CAPACITY, SEGMENT);
+  store->acknowledge();
+  expect(store->getDroppedRecords() == SEGMENT, "full during upload: segment dropped");
+  drain(*store, received);
+  Ids expected = range(0, BACKLOG_BATCH_SIZE);
+  Ids rest = range(SEGMENT, CAPACITY + SEGMENT);
+  expected.insert(expected.end(), rest.begin(), rest.end());
+  expect(received == expected, "full during upload: read position moves past the dropped segment");
+}
+
+static void testRebootDuringDrain() {
+  const uint32_t total = 3 * SEGMENT + 10;
+
+  // Reboot between read() and acknowledge()
+  std::unique_ptr<PacketStore> store = freshStore();
+  push(*store, 0, total);
+  Ids received;
+  for (int batch = 0; batch < 3; batch++) {
+    readBatch(*store, received);
+    store->acknowledge();
+  }
+  readBatch(*store, received);
+  store = boot();
+  drain(*store, received);
+  expect(deliveredOnce(received, 0, total) == BACKLOG_BATCH_SIZE,
+         "reboot before acknowledge: nothing lost, one batch again");
+
+  // Power cut after each flash write of an undisturbed drain
+  store = freshStore();
+  push(*store, 0, total);
+  uint32_t before = LittleFS.flashWrites();
+  received.clear();
+  drain(*store, received);
+  uint32_t drainWrites = LittleFS.flashWrites() - before;
+
+  size_t cuts = 0;
+  size_t repeatedMax = 0;
+  for (uint32_t cut = 0; cut < drainWrites; cut++) {
+    store = freshStore();
+    push(*store, 0, total);
+    received.clear();
+    LittleFS.cutPowerAfter(cut);
+    while (store->pending() > 0) {
+      readBatch(*store, received);
+      store->acknowledge();
+      if (LittleFS.powerCut()) {
+        break;
+      }
+    }
+
+    store = boot();
+    drain(*store, received);
+    long repeated = deliveredOnce(received, 0, total);
+    if (repeated < 0) {
+      fprintf(stderr, "FAIL: power cut after drain write %u: records lost or out of order\n", cut);
+      failures++;
+    } else if ((size_t)repeated > repeatedMax) {
+      repeatedMax = repeated;
+    }
+    cuts++;
+  }
+  printf("Drain of %u records: %u flash writes, power cut after each: at most %zu records sent twice\n",
+         total, drainWrites, repeatedMax);
+  expect(cuts > 0, "drain sweep ran");
+}
+
+int main(int argc, char** argv) {
+  Serial.quiet = true;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--verbose") {
+      Serial.quiet = false;
+    } else {
+      fprintf(stderr, "Usage: %s [--verbose]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  testFormatRecord();
+  testTornAppend();
+  testCutBeforeSaveState();
+  testStoreFull();
+  testRebootDuringDrain();
+
+  if (failures > 0) {
+    printf("FAIL: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("OK: format record, torn appends, power cuts, full store and reboots during the drain\n");
+  return 0;
+}
@@ -0,0 +1,303 @@
+// ===== PMS5003 PARSER TEST =====
+// Feeds PmsParser.h byte streams as the PMS5003 UART delivers them and
+// checks every frame it returns:
+//  - fixed cases: clean frame with all fields, noise around it, the frame
+//    split at every position, false headers (0x42 0x4D with a wrong length,
+//    or a valid-looking header whose frame starts again inside it), broken
+//    checksums, command replies (8-byte frames), truncated frames
+//  - frames are read in place: frame() points into the parser and stays
+//    unchanged while the next frame is received
+//  - a random stream of frames mixed with noise, corrupted and truncated
+//    frames, fed in chunks of 1-32 bytes; the frames returned must be the
+//    ones a plain offset-by-offset search of the whole stream finds
+// Any difference fails the run; ns per byte of the random stream is printed.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/pms_parser_test.cpp -o pms_parser_test && ./pms_parser_test
+// Options: --frames N (100000), --seed N (1).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "PmsParser.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// ===== STREAM BUILDING =====
+static Bytes makeFrame(const uint16_t (&words)[13]) {
+  Bytes frame = {PMS_HEADER_1, PMS_HEADER_2, 0, PMS_FRAME_LENGTH};
+  for (uint16_t word : words) {
+    frame.push_back(word >> 8);
+    frame.push_back(word & 0xFF);
+  }
+  uint16_t sum = 0;
+  for (uint8_t byte : frame) {
+    sum += byte;
+  }
+  frame.push_back(sum >> 8);
+  frame.push_back(sum & 0xFF);
+  return frame;
+}
+
+static Bytes randomFrame(std::mt19937& rng) {
+  uint16_t words[13];
+  for (int i = 0; i < 12; i++) {
+    words[i] = (uint16_t)(rng() % (i < 6 ? 1000 : 65536));
+  }
+  words[12] = (uint16_t)(0x9100 | (rng() % 4));  // Version 0x91, error code
+  return makeFrame(words);
+}
+
+static void append(Bytes& stream, const Bytes& bytes) {
+  stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+// Frame found at every offset a byte-by-byte search accepts, skipping past it
+static std::vector<size_t> referenceFrames(const Bytes& stream) {
+  std::vector<size_t> offsets;
+  size_t i = 0;
+  while (i + PMS_FRAME_SIZE <= stream.size()) {
+    const uint8_t* p = &stream[i];
+    uint16_t sum = 0;
+    for (int k = 0; k < PMS_FRAME_SIZE - 2; k++) {
+      sum += p[k];
+    }
+    if (p[0] == PMS_HEADER_1 && p[1] == PMS_HEADER_2 && ((p[2] << 8) | p[3]) == PMS_FRAME_LENGTH &&
+        sum == ((p[30] << 8) | p[31])) {
+      offsets.push_back(i);
+      i += PMS_FRAME_SIZE;
+    } else {
+      i++;
+    }
+  }
+  return offsets;
+}
+
+// Frames the parser returns, fed in chunks like the UART driver delivers them
+static std::vector<Bytes> parse(PmsParser& parser, const Bytes& stream, std::mt19937* rng = nullptr) {
+  std::vector<Bytes> frames;
+  size_t i = 0;
+  while (i < stream.size()) {
+    size_t chunk = rng != nullptr ? 1 + (*rng)() % PMS_FRAME_SIZE : stream.size();
+    for (size_t end = std::min(stream.size(), i + chunk); i < end; i++) {
+      if (parser.push(stream[i])) {
+        const PmsFrame* frame = parser.frame();
+        frames.push_back(Bytes(frame->bytes, frame->bytes + PMS_FRAME_SIZE));
+      }
+    }
+  }
+  return frames;
+}
+
+// ===== FIXED CASES =====
+static int failures = 0;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", name);
+    failures++;
+  }
+}
+
+static void expectFrames(const char* name, const Bytes& stream, const std::vector<Bytes>& expected) {
+  PmsParser parser;
+  expect(parse(parser, stream) == expected, name);
+}
+
+static void fixedCases() {
+  static const uint16_t WORDS[13] = {11, 22, 33, 10, 20, 30, 3000, 900, 150, 20, 5, 1, 0x9100};
+  Bytes frame = makeFrame(WORDS);
+  Bytes other = makeFrame({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0x9102});
+
+  // All fields, read in place
+  PmsParser parser;
+  std::vector<Bytes> frames = parse(parser, frame);
+  const PmsFrame* decoded = parser.frame();
+  expect(frames.size() == 1 && decoded != nullptr, "clean frame");
+  if (decoded != nullptr) {
+    expect(decoded->pm1_0Cf1() == 11 && decoded->pm2_5Cf1() == 22 && decoded->pm10Cf1() == 33, "CF=1 values");
+    expect(decoded->pm1_0() == 10 && decoded->pm2_5() == 20 && decoded->pm10() == 30, "atmospheric values");
+    expect(decoded->particles(PMS_BIN_0_3) == 3000 && decoded->particles(PMS_BIN_0_5) == 900 &&
+           decoded->particles(PMS_BIN_1_0) == 150 && decoded->particles(PMS_BIN_2_5) == 20 &&
+           decoded->particles(PMS_BIN_5_0) == 5 && decoded->particles(PMS_BIN_10) == 1, "particle bins");
+    expect(decoded->version() == 0x91 && decoded->errorCode() == 0, "version and error code");
+  }
+
+  // Zero copy: the frame lives in the parser and survives the next one's reception
+  const uint8_t* parserStart = reinterpret_cast<const uint8_t*>(&parser);
+  const uint8_t* framePointer = reinterpret_cast<const uint8_t*>(decoded);
+  expect(framePointer >= parserStart && framePointer + sizeof(PmsFrame) <= parserStart + sizeof(parser),
+         "frame points into the parser");
+  for (size_t i = 0; i + 1 < other.size(); i++) {
+    parser.push(other[i]);
+  }
+  expect(decoded != nullptr && memcmp(decoded->bytes, frame.data(), PMS_FRAME_SIZE) == 0,
+         "frame unchanged while the next is received");
+  expect(parser.push(other.back()) && parser.frame() != decoded, "next frame in the other slot");
+
+  Bytes stream = {0x00, 0xFF, 0x4D, 0x42, 0x13};
+  append(stream, frame);
+  stream.insert(stream.end(), {0x42, 0x00, 0x4D});
+  expectFrames("noise around a frame", stream, {frame});
+
+  for (size_t split = 1; split < PMS_FRAME_SIZE; split++) {
+    PmsParser splitParser;
+    bool early = false;
+    for (size_t i = 0; i < split; i++) {
+      early |= splitParser.push(frame[i]);
+    }
+    bool complete = false;
+    for (size_t i = split; i < frame.size(); i++) {
+      complete = splitParser.push(frame[i]);
+    }
+    if (early || !complete) {
+      fprintf(stderr, "FAIL: frame split at byte %zu\n", split);
+      failures++;
+    }
+  }
+
+  stream = {PMS_HEADER_1, PMS_HEADER_1};
+  append(stream, frame);
+  expectFrames("repeated 0x42", stream, {frame});
+
+  // Command reply to passiveMode(): 0x42 0x4D 0x00 0x04 0xE1 0x00 0x01 0x74
+  stream = {0x42, 0x4D, 0x00, 0x04, 0xE1, 0x00, 0x01, 0x74};
+  append(stream, frame);
+  expectFrames("command reply", stream, {frame});
+
+  // Header with the right length, the real frame starting in its payload
+  stream = {0x42, 0x4D, 0x00, 0x1C, 0x01, 0x02};
+  append(stream, frame);
+  expectFrames("false header before a frame", stream, {frame});
+
+  // False header inside noise, length wrong
+  stream = {0x42, 0x4D, 0x42, 0x4D, 0x01, 0x00};
+  append(stream, frame);
+  expectFrames("false header with wrong length", stream, {frame});
+
+  Bytes broken = frame;
+  broken[10] ^= 0x20;
+  stream = broken;
+  append(stream, other);
+  expectFrames("broken checksum", stream, {other});
+
+  stream.assign(frame.begin(), frame.begin() + 20);
+  append(stream, other);
+  expectFrames("truncated frame", stream, {other});
+
+  stream = frame;
+  append(stream, other);
+  append(stream, frame);
+  expectFrames("back to back", stream, {frame, other, frame});
+
+  PmsParser resetParser;
+  for (size_t i = 0; i < 12; i++) {
+    resetParser.push(frame[i]);
+  }
+  resetParser.reset();
+  expect(parse(resetParser, other).size() == 1, "reset drops a partial frame");
+}
+
+// ===== RANDOM STREAM =====
+static Bytes noise(std::mt19937& rng) {
+  Bytes bytes;
+  size_t length = rng() % 40;
+  for (size_t i = 0; i < length; i++) {
+    switch (rng() % 8) {
+      case 0: bytes.push_back(PMS_HEADER_1); break;
+      case 1: bytes.push_back(PMS_HEADER_2); break;
+      case 2: bytes.insert(bytes.end(), {PMS_HEADER_1, PMS_HEADER_2, 0x00, (uint8_t)(rng() % 2 ? 0x1C : 0x04)}); break;
+      default: bytes.push_back((uint8_t)rng()); break;
+    }
+  }
+  return bytes;
+}
+
+int main(int argc, char** argv) {
+  size_t frameCount = 100000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--frames" && i + 1 < argc) {
+      frameCount = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--frames N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (frameCount == 0) {
+    fprintf(stderr, "--frames must be > 0\n");
+    return 2;
+  }
+
+  fixedCases();
+  if (failures > 0) {
+    return 1;
+  }
+  printf("Fixed cases ok\n");
+
+  // Valid frames, each preceded by noise and sometimes a corrupted or cut-off frame
+  std::mt19937 rng(seed);
+  Bytes stream;
+  std::vector<size_t> planted;
+  size_t corrupted = 0;
+  size_t truncated = 0;
+  for (size_t i = 0; i < frameCount; i++) {
+    append(stream, noise(rng));
+    uint32_t kind = rng() % 8;
+    if (kind == 0) {
+      Bytes bad = randomFrame(rng);
+      bad[4 + rng() % 28] ^= (uint8_t)(1 + rng() % 255);
+      append(stream, bad);
+      corrupted++;
+    } else if (kind == 1) {
+      Bytes cut = randomFrame(rng);
+      cut.resize(1 + rng() % (PMS_FRAME_SIZE - 1));
+      append(stream, cut);
+      truncated++;
+    }
+    planted.push_back(stream.size());
+    append(stream, randomFrame(rng));
+  }
+
+  std::vector<size_t> reference = referenceFrames(stream);
+  PmsParser parser;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Bytes> frames = parse(parser, stream, &rng);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  bool same = frames.size() == reference.size();
+  for (size_t i = 0; same && i < frames.size(); i++) {
+    same = memcmp(frames[i].data(), &stream[reference[i]], PMS_FRAME_SIZE) == 0;
+  }
+
+  // Planted frames the stream itself hides: a false header whose 32 bytes
+  // happen to sum up right (about 1 in 65536 tries)
+  size_t found = 0;
+  size_t r = 0;
+  for (size_t offset : planted) {
+    while (r < reference.size() && reference[r] < offset) {
+      r++;
+    }
+    found += r < reference.size() && reference[r] == offset;
+  }
+
+  const PmsParserStats& stats = parser.getStats();
+  printf("Random stream: %zu bytes, %zu frames planted (+%zu corrupted, +%zu truncated), %zu returned, "
+         "%zu planted found\n", stream.size(), planted.size(), corrupted, truncated, frames.size(), found);
+  printf("Parser stats: %u frames, %u checksum errors, %u length errors, %u bytes skipped\n",
+         stats.frames, stats.checksumErrors, stats.lengthErrors, stats.skippedBytes);
+  printf("%.1f ns/byte\n", seconds * 1e9 / stream.size());
+  if (!same) {
+    printf("FAIL: frames differ from the offset search\n");
+    return 1;
+  }
+  printf("OK: frames match the offset search\n");
+  return 0;
+}
@@ -0,0 +1,686 @@
+#ifndef SERIES_STORE_H
+#define SERIES_STORE_H
+
+// ===== TIME-SERIES STORE =====
+// Append-only storage for decoded sensor packets, one directory per device
+// (12 hex digits of the eFuse MAC) with four memory-mapped segment files:
+//   raw.seg - every packet, columnar: blocks of BLOCK_ROWS rows, each block
+//             a zone map (min/max time, rows in time order), the time
+//             column (ms), one column
+//             per PACKET_SCHEMA field at its packet width and the section
+//             bitmap. Fields are stored as sent, scaled on read.
+//   1m.seg, 1h.seg, 1d.seg - rollups of ROLLUP_FIELDS (pm2_5, iaq,
+//             co2_equivalent, bme_temperature): min, max, sum and count per
+//             bucket, dense from the device's origin (midnight UTC one day
+//             before its first sample, so a day of backlog still lands in
+//             a bucket).
+// Rollups are updated in place as packets arrive, so late backlog packets
+// fold into their old buckets. aggregate() answers a time range from the
+// coarsest buckets that fit and scans raw rows only for the edges; the
+// result equals scanRaw() over the same range.
+//
+// Files grow by doubling (sparse ftruncate + mremap); the descriptor is
+// closed after mapping so thousands of devices need no open files. Rows
+// count once the header's row counter moves past them - a crash loses at
+// most the packet being written. Host byte order, Linux only.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "packet_decoder.h"
+
+enum class RollupLevel : uint8_t { MINUTE, HOUR, DAY };
+
+static const size_t ROLLUP_LEVEL_COUNT = 3;
+static const int64_t ROLLUP_WIDTH_MS[ROLLUP_LEVEL_COUNT] = {60000, 3600000, 86400000};
+static const char* const ROLLUP_LEVEL_NAMES[ROLLUP_LEVEL_COUNT] = {"1m", "1h", "1d"};
+
+static constexpr size_t ROLLUP_FIELDS[] = {
+  fieldIndex("pm2_5"), fieldIndex("iaq"), fieldIndex("co2_equivalent"), fieldIndex("bme_temperature")
+};
+static constexpr size_t ROLLUP_FIELD_COUNT = sizeof(ROLLUP_FIELDS) / sizeof(ROLLUP_FIELDS[0]);
+
+// Min, max, sum and count of one field over a time range
+struct SeriesAggregate {
+  float min = INFINITY;
+  float max = -INFINITY;
+  double sum = 0;
+  uint64_t count = 0;
+
+  void add(float value) {
+    min = std::min(min, value);
+    max = std::max(max, value);
+    sum += value;
+    count++;
+  }
+  double mean() const { return count > 0 ? sum / count : NAN; }
+};
+
+// One field in one rollup bucket; count 0 = no sample yet
+struct RollupCell {
+  float min;
+  float max;
+  float sum;
+  uint32_t count;
+};
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  // Maps path, creating it with `size` bytes if missing
+  bool open(const std::string& path, size_t size, bool& created);
+  bool reserve(size_t size);   // Grows the file (zero-filled) and the mapping
+  void sync();
+
+  uint8_t* data() const { return base; }
+  size_t size() const { return length; }
+
+private:
+  std::string path;
+  uint8_t* base = nullptr;
+  size_t length = 0;
+};
+
+class SeriesStore {
+public:
+  static const size_t BLOCK_ROWS = 4096;   // Raw rows per block, a multiple of 8 keeps columns aligned
+
+  explicit SeriesStore(const std::string& directory) : directory(directory) {}
+
+  bool open();   // Creates the directory; devices are mapped on first use
+
+  // Stores one packet sampled at timeMs (Unix ms) and updates its rollups
+  bool append(const SensorDataPacket& packet, int64_t timeMs);
+
+  // Range queries over [fromMs, toMs); false if the device is unknown.
+  // aggregate() reads rollups for ROLLUP_FIELDS and scans other fields.
+  bool aggregate(uint64_t deviceId, size_t field, int64_t fromMs, int64_t toMs, SeriesAggregate& out);
+  bool scanRaw(uint64_t deviceId, size_t field, int64_t fromMs, int64_t toMs, SeriesAggregate& out);
+
+  // One aggregate per bucket of `level` from fromMs (rounded down to a
+  // bucket start), from the rollup or by scanning raw rows
+  bool series(uint64_t deviceId, size_t field, RollupLevel level, int64_t fromMs, size_t buckets,
+              std::vector<SeriesAggregate>& out);
+  bool scanRawSeries(uint64_t deviceId, size_t field, RollupLevel level, int64_t fromMs, size_t buckets,
+                     std::vector<SeriesAggregate>& out);
+
+  std::vector<uint64_t> devices() const;   // Devices on disk
+  uint64_t rows(uint64_t deviceId);
+  void sync();
+
+  uint64_t appended() const { return appendedRows; }
+  uint64_t outsideRollups() const { return outsideRollupRows; }   // Stored raw only
+
+  static uint64_t deviceKey(const uint8_t* deviceId);   // eFuse MAC, byte 0 lowest
+  static std::string deviceName(uint64_t deviceId);     // Directory name, hex like FlowSample::deviceId
+  static int rollupIndex(size_t field);                 // Position in ROLLUP_FIELDS, -1 if none
+
+private:
+  struct SegmentHeader {
+    char magic[4];              // "AQTS"
+    uint8_t version;
+    uint8_t kind;               // 0 = raw, 1 + RollupLevel
+    uint16_t reserved;
+    uint32_t unitBytes;         // Raw: bytes per block, rollup: bytes per bucket
+    uint32_t blockRows;
+    uint64_t rows;              // Raw: committed rows, rollup: buckets in the file
+    int64_t originMs;           // Rollup: start of bucket 0
+    uint64_t deviceId;
+    uint8_t padding[24];
+  };
+  static_assert(sizeof(SegmentHeader) == 64, "Segment header is one cache line");
+
+  // Byte offsets within a raw block; column[f] = 0 for fields not stored
+  struct RawLayout {
+    size_t zone;
+    size_t time;
+    size_t column[PACKET_FIELD_COUNT];
+    size_t sections;
+    size_t blockBytes;
+  };
+
+  struct Device {
+    std::mutex mutex;
+    MappedFile raw;
+    MappedFile rollups[ROLLUP_LEVEL_COUNT];
+    int64_t originMs = 0;
+  };
+
+  static const uint8_t VERSION = 1;
+  static const size_t ROLLUP_BUCKET_BYTES = ROLLUP_FIELD_COUNT * sizeof(RollupCell);
+  static const int64_t MAX_SPAN_MS = 20ll * 366 * 86400000;   // Rollup range past the origin
+
+  std::string directory;
+  mutable std::mutex devicesMutex;
+  std::unordered_map<uint64_t, std::unique_ptr<Device>> deviceMap;
+  std::atomic<uint64_t> appendedRows{0};
+  std::atomic<uint64_t> outsideRollupRows{0};
+
+  static const RawLayout& rawLayout();
+  static bool storedField(size_t field) { return !isConstantField(PACKET_SCHEMA[field].type); }
+  static float fieldValue(const uint8_t* column, size_t row, FieldType type, uint16_t scale);
+  static int64_t floorDiv(int64_t value, int64_t divisor);
+  static SegmentHeader* header(const MappedFile& file) { return (SegmentHeader*)file.data(); }
+  static RollupCell* bucket(const MappedFile& file, uint64_t index);
+
+  Device* device(uint64_t deviceId, int64_t timeMs, bool create);
+  bool openSegment(MappedFile& file, const std::string& path, uint8_t kind, uint32_t unitBytes, uint64_t deviceId,
+                   int64_t originMs, uint64_t rows);
+  void aggregateLevel(Device& device, size_t field, int rollup, int level, int64_t fromMs, int64_t toMs,
+                      SeriesAggregate& out);
+  void scanRows(Device& device, size_t field, int64_t fromMs, int64_t toMs, int64_t widthMs, SeriesAggregate* out,
+                size_t buckets);
+  template <typename T>
+  static void scanBlock(const uint8_t* block, size_t rows, size_t field, int64_t fromMs, int64_t toMs,
+                        int64_t widthMs, SeriesAggregate* out, size_t buckets);
+};
+
+// ===== IMPLEMENTATION =====
+MappedFile::~MappedFile() {
+  if (base != nullptr) {
+    munmap(base, length);
+  }
+}
+
+bool MappedFile::open(const std::string& filePath, size_t size, bool& created) {
+  path = filePath;
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    perror(path.c_str());
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  created = info.st_size == 0;
+  length = created ? size : (size_t)info.st_size;
+  if (created && ftruncate(fd, (off_t)length) != 0) {
+    perror(path.c_str());
+    close(fd);
+    return false;
+  }
+  void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    perror(path.c_str());
+    return false;
+  }
+  base = (uint8_t*)mapped;
+  return true;
+}
+
+bool MappedFile::reserve(size_t size) {
+  if (size <= length) {
+    return true;
+  }
+  size_t grown = std::max(size, length * 2);
+  int fd = ::open(path.c_str(), O_RDWR);
+  if (fd < 0 || ftruncate(fd, (off_t)grown) != 0) {
+    perror(path.c_str());
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  close(fd);
+  void* mapped = mremap(base, length, grown, MREMAP_MAYMOVE);
+  if (mapped == MAP_FAILED) {
+    perror(path.c_str());
+    return false;
+  }
+  base = (uint8_t*)mapped;
+  length = grown;
+  return true;
+}
+
+void MappedFile::sync() {
+  if (base != nullptr) {
+    msync(base, length, MS_ASYNC);
+  }
+}
+
+uint64_t SeriesStore::deviceKey(const uint8_t* deviceId) {
+  uint64_t key = 0;
+  for (size_t i = 0; i < 6; i++) {
+    key |= (uint64_t)deviceId[i] << (8 * i);
+  }
+  return key;
+}
+
+std::string SeriesStore::deviceName(uint64_t deviceId) {
+  char name[13];
+  for (size_t i = 0; i < 6; i++) {
+    snprintf(name + 2 * i, 3, "%02x", (unsigned)(deviceId >> (8 * i)) & 0xFF);
+  }
+  return name;
+}
+
+int SeriesStore::rollupIndex(size_t field) {
+  for (size_t i = 0; i < ROLLUP_FIELD_COUNT; i++) {
+    if (ROLLUP_FIELDS[i] == field) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+int64_t SeriesStore::floorDiv(int64_t value, int64_t divisor) {
+  return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+const SeriesStore::RawLayout& SeriesStore::rawLayout() {
+  static const RawLayout layout = [] {
+    // Widest columns first so every column stays naturally aligned
+    RawLayout built = {};
+    built.zone = 0;
+    built.time = 4 * sizeof(int64_t);   // Zone map: min time, max time, sorted flag, reserved
+    size_t offset = built.time + BLOCK_ROWS * sizeof(int64_t);
+    for (size_t width = 4; width >= 1; width /= 2) {
+      for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+        if (storedField(f) && PACKET_SCHEMA[f].size == width) {
+          built.column[f] = offset;
+          offset += BLOCK_ROWS * width;
+        }
+      }
+    }
+    built.sections = offset;
+    built.blockBytes = offset + BLOCK_ROWS;
+    return built;
+  }();
+  return layout;
+}
+
+// Same conversion as FlowPipeline::scaled(), in float - ingest and raw
+// scans share it so rollup min/max match a scan exactly
+float SeriesStore::fieldValue(const uint8_t* column, size_t row, FieldType type, uint16_t scale) {
+  double raw;
+  switch (type) {
+    case FieldType::I8:
+      raw = ((const int8_t*)column)[row];
+      break;
+    case FieldType::U16:
+      raw = ((const uint16_t*)column)[row];
+      break;
+    case FieldType::I16:
+      raw = ((const int16_t*)column)[row];
+      break;
+    case FieldType::U32:
+      raw = ((const uint32_t*)column)[row];
+      break;
+    default:
+      raw = column[row];
+      break;
+  }
+  return (float)(scale == 1 ? raw : raw / scale);
+}
+
+RollupCell* SeriesStore::bucket(const MappedFile& file, uint64_t index) {
+  return (RollupCell*)(file.data() + sizeof(SegmentHeader) + index * ROLLUP_BUCKET_BYTES);
+}
+
+bool SeriesStore::open() {
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror(directory.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SeriesStore::openSegment(MappedFile& file, const std::string& path, uint8_t kind, uint32_t unitBytes,
+                              uint64_t deviceId, int64_t originMs, uint64_t rows) {
+  bool created;
+  size_t size = kind == 0 ? sizeof(SegmentHeader) + unitBytes : sizeof(SegmentHeader) + rows * unitBytes;
+  if (!file.open(path, size, created)) {
+    return false;
+  }
+  SegmentHeader* segment = header(file);
+  if (created) {
+    memcpy(segment->magic, "AQTS", 4);
+    segment->version = VERSION;
+    segment->kind = kind;
+    segment->unitBytes = unitBytes;
+    segment->blockRows = kind == 0 ? BLOCK_ROWS : 1;
+    segment->rows = rows;
+    segment->originMs = originMs;
+    segment->deviceId = deviceId;
+    return true;
+  }
+  // A schema change alters the block size: refuse to read old segments as new
+  if (file.size() < sizeof(SegmentHeader) || memcmp(segment->magic, "AQTS", 4) != 0 || segment->version != VERSION ||
+      segment->kind != kind || segment->unitBytes != unitBytes) {
+    fprintf(stderr, "%s: not a version %u segment of this schema\n", path.c_str(), VERSION);
+    return false;
+  }
+  return true;
+}
+
+SeriesStore::Device* SeriesStore::device(uint64_t deviceId, int64_t timeMs, bool create) {
+  std::lock_guard<std::mutex> lock(devicesMutex);
+  auto found = deviceMap.find(deviceId);
+  if (found != deviceMap.end()) {
+    return found->second.get();
+  }
+
+  std::string path = directory + "/" + deviceName(deviceId);
+  struct stat info;
+  bool exists = stat((path + "/raw.seg").c_str(), &info) == 0;
+  if (!exists && (!create || (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST))) {
+    return nullptr;
+  }
+
+  std::unique_ptr<Device> opened(new Device());
+  int64_t day = ROLLUP_WIDTH_MS[(int)RollupLevel::DAY];
+  opened->originMs = (floorDiv(timeMs, day) - 1) * day;
+  if (!openSegment(opened->raw, path + "/raw.seg", 0, (uint32_t)rawLayout().blockBytes, deviceId, 0, 0)) {
+    return nullptr;
+  }
+  for (size_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+    // Two days of buckets to start with (at least one)
+    uint64_t buckets = (uint64_t)std::max<int64_t>(1, 2 * day / ROLLUP_WIDTH_MS[level]);
+    std::string file = path + "/" + ROLLUP_LEVEL_NAMES[level] + ".seg";
+    if (!openSegment(opened->rollups[level], file, (uint8_t)(1 + level), ROLLUP_BUCKET_BYTES, deviceId,
+                     opened->originMs, buckets)) {
+      return nullptr;
+    }
+  }
+  opened->originMs = header(opened->rollups[0])->originMs;   // Existing device: origin from disk
+  Device* result = opened.get();
+  deviceMap[deviceId] = std::move(opened);
+  return result;
+}
+
+bool SeriesStore::append(const SensorDataPacket& packet, int64_t timeMs) {
+  Device* target = device(deviceKey(packet.device_id), timeMs, true);
+  if (target == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(target->mutex);
+  const RawLayout& layout = rawLayout();
+  const uint8_t* bytes = (const uint8_t*)&packet;
+  uint8_t sections = PacketFieldCodec<0>::fixedSections() | PacketFieldCodec<0>::flaggedSections(bytes);
+
+  // Raw row
+  uint64_t row = header(target->raw)->rows;
+  size_t slot = row % BLOCK_ROWS;
+  size_t blockStart = sizeof(SegmentHeader) + (row / BLOCK_ROWS) * layout.blockBytes;
+  if (!target->raw.reserve(blockStart + layout.blockBytes)) {
+    return false;
+  }
+  uint8_t* block = target->raw.data() + blockStart;
+  int64_t* zone = (int64_t*)(block + layout.zone);
+  int64_t* time = (int64_t*)(block + layout.time);
+  zone[0] = slot == 0 ? timeMs : std::min(zone[0], timeMs);
+  zone[1] = slot == 0 ? timeMs : std::max(zone[1], timeMs);
+  zone[2] = slot == 0 || (zone[2] != 0 && timeMs >= time[slot - 1]);   // Backlog rows unsort a block
+  time[slot] = timeMs;
+  for (size_t f = 0; f < PACKET_FIELD_COUNT; f++) {
+    if (storedField(f)) {
+      memcpy(block + layout.column[f] + slot * PACKET_SCHEMA[f].size, bytes + PACKET_SCHEMA[f].offset,
+             PACKET_SCHEMA[f].size);
+    }
+  }
+  block[layout.sections + slot] = sections;
+  header(target->raw)->rows = row + 1;
+
+  // Rollups
+  appendedRows++;
+  if (timeMs < target->originMs || timeMs >= target->originMs + MAX_SPAN_MS) {
+    outsideRollupRows++;
+    return true;
+  }
+  float values[ROLLUP_FIELD_COUNT];
+  for (size_t i = 0; i < ROLLUP_FIELD_COUNT; i++) {
+    const PacketFieldSpec& field = PACKET_SCHEMA[ROLLUP_FIELDS[i]];
+    values[i] = fieldValue(block + layout.column[ROLLUP_FIELDS[i]], slot, field.type, field.scale);
+  }
+  for (size_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+    MappedFile& file = target->rollups[level];
+    uint64_t index = (uint64_t)((timeMs - target->originMs) / ROLLUP_WIDTH_MS[level]);
+    if (index >= header(file)->rows) {
+      uint64_t buckets = std::max(index + 1, header(file)->rows * 2);
+      if (!file.reserve(sizeof(SegmentHeader) + buckets * ROLLUP_BUCKET_BYTES)) {
+        return false;
+      }
+      header(file)->rows = buckets;
+    }
+    RollupCell* cells = bucket(file, index);
+    for (size_t i = 0; i < ROLLUP_FIELD_COUNT; i++) {
+      if (!(sections & (1 << PACKET_SCHEMA[ROLLUP_FIELDS[i]].section))) {
+        continue;
+      }
+      RollupCell& cell = cells[i];
+      cell.min = cell.count == 0 ? values[i] : std::min(cell.min, values[i]);
+      cell.max = cell.count == 0 ? values[i] : std::max(cell.max, values[i]);
+      cell.sum += values[i];
+      cell.count++;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+void SeriesStore::scanBlock(const uint8_t* block, size_t rows, size_t field, int64_t fromMs, int64_t toMs,
+                            int64_t widthMs, SeriesAggregate* out, size_t buckets) {
+  const RawLayout& layout = rawLayout();
+  const PacketFieldSpec& spec = PACKET_SCHEMA[field];
+  const int64_t* zone = (const int64_t*)(block + layout.zone);
+  const int64_t* time = (const int64_t*)(block + layout.time);
+  const T* column = (const T*)(block + layout.column[field]);
+  const uint8_t* sections = block + layout.sections;
+  uint8_t bit = (uint8_t)(1 << spec.section);
+  double scale = spec.scale;
+
+  // Rows in time order: binary search the range, unsorted blocks check every row
+  size_t first = 0;
+  size_t last = rows;
+  if (zone[2] != 0) {
+    first = (size_t)(std::lower_bound(time, time + rows, fromMs) - time);
+    last = (size_t)(std::lower_bound(time + first, time + rows, toMs) - time);
+  }
+  for (size_t i = first; i < last; i++) {
+    if (time[i] < fromMs || time[i] >= toMs || !(sections[i] & bit)) {
+      continue;
+    }
+    float value = (float)(spec.scale == 1 ? (double)column[i] : column[i] / scale);
+    size_t index = widthMs > 0 ? (size_t)((time[i] - fromMs) / widthMs) : 0;
+    if (index < buckets) {
+      out[index].add(value);
+    }
+  }
+}
+
+void SeriesStore::scanRows(Device& target, size_t field, int64_t fromMs, int64_t toMs, int64_t widthMs,
+                           SeriesAggregate* out, size_t buckets) {
+  const RawLayout& layout = rawLayout();
+  uint64_t rows = header(target.raw)->rows;
+  for (uint64_t first = 0; first < rows; first += BLOCK_ROWS) {
+    const uint8_t* block = target.raw.data() + sizeof(SegmentHeader) + (first / BLOCK_ROWS) * layout.blockBytes;
+    const int64_t* zone = (const int64_t*)(block + layout.zone);
+    if (zone[1] < fromMs || zone[0] >= toMs) {
+      continue;   // Zone map: no row of this block in range
+    }
+    size_t count = (size_t)std::min<uint64_t>(BLOCK_ROWS, rows - first);
+    switch (PACKET_SCHEMA[field].type) {
+      case FieldType::I8:
+        scanBlock<int8_t>(block, count, field, fromMs, toMs, widthMs, out, buckets);
+        break;
+      case FieldType::U16:
+        scanBlock<uint16_t>(block, count, field, fromMs, toMs, widthMs, out, buckets);
+        break;
+      case FieldType::I16:
+        scanBlock<int16_t>(block, count, field, fromMs, toMs, widthMs, out, buckets);
+        break;
+      case FieldType::U32:
+        scanBlock<uint32_t>(block, count, field, fromMs, toMs, widthMs, out, buckets);
+        break;
+      default:
+        scanBlock<uint8_t>(block, count, field, fromMs, toMs, widthMs, out, buckets);
+        break;
+    }
+  }
+}
+
+bool SeriesStore::scanRaw(uint64_t deviceId, size_t field, int64_t fromMs, int64_t toMs, SeriesAggregate& out) {
+  Device* target = field < PACKET_FIELD_COUNT && storedField(field) ? device(deviceId, 0, false) : nullptr;
+  if (target == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(target->mutex);
+  scanRows(*target, field, fromMs, toMs, 0, &out, 1);
+  return true;
+}
+
+// Whole buckets of `level` inside the range, the uncovered edges from the
+// next finer level and finally from raw rows
+void SeriesStore::aggregateLevel(Device& target, size_t field, int rollup, int level, int64_t fromMs, int64_t toMs,
+                                 SeriesAggregate& out) {
+  if (fromMs >= toMs) {
+    return;
+  }
+  if (level < 0 || toMs <= target.originMs) {
+    scanRows(target, field, fromMs, toMs, 0, &out, 1);
+    return;
+  }
+  if (fromMs < target.originMs) {
+    scanRows(target, field, fromMs, target.originMs, 0, &out, 1);
+    fromMs = target.originMs;
+  }
+  const MappedFile& file = target.rollups[level];
+  int64_t width = ROLLUP_WIDTH_MS[level];
+  int64_t first = floorDiv(fromMs - target.originMs + width - 1, width);
+  int64_t last = floorDiv(toMs - target.originMs, width);
+  if (first >= last) {
+    aggregateLevel(target, field, rollup, level - 1, fromMs, toMs, out);
+    return;
+  }
+  aggregateLevel(target, field, rollup, level - 1, fromMs, target.originMs + first * width, out);
+  int64_t end = std::min<int64_t>(last, (int64_t)header(file)->rows);
+  for (int64_t index = first; index < end; index++) {
+    const RollupCell& cell = bucket(file, (uint64_t)index)[rollup];
+    if (cell.count > 0) {
+      out.min = std::min(out.min, cell.min);
+      out.max = std::max(out.max, cell.max);
+      out.sum += cell.sum;
+      out.count += cell.count;
+    }
+  }
+  aggregateLevel(target, field, rollup, level - 1, target.originMs + last * width, toMs, out);
+}
+
+bool SeriesStore::aggregate(uint64_t deviceId, size_t field, int64_t fromMs, int64_t toMs, SeriesAggregate& out) {
+  int rollup = rollupIndex(field);
+  if (rollup < 0) {
+    return scanRaw(deviceId, field, fromMs, toMs, out);
+  }
+  Device* target = device(deviceId, 0, false);
+  if (target == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(target->mutex);
+  aggregateLevel(*target, field, rollup, (int)ROLLUP_LEVEL_COUNT - 1, fromMs, toMs, out);
+  return true;
+}
+
+bool SeriesStore::series(uint64_t deviceId, size_t field, RollupLevel level, int64_t fromMs, size_t buckets,
+                         std::vector<SeriesAggregate>& out) {
+  int rollup = rollupIndex(field);
+  if (rollup < 0) {
+    return scanRawSeries(deviceId, field, level, fromMs, buckets, out);
+  }
+  Device* target = device(deviceId, 0, false);
+  if (target == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(target->mutex);
+  const MappedFile& file = target->rollups[(int)level];
+  int64_t width = ROLLUP_WIDTH_MS[(int)level];
+  int64_t first = floorDiv(fromMs - target->originMs, width);
+  out.assign(buckets, SeriesAggregate());
+  for (size_t i = 0; i < buckets; i++) {
+    int64_t index = first + (int64_t)i;
+    if (index < 0 || index >= (int64_t)header(file)->rows) {
+      continue;   // Before the origin (raw only) or past the last sample
+    }
+    const RollupCell& cell = bucket(file, (uint64_t)index)[rollup];
+    if (cell.count > 0) {
+      out[i].min = cell.min;
+      out[i].max = cell.max;
+      out[i].sum = cell.sum;
+      out[i].count = cell.count;
+    }
+  }
+  return true;
+}
+
+bool SeriesStore::scanRawSeries(uint64_t deviceId, size_t field, RollupLevel level, int64_t fromMs, size_t buckets,
+                                std::vector<SeriesAggregate>& out) {
+  Device* target = field < PACKET_FIELD_COUNT && storedField(field) ? device(deviceId, 0, false) : nullptr;
+  if (target == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(target->mutex);
+  int64_t width = ROLLUP_WIDTH_MS[(int)level];
+  int64_t start = target->originMs + floorDiv(fromMs - target->originMs, width) * width;
+  out.assign(buckets, SeriesAggregate());
+  scanRows(*target, field, start, start + (int64_t)buckets * width, width, out.data(), buckets);
+  return true;
+}
+
+std::vector<uint64_t> SeriesStore::devices() const {
+  std::vector<uint64_t> found;
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    return found;
+  }
+  while (dirent* entry = readdir(dir)) {
+    uint8_t id[6];
+    if (strlen(entry->d_name) == 12 && sscanf(entry->d_name, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx", &id[0], &id[1],
+                                               &id[2], &id[3], &id[4], &id[5]) == 6) {
+      found.push_back(deviceKey(id));
+    }
+  }
+  closedir(dir);
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+uint64_t SeriesStore::rows(uint64_t deviceId) {
+  Device* target = device(deviceId, 0, false);
+  if (target == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(target->mutex);
+  return header(target->raw)->rows;
+}
+
+void SeriesStore::sync() {
+  std::lock_guard<std::mutex> lock(devicesMutex);
+  for (auto& entry : deviceMap) {
+    std::lock_guard<std::mutex> deviceLock(entry.second->mutex);
+    entry.second->raw.sync();
+    for (size_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+      entry.second->rollups[level].sync();
+    }
+  }
+}
+
+#endif // SERIES_STORE_H
@@ -0,0 +1,73 @@
+#ifndef STAND_IN_H
+#define STAND_IN_H
+
+// ===== STAND-IN HELPERS =====
+// Shared by the host stand-ins for the Node-RED flow (coap_server,
+// mqtt_broker): checks a v3 wire packet and builds the 8-byte
+// AQIResponsePacket the firmware expects (PM2.5 AQI only).
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "packet_decoder.h"
+
+static const uint8_t AQI_RESPONSE_MAGIC = 0xA1;  // As in ByteTransmission.h
+
+struct WirePacket {
+  size_t length;        // Wire length incl. CRC
+  uint8_t sections;     // Section bitmap
+  uint16_t bootCount;
+  uint32_t sequence;
+  bool hasPm25;
+  float pm25;
+};
+
+// ===== AQI ANSWER =====
+static float pm25Aqi(float pm25) {
+  // US EPA breakpoints, same as the flow's AQI Response Generator
+  static const float LIMITS[][4] = {
+    {0, 12, 0, 50}, {12.1f, 35.4f, 50, 100}, {35.5f, 55.4f, 100, 150},
+    {55.5f, 150.4f, 150, 200}, {150.5f, 250.4f, 200, 300}, {250.5f, 500.4f, 300, 500}
+  };
+  for (const auto& l : LIMITS) {
+    if (pm25 <= l[1]) {
+      return l[2] + (l[3] - l[2]) / (l[1] - l[0]) * (pm25 - l[0]);
+    }
+  }
+  return 500;
+}
+
+static std::vector<uint8_t> aqiResponse(float aqi) {
+  // Level ids and colors as enum AQILevel / AQI_LEVELS (25-point steps up to 300)
+  static const uint32_t COLORS[] = {0x808080, 0x40FF00, 0x80FF00, 0xC0FF00, 0xFFFF00, 0xFFC000,
+                                    0xFF7E00, 0xFF4000, 0xFF0000, 0xC00040, 0x8F0097, 0x800000};
+  uint8_t level = aqi <= 0 ? 1 : aqi <= 200 ? (uint8_t)(1 + ((int)ceilf(aqi) - 1) / 25)
+                : aqi <= 250 ? 9 : aqi <= 300 ? 10 : 11;
+  uint16_t value = (uint16_t)(aqi * 10 + 0.5f);
+  std::vector<uint8_t> body = {AQI_RESPONSE_MAGIC, (uint8_t)value, (uint8_t)(value >> 8), level,
+                               (uint8_t)(COLORS[level] >> 16), (uint8_t)(COLORS[level] >> 8),
+                               (uint8_t)COLORS[level], 0};
+  for (size_t i = 0; i < 7; i++) {
+    body[7] ^= body[i];
+  }
+  return body;
+}
+
+// Checks magic, length and CRC-32 of one v3 packet filling the whole buffer
+static bool inspectPacket(const uint8_t* data, size_t length, WirePacket& packet) {
+  SensorDataPacket decoded;
+  if (PacketDecoder::decode(data, length, decoded) != length) {
+    return false;
+  }
+
+  packet.length = length;
+  packet.sections = PacketDecoder::sections(data);
+  packet.bootCount = decoded.boot_count;
+  packet.sequence = decoded.sequence;
+  packet.hasPm25 = (packet.sections & (1 << SECTION_PMS5003)) != 0;
+  packet.pm25 = decoded.pm2_5;
+  return true;
+}
+
+#endif
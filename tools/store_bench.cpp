@@ -0,0 +1,367 @@
+// ===== SERIES STORE BENCHMARK =====
+// Fills a tools/series_store.h store with weeks of 10 s packets from many
+// monitors - in arrival order, outages delivered late as backlog - then
+// times range queries answered by scanning raw rows against the same
+// queries answered from the 1 min / 1 h / 1 day rollups, and checks that
+// both give the same count, min, max and mean.
+//
+// Build and run from the repository root (Linux):
+//   g++ -std=c++17 -O2 -I. tools/store_bench.cpp -o store_bench && ./store_bench
+// Options: --dir DIR (store_bench.data, must not hold a store yet),
+// --devices N (20), --days N (28), --queries N (200 per query kind),
+// --keep 1 (leave the store on disk), --seed N.
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "series_store.h"
+
+static const int64_t SAMPLE_MS = 10000;                 // DATA_SEND_INTERVAL
+static const int64_t START_MS = 1767571200000ll;        // 2026-01-05 00:00 UTC
+static const int64_t HOUR_MS = 3600000;
+static const int64_t DAY_MS = 86400000;
+
+struct Options {
+  std::string dir = "store_bench.data";
+  unsigned devices = 20;
+  unsigned days = 28;
+  unsigned queries = 200;
+  bool keep = false;
+  unsigned seed = 14;
+};
+
+static double nowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ===== PACKET GENERATOR =====
+// Random walks per device; about one outage every three days whose packets
+// arrive together when it ends, like a drained backlog
+struct Monitor {
+  SensorDataPacket packet;
+  int64_t outageUntil = 0;
+  std::vector<std::pair<SensorDataPacket, int64_t>> backlog;
+};
+
+static void initMonitor(Monitor& monitor, unsigned index) {
+  SensorDataPacket& p = monitor.packet;
+  memset(&p, 0, sizeof(p));
+  p.magic_version = PACKET_MAGIC_V3;
+  uint8_t id[6] = {0x24, 0x6F, 0x28, (uint8_t)(index >> 16), (uint8_t)(index >> 8), (uint8_t)index};
+  memcpy(p.device_id, id, sizeof(id));
+  p.boot_count = 1;
+  p.bme_temperature = 2100;
+  p.bme_humidity = 4500;
+  p.bme_pressure = 10130;
+  p.gas_resistance = 120000;
+  p.iaq = 500;
+  p.co2_equivalent = 600;
+  p.breath_voc = 80;
+  p.bme_flags = 3;
+  p.pm1_0 = 4;
+  p.pm2_5 = 8;
+  p.pm10 = 12;
+  p.pms_flags = 1;
+  p.ds_flags = index % 4 != 0;
+  p.wifi_rssi = -60;
+}
+
+static void nextSample(Monitor& monitor, std::mt19937& rng) {
+  auto walk = [&rng](int value, int step, int low, int high) {
+    return std::min(high, std::max(low, value + (int)(rng() % (2 * step + 1)) - step));
+  };
+  SensorDataPacket& p = monitor.packet;
+  p.sequence++;
+  p.timestamp += 10;
+  p.uptime_seconds += 10;
+  p.bme_temperature = (int16_t)walk(p.bme_temperature, 3, 1500, 3000);
+  p.bme_humidity = (uint16_t)walk(p.bme_humidity, 10, 2000, 8000);
+  p.bme_pressure = (uint16_t)walk(p.bme_pressure, 1, 9800, 10400);
+  p.gas_resistance = (uint32_t)walk((int)p.gas_resistance, 300, 5000, 500000);
+  p.iaq = (uint16_t)walk(p.iaq, 8, 0, 5000);
+  p.static_iaq = p.iaq;
+  p.co2_equivalent = (uint16_t)walk(p.co2_equivalent, 4, 400, 5000);
+  p.breath_voc = (uint16_t)walk(p.breath_voc, 2, 0, 3000);
+  p.iaq_accuracy = p.co2_accuracy = p.voc_accuracy = 3;
+  p.ds_temperature = p.ds_flags ? (int16_t)(p.bme_temperature - 40) : 0;
+  p.pms_flags = rng() % 50 != 0;   // PMS5003 misses a frame now and then
+  p.pm2_5 = p.pms_flags ? (uint16_t)walk(p.pm2_5, 1, 0, 500) : 0;
+  p.pm1_0 = p.pms_flags ? (uint16_t)(p.pm2_5 / 2) : 0;
+  p.pm10 = p.pms_flags ? (uint16_t)(p.pm2_5 + 4) : 0;
+  p.wifi_rssi = (int8_t)walk(p.wifi_rssi, 1, -90, -40);
+}
+
+static bool ingest(SeriesStore& store, const Options& options, double& seconds) {
+  std::mt19937 rng(options.seed);
+  std::vector<Monitor> monitors(options.devices);
+  for (unsigned d = 0; d < options.devices; d++) {
+    initMonitor(monitors[d], d);
+  }
+
+  int64_t end = START_MS + (int64_t)options.days * DAY_MS;
+  double start = nowSeconds();
+  for (int64_t time = START_MS; time < end; time += SAMPLE_MS) {
+    for (Monitor& monitor : monitors) {
+      nextSample(monitor, rng);
+      if (monitor.outageUntil == 0 && rng() % (3 * 8640) == 0) {
+        monitor.outageUntil = time + (int64_t)(1 + rng() % 6) * HOUR_MS;
+      }
+      if (monitor.outageUntil != 0) {
+        monitor.backlog.emplace_back(monitor.packet, time);
+        if (time < monitor.outageUntil && time + SAMPLE_MS < end) {
+          continue;
+        }
+        // Back online: live packet last, backlog drained after it
+        std::swap(monitor.backlog.front(), monitor.backlog.back());
+        for (const auto& queued : monitor.backlog) {
+          if (!store.append(queued.first, queued.second)) {
+            return false;
+          }
+        }
+        monitor.backlog.clear();
+        monitor.outageUntil = 0;
+        continue;
+      }
+      if (!store.append(monitor.packet, time)) {
+        return false;
+      }
+    }
+  }
+  seconds = nowSeconds() - start;
+  return true;
+}
+
+// ===== QUERIES =====
+static bool sameAggregate(const SeriesAggregate& raw, const SeriesAggregate& rollup) {
+  if (raw.count != rollup.count) {
+    return false;
+  }
+  if (raw.count == 0) {
+    return true;
+  }
+  // Bucket sums are float, the raw scan sums in double
+  return raw.min == rollup.min && raw.max == rollup.max &&
+         fabs(raw.mean() - rollup.mean()) <= 1e-4 * std::max(1.0, fabs(raw.mean()));
+}
+
+struct QueryTiming {
+  double rawSeconds = 0;
+  double rollupSeconds = 0;
+  uint64_t rows = 0;
+};
+
+// Random device, field and unaligned start for each query; both paths run
+// the same query list
+static bool rangeQueries(SeriesStore& store, const std::vector<uint64_t>& devices, const Options& options,
+                         int64_t window, QueryTiming& timing) {
+  std::mt19937 rng(options.seed + (unsigned)(window / 1000));
+  int64_t span = (int64_t)options.days * DAY_MS;
+  struct Query {
+    uint64_t device;
+    size_t field;
+    int64_t from;
+  };
+  std::vector<Query> queries;
+  for (unsigned i = 0; i < options.queries; i++) {
+    int64_t offset = span > window ? (int64_t)(rng() % (uint64_t)((span - window) / 1000)) * 1000 : 0;
+    queries.push_back({devices[rng() % devices.size()], ROLLUP_FIELDS[rng() % ROLLUP_FIELD_COUNT], START_MS + offset});
+  }
+
+  std::vector<SeriesAggregate> raw(queries.size());
+  std::vector<SeriesAggregate> rollup(queries.size());
+  double start = nowSeconds();
+  for (size_t i = 0; i < queries.size(); i++) {
+    store.scanRaw(queries[i].device, queries[i].field, queries[i].from, queries[i].from + window, raw[i]);
+  }
+  timing.rawSeconds = nowSeconds() - start;
+  start = nowSeconds();
+  for (size_t i = 0; i < queries.size(); i++) {
+    store.aggregate(queries[i].device, queries[i].field, queries[i].from, queries[i].from + window, rollup[i]);
+  }
+  timing.rollupSeconds = nowSeconds() - start;
+
+  for (size_t i = 0; i < queries.size(); i++) {
+    timing.rows += raw[i].count;
+    if (!sameAggregate(raw[i], rollup[i])) {
+      fprintf(stderr, "%s from %lld: raw n=%llu min=%g max=%g mean=%g, rollup n=%llu min=%g max=%g mean=%g\n",
+              PACKET_SCHEMA[queries[i].field].name, (long long)queries[i].from, (unsigned long long)raw[i].count,
+              raw[i].min, raw[i].max, raw[i].mean(), (unsigned long long)rollup[i].count, rollup[i].min,
+              rollup[i].max, rollup[i].mean());
+      return false;
+    }
+  }
+  return true;
+}
+
+// Dashboard-style series: one point per bucket over the whole range
+static bool seriesQueries(SeriesStore& store, const std::vector<uint64_t>& devices, RollupLevel level,
+                          size_t buckets, int64_t from, QueryTiming& timing) {
+  std::vector<SeriesAggregate> raw;
+  std::vector<SeriesAggregate> rollup;
+  double start = nowSeconds();
+  for (uint64_t device : devices) {
+    for (size_t field : ROLLUP_FIELDS) {
+      store.scanRawSeries(device, field, level, from, buckets, raw);
+    }
+  }
+  timing.rawSeconds = nowSeconds() - start;
+  start = nowSeconds();
+  for (uint64_t device : devices) {
+    for (size_t field : ROLLUP_FIELDS) {
+      store.series(device, field, level, from, buckets, rollup);
+    }
+  }
+  timing.rollupSeconds = nowSeconds() - start;
+
+  for (uint64_t device : devices) {
+    for (size_t field : ROLLUP_FIELDS) {
+      store.scanRawSeries(device, field, level, from, buckets, raw);
+      store.series(device, field, level, from, buckets, rollup);
+      for (size_t b = 0; b < buckets; b++) {
+        timing.rows += raw[b].count;
+        if (!sameAggregate(raw[b], rollup[b])) {
+          fprintf(stderr, "%s %s bucket %zu differs\n", PACKET_SCHEMA[field].name,
+                  ROLLUP_LEVEL_NAMES[(int)level], b);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static void printTiming(const char* name, size_t queries, const QueryTiming& timing) {
+  printf("%-26s %8zu %12.1f %12.1f %12.1f %9.1fx\n", name, queries, (double)timing.rows / queries,
+         timing.rawSeconds * 1e6 / queries, timing.rollupSeconds * 1e6 / queries,
+         timing.rawSeconds / std::max(timing.rollupSeconds, 1e-9));
+}
+
+// ===== STORE FILES =====
+static const char* const SEGMENT_FILES[] = {"raw.seg", "1m.seg", "1h.seg", "1d.seg"};
+
+static std::string devicePath(const Options& options, uint64_t device) {
+  return options.dir + "/" + SeriesStore::deviceName(device);
+}
+
+// Bytes on disk (sparse files count allocated blocks only)
+static void diskUsage(const Options& options, const std::vector<uint64_t>& devices, uint64_t& raw, uint64_t& rollups) {
+  raw = rollups = 0;
+  for (uint64_t device : devices) {
+    for (size_t i = 0; i < 4; i++) {
+      struct stat info;
+      if (stat((devicePath(options, device) + "/" + SEGMENT_FILES[i]).c_str(), &info) == 0) {
+        (i == 0 ? raw : rollups) += (uint64_t)info.st_blocks * 512;
+      }
+    }
+  }
+}
+
+static void removeStore(const Options& options, const std::vector<uint64_t>& devices) {
+  for (uint64_t device : devices) {
+    for (const char* file : SEGMENT_FILES) {
+      unlink((devicePath(options, device) + "/" + file).c_str());
+    }
+    rmdir(devicePath(options, device).c_str());
+  }
+  rmdir(options.dir.c_str());
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--dir") {
+      options.dir = value;
+    } else if (arg == "--devices") {
+      options.devices = (unsigned)atoi(value.c_str());
+    } else if (arg == "--days") {
+      options.days = (unsigned)atoi(value.c_str());
+    } else if (arg == "--queries") {
+      options.queries = (unsigned)atoi(value.c_str());
+    } else if (arg == "--keep") {
+      options.keep = atoi(value.c_str()) != 0;
+    } else if (arg == "--seed") {
+      options.seed = (unsigned)atoi(value.c_str());
+    } else {
+      return false;
+    }
+  }
+  return options.devices > 0 && options.devices <= 0xFFFFFF && options.days > 0 && options.queries > 0;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--dir DIR] [--devices N] [--days N] [--queries N] [--keep 0|1] [--seed N]\n",
+            argv[0]);
+    return 2;
+  }
+
+  SeriesStore store(options.dir);
+  if (!store.open()) {
+    return 1;
+  }
+  if (!store.devices().empty()) {
+    fprintf(stderr, "%s already holds a store\n", options.dir.c_str());
+    return 1;
+  }
+
+  double seconds = 0;
+  if (!ingest(store, options, seconds)) {
+    return 1;
+  }
+  std::vector<uint64_t> devices = store.devices();
+  uint64_t rawBytes, rollupBytes;
+  diskUsage(options, devices, rawBytes, rollupBytes);
+  printf("ingest: %u devices x %u days, %llu packets in %.2f s (%.2f M packets/s), %llu outside rollups\n",
+         options.devices, options.days, (unsigned long long)store.appended(), seconds,
+         store.appended() / seconds / 1e6, (unsigned long long)store.outsideRollups());
+  printf("disk: raw %.1f MB (%.1f B/packet), rollups %.1f MB\n\n", rawBytes / 1e6,
+         (double)rawBytes / store.appended(), rollupBytes / 1e6);
+
+  printf("%-26s %8s %12s %12s %12s %10s\n", "query", "queries", "rows/query", "raw us", "rollup us", "speedup");
+  struct Window {
+    const char* name;
+    int64_t length;
+  } windows[] = {{"aggregate 1 h", HOUR_MS}, {"aggregate 1 day", DAY_MS}, {"aggregate 7 days", 7 * DAY_MS},
+                 {"aggregate all days", (int64_t)options.days * DAY_MS}};
+  for (const Window& window : windows) {
+    QueryTiming timing;
+    if (!rangeQueries(store, devices, options, window.length, timing)) {
+      return 1;
+    }
+    printTiming(window.name, options.queries, timing);
+  }
+
+  struct Series {
+    const char* name;
+    RollupLevel level;
+    size_t buckets;
+  } series[] = {{"series 1 h, last 7 days", RollupLevel::HOUR, 7 * 24},
+                {"series 1 day, all days", RollupLevel::DAY, options.days},
+                {"series 1 min, last day", RollupLevel::MINUTE, 24 * 60}};
+  for (const Series& query : series) {
+    QueryTiming timing;
+    int64_t end = START_MS + (int64_t)options.days * DAY_MS;
+    int64_t from = end - (int64_t)query.buckets * ROLLUP_WIDTH_MS[(int)query.level];
+    if (!seriesQueries(store, devices, query.level, query.buckets, from, timing)) {
+      return 1;
+    }
+    printTiming(query.name, devices.size() * ROLLUP_FIELD_COUNT, timing);
+  }
+  printf("\nverify: rollup answers match raw scans (count, min, max, mean)\n");
+
+  store.sync();
+  if (!options.keep) {
+    removeStore(options, devices);
+  }
+  return 0;
+}
@@ -0,0 +1,294 @@
+// ===== TLS SESSION TEST =====
+// Runs TlsClient.h unchanged on the real mbedtls (-DHOST_MBEDTLS: the
+// system's libmbedtls, 2.28 like the ESP32 core) against a local TLS echo
+// stand-in on OpenSSL, which keeps a session cache and issues session
+// tickets like a broker or reverse proxy. The stand-in records for every
+// connection whether OpenSSL resumed a session, and the client's counters
+// must match that view:
+//  - first connect: a full handshake
+//  - reconnects after stop(): each one resumed
+//  - server restart (empty session cache, new ticket key): the cached
+//    session is declined, the full handshake that follows counts as full
+//  - clearSession(): a full handshake
+//  - handshake cut off (the server closes on accept): counted as a
+//    failure, the session is dropped, the next connect is full
+// Every connection echoes a line, so records go both ways after a
+// resumption too.
+//
+// Build and run from the repository root (Linux, libmbedtls-dev and
+// libssl-dev):
+//   g++ -std=c++17 -O2 -DHOST_MBEDTLS -I. -Itools/host tools/tls_session_test.cpp -o tls_session_test -lmbedtls -lmbedx509 -lmbedcrypto -lssl -lcrypto -lpthread && ./tls_session_test
+// Options: --reconnects N (10), --verbose (DEBUG output of TlsClient).
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "TlsClient.h"
+
+static const int32_t TIMEOUT_MS = 3000;
+
+static int failures = 0;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", name);
+    failures++;
+  }
+}
+
+// ===== TLS STAND-IN =====
+// One thread per connection, echoes lines; restart() replaces the context,
+// which drops the session cache and the ticket key
+class StandIn {
+public:
+  uint16_t port = 0;
+
+  bool start() {
+    key = EVP_EC_gen("P-256");
+    certificate = selfSigned(key);
+    if (key == nullptr || certificate == nullptr || !restart()) {
+      return false;
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 8) != 0 ||
+        getsockname(listenFd, (sockaddr*)&address, &length) != 0) {
+      return false;
+    }
+    port = ntohs(address.sin_port);
+    acceptor = std::thread([this] { acceptLoop(); });
+    return true;
+  }
+
+  void stop() {
+    shutdown(listenFd, SHUT_RDWR);
+    close(listenFd);
+    acceptor.join();
+    for (std::thread& connection : connections) {
+      connection.join();
+    }
+    SSL_CTX_free(context);
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+  }
+
+  bool restart() {
+    SSL_CTX* fresh = SSL_CTX_new(TLS_server_method());
+    static const unsigned char SESSION_CONTEXT[] = "tls_session_test";
+    if (fresh == nullptr || SSL_CTX_use_certificate(fresh, certificate) != 1 ||
+        SSL_CTX_use_PrivateKey(fresh, key) != 1 ||
+        SSL_CTX_set_session_id_context(fresh, SESSION_CONTEXT, sizeof(SESSION_CONTEXT) - 1) != 1) {
+      SSL_CTX_free(fresh);
+      return false;
+    }
+    SSL_CTX_set_max_proto_version(fresh, TLS1_2_VERSION);  // As far as the client goes
+    std::lock_guard<std::mutex> guard(lock);
+    SSL_CTX_free(context);  // Connections hold their own reference
+    context = fresh;
+    return true;
+  }
+
+  void refuseNext() {
+    std::lock_guard<std::mutex> guard(lock);
+    refuse = true;
+  }
+
+  int full() {
+    std::lock_guard<std::mutex> guard(lock);
+    return fullCount;
+  }
+  int resumed() {
+    std::lock_guard<std::mutex> guard(lock);
+    return resumedCount;
+  }
+  bool lastResumed() {
+    std::lock_guard<std::mutex> guard(lock);
+    return lastWasResumed;
+  }
+
+private:
+  int listenFd = -1;
+  std::thread acceptor;
+  std::vector<std::thread> connections;
+  std::mutex lock;
+  EVP_PKEY* key = nullptr;
+  X509* certificate = nullptr;
+  SSL_CTX* context = nullptr;
+  bool refuse = false;
+  int fullCount = 0;
+  int resumedCount = 0;
+  bool lastWasResumed = false;
+
+  static X509* selfSigned(EVP_PKEY* key) {
+    X509* certificate = X509_new();
+    if (key == nullptr || certificate == nullptr) {
+      X509_free(certificate);
+      return nullptr;
+    }
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 3600);
+    X509_set_pubkey(certificate, key);
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(certificate, name);
+    if (X509_sign(certificate, key, EVP_sha256()) == 0) {
+      X509_free(certificate);
+      return nullptr;
+    }
+    return certificate;
+  }
+
+  void acceptLoop() {
+    int fd;
+    while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (refuse) {
+        refuse = false;
+        close(fd);  // Before the ServerHello
+        continue;
+      }
+      SSL* ssl = SSL_new(context);
+      connections.emplace_back([this, ssl, fd] { serve(ssl, fd); });
+    }
+  }
+
+  void serve(SSL* ssl, int fd) {
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) == 1) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        lastWasResumed = SSL_session_reused(ssl) == 1;
+        (lastWasResumed ? resumedCount : fullCount)++;
+      }
+      char data[256];
+      int count;
+      while ((count = SSL_read(ssl, data, sizeof(data))) > 0) {
+        SSL_write(ssl, data, count);
+      }
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+  }
+};
+
+// ===== CLIENT SIDE =====
+// Connect, one line there and back, stop() as HttpConnection does on a close
+static bool exchange(TlsClient& client, uint16_t port, const std::string& line) {
+  if (!client.connect(IPAddress(127, 0, 0, 1), port, TIMEOUT_MS)) {
+    return false;
+  }
+  bool echoed = client.write((const uint8_t*)line.data(), line.size()) == line.size();
+  std::string answer;
+  unsigned long start = millis();
+  while (echoed && answer.size() < line.size() && millis() - start < (unsigned long)TIMEOUT_MS) {
+    uint8_t buf[256];
+    int count = client.available() > 0 ? client.read(buf, sizeof(buf)) : -1;
+    if (count > 0) {
+      answer.append((const char*)buf, count);
+    } else {
+      delay(1);
+    }
+  }
+  client.stop();
+  return echoed && answer == line;
+}
+
+static void runCases(StandIn& server, int reconnects) {
+  TlsClient client;
+  client.setSecure(true);
+  client.setServerName("localhost");
+  const TlsClientStats& stats = client.getStats();
+
+  // First connect: nothing to resume
+  expect(exchange(client, server.port, "first\n"), "first connect: echoed");
+  expect(stats.fullHandshakes == 1 && stats.resumedHandshakes == 0, "first connect: full handshake");
+  expect(server.full() == 1 && !server.lastResumed(), "first connect: full on the server");
+
+  // Reconnects: every one resumed
+  bool echoed = true;
+  for (int i = 0; i < reconnects; i++) {
+    echoed = exchange(client, server.port, "again " + std::to_string(i) + "\n") && echoed;
+  }
+  expect(echoed, "reconnects: echoed");
+  expect(stats.resumedHandshakes == (uint32_t)reconnects && stats.fullHandshakes == 1,
+         "reconnects: all resumed, no further full handshake");
+  expect(server.resumed() == reconnects && server.full() == 1, "reconnects: resumed on the server");
+
+  // Server restart: the cached session is declined
+  expect(server.restart(), "restart: new server context");
+  expect(exchange(client, server.port, "restarted\n"), "restart: echoed");
+  expect(stats.fullHandshakes == 2 && !server.lastResumed(), "restart: declined session counts as full");
+  expect(exchange(client, server.port, "after restart\n"), "restart: next reconnect echoed");
+  expect(stats.resumedHandshakes == (uint32_t)reconnects + 1 && server.lastResumed(),
+         "restart: next reconnect resumes the new session");
+
+  // clearSession(): full again
+  client.clearSession();
+  expect(exchange(client, server.port, "cleared\n"), "clear: echoed");
+  expect(stats.fullHandshakes == 3 && !server.lastResumed(), "clear: full handshake");
+  expect(exchange(client, server.port, "after clear\n"), "clear: next reconnect echoed");
+
+  // Handshake cut off: failure, session dropped
+  server.refuseNext();
+  expect(!exchange(client, server.port, "refused\n"), "cut off: connect fails");
+  expect(stats.failures == 1, "cut off: counted as a failure");
+  expect(exchange(client, server.port, "after failure\n"), "cut off: next connect echoed");
+  expect(stats.fullHandshakes == 4 && !server.lastResumed(), "cut off: next connect is a full handshake");
+
+  expect(stats.fullHandshakes == (uint32_t)server.full() && stats.resumedHandshakes == (uint32_t)server.resumed(),
+         "counters match the server");
+
+  printf("TLS sessions: %u full handshakes (avg %u ms), %u resumed (avg %u ms), %u failed; "
+         "server: %d full, %d resumed\n",
+         (unsigned)stats.fullHandshakes, (unsigned)stats.averageFullMs(), (unsigned)stats.resumedHandshakes,
+         (unsigned)stats.averageResumedMs(), (unsigned)stats.failures, server.full(), server.resumed());
+}
+
+int main(int argc, char** argv) {
+  Serial.quiet = true;
+  int reconnects = 10;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--reconnects" && i + 1 < argc) {
+      reconnects = atoi(argv[++i]);
+    } else if (arg == "--verbose") {
+      Serial.quiet = false;
+    } else {
+      fprintf(stderr, "Usage: %s [--reconnects N] [--verbose]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (reconnects < 1) {
+    fprintf(stderr, "--reconnects must be > 0\n");
+    return 1;
+  }
+
+  StandIn server;
+  if (!server.start()) {
+    fprintf(stderr, "Cannot start the TLS stand-in on the loopback interface\n");
+    ERR_print_errors_fp(stderr);
+    return 1;
+  }
+  runCases(server, reconnects);
+  server.stop();
+
+  if (failures > 0) {
+    printf("FAIL: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("OK: 1 full + %d resumed handshakes, full after a server restart, clearSession() and a failure\n",
+         reconnects);
+  return 0;
+}